@@ -0,0 +1,209 @@
+/*
+ * Copyright 2026 Stefano Ceccherini <stefano.ceccherini@gmail.com>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+#include "ActivityDetector.h"
+
+#include <Bitmap.h>
+#include <InterfaceDefs.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+const static int32 kTileSize = 64;
+// One row every kRowSpacing is compared, starting from a
+// different one every frame
+const static int32 kRowSpacing = 8;
+// Share of the tiles which changing is enough for the highest rate
+const static float kFullActivityRatio = 0.03f;
+// The rate is lowered by a quarter at most this often
+const static bigtime_t kStepDownInterval = 500000;
+
+const static uint64 kHashPrime = 0x9e3779b185ebca87ULL;
+
+
+static inline uint64
+HashRow(uint64 hash, const uint8* data, size_t length)
+{
+	while (length >= sizeof(uint64)) {
+		uint64 word;
+		::memcpy(&word, data, sizeof(word));
+		hash = ((hash ^ word) * kHashPrime) ^ (hash >> 29);
+		data += sizeof(uint64);
+		length -= sizeof(uint64);
+	}
+	while (length-- > 0)
+		hash = (hash ^ *data++) * kHashPrime;
+	return hash;
+}
+
+
+ActivityDetector::ActivityDetector(int32 minFrameRate, int32 maxFrameRate)
+	:
+	fMinFrameRate(std::max(minFrameRate, int32(1))),
+	fMaxFrameRate(std::max(maxFrameRate, int32(1))),
+	fFrameRate(fMaxFrameRate),
+	fLastRateChange(0),
+	fChangedRatio(1),
+	fWidth(0),
+	fHeight(0),
+	fBytesPerRow(0),
+	fColorSpace(B_NO_COLOR_SPACE),
+	fRowLength(0),
+	fTilesX(0),
+	fTilesY(0),
+	fPhase(0),
+	fSamplesTaken(0)
+{
+	Restart();
+}
+
+
+void
+ActivityDetector::Restart()
+{
+	fFrameRate = fMaxFrameRate;
+	fLastRateChange = system_time();
+	fChangedRatio = 1;
+	fPhase = 0;
+	fSamplesTaken = 0;
+}
+
+
+// The rate only goes up at once: going down, it waits a bit
+// at every step, since the screen could change again soon
+int32
+ActivityDetector::AddFrame(const BBitmap* bitmap, bigtime_t frameTime)
+{
+	if (bitmap == NULL || _Prepare(bitmap) != B_OK) {
+		fChangedRatio = 1;
+		fFrameRate = fMaxFrameRate;
+		return fFrameRate;
+	}
+
+	fChangedRatio = float(_CountChangedTiles(bitmap)) / (fTilesX * fTilesY);
+
+	const int32 minFrameRate = std::min(fMinFrameRate, fMaxFrameRate);
+	const float activity = std::min(fChangedRatio / kFullActivityRatio, 1.0f);
+	const int32 target = minFrameRate
+		+ int32(ceilf((fMaxFrameRate - minFrameRate) * activity));
+	if (target >= fFrameRate) {
+		fFrameRate = target;
+		fLastRateChange = frameTime;
+	} else if (frameTime - fLastRateChange >= kStepDownInterval) {
+		fFrameRate = std::max(target, fFrameRate * 3 / 4);
+		fLastRateChange = frameTime;
+	}
+	return fFrameRate;
+}
+
+
+void
+ActivityDetector::SetMaxFrameRate(int32 framesPerSecond)
+{
+	fMaxFrameRate = std::max(framesPerSecond, int32(1));
+	fFrameRate = std::min(fFrameRate, fMaxFrameRate);
+}
+
+
+int32
+ActivityDetector::MaxFrameRate() const
+{
+	return fMaxFrameRate;
+}
+
+
+int32
+ActivityDetector::FrameRate() const
+{
+	return fFrameRate;
+}
+
+
+float
+ActivityDetector::ChangedRatio() const
+{
+	return fChangedRatio;
+}
+
+
+status_t
+ActivityDetector::_Prepare(const BBitmap* bitmap)
+{
+	const BRect bounds = bitmap->Bounds();
+	const int32 width = bounds.IntegerWidth() + 1;
+	const int32 height = bounds.IntegerHeight() + 1;
+	if (width == fWidth && height == fHeight && !fHashes.empty()
+		&& bitmap->BytesPerRow() == fBytesPerRow
+		&& bitmap->ColorSpace() == fColorSpace)
+		return B_OK;
+
+	// Tiles are made of bytes, so any color space will do.
+	// Without a whole number of bytes per pixel, the padding
+	// at the end of the rows is compared too, but never changes
+	size_t pixelChunk = 0;
+	size_t rowAlignment = 0;
+	size_t pixelsPerChunk = 0;
+	size_t rowLength = bitmap->BytesPerRow();
+	if (get_pixel_size_for(bitmap->ColorSpace(), &pixelChunk, &rowAlignment,
+			&pixelsPerChunk) == B_OK && pixelsPerChunk == 1)
+		rowLength = std::min(rowLength, size_t(width) * pixelChunk);
+
+	const uint32 tilesX = (width + kTileSize - 1) / kTileSize;
+	const uint32 tilesY = (height + kTileSize - 1) / kTileSize;
+	try {
+		fHashes.assign(size_t(tilesX) * tilesY * kRowSpacing, 0);
+	} catch (...) {
+		fHashes.clear();
+		fWidth = 0;
+		return B_NO_MEMORY;
+	}
+	fWidth = width;
+	fHeight = height;
+	fBytesPerRow = bitmap->BytesPerRow();
+	fColorSpace = bitmap->ColorSpace();
+	fRowLength = rowLength;
+	fTilesX = tilesX;
+	fTilesY = tilesY;
+	fPhase = 0;
+	fSamplesTaken = 0;
+	return B_OK;
+}
+
+
+// Only the tiles of rows which were sampled before are compared
+uint32
+ActivityDetector::_CountChangedTiles(const BBitmap* bitmap)
+{
+	const uint32 tileCount = fTilesX * fTilesY;
+	uint64* hashes = &fHashes[size_t(fPhase) * tileCount];
+	const bool compare = fSamplesTaken >= kRowSpacing;
+
+	const uint8* bits = (const uint8*)bitmap->Bits();
+	const size_t tileLength = (fRowLength + fTilesX - 1) / fTilesX;
+	uint32 changed = 0;
+	for (uint32 ty = 0; ty < fTilesY; ty++) {
+		const int32 top = ty * kTileSize;
+		const int32 bottom = std::min(top + kTileSize, fHeight);
+		for (uint32 tx = 0; tx < fTilesX; tx++) {
+			const size_t offset = tx * tileLength;
+			if (offset >= fRowLength)
+				break;
+			const size_t length = std::min(tileLength, fRowLength - offset);
+			uint64 hash = tx + 1;
+			for (int32 y = top + fPhase; y < bottom; y += kRowSpacing)
+				hash = HashRow(hash, bits + size_t(y) * fBytesPerRow + offset, length);
+
+			uint64& previous = hashes[ty * fTilesX + tx];
+			if (compare && hash != previous)
+				changed++;
+			previous = hash;
+		}
+	}
+
+	fPhase = (fPhase + 1) % kRowSpacing;
+	if (fSamplesTaken < kRowSpacing)
+		fSamplesTaken++;
+	return changed;
+}
@@ -0,0 +1,62 @@
+/*
+ * Copyright 2026 Stefano Ceccherini <stefano.ceccherini@gmail.com>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+#ifndef __ACTIVITYDETECTOR_H
+#define __ACTIVITYDETECTOR_H
+
+#include <GraphicsDefs.h>
+#include <OS.h>
+
+#include <vector>
+
+class BBitmap;
+// Picks the capture rate from how much the screen changes: close to
+// the lowest rate while it stays the same, up to the highest as soon
+// as it changes. Only a few rows of every tile are compared, a
+// different set every frame, so it's cheap enough for every frame:
+// anything taller than the row spacing is seen by the next frame,
+// thinner changes within as many frames as there are sets.
+class ActivityDetector {
+public:
+	ActivityDetector(int32 minFrameRate, int32 maxFrameRate);
+
+	// Starts again at the highest rate, for example after a pause
+	void Restart();
+
+	// Called for every captured frame, with its time. Returns the
+	// rate the next frames should be captured at
+	int32 AddFrame(const BBitmap* bitmap, bigtime_t frameTime);
+
+	// Lowered meanwhile when the frames can't be written fast enough
+	void SetMaxFrameRate(int32 framesPerSecond);
+	int32 MaxFrameRate() const;
+	int32 FrameRate() const;
+	// The share of the tiles which changed in the last frame
+	float ChangedRatio() const;
+
+private:
+	status_t _Prepare(const BBitmap* bitmap);
+	uint32 _CountChangedTiles(const BBitmap* bitmap);
+
+	int32 fMinFrameRate;
+	int32 fMaxFrameRate;
+	int32 fFrameRate;
+	bigtime_t fLastRateChange;
+	float fChangedRatio;
+
+	int32 fWidth;
+	int32 fHeight;
+	int32 fBytesPerRow;
+	color_space fColorSpace;
+	size_t fRowLength;
+	uint32 fTilesX;
+	uint32 fTilesY;
+	// The hashes of every set of rows, each compared with the
+	// ones of the frame which had the same set
+	std::vector<uint64> fHashes;
+	int32 fPhase;
+	int32 fSamplesTaken;
+};
+
+#endif // __ACTIVITYDETECTOR_H
@@ -9,19 +9,34 @@
 #include "FrameRateView.h"
 #include "MediaFormatView.h"
 #include "Settings.h"
+#include "Utils.h"
 
 #include <Box.h>
 #include <Catalog.h>
 #include <CheckBox.h>
 #include <LayoutBuilder.h>
+#include <String.h>
+#include <StringList.h>
+#include <TextControl.h>
+
+#include <algorithm>
+#include <cstdlib>
 
 
 const static uint32 kLocalUseDirectWindow = 'UsDW';
+const static uint32 kLocalCompressFrames = 'CoFr';
+const static uint32 kLocalAdaptiveFrameRate = 'AdFR';
+const static uint32 kLocalScaleAtCapture = 'ScCa';
+const static uint32 kLocalEncodeWhileRecording = 'EnWR';
+const static uint32 kLocalFFMPEGGIF = 'FfGi';
 const static uint32 kLocalHideDeskbar = 'HiDe';
 const static uint32 kLocalEnableShortcut = 'EnSh';
 const static uint32 kLocalSelectOnStart = 'SeSt';
 const static uint32 kLocalMinimizeOnRecording = 'MiRe';
 const static uint32 kLocalQuitWhenFinished = 'QuFi';
+const static uint32 kLocalEncodeRange = 'EnRa';
+const static uint32 kLocalEncodeRangeInFrames = 'EnRF';
+const static uint32 kLocalExtraOutputs = 'ExOu';
 
 
 #undef B_TRANSLATION_CONTEXT
@@ -70,6 +85,31 @@ AdvancedOptionsView::AdvancedOptionsView()
 			.Add(fUseDirectWindow = new BCheckBox("use_dw",
 					B_TRANSLATE("Use less CPU (BDirectWindow)"),
 					new BMessage(kLocalUseDirectWindow)))
+			.Add(fCompressFrames = new BCheckBox("compress_frames",
+					B_TRANSLATE("Compress captured frames (less disk, more CPU)"),
+					new BMessage(kLocalCompressFrames)))
+			.Add(fAdaptiveFrameRate = new BCheckBox("adaptive_frame_rate",
+					B_TRANSLATE("Lower the frame rate while the screen doesn't change"),
+					new BMessage(kLocalAdaptiveFrameRate)))
+			.Add(fScaleAtCapture = new BCheckBox("scale_at_capture",
+					B_TRANSLATE("Scale while recording (less disk, loses the original size)"),
+					new BMessage(kLocalScaleAtCapture)))
+			.Add(fEncodeWhileRecording = new BCheckBox("encode_while_recording",
+					B_TRANSLATE("Encode while recording"),
+					new BMessage(kLocalEncodeWhileRecording)))
+			.Add(fFFMPEGGIF = new BCheckBox("ffmpeg_gif",
+					B_TRANSLATE("Make GIF files with ffmpeg"),
+					new BMessage(kLocalFFMPEGGIF)))
+			.AddGroup(B_HORIZONTAL, B_USE_DEFAULT_SPACING)
+				.Add(fEncodeRangeStart = new BTextControl("encode_range_start",
+					B_TRANSLATE("Encode from:"), "", new BMessage(kLocalEncodeRange)))
+				.Add(fEncodeRangeEnd = new BTextControl("encode_range_end",
+					B_TRANSLATE("to:"), "", new BMessage(kLocalEncodeRange)))
+				.Add(fEncodeRangeInFrames = new BCheckBox("encode_range_in_frames",
+					B_TRANSLATE("Frames"), new BMessage(kLocalEncodeRangeInFrames)))
+			.End()
+			.Add(fExtraOutputs = new BTextControl("extra_outputs",
+				B_TRANSLATE("Also encode to:"), "", new BMessage(kLocalExtraOutputs)))
 			.Add(fMinimizeOnStart = new BCheckBox("hide_when_Recording",
 					B_TRANSLATE("Hide window when recording"),
 					new BMessage(kLocalMinimizeOnRecording)))
@@ -94,6 +134,26 @@ AdvancedOptionsView::AdvancedOptionsView()
 		"Stop recording with with CTRL+ALT+SHIFT+R,\n"
 		"or define a key combination with the Shortcuts preferences."));
 
+	fCompressFrames->SetToolTip(B_TRANSLATE(
+		"Use it when the disk can't keep up with the capture,\n"
+		"for example when recording big areas."));
+
+	fEncodeWhileRecording->SetToolTip(B_TRANSLATE(
+		"The clip is ready as soon as the recording stops.\n"
+		"Frames are saved to disk only when the encoder can't keep up."));
+
+	fFFMPEGGIF->SetToolTip(B_TRANSLATE(
+		"Slower, but the colors are dithered.\n"
+		"Needs ffmpeg to be installed."));
+
+	fEncodeRangeStart->SetToolTip(B_TRANSLATE(
+		"Only encode part of the recording, in seconds from its start,\n"
+		"or in frames. Leave empty to encode all of it."));
+
+	fExtraOutputs->SetToolTip(B_TRANSLATE(
+		"Other files made in the same pass, separated by ';', each as\n"
+		"format[:codec[:scale[:quality]]]. For example: gif::50;mkv"));
+
 	advancedBox->AddChild(layoutView);
 
 	_EnableDirectWindowIfSupported();
@@ -103,6 +163,12 @@ AdvancedOptionsView::AdvancedOptionsView()
 	app->SetUseDirectWindow(fUseDirectWindow->Value() == B_CONTROL_ON);
 
 	const Settings& settings = Settings::Current();
+	fCompressFrames->SetValue(settings.CompressFrames() ? B_CONTROL_ON : B_CONTROL_OFF);
+	fAdaptiveFrameRate->SetValue(settings.AdaptiveFrameRate() ? B_CONTROL_ON : B_CONTROL_OFF);
+	fScaleAtCapture->SetValue(settings.ScaleAtCapture() ? B_CONTROL_ON : B_CONTROL_OFF);
+	fEncodeWhileRecording->SetValue(settings.EncodeWhileRecording() ? B_CONTROL_ON : B_CONTROL_OFF);
+	fFFMPEGGIF->SetValue(settings.FFMPEGGIF() ? B_CONTROL_ON : B_CONTROL_OFF);
+	fFFMPEGGIF->SetEnabled(IsFFMPEGAvailable());
 	fMinimizeOnStart->SetValue(settings.MinimizeOnRecording() ? B_CONTROL_ON : B_CONTROL_OFF);
 	if (settings.EnableShortcut()) {
 		fHideDeskbarIcon->SetEnabled(true);
@@ -115,6 +181,8 @@ AdvancedOptionsView::AdvancedOptionsView()
 	fSelectOnStart->SetEnabled(settings.EnableShortcut());
 	fUseShortcut->SetValue(settings.EnableShortcut() ? B_CONTROL_ON : B_CONTROL_OFF);
 	fSelectOnStart->SetValue(settings.SelectOnStart() ? B_CONTROL_ON : B_CONTROL_OFF);
+	_UpdateEncodeRangeControls();
+	fExtraOutputs->SetText(settings.ExtraOutputs().Join(";").String());
 }
 
 
@@ -126,11 +194,20 @@ AdvancedOptionsView::AttachedToWindow()
 
 	SetViewColor(ui_color(B_PANEL_BACKGROUND_COLOR));
 	fUseDirectWindow->SetTarget(this);
+	fCompressFrames->SetTarget(this);
+	fAdaptiveFrameRate->SetTarget(this);
+	fScaleAtCapture->SetTarget(this);
+	fEncodeWhileRecording->SetTarget(this);
+	fFFMPEGGIF->SetTarget(this);
 	fMinimizeOnStart->SetTarget(this);
 	fHideDeskbarIcon->SetTarget(this);
 	fUseShortcut->SetTarget(this);
 	fSelectOnStart->SetTarget(this);
 	fQuitWhenFinished->SetTarget(this);
+	fEncodeRangeStart->SetTarget(this);
+	fEncodeRangeEnd->SetTarget(this);
+	fEncodeRangeInFrames->SetTarget(this);
+	fExtraOutputs->SetTarget(this);
 }
 
 
@@ -145,6 +222,24 @@ AdvancedOptionsView::MessageReceived(BMessage *message)
 			app->SetUseDirectWindow(fUseDirectWindow->Value() == B_CONTROL_ON);
 			break;
 		}
+		case kLocalCompressFrames:
+			Settings::Current().SetCompressFrames(fCompressFrames->Value() == B_CONTROL_ON);
+			break;
+		case kLocalAdaptiveFrameRate:
+			Settings::Current().SetAdaptiveFrameRate(
+				fAdaptiveFrameRate->Value() == B_CONTROL_ON);
+			break;
+		case kLocalScaleAtCapture:
+			Settings::Current().SetScaleAtCapture(
+				fScaleAtCapture->Value() == B_CONTROL_ON);
+			break;
+		case kLocalEncodeWhileRecording:
+			Settings::Current().SetEncodeWhileRecording(
+				fEncodeWhileRecording->Value() == B_CONTROL_ON);
+			break;
+		case kLocalFFMPEGGIF:
+			Settings::Current().SetFFMPEGGIF(fFFMPEGGIF->Value() == B_CONTROL_ON);
+			break;
 		case kLocalHideDeskbar:
 		{
 			bool hide = fHideDeskbarIcon->Value() == B_CONTROL_ON;
@@ -175,6 +270,24 @@ AdvancedOptionsView::MessageReceived(BMessage *message)
 			Settings::Current().SetQuitWhenFinished(fQuitWhenFinished->Value() == B_CONTROL_ON);
 			break;
 
+		case kLocalEncodeRange:
+		case kLocalEncodeRangeInFrames:
+			// Switching the unit keeps the numbers as they are
+			_SetEncodeRangeFromControls();
+			break;
+
+		case kLocalExtraOutputs:
+		{
+			// An invalid one reverts to what there was
+			BString text = fExtraOutputs->Text();
+			BStringList outputs;
+			if (text != "")
+				text.Split(";", true, outputs);
+			Settings::Current().SetExtraOutputs(outputs);
+			fExtraOutputs->SetText(Settings::Current().ExtraOutputs().Join(";").String());
+			break;
+		}
+
 		case kLocalEnableShortcut:
 			Settings::Current().SetEnableShortcut(fUseShortcut->Value() == B_CONTROL_ON);
 			fSelectOnStart->SetEnabled(fUseShortcut->Value() == B_CONTROL_ON);
@@ -207,6 +320,15 @@ AdvancedOptionsView::MessageReceived(BMessage *message)
 					fSelectOnStart->SetEnabled(false);
 					fHideDeskbarIcon->SetValue(B_CONTROL_OFF);
 					fQuitWhenFinished->SetValue(B_CONTROL_OFF);
+					fCompressFrames->SetValue(Settings::Current().CompressFrames()
+						? B_CONTROL_ON : B_CONTROL_OFF);
+					fAdaptiveFrameRate->SetValue(Settings::Current().AdaptiveFrameRate()
+						? B_CONTROL_ON : B_CONTROL_OFF);
+					fScaleAtCapture->SetValue(Settings::Current().ScaleAtCapture()
+						? B_CONTROL_ON : B_CONTROL_OFF);
+					_UpdateEncodeRangeControls();
+					fExtraOutputs->SetText(
+						Settings::Current().ExtraOutputs().Join(";").String());
 					_EnableDirectWindowIfSupported();
 					break;
 				}
@@ -231,3 +353,48 @@ AdvancedOptionsView::_EnableDirectWindowIfSupported()
 	} else
 		fUseDirectWindow->SetEnabled(false);
 }
+
+
+// Empty fields mean the start and the end of the recording
+void
+AdvancedOptionsView::_UpdateEncodeRangeControls()
+{
+	const Settings& settings = Settings::Current();
+	const bool inFrames = settings.EncodeRangeInFrames();
+	const int32 start = settings.EncodeRangeStart();
+	const int32 end = settings.EncodeRangeEnd();
+	BString text;
+	if (start > 0) {
+		if (inFrames)
+			text << start;
+		else
+			text.SetToFormat("%g", start / 1000.0);
+	}
+	fEncodeRangeStart->SetText(text.String());
+	text = "";
+	if (end > 0) {
+		if (inFrames)
+			text << end;
+		else
+			text.SetToFormat("%g", end / 1000.0);
+	}
+	fEncodeRangeEnd->SetText(text.String());
+	fEncodeRangeInFrames->SetValue(inFrames ? B_CONTROL_ON : B_CONTROL_OFF);
+}
+
+
+void
+AdvancedOptionsView::_SetEncodeRangeFromControls()
+{
+	const bool inFrames = fEncodeRangeInFrames->Value() == B_CONTROL_ON;
+	const double scale = inFrames ? 1 : 1000;
+	const double start = std::min(::strtod(fEncodeRangeStart->Text(), NULL) * scale,
+		double(INT32_MAX));
+	const double end = std::min(::strtod(fEncodeRangeEnd->Text(), NULL) * scale,
+		double(INT32_MAX));
+	Settings& settings = Settings::Current();
+	settings.SetEncodeRangeInFrames(inFrames);
+	settings.SetEncodeRangeStart(start > 0 ? int32(start) : 0);
+	settings.SetEncodeRangeEnd(end > 0 ? int32(end) : 0);
+	_UpdateEncodeRangeControls();
+}
@@ -8,6 +8,7 @@
 #include <View.h>
 
 class BCheckBox;
+class BTextControl;
 class SizeControl;
 class AdvancedOptionsView : public BView {
 public:
@@ -18,14 +19,25 @@ public:
 
 private:
 	BCheckBox* fUseDirectWindow;
+	BCheckBox* fCompressFrames;
+	BCheckBox* fAdaptiveFrameRate;
+	BCheckBox* fScaleAtCapture;
+	BCheckBox* fEncodeWhileRecording;
+	BCheckBox* fFFMPEGGIF;
 	BCheckBox *fMinimizeOnStart;
 	BCheckBox* fHideDeskbarIcon;
 	BCheckBox* fUseShortcut;
 	BCheckBox* fSelectOnStart;
 	BCheckBox* fQuitWhenFinished;
+	BTextControl* fEncodeRangeStart;
+	BTextControl* fEncodeRangeEnd;
+	BCheckBox* fEncodeRangeInFrames;
+	BTextControl* fExtraOutputs;
 	bool fCurrentMinimizeValue;
 
 	void _EnableDirectWindowIfSupported();
+	void _UpdateEncodeRangeControls();
+	void _SetEncodeRangeFromControls();
 };
 
 #endif // __ADVANCEDOPTIONSVIEW_H
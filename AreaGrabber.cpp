@@ -0,0 +1,141 @@
+/*
+ * Copyright 2026 Stefano Ceccherini <stefano.ceccherini@gmail.com>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+#include "AreaGrabber.h"
+
+#include "DirectFrameBuffer.h"
+#include "FrameAllocator.h"
+#include "TraceRecorder.h"
+#include "WorkerPool.h"
+
+#include <Bitmap.h>
+#include <Screen.h>
+
+#include <algorithm>
+#include <iostream>
+#include <new>
+
+
+AreaGrabber::AreaGrabber()
+	:
+	fPool(NULL),
+	fScreenSpace(B_NO_COLOR_SPACE),
+	fFrame(NULL)
+{
+}
+
+
+AreaGrabber::~AreaGrabber()
+{
+	_Unset();
+}
+
+
+status_t
+AreaGrabber::Init(const BRect& firstArea, const std::vector<BRect>& extraAreas,
+	color_space frameSpace)
+{
+	_Unset();
+
+	fScreenSpace = BScreen().ColorSpace();
+	size_t pixelChunk;
+	size_t rowAlignment;
+	size_t pixelsPerChunk;
+	if (!DirectFrameBuffer::CanConvert(fScreenSpace, frameSpace)
+		|| get_pixel_size_for(frameSpace, &pixelChunk, &rowAlignment,
+			&pixelsPerChunk) != B_OK || pixelsPerChunk != 1)
+		return B_NOT_SUPPORTED;
+
+	std::vector<BRect> areas;
+	try {
+		areas.push_back(firstArea);
+		areas.insert(areas.end(), extraAreas.begin(), extraAreas.end());
+		fGrabs.resize(areas.size());
+	} catch (...) {
+		return B_NO_MEMORY;
+	}
+
+	size_t offset = 0;
+	for (size_t i = 0; i < areas.size(); i++) {
+		area_grab& grab = fGrabs[i];
+		grab.area = areas[i];
+		grab.offset = offset;
+		grab.status = B_OK;
+		grab.bitmap = FrameAllocator::Allocate(kFrameStageCapture,
+			areas[i].OffsetToCopy(B_ORIGIN), fScreenSpace);
+		if (grab.bitmap == NULL) {
+			_Unset();
+			return B_NO_MEMORY;
+		}
+		offset += (areas[i].IntegerWidth() + 1) * pixelChunk;
+	}
+
+	// The capture thread grabs one of the areas too
+	fPool = WorkerPool::Shared(WorkerPool::kDisplayWork);
+	if (fPool == NULL) {
+		std::cerr << "AreaGrabber::Init(): cannot start the workers" << std::endl;
+		_Unset();
+		return B_NO_MEMORY;
+	}
+	return B_OK;
+}
+
+
+int32
+AreaGrabber::CountAreas() const
+{
+	return fGrabs.size();
+}
+
+
+status_t
+AreaGrabber::ReadFrame(BBitmap* frame, const BRect& firstArea)
+{
+	if (fPool == NULL)
+		return B_NO_INIT;
+	if (frame == NULL)
+		return B_BAD_VALUE;
+
+	fGrabs[0].area = firstArea;
+	fFrame = frame;
+	status_t status = fPool->Run(&_GrabArea, this, CountAreas());
+	fFrame = NULL;
+	for (int32 i = 0; i < CountAreas() && status == B_OK; i++)
+		status = fGrabs[i].status;
+	return status;
+}
+
+
+/* static */
+void
+AreaGrabber::_GrabArea(void* cookie, int32 index)
+{
+	AreaGrabber* grabber = static_cast<AreaGrabber*>(cookie);
+	area_grab& grab = grabber->fGrabs[index];
+	BBitmap* frame = grabber->fFrame;
+	TraceScope trace("grab area", index);
+
+	BScreen screen;
+	grab.status = screen.ReadBitmap(grab.bitmap, false, &grab.area);
+	if (grab.status != B_OK)
+		return;
+
+	const BRect bounds = grab.bitmap->Bounds();
+	const int32 height = std::min(bounds.IntegerHeight(),
+		frame->Bounds().IntegerHeight()) + 1;
+	grab.status = DirectFrameBuffer::ConvertRows(grab.bitmap->Bits(),
+		grab.bitmap->BytesPerRow(), grabber->fScreenSpace,
+		(uint8*)frame->Bits() + grab.offset, frame->BytesPerRow(),
+		frame->ColorSpace(), bounds.IntegerWidth() + 1, height);
+}
+
+
+void
+AreaGrabber::_Unset()
+{
+	fPool = NULL;
+	for (size_t i = 0; i < fGrabs.size(); i++)
+		FrameAllocator::Free(fGrabs[i].bitmap);
+	fGrabs.clear();
+}
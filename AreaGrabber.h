@@ -0,0 +1,59 @@
+/*
+ * Copyright 2026 Stefano Ceccherini <stefano.ceccherini@gmail.com>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+#ifndef __AREAGRABBER_H
+#define __AREAGRABBER_H
+
+#include <GraphicsDefs.h>
+#include <Rect.h>
+
+#include <vector>
+
+class BBitmap;
+class WorkerPool;
+// Grabs several areas of the screen into the same frame, side by
+// side from the left, aligned at the top: the parts of the frame
+// below the shorter ones are left as they are.
+// The areas are read on the shared display workers, all at the same
+// time, when the capture thread asks for the frame, so they show
+// the screen at the same moment and a frame takes as long as its
+// largest area. They're read through the app_server, since the frame
+// buffer of the direct window can only be read by one thread.
+class AreaGrabber {
+public:
+	AreaGrabber();
+	~AreaGrabber();
+
+	// The frames must be in a color space the screen can be
+	// converted to
+	status_t Init(const BRect& firstArea, const std::vector<BRect>& extraAreas,
+				color_space frameSpace);
+	int32 CountAreas() const;
+
+	// Only the first area can move, following a window or the pointer
+	status_t ReadFrame(BBitmap* frame, const BRect& firstArea);
+
+private:
+	struct area_grab {
+		// On the screen
+		BRect area;
+		// Where it starts in the frame, in bytes
+		size_t offset;
+		// At the screen depth
+		BBitmap* bitmap;
+		status_t status;
+	};
+
+	static void _GrabArea(void* cookie, int32 index);
+	void _Unset();
+
+	std::vector<area_grab> fGrabs;
+	// Shared, not owned
+	WorkerPool* fPool;
+	color_space fScreenSpace;
+	// Only while ReadFrame() runs
+	BBitmap* fFrame;
+};
+
+#endif // __AREAGRABBER_H
@@ -15,7 +15,8 @@ Arguments::Arguments(int defaultArgcNum, const char* const* defaultArgv)
 	  fShellArgumentCount(0),
 	  fShellArguments(NULL),
 	  fRecordNow(false),
-	  fFullScreen(false)
+	  fFullScreen(false),
+	  fBenchmark(false)
 {
 	_SetShellArguments(defaultArgcNum, defaultArgv);
 }
@@ -43,6 +44,14 @@ Arguments::Parse(int argc, const char* const* argv)
 			} else if (strcmp(arg, "-f") == 0 || strcmp(arg, "--fullscreen")
 					== 0)
 				fFullScreen = true;
+			else if (strcmp(arg, "-b") == 0 || strcmp(arg, "--benchmark") == 0)
+				fBenchmark = true;
+			else if ((strcmp(arg, "-o") == 0 || strcmp(arg, "--output") == 0)
+					&& argi + 1 < argc)
+				fOutputs.Add(argv[++argi]);
+			else if ((strcmp(arg, "-t") == 0 || strcmp(arg, "--trace") == 0)
+					&& argi + 1 < argc)
+				fTracePath = argv[++argi];
 			else {
 				// illegal option
 				fprintf(stderr, "Unrecognized option \"%s\"\n", arg);
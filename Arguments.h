@@ -7,6 +7,8 @@
 #define ARGUMENTS_H
 
 #include <Rect.h>
+#include <String.h>
+#include <StringList.h>
 
 class Arguments {
 public:
@@ -17,7 +19,10 @@ public:
 
 	bool RecordNow() const { return fRecordNow; }
 	bool FullScreen() const { return fFullScreen; }
+	bool Benchmark() const { return fBenchmark; }
 	bool UsageRequested() const	{ return fUsageRequested; }
+	const BStringList& Outputs() const { return fOutputs; }
+	const char* TracePath() const { return fTracePath.String(); }
 	void GetShellArguments(int& argc, const char* const*& argv) const;
 
 private:
@@ -28,6 +33,9 @@ private:
 	const char**	fShellArguments;
 	bool			fRecordNow;
 	bool			fFullScreen;
+	bool			fBenchmark;
+	BStringList		fOutputs;
+	BString			fTracePath;
 };
 
 
@@ -0,0 +1,275 @@
+/*
+ * Copyright 2026 Stefano Ceccherini <stefano.ceccherini@gmail.com>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+#include "BMPFrameStore.h"
+
+#include "FramesList.h"
+
+#include <Autolock.h>
+#include <Bitmap.h>
+#include <Directory.h>
+#include <Entry.h>
+#include <TranslationUtils.h>
+
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+
+BMPFrameStore::BMPFrameStore()
+	:
+	fColorSpace(B_NO_COLOR_SPACE),
+	fBytesPerRow(0),
+	fLocker("bmp frame store lock")
+{
+}
+
+
+/* virtual */
+BMPFrameStore::~BMPFrameStore()
+{
+}
+
+
+/* virtual */
+status_t
+BMPFrameStore::Create(const char* path, const BRect& bounds,
+	color_space colorSpace, int32 bytesPerRow, int64 memoryBudget)
+{
+	if (path == NULL || !bounds.IsValid() || bytesPerRow <= 0)
+		return B_BAD_VALUE;
+
+	_Unset();
+	fPath = path;
+	fBounds = bounds;
+	fColorSpace = colorSpace;
+	fBytesPerRow = bytesPerRow;
+	return B_OK;
+}
+
+
+// Can be called from many threads at the same time: only
+// adding the file to the list is serialized
+/* virtual */
+status_t
+BMPFrameStore::WriteFrame(const BBitmap* bitmap, bigtime_t frameTime)
+{
+	if (bitmap == NULL)
+		return B_BAD_VALUE;
+	if (fPath == "")
+		return B_NO_INIT;
+
+	frame_file frame;
+	frame.time = frameTime;
+	frame.name << fPath << "/" << frameTime << ".bmp";
+	status_t status = FramesList::WriteFrame(bitmap, frameTime, frame.name);
+	if (status != B_OK)
+		return status;
+
+	BAutolock _(fLocker);
+	try {
+		fFrames.push_back(frame);
+	} catch (...) {
+		BEntry(frame.name).Remove();
+		return B_NO_MEMORY;
+	}
+	return B_OK;
+}
+
+
+/* static */
+bool
+BMPFrameStore::_CompareTimes(const frame_file& a, const frame_file& b)
+{
+	return a.time < b.time;
+}
+
+
+// Writers don't complete in order
+/* virtual */
+status_t
+BMPFrameStore::Finish()
+{
+	BAutolock _(fLocker);
+	std::sort(fFrames.begin(), fFrames.end(), _CompareTimes);
+	return B_OK;
+}
+
+
+// The size of the frames is the one of the first file
+/* virtual */
+status_t
+BMPFrameStore::Open(const char* path)
+{
+	if (path == NULL)
+		return B_BAD_VALUE;
+
+	_Unset();
+
+	BDirectory dir(path);
+	status_t status = dir.InitCheck();
+	if (status != B_OK)
+		return status;
+
+	BEntry entry;
+	while (dir.GetNextEntry(&entry) == B_OK) {
+		// Frame files are named after their timestamp
+		const char* name = entry.Name();
+		if (!isdigit(name[0]))
+			continue;
+		frame_file frame;
+		frame.time = (bigtime_t)strtoull(name, NULL, 10);
+		frame.name << path << "/" << name;
+		try {
+			fFrames.push_back(frame);
+		} catch (...) {
+			_Unset();
+			return B_NO_MEMORY;
+		}
+	}
+	std::sort(fFrames.begin(), fFrames.end(), _CompareTimes);
+	fPath = path;
+
+	if (!fFrames.empty()) {
+		BBitmap* bitmap = CreateBitmap(0);
+		if (bitmap == NULL) {
+			std::cerr << "BMPFrameStore::Open(): cannot read " << fFrames[0].name.String() << std::endl;
+			_Unset();
+			return B_BAD_DATA;
+		}
+		fBounds = bitmap->Bounds();
+		fColorSpace = bitmap->ColorSpace();
+		fBytesPerRow = bitmap->BytesPerRow();
+		delete bitmap;
+	}
+	return B_OK;
+}
+
+
+/* virtual */
+const char*
+BMPFrameStore::Path() const
+{
+	return fPath.String();
+}
+
+
+/* virtual */
+BRect
+BMPFrameStore::Bounds() const
+{
+	return fBounds;
+}
+
+
+/* virtual */
+color_space
+BMPFrameStore::ColorSpace() const
+{
+	return fColorSpace;
+}
+
+
+/* virtual */
+int32
+BMPFrameStore::BytesPerRow() const
+{
+	return fBytesPerRow;
+}
+
+
+/* virtual */
+int32
+BMPFrameStore::CountFrames() const
+{
+	return fFrames.size();
+}
+
+
+/* virtual */
+bigtime_t
+BMPFrameStore::FrameTime(int32 index) const
+{
+	if (index < 0 || index >= CountFrames())
+		return -1;
+	return fFrames[index].time;
+}
+
+
+// The file is decoded by the translator, then copied: frames
+// which don't have the layout of the bitmap aren't converted
+/* virtual */
+status_t
+BMPFrameStore::ReadBitmap(int32 index, BBitmap* bitmap) const
+{
+	if (bitmap == NULL || index < 0 || index >= CountFrames())
+		return B_BAD_VALUE;
+
+	BBitmap* frame = CreateBitmap(index);
+	if (frame == NULL)
+		return B_ERROR;
+
+	status_t status = B_OK;
+	if (frame->ColorSpace() != bitmap->ColorSpace()
+		|| frame->BytesPerRow() != bitmap->BytesPerRow()
+		|| frame->BitsLength() != bitmap->BitsLength())
+		status = B_MISMATCHED_VALUES;
+	else
+		::memcpy(bitmap->Bits(), frame->Bits(), bitmap->BitsLength());
+	delete frame;
+	return status;
+}
+
+
+/* virtual */
+BBitmap*
+BMPFrameStore::CreateBitmap(int32 index) const
+{
+	if (index < 0 || index >= CountFrames())
+		return NULL;
+	return BTranslationUtils::GetBitmapFile(fFrames[index].name.String());
+}
+
+
+// The files of the frames which aren't kept are removed
+/* virtual */
+status_t
+BMPFrameStore::Trim(int32 first, int32 count)
+{
+	if (first < 0 || count < 0 || first + count > CountFrames())
+		return B_BAD_VALUE;
+
+	BAutolock _(fLocker);
+	for (int32 i = 0; i < CountFrames(); i++) {
+		if (i < first || i >= first + count)
+			BEntry(fFrames[i].name).Remove();
+	}
+	fFrames.erase(fFrames.begin() + first + count, fFrames.end());
+	fFrames.erase(fFrames.begin(), fFrames.begin() + first);
+	return B_OK;
+}
+
+
+/* virtual */
+void
+BMPFrameStore::Release()
+{
+	BAutolock _(fLocker);
+	for (size_t i = 0; i < fFrames.size(); i++)
+		BEntry(fFrames[i].name).Remove();
+	_Unset();
+}
+
+
+void
+BMPFrameStore::_Unset()
+{
+	fFrames.clear();
+	fPath = "";
+	fBounds = BRect();
+	fColorSpace = B_NO_COLOR_SPACE;
+	fBytesPerRow = 0;
+}
@@ -0,0 +1,63 @@
+/*
+ * Copyright 2026 Stefano Ceccherini <stefano.ceccherini@gmail.com>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+#ifndef __BMPFRAMESTORE_H
+#define __BMPFRAMESTORE_H
+
+#include "FrameStore.h"
+
+#include <Locker.h>
+#include <String.h>
+
+#include <vector>
+
+// Stores every frame in its own BMP file, named after its
+// timestamp, in the folder of the session.
+// Nothing is kept in memory: this is the slowest store, but the
+// frames can be looked at, or recovered, with any image viewer.
+class BMPFrameStore : public FrameStore {
+public:
+	BMPFrameStore();
+	virtual ~BMPFrameStore();
+
+	virtual status_t Create(const char* path, const BRect& bounds,
+				color_space colorSpace, int32 bytesPerRow,
+				int64 memoryBudget = 0);
+	virtual status_t WriteFrame(const BBitmap* bitmap, bigtime_t frameTime);
+	virtual status_t Finish();
+
+	// Reads all the frame files in the folder
+	virtual status_t Open(const char* path);
+
+	virtual const char* Path() const;
+	virtual BRect Bounds() const;
+	virtual color_space ColorSpace() const;
+	virtual int32 BytesPerRow() const;
+
+	virtual int32 CountFrames() const;
+	virtual bigtime_t FrameTime(int32 index) const;
+	virtual status_t ReadBitmap(int32 index, BBitmap* bitmap) const;
+	virtual BBitmap* CreateBitmap(int32 index) const;
+
+	virtual status_t Trim(int32 first, int32 count);
+	virtual void Release();
+
+private:
+	struct frame_file {
+		bigtime_t time;
+		BString name;
+	};
+
+	static bool _CompareTimes(const frame_file& a, const frame_file& b);
+	void _Unset();
+
+	BString fPath;
+	BRect fBounds;
+	color_space fColorSpace;
+	int32 fBytesPerRow;
+	std::vector<frame_file> fFrames;
+	BLocker fLocker;
+};
+
+#endif // __BMPFRAMESTORE_H
@@ -4,17 +4,41 @@
  */
 #include "BSCApp.h"
 
+#include "ActivityDetector.h"
+#include "AreaGrabber.h"
 #include "Arguments.h"
 #include "BSCWindow.h"
+#include "Benchmark.h"
+#include "CaptureThrottle.h"
+#include "CodecSpeedTest.h"
+#include "CursorFollower.h"
 #include "Constants.h"
 #include "ControllerObserver.h"
+#include "CursorTrack.h"
 #include "DeskbarControlView.h"
+#include "DirectFrameBuffer.h"
+#include "FrameAllocator.h"
+#include "FramePacer.h"
+#include "FramePool.h"
+#include "FramePreview.h"
+#include "FrameScaler.h"
+#include "FrameSpool.h"
+#include "FrameStore.h"
+#include "FrameWriter.h"
 #include "FramesList.h"
+#include "MediaCache.h"
 #include "MovieEncoder.h"
+#include "PipelineStats.h"
 #include "PublicMessages.h"
+#include "ReplayBuffer.h"
 #include "SelectionWindow.h"
+#include "SessionConfig.h"
 #include "Settings.h"
+#include "StripedFrameStore.h"
+#include "TraceRecorder.h"
 #include "Utils.h"
+#include "WindowTracker.h"
+#include "WorkerPool.h"
 
 #include <private/interface/AboutWindow.h>
 #include <Autolock.h>
@@ -25,6 +49,7 @@
 #include <Entry.h>
 #include <File.h>
 #include <FindDirectory.h>
+#include <InterfaceDefs.h>
 #include <MessageRunner.h>
 #include <NodeInfo.h>
 #include <PropertyInfo.h>
@@ -34,7 +59,9 @@
 #include <String.h>
 #include <StringList.h>
 
+#include <algorithm>
 #include <cerrno>
+#include <cmath>
 #include <cstdio>
 #include <cstdlib>
 #include <string>
@@ -59,9 +86,51 @@ const char* kAuthors[] = {
 #define kPropertyStartRecording "Record"
 #define kPropertyStopRecording "Stop"
 #define kPropertyCaptureRect "CaptureRect"
+#define kPropertyExtraCaptureAreas "ExtraCaptureAreas"
 #define kPropertyScaleFactor "Scale"
 #define kPropertyRecordingTime "RecordingTime"
 #define kPropertyQuitWhenFinished "QuitWhenFinished"
+#define kPropertyKeyFrameInterval "KeyFrameInterval"
+#define kPropertySceneChangeKeyFrames "SceneChangeKeyFrames"
+#define kPropertyEncodeSegments "EncodeSegments"
+#define kPropertyFrameStore "FrameStore"
+#define kPropertyUnbufferedWrites "UnbufferedWrites"
+#define kPropertyLockFrameBuffers "LockFrameBuffers"
+#define kPropertyCaptureBackpressure "CaptureBackpressure"
+#define kPropertyFollowCursor "FollowCursor"
+#define kPropertyFollowCursorDeadZone "FollowCursorDeadZone"
+#define kPropertyFollowCursorSmoothing "FollowCursorSmoothing"
+#define kPropertyStandby "Standby"
+#define kPropertyReplayBuffer "ReplayBuffer"
+#define kPropertyReplayBufferSeconds "ReplayBufferSeconds"
+#define kPropertyReplayBufferOnDisk "ReplayBufferOnDisk"
+#define kPropertySpoolFolders "SpoolFolders"
+#define kPropertyEncodeRangeStart "EncodeRangeStart"
+#define kPropertyEncodeRangeEnd "EncodeRangeEnd"
+#define kPropertyEncodeRangeInFrames "EncodeRangeInFrames"
+#define kPropertyExtraOutputs "ExtraOutputs"
+#define kPropertyAdaptiveFrameRate "AdaptiveFrameRate"
+#define kPropertyMinFrameRate "MinFrameRate"
+#define kPropertyScaleAtCapture "ScaleAtCapture"
+#define kPropertyTrace "Trace"
+#define kPropertySaveReplay "SaveReplay"
+#define kPropertyStats "Stats"
+
+// Number of threads which write the captured frames to disk
+const static int32 kFrameWriterCount = 2;
+// How often the capture progress is sent to the observers
+const static bigtime_t kStatsInterval = 500000;
+// Number of frames which can be queued to every writer
+const static int32 kFrameWriterQueueSize = 4;
+// Number of frame buffers preallocated for every capture session:
+// enough to fill all the queues, plus the ones being written
+// and the one being captured
+const static int32 kFrameBufferCount = kFrameWriterCount * (kFrameWriterQueueSize + 1) + 1;
+// Frames measured by every stage of the benchmark
+const static int32 kBenchmarkFrames = 100;
+// Free space a volume needs to be spooled to, and to keep spooling
+const static int64 kMinSpoolSpace = 64 * 1024 * 1024;
+const static int32 kSpoolSpaceSeconds = 10;
 
 const property_info kPropList[] = {
 	{
@@ -74,6 +143,17 @@ const property_info kPropList[] = {
 		{},
 		{}
 	},
+	{
+		kPropertyExtraCaptureAreas,
+		{ B_GET_PROPERTY, B_SET_PROPERTY },
+		{ B_NO_SPECIFIER },
+		"Set/Get the areas captured along with the capture rect, on "
+		"its right, as \"left,top,right,bottom\" separated by ';'",
+		0,
+		{ B_STRING_TYPE },
+		{},
+		{}
+	},
 	{
 		kPropertyScaleFactor,
 		{ B_GET_PROPERTY, B_SET_PROPERTY },
@@ -124,9 +204,294 @@ const property_info kPropList[] = {
 		{},
 		{}
 	},
+	{
+		kPropertyKeyFrameInterval,
+		{ B_GET_PROPERTY, B_SET_PROPERTY },
+		{ B_NO_SPECIFIER },
+		"Set/Get key frame interval (in frames)",
+		0,
+		{ B_INT32_TYPE },
+		{},
+		{}
+	},
+	{
+		kPropertySceneChangeKeyFrames,
+		{ B_GET_PROPERTY, B_SET_PROPERTY },
+		{ B_NO_SPECIFIER },
+		"Set/Get key frames on scene changes",
+		0,
+		{ B_BOOL_TYPE },
+		{},
+		{}
+	},
+	{
+		kPropertyEncodeSegments,
+		{ B_GET_PROPERTY, B_SET_PROPERTY },
+		{ B_NO_SPECIFIER },
+		"Set/Get the number of segments encoded at the same time",
+		0,
+		{ B_INT32_TYPE },
+		{},
+		{}
+	},
+	{
+		kPropertyFrameStore,
+		{ B_GET_PROPERTY, B_SET_PROPERTY },
+		{ B_NO_SPECIFIER },
+		"Set/Get where the frames are kept: 0 spool file, 1 BMP files",
+		0,
+		{ B_INT32_TYPE },
+		{},
+		{}
+	},
+	{
+		kPropertyUnbufferedWrites,
+		{ B_GET_PROPERTY, B_SET_PROPERTY },
+		{ B_NO_SPECIFIER },
+		"Set/Get writing the spooled frames around the file cache",
+		0,
+		{ B_BOOL_TYPE },
+		{},
+		{}
+	},
+	{
+		kPropertyLockFrameBuffers,
+		{ B_GET_PROPERTY, B_SET_PROPERTY },
+		{ B_NO_SPECIFIER },
+		"Set/Get keeping the capture buffers locked in memory",
+		0,
+		{ B_BOOL_TYPE },
+		{},
+		{}
+	},
+	{
+		kPropertyCaptureBackpressure,
+		{ B_GET_PROPERTY, B_SET_PROPERTY },
+		{ B_NO_SPECIFIER },
+		"Set/Get what to do when the frames can't be written fast enough: "
+		"0 notify, 1 lower the frame rate, 2 compress the frames",
+		0,
+		{ B_INT32_TYPE },
+		{},
+		{}
+	},
+	{
+		kPropertyFollowCursor,
+		{ B_GET_PROPERTY, B_SET_PROPERTY },
+		{ B_NO_SPECIFIER },
+		"Set/Get moving the capture area with the mouse pointer",
+		0,
+		{ B_BOOL_TYPE },
+		{},
+		{}
+	},
+	{
+		kPropertyFollowCursorDeadZone,
+		{ B_GET_PROPERTY, B_SET_PROPERTY },
+		{ B_NO_SPECIFIER },
+		"Set/Get how near, in pixels, the pointer gets to the sides of "
+		"the capture area before it moves",
+		0,
+		{ B_INT32_TYPE },
+		{},
+		{}
+	},
+	{
+		kPropertyFollowCursorSmoothing,
+		{ B_GET_PROPERTY, B_SET_PROPERTY },
+		{ B_NO_SPECIFIER },
+		"Set/Get the percentage of the way the capture area still has "
+		"to go after every frame, from 0 to 95",
+		0,
+		{ B_INT32_TYPE },
+		{},
+		{}
+	},
+	{
+		kPropertyStandby,
+		{ B_GET_PROPERTY, B_SET_PROPERTY },
+		{ B_NO_SPECIFIER },
+		"Set/Get keeping the next capture ready while idle, so it "
+		"starts at once. Keeps its buffers allocated",
+		0,
+		{ B_BOOL_TYPE },
+		{},
+		{}
+	},
+	{
+		kPropertyReplayBuffer,
+		{ B_GET_PROPERTY, B_SET_PROPERTY },
+		{ B_NO_SPECIFIER },
+		"Set/Get capturing into a replay buffer, which only keeps "
+		"the last seconds until they're saved",
+		0,
+		{ B_BOOL_TYPE },
+		{},
+		{}
+	},
+	{
+		kPropertyReplayBufferSeconds,
+		{ B_GET_PROPERTY, B_SET_PROPERTY },
+		{ B_NO_SPECIFIER },
+		"Set/Get how many seconds the replay buffer keeps",
+		0,
+		{ B_INT32_TYPE },
+		{},
+		{}
+	},
+	{
+		kPropertyReplayBufferOnDisk,
+		{ B_GET_PROPERTY, B_SET_PROPERTY },
+		{ B_NO_SPECIFIER },
+		"Set/Get keeping the replay buffer on disk instead of memory",
+		0,
+		{ B_BOOL_TYPE },
+		{},
+		{}
+	},
+	{
+		kPropertySpoolFolders,
+		{ B_GET_PROPERTY, B_SET_PROPERTY },
+		{ B_NO_SPECIFIER },
+		"Set/Get the folders where the frames are spooled, separated "
+		"by ':'. Frames are striped over them. Empty for the system "
+		"temporary folder",
+		0,
+		{ B_STRING_TYPE },
+		{},
+		{}
+	},
+	{
+		kPropertyEncodeRangeStart,
+		{ B_GET_PROPERTY, B_SET_PROPERTY },
+		{ B_NO_SPECIFIER },
+		"Set/Get where the encoded part of the recording starts, "
+		"in milliseconds or frames",
+		0,
+		{ B_INT32_TYPE },
+		{},
+		{}
+	},
+	{
+		kPropertyEncodeRangeEnd,
+		{ B_GET_PROPERTY, B_SET_PROPERTY },
+		{ B_NO_SPECIFIER },
+		"Set/Get where the encoded part of the recording ends, "
+		"in milliseconds or frames. 0 encodes up to the last frame",
+		0,
+		{ B_INT32_TYPE },
+		{},
+		{}
+	},
+	{
+		kPropertyEncodeRangeInFrames,
+		{ B_GET_PROPERTY, B_SET_PROPERTY },
+		{ B_NO_SPECIFIER },
+		"Set/Get giving the encoded range in frames instead of milliseconds",
+		0,
+		{ B_BOOL_TYPE },
+		{},
+		{}
+	},
+	{
+		kPropertyExtraOutputs,
+		{ B_GET_PROPERTY, B_SET_PROPERTY },
+		{ B_NO_SPECIFIER },
+		"Set/Get the other files encoded with the output file, separated "
+		"by ';', each as format[:codec[:scale[:quality]]]",
+		0,
+		{ B_STRING_TYPE },
+		{},
+		{}
+	},
+	{
+		kPropertyAdaptiveFrameRate,
+		{ B_GET_PROPERTY, B_SET_PROPERTY },
+		{ B_NO_SPECIFIER },
+		"Set/Get lowering the capture rate while the screen doesn't change",
+		0,
+		{ B_BOOL_TYPE },
+		{},
+		{}
+	},
+	{
+		kPropertyMinFrameRate,
+		{ B_GET_PROPERTY, B_SET_PROPERTY },
+		{ B_NO_SPECIFIER },
+		"Set/Get the lowest capture rate, with the adaptive frame rate",
+		0,
+		{ B_INT32_TYPE },
+		{},
+		{}
+	},
+	{
+		kPropertyScaleAtCapture,
+		{ B_GET_PROPERTY, B_SET_PROPERTY },
+		{ B_NO_SPECIFIER },
+		"Set/Get scaling the frames before they're spooled, instead of when encoding",
+		0,
+		{ B_BOOL_TYPE },
+		{},
+		{}
+	},
+	{
+		kPropertyTrace,
+		{ B_GET_PROPERTY, B_SET_PROPERTY },
+		{ B_NO_SPECIFIER },
+		"Set/Get the file where a trace of the next sessions is written, "
+		"in the Chrome trace format. Empty to stop tracing",
+		0,
+		{ B_STRING_TYPE },
+		{},
+		{}
+	},
+	{
+		kPropertySaveReplay,
+		{ B_EXECUTE_PROPERTY },
+		{ B_NO_SPECIFIER },
+		"Encode the replay buffer, or its last seconds, "
+		"without stopping the capture",
+		0,
+		{ B_INT32_TYPE },
+		{},
+		{}
+	},
+	{
+		kPropertyStats,
+		{ B_GET_PROPERTY },
+		{ B_NO_SPECIFIER },
+		"Get the counters of the capture and the encoding",
+		0,
+		{ B_MESSAGE_TYPE },
+		{},
+		{}
+	},
 	{ 0 }
 };
 
+// A finished capture, or a clip saved from the replay buffer,
+// with what it's encoded with. They're encoded one at a time
+struct encode_job {
+	~encode_job() { delete encoder; }
+
+	MovieEncoder*	encoder;
+	// The settings can change meanwhile, for the next capture
+	session_config	session;
+	BString			outputFileName;
+	int32			frames;
+};
+
+static int32
+FrameBufferCount(const BRect& frame)
+{
+	// Don't use more than a quarter of the free memory for the buffers
+	const uint64 frameSize = uint64(frame.IntegerWidth() + 1)
+		* uint64(frame.IntegerHeight() + 1) * 4;
+	const uint64 maxCount = GetFreeMemory() / 4 / std::max(frameSize, uint64(1));
+	return std::max(int32(2), int32(std::min(uint64(kFrameBufferCount), maxCount)));
+}
+
+
 int
 main()
 {
@@ -145,15 +510,43 @@ BSCApp::BSCApp()
 	fArgs(NULL),
 	fShouldStartRecording(false),
 	fCaptureThread(-1),
+	fStandbyThread(-1),
+	fStandingBy(false),
 	fNumFrames(0),
+	fCaptureFrameRate(0),
 	fRecordWatch(NULL),
 	fKillCaptureThread(true),
 	fPaused(false),
-	fDirectWindowAvailable(false),
+	fPauseSem(-1),
+	fFramePool(NULL),
+	fFrameStore(NULL),
+	fCursorTrack(NULL),
+	fSession(NULL),
+	fStats(NULL),
+	fPreview(NULL),
+	fFrameWriters(kFrameWriterCount, true),
+	fDirectFrameBuffer(NULL),
+	fScreenBitmap(NULL),
 	fEncoder(NULL),
 	fEncoderThread(-1),
+	fLiveEncoder(NULL),
+	fEncodeJobs(4, true),
 	fCodecList(NULL),
+	fCodecSpeedTest(NULL),
+	fCodecTestThread(-1),
+	fCodecTestSelect(false),
+	fCodecTestCanceled(false),
+	fCodecTestList(1, true),
+	fReplayThread(-1),
+	fReplayDuration(0),
+	fReplayStatus(B_OK),
+	fReplayClip(NULL),
+	fReplayTrack(NULL),
 	fStopRunner(NULL),
+	fStatsRunner(NULL),
+	fLastGrabbedFrames(0),
+	fLastSpoolBytes(0),
+	fLastStatsTime(0),
 	fRequestedRecordTime(0),
 	fSupportsWaitForRetrace(false)
 {
@@ -161,9 +554,15 @@ BSCApp::BSCApp()
 
 	Settings::Initialize();
 
-	memset(&fDirectInfo, 0, sizeof(fDirectInfo));
-
+	fSession = new session_config(Settings::Current().SessionConfig());
+	fStats = new PipelineStats;
+	fPreview = new FramePreview;
+	fCodecSpeedTest = new CodecSpeedTest;
 	fEncoder = new MovieEncoder;
+	fEncoder->SetStats(&fStats->Encode());
+	fFramePool = new FramePool;
+	fDirectFrameBuffer = new DirectFrameBuffer;
+	fPauseSem = create_sem(0, "capture pause");
 
 	_UpdateFromSettings();
 }
@@ -175,8 +574,24 @@ BSCApp::~BSCApp()
 
 	StopThreads();
 	delete fRecordWatch;
+	delete fStatsRunner;
 	delete fEncoder;
+	delete fStats;
+	delete fPreview;
+	delete fSession;
 	delete fCodecList;
+	delete fCodecSpeedTest;
+	fFrameWriters.MakeEmpty(true);
+	delete fFrameStore;
+	delete fCursorTrack;
+	delete fFramePool;
+	FrameAllocator::Free(fScreenBitmap);
+	delete fDirectFrameBuffer;
+	delete_sem(fPauseSem);
+	// After the encoder and the writers, which use them
+	WorkerPool::DeleteShared();
+	// After the pools: it could be revalidated meanwhile
+	MediaCache::DeleteDefault();
 
 	FramesList::DeleteTempPath();
 
@@ -197,7 +612,17 @@ BSCApp::ArgvReceived(int32 argc, char** argv)
 		PostMessage(B_QUIT_REQUESTED);
 		return;
 	}
+	const BStringList& outputs = fArgs->Outputs();
+	for (int32 i = 0; i < outputs.CountStrings(); i++) {
+		if (!Settings::ParseEncodeOutput(outputs.StringAt(i), NULL)) {
+			std::cerr << "Invalid output \"" << outputs.StringAt(i).String() << "\"" << std::endl;
+			_UsageRequested();
+			PostMessage(B_QUIT_REQUESTED);
+			return;
+		}
+	}
 
+	fTracePath = fArgs->TracePath();
 	fShouldStartRecording = fArgs->RecordNow();
 }
 
@@ -205,6 +630,12 @@ BSCApp::ArgvReceived(int32 argc, char** argv)
 void
 BSCApp::ReadyToRun()
 {
+	// Nothing is shown: the results are printed
+	if (fArgs->Benchmark()) {
+		TestSystem();
+		return;
+	}
+
 	try {
 		fWindow = new BSCWindow();
 	} catch (...) {
@@ -229,7 +660,13 @@ BSCApp::ReadyToRun()
 		}
 	} else {
 		fWindow->Show();
+		_EnterStandby();
 	}
+
+	// The formats and codecs may have been read from the cache
+	MediaCache* cache = MediaCache::Default();
+	if (cache != NULL)
+		cache->Revalidate(BMessenger(this), kMediaCacheChanged);
 }
 
 
@@ -287,13 +724,57 @@ BSCApp::MessageReceived(BMessage *message)
 			TogglePause();
 			break;
 
+		case kMsgGUISaveReplay:
+		{
+			status_t status = SaveReplay(message->GetInt64("duration", 0));
+			if (status != B_OK)
+				std::cerr << "BSCApp: cannot save the replay: " << ::strerror(status) << std::endl;
+			break;
+		}
+		case kReplaySaved:
+			_ReplaySaved();
+			break;
+
+		case kCodecSpeedMeasured:
+		{
+			BMessage notice(*message);
+			notice.what = kMsgControllerCodecSpeedMeasured;
+			notice.AddFloat("target_fps", float(Settings::Current().CaptureFrameRate()));
+			SendNotices(kMsgControllerCodecSpeedMeasured, &notice);
+			break;
+		}
+		case kCodecSpeedTestFinished:
+			_CodecSpeedTestFinished(message);
+			break;
+
+		case kMediaCacheChanged:
+			_MediaCacheChanged();
+			break;
+
+		case kPublishStats:
+			// The capture can also stop by itself, on errors
+			if (State() == STATE_RECORDING) {
+				_PublishStats();
+				_CheckSpoolSpace();
+			} else {
+				delete fStatsRunner;
+				fStatsRunner = NULL;
+				_UpdateEncodeThrottle();
+			}
+			break;
+
 		case kEncodingFinished:
 		{
 			status_t error;
 			message->FindInt32("status", reinterpret_cast<int32*>(&error));
 			const char* fileName = NULL;
 			message->FindString("file_name", &fileName);
-			_EncodingFinished(error, fileName);
+			// The jobs which were canceled are already gone
+			if (fEncoderThread < 0
+				|| message->GetInt32("thread", -1) != fEncoderThread)
+				break;
+			fEncoderThread = -1;
+			_EncodingFinished(error, fileName, fEncodeJobs.RemoveItemAt(0));
 			break;
 		}
 		case kEncodingProgress:
@@ -478,6 +959,32 @@ BSCApp::_HandleScripting(BMessage* message)
 					reply.AddInt32("error", result);
 					message->SendReply(&reply);
 				}
+			} else if (::strcmp(property, kPropertyExtraCaptureAreas) == 0) {
+				if (form == B_DIRECT_SPECIFIER) {
+					if (what == B_GET_PROPERTY) {
+						const std::vector<BRect> areas
+							= Settings::Current().ExtraCaptureAreas();
+						BStringList list;
+						for (size_t i = 0; i < areas.size(); i++) {
+							BString area;
+							area.SetToFormat("%d,%d,%d,%d", int(areas[i].left),
+								int(areas[i].top), int(areas[i].right),
+								int(areas[i].bottom));
+							list.Add(area);
+						}
+						reply.AddString("result", list.Join(";"));
+					} else if (what == B_SET_PROPERTY) {
+						BString spec;
+						std::vector<BRect> areas;
+						if (message->FindString("data", &spec) != B_OK
+							|| !Settings::ParseCaptureAreas(spec, &areas))
+							result = B_ERROR;
+						else if (!SetExtraCaptureAreas(areas))
+							result = B_BAD_VALUE;
+					}
+					reply.AddInt32("error", result);
+					message->SendReply(&reply);
+				}
 			} else if (::strcmp(property, kPropertyScaleFactor) == 0) {
 				if (form == B_DIRECT_SPECIFIER) {
 					if (what == B_GET_PROPERTY) {
@@ -516,22 +1023,367 @@ BSCApp::_HandleScripting(BMessage* message)
 					reply.AddInt32("error", result);
 					message->SendReply(&reply);
 				}
-			}
-			break;
-		}
-		case B_EXECUTE_PROPERTY:
-		{
-			if (::strcmp(property, kPropertyStartRecording) == 0) {
+			} else if (::strcmp(property, kPropertyKeyFrameInterval) == 0) {
 				if (form == B_DIRECT_SPECIFIER) {
-					if (State() == BSCApp::STATE_IDLE) {
-						BMessage toggleMessage(kMsgGUIToggleCapture);
-						be_app->PostMessage(&toggleMessage);
-					} else
-						result = B_ERROR;
+					if (what == B_GET_PROPERTY) {
+						reply.AddInt32("result", Settings::Current().KeyFrameInterval());
+					} else if (what == B_SET_PROPERTY) {
+						int32 frames;
+						if (message->FindInt32("data", &frames) == B_OK && frames > 0)
+							Settings::Current().SetKeyFrameInterval(frames);
+						else
+							result = B_BAD_VALUE;
+					}
 					reply.AddInt32("error", result);
 					message->SendReply(&reply);
 				}
-			} else if (::strcmp(property, kPropertyStopRecording) == 0) {
+			} else if (::strcmp(property, kPropertySceneChangeKeyFrames) == 0) {
+				if (form == B_DIRECT_SPECIFIER) {
+					if (what == B_GET_PROPERTY) {
+						reply.AddBool("result", Settings::Current().SceneChangeKeyFrames());
+					} else if (what == B_SET_PROPERTY) {
+						bool enable;
+						if (message->FindBool("data", &enable) == B_OK)
+							Settings::Current().SetSceneChangeKeyFrames(enable);
+						else
+							result = B_ERROR;
+					}
+					reply.AddInt32("error", result);
+					message->SendReply(&reply);
+				}
+			} else if (::strcmp(property, kPropertyEncodeSegments) == 0) {
+				if (form == B_DIRECT_SPECIFIER) {
+					if (what == B_GET_PROPERTY) {
+						reply.AddInt32("result", Settings::Current().EncodeSegments());
+					} else if (what == B_SET_PROPERTY) {
+						int32 segments;
+						if (message->FindInt32("data", &segments) == B_OK && segments > 0)
+							Settings::Current().SetEncodeSegments(segments);
+						else
+							result = B_BAD_VALUE;
+					}
+					reply.AddInt32("error", result);
+					message->SendReply(&reply);
+				}
+			} else if (::strcmp(property, kPropertyFrameStore) == 0) {
+				if (form == B_DIRECT_SPECIFIER) {
+					if (what == B_GET_PROPERTY) {
+						reply.AddInt32("result", Settings::Current().FrameStoreType());
+					} else if (what == B_SET_PROPERTY) {
+						int32 type;
+						if (message->FindInt32("data", &type) == B_OK
+							&& (type == kSpoolFrameStore || type == kBMPFrameStore))
+							Settings::Current().SetFrameStoreType(type);
+						else
+							result = B_BAD_VALUE;
+					}
+					reply.AddInt32("error", result);
+					message->SendReply(&reply);
+				}
+			} else if (::strcmp(property, kPropertyUnbufferedWrites) == 0) {
+				if (form == B_DIRECT_SPECIFIER) {
+					if (what == B_GET_PROPERTY) {
+						reply.AddBool("result", Settings::Current().UnbufferedWrites());
+					} else if (what == B_SET_PROPERTY) {
+						bool unbuffered;
+						if (message->FindBool("data", &unbuffered) == B_OK)
+							Settings::Current().SetUnbufferedWrites(unbuffered);
+						else
+							result = B_ERROR;
+					}
+					reply.AddInt32("error", result);
+					message->SendReply(&reply);
+				}
+			} else if (::strcmp(property, kPropertyLockFrameBuffers) == 0) {
+				if (form == B_DIRECT_SPECIFIER) {
+					if (what == B_GET_PROPERTY) {
+						reply.AddBool("result", Settings::Current().LockFrameBuffers());
+					} else if (what == B_SET_PROPERTY) {
+						bool lock;
+						if (message->FindBool("data", &lock) == B_OK)
+							Settings::Current().SetLockFrameBuffers(lock);
+						else
+							result = B_ERROR;
+					}
+					reply.AddInt32("error", result);
+					message->SendReply(&reply);
+				}
+			} else if (::strcmp(property, kPropertyCaptureBackpressure) == 0) {
+				if (form == B_DIRECT_SPECIFIER) {
+					if (what == B_GET_PROPERTY) {
+						reply.AddInt32("result", Settings::Current().CaptureBackpressure());
+					} else if (what == B_SET_PROPERTY) {
+						int32 policy;
+						if (message->FindInt32("data", &policy) == B_OK
+							&& policy >= kBackpressureNotify
+							&& policy <= kBackpressureCompressFrames)
+							Settings::Current().SetCaptureBackpressure(policy);
+						else
+							result = B_BAD_VALUE;
+					}
+					reply.AddInt32("error", result);
+					message->SendReply(&reply);
+				}
+			} else if (::strcmp(property, kPropertyFollowCursor) == 0) {
+				if (form == B_DIRECT_SPECIFIER) {
+					if (what == B_GET_PROPERTY) {
+						reply.AddBool("result", Settings::Current().FollowCursor());
+					} else if (what == B_SET_PROPERTY) {
+						bool follow;
+						if (message->FindBool("data", &follow) == B_OK)
+							Settings::Current().SetFollowCursor(follow);
+						else
+							result = B_ERROR;
+					}
+					reply.AddInt32("error", result);
+					message->SendReply(&reply);
+				}
+			} else if (::strcmp(property, kPropertyFollowCursorDeadZone) == 0) {
+				if (form == B_DIRECT_SPECIFIER) {
+					if (what == B_GET_PROPERTY) {
+						reply.AddInt32("result", Settings::Current().FollowCursorDeadZone());
+					} else if (what == B_SET_PROPERTY) {
+						int32 pixels;
+						if (message->FindInt32("data", &pixels) == B_OK && pixels >= 0)
+							Settings::Current().SetFollowCursorDeadZone(pixels);
+						else
+							result = B_BAD_VALUE;
+					}
+					reply.AddInt32("error", result);
+					message->SendReply(&reply);
+				}
+			} else if (::strcmp(property, kPropertyFollowCursorSmoothing) == 0) {
+				if (form == B_DIRECT_SPECIFIER) {
+					if (what == B_GET_PROPERTY) {
+						reply.AddInt32("result", Settings::Current().FollowCursorSmoothing());
+					} else if (what == B_SET_PROPERTY) {
+						int32 percent;
+						if (message->FindInt32("data", &percent) == B_OK
+							&& percent >= 0 && percent <= 95)
+							Settings::Current().SetFollowCursorSmoothing(percent);
+						else
+							result = B_BAD_VALUE;
+					}
+					reply.AddInt32("error", result);
+					message->SendReply(&reply);
+				}
+			} else if (::strcmp(property, kPropertyStandby) == 0) {
+				if (form == B_DIRECT_SPECIFIER) {
+					if (what == B_GET_PROPERTY) {
+						reply.AddBool("result", Settings::Current().Standby());
+					} else if (what == B_SET_PROPERTY) {
+						bool standby;
+						if (message->FindBool("data", &standby) == B_OK) {
+							Settings::Current().SetStandby(standby);
+							if (standby)
+								_EnterStandby();
+							else
+								_LeaveStandby();
+						} else
+							result = B_ERROR;
+					}
+					reply.AddInt32("error", result);
+					message->SendReply(&reply);
+				}
+			} else if (::strcmp(property, kPropertyReplayBuffer) == 0) {
+				if (form == B_DIRECT_SPECIFIER) {
+					if (what == B_GET_PROPERTY) {
+						reply.AddBool("result", Settings::Current().ReplayBuffer());
+					} else if (what == B_SET_PROPERTY) {
+						bool replay;
+						if (message->FindBool("data", &replay) == B_OK)
+							Settings::Current().SetReplayBuffer(replay);
+						else
+							result = B_ERROR;
+					}
+					reply.AddInt32("error", result);
+					message->SendReply(&reply);
+				}
+			} else if (::strcmp(property, kPropertyReplayBufferSeconds) == 0) {
+				if (form == B_DIRECT_SPECIFIER) {
+					if (what == B_GET_PROPERTY) {
+						reply.AddInt32("result", Settings::Current().ReplayBufferSeconds());
+					} else if (what == B_SET_PROPERTY) {
+						int32 seconds;
+						if (message->FindInt32("data", &seconds) == B_OK && seconds > 0)
+							Settings::Current().SetReplayBufferSeconds(seconds);
+						else
+							result = B_BAD_VALUE;
+					}
+					reply.AddInt32("error", result);
+					message->SendReply(&reply);
+				}
+			} else if (::strcmp(property, kPropertyReplayBufferOnDisk) == 0) {
+				if (form == B_DIRECT_SPECIFIER) {
+					if (what == B_GET_PROPERTY) {
+						reply.AddBool("result", Settings::Current().ReplayBufferOnDisk());
+					} else if (what == B_SET_PROPERTY) {
+						bool onDisk;
+						if (message->FindBool("data", &onDisk) == B_OK)
+							Settings::Current().SetReplayBufferOnDisk(onDisk);
+						else
+							result = B_ERROR;
+					}
+					reply.AddInt32("error", result);
+					message->SendReply(&reply);
+				}
+			} else if (::strcmp(property, kPropertySpoolFolders) == 0) {
+				if (form == B_DIRECT_SPECIFIER) {
+					if (what == B_GET_PROPERTY) {
+						reply.AddString("result",
+							Settings::Current().SpoolFolders().Join(":"));
+					} else if (what == B_SET_PROPERTY) {
+						BString folders;
+						BStringList list;
+						if (message->FindString("data", &folders) == B_OK
+							&& (folders == "" || folders.Split(":", true, list)))
+							Settings::Current().SetSpoolFolders(list);
+						else
+							result = B_ERROR;
+					}
+					reply.AddInt32("error", result);
+					message->SendReply(&reply);
+				}
+			} else if (::strcmp(property, kPropertyEncodeRangeStart) == 0) {
+				if (form == B_DIRECT_SPECIFIER) {
+					if (what == B_GET_PROPERTY) {
+						reply.AddInt32("result", Settings::Current().EncodeRangeStart());
+					} else if (what == B_SET_PROPERTY) {
+						int32 start;
+						if (message->FindInt32("data", &start) == B_OK && start >= 0)
+							Settings::Current().SetEncodeRangeStart(start);
+						else
+							result = B_BAD_VALUE;
+					}
+					reply.AddInt32("error", result);
+					message->SendReply(&reply);
+				}
+			} else if (::strcmp(property, kPropertyEncodeRangeEnd) == 0) {
+				if (form == B_DIRECT_SPECIFIER) {
+					if (what == B_GET_PROPERTY) {
+						reply.AddInt32("result", Settings::Current().EncodeRangeEnd());
+					} else if (what == B_SET_PROPERTY) {
+						int32 end;
+						if (message->FindInt32("data", &end) == B_OK && end >= 0)
+							Settings::Current().SetEncodeRangeEnd(end);
+						else
+							result = B_BAD_VALUE;
+					}
+					reply.AddInt32("error", result);
+					message->SendReply(&reply);
+				}
+			} else if (::strcmp(property, kPropertyEncodeRangeInFrames) == 0) {
+				if (form == B_DIRECT_SPECIFIER) {
+					if (what == B_GET_PROPERTY) {
+						reply.AddBool("result", Settings::Current().EncodeRangeInFrames());
+					} else if (what == B_SET_PROPERTY) {
+						bool inFrames;
+						if (message->FindBool("data", &inFrames) == B_OK)
+							Settings::Current().SetEncodeRangeInFrames(inFrames);
+						else
+							result = B_ERROR;
+					}
+					reply.AddInt32("error", result);
+					message->SendReply(&reply);
+				}
+			} else if (::strcmp(property, kPropertyExtraOutputs) == 0) {
+				if (form == B_DIRECT_SPECIFIER) {
+					if (what == B_GET_PROPERTY) {
+						reply.AddString("result",
+							Settings::Current().ExtraOutputs().Join(";"));
+					} else if (what == B_SET_PROPERTY) {
+						BString outputs;
+						BStringList list;
+						if (message->FindString("data", &outputs) == B_OK
+							&& (outputs == "" || outputs.Split(";", true, list)))
+							result = Settings::Current().SetExtraOutputs(list);
+						else
+							result = B_ERROR;
+					}
+					reply.AddInt32("error", result);
+					message->SendReply(&reply);
+				}
+			} else if (::strcmp(property, kPropertyAdaptiveFrameRate) == 0) {
+				if (form == B_DIRECT_SPECIFIER) {
+					if (what == B_GET_PROPERTY) {
+						reply.AddBool("result", Settings::Current().AdaptiveFrameRate());
+					} else if (what == B_SET_PROPERTY) {
+						bool adaptive;
+						if (message->FindBool("data", &adaptive) == B_OK)
+							Settings::Current().SetAdaptiveFrameRate(adaptive);
+						else
+							result = B_ERROR;
+					}
+					reply.AddInt32("error", result);
+					message->SendReply(&reply);
+				}
+			} else if (::strcmp(property, kPropertyMinFrameRate) == 0) {
+				if (form == B_DIRECT_SPECIFIER) {
+					if (what == B_GET_PROPERTY) {
+						reply.AddInt32("result", Settings::Current().MinFrameRate());
+					} else if (what == B_SET_PROPERTY) {
+						int32 rate;
+						if (message->FindInt32("data", &rate) == B_OK && rate > 0)
+							Settings::Current().SetMinFrameRate(rate);
+						else
+							result = B_BAD_VALUE;
+					}
+					reply.AddInt32("error", result);
+					message->SendReply(&reply);
+				}
+			} else if (::strcmp(property, kPropertyScaleAtCapture) == 0) {
+				if (form == B_DIRECT_SPECIFIER) {
+					if (what == B_GET_PROPERTY) {
+						reply.AddBool("result", Settings::Current().ScaleAtCapture());
+					} else if (what == B_SET_PROPERTY) {
+						bool atCapture;
+						if (message->FindBool("data", &atCapture) == B_OK)
+							Settings::Current().SetScaleAtCapture(atCapture);
+						else
+							result = B_ERROR;
+					}
+					reply.AddInt32("error", result);
+					message->SendReply(&reply);
+				}
+			} else if (::strcmp(property, kPropertyTrace) == 0) {
+				if (form == B_DIRECT_SPECIFIER) {
+					if (what == B_GET_PROPERTY) {
+						reply.AddString("result", fTracePath);
+					} else if (what == B_SET_PROPERTY) {
+						if (message->FindString("data", &fTracePath) != B_OK)
+							result = B_ERROR;
+					}
+					reply.AddInt32("error", result);
+					message->SendReply(&reply);
+				}
+			} else if (::strcmp(property, kPropertyStats) == 0) {
+				if (form == B_DIRECT_SPECIFIER) {
+					if (what == B_GET_PROPERTY) {
+						BMessage stats;
+						fStats->Archive(&stats, CaptureQueueDepth());
+						FrameAllocator::Archive(&stats);
+						reply.AddMessage("result", &stats);
+					} else
+						result = B_BAD_VALUE;
+					reply.AddInt32("error", result);
+					message->SendReply(&reply);
+				}
+			}
+			break;
+		}
+		case B_EXECUTE_PROPERTY:
+		{
+			if (::strcmp(property, kPropertyStartRecording) == 0) {
+				if (form == B_DIRECT_SPECIFIER) {
+					if (State() != BSCApp::STATE_RECORDING) {
+						BMessage toggleMessage(kMsgGUIToggleCapture);
+						be_app->PostMessage(&toggleMessage);
+					} else
+						result = B_ERROR;
+					reply.AddInt32("error", result);
+					message->SendReply(&reply);
+				}
+			} else if (::strcmp(property, kPropertyStopRecording) == 0) {
 				if (form == B_DIRECT_SPECIFIER) {
 					if (State() == BSCApp::STATE_RECORDING) {
 						BMessage toggleMessage(kMsgGUIToggleCapture);
@@ -541,6 +1393,18 @@ BSCApp::_HandleScripting(BMessage* message)
 					reply.AddInt32("error", result);
 					message->SendReply(&reply);
 				}
+			} else if (::strcmp(property, kPropertySaveReplay) == 0) {
+				if (form == B_DIRECT_SPECIFIER) {
+					// The seconds are optional
+					int32 seconds = 0;
+					message->FindInt32("data", &seconds);
+					if (seconds >= 0)
+						result = SaveReplay(bigtime_t(seconds) * 1000000);
+					else
+						result = B_BAD_VALUE;
+					reply.AddInt32("error", result);
+					message->SendReply(&reply);
+				}
 			}
 			break;
 		}
@@ -618,6 +1482,8 @@ void
 BSCApp::StopThreads()
 {
 	BAutolock _(this);
+	_LeaveStandby();
+	_CancelCodecSpeedTest();
 	switch (State()) {
 		case STATE_RECORDING:
 		{
@@ -625,16 +1491,29 @@ BSCApp::StopThreads()
 			fKillCaptureThread = true;
 			wait_for_thread(fCaptureThread, &status);
 			fCaptureThread = -1;
+			_CancelLiveEncoding();
+			if (fReplayThread >= 0) {
+				wait_for_thread(fReplayThread, &status);
+				fReplayThread = -1;
+				if (fReplayClip != NULL)
+					fReplayClip->Release();
+				delete fReplayClip;
+				fReplayClip = NULL;
+				delete fReplayTrack;
+				fReplayTrack = NULL;
+			}
 			break;
 		}
 		case STATE_ENCODING:
-			fEncoder->Cancel();
-			fEncoderThread = -1;
-			break;
 		case STATE_IDLE:
 		default:
 			break;
 	}
+	_CancelEncodeJobs();
+#ifdef DEBUG
+	// Only the encoder could still have some, while it's canceled
+	FrameAllocator::ReportOutstanding();
+#endif
 }
 
 
@@ -642,7 +1521,9 @@ int
 BSCApp::State() const
 {
 	BAutolock _(const_cast<BSCApp*>(this));
-	if (fCaptureThread > 0)
+	// When encoding while recording, the recording is over only
+	// when the spooled frames are handed over to the encoder
+	if (fCaptureThread > 0 || fLiveEncoder != NULL)
 		return STATE_RECORDING;
 
 	if (fEncoderThread > 0)
@@ -666,14 +1547,14 @@ BSCApp::ToggleCapture()
 	int state = State();
 	switch (state) {
 		case STATE_IDLE:
+		case STATE_ENCODING:
+			// The clips of the previous captures are still
+			// encoded meanwhile
 			StartCapture();
 			break;
 		case STATE_RECORDING:
 			EndCapture();
 			break;
-		case STATE_ENCODING:
-			// DO NOTHING
-			break;
 	}
 }
 
@@ -718,31 +1599,205 @@ BSCApp::SetRecordingTime(const bigtime_t msecs)
 }
 
 
-float
-BSCApp::AverageFPS() const
+float
+BSCApp::AverageFPS() const
+{
+	if (RecordTime() == 0)
+		return 0;
+
+	return CalculateFPS(RecordedFrames(), RecordTime());
+}
+
+
+int32
+BSCApp::CaptureQueueDepth() const
+{
+	BAutolock _(const_cast<BSCApp*>(this));
+	int32 depth = 0;
+	for (int32 i = 0; i < fFrameWriters.CountItems(); i++)
+		depth += fFrameWriters.ItemAt(i)->QueueDepth();
+	return depth;
+}
+
+
+int32
+BSCApp::CaptureQueueHighWaterMark() const
+{
+	BAutolock _(const_cast<BSCApp*>(this));
+	int32 highWaterMark = 0;
+	for (int32 i = 0; i < fFrameWriters.CountItems(); i++)
+		highWaterMark = std::max(highWaterMark, fFrameWriters.ItemAt(i)->QueueHighWaterMark());
+	return highWaterMark;
+}
+
+
+// Sends the capture progress, with the rates since the last time
+void
+BSCApp::_PublishStats()
+{
+	BMessage message(kMsgControllerCaptureProgress);
+	fStats->Archive(&message, CaptureQueueDepth());
+	// The writers share the buffers of the pool
+	const int32 queueCapacity = fFrameWriters.IsEmpty()
+		? 0 : fFramePool->CountBuffers();
+
+	const bigtime_t now = system_time();
+	const bigtime_t elapsed = std::max(now - fLastStatsTime, bigtime_t(1));
+	const int64 grabbedFrames = message.GetInt64("frames_grabbed", 0);
+	const int64 spoolBytes = message.GetInt64("spool_bytes", 0);
+	const float fps = fPaused ? 0
+		: float(grabbedFrames - fLastGrabbedFrames) * 1000000 / elapsed;
+	const int64 diskRate = (spoolBytes - fLastSpoolBytes) * 1000000 / elapsed;
+	fLastGrabbedFrames = grabbedFrames;
+	fLastSpoolBytes = spoolBytes;
+	fLastStatsTime = now;
+
+	message.AddInt32("frames_total", RecordedFrames());
+	message.AddInt64("record_time", RecordTime());
+	message.AddFloat("fps", fps);
+	message.AddFloat("average_fps", AverageFPS());
+	// Lower than the frame rate of the session while the
+	// screen doesn't change, or the writers are behind
+	const int32 targetRate = atomic_get(&fCaptureFrameRate);
+	message.AddInt32("target_fps", targetRate > 0 ? targetRate : fSession->frameRate);
+	message.AddInt32("queue_capacity", queueCapacity);
+	message.AddInt64("disk_rate", diskRate);
+	SendNotices(kMsgControllerCaptureProgress, &message);
+}
+
+
+void
+BSCApp::EncodeMovie()
+{
+	BAutolock _(this);
+
+	if (RecordedFrames() <= 0) {
+		_CancelLiveEncoding();
+		_EncodingFinished(B_ERROR, NULL, NULL);
+		return;
+	}
+
+	// When encoding while recording, the job is already there.
+	// Otherwise the capture becomes a new one, after the others
+	const bool live = fLiveEncoder != NULL;
+	encode_job* job = live ? fEncodeJobs.FirstItem() : _CreateEncodeJob();
+	status_t status = job != NULL ? B_OK : B_NO_MEMORY;
+	if (status == B_OK)
+		status = _HandOverFrames(job->encoder);
+	if (status == B_OK && !live)
+		status = _SetTempOutputFile(job->encoder);
+	if (status == B_OK && !live && !fEncodeJobs.AddItem(job))
+		status = B_NO_MEMORY;
+	if (status != B_OK) {
+		if (live)
+			_CancelLiveEncoding();
+		else
+			delete job;
+		_EncodingFinished(status, NULL, NULL);
+		return;
+	}
+	job->frames = RecordedFrames();
+
+	if (!live) {
+		_StartEncodeJob();
+		return;
+	}
+	// The encoder already has the file, and now
+	// the frames it couldn't keep up with, if any
+	fLiveEncoder = NULL;
+	BMessage message(kMsgControllerEncodeStarted);
+	message.AddInt32("frames_total", job->frames);
+	SendNotices(kMsgControllerEncodeStarted, &message);
+}
+
+
+// A job for the frames of the current session, with the settings
+// there are now. It's encoded at the priority in the settings
+encode_job*
+BSCApp::_CreateEncodeJob()
+{
+	encode_job* job = new (std::nothrow) encode_job;
+	if (job == NULL)
+		return NULL;
+	job->encoder = fEncoder->CreateCopy();
+	if (job->encoder == NULL) {
+		delete job;
+		return NULL;
+	}
+	const Settings& settings = Settings::Current();
+	job->encoder->SetThreadPriority(settings.EncodingThreadPriority());
+	job->session = *fSession;
+	job->outputFileName = settings.OutputFileName();
+	job->frames = 0;
+	return job;
+}
+
+
+// Starts the first job, unless it's already encoding. The jobs
+// which can't be started are given up, and the next one tried
+void
+BSCApp::_StartEncodeJob()
+{
+	while (fEncoderThread < 0 && !fEncodeJobs.IsEmpty()) {
+		encode_job* job = fEncodeJobs.FirstItem();
+		MovieEncoder* encoder = job->encoder;
+		// The outputs are only named now, after the files
+		// of the jobs before it
+		_AddEncodeOutputs(job);
+		// The background threads, which give way to a capture
+		encoder->SetWorkerPool(WorkerPool::Shared(WorkerPool::kBackgroundWork));
+		encoder->SetThrottled(fCaptureThread > 0);
+		encoder->SetMessenger(BMessenger(this));
+		thread_id thread = encoder->EncodeThreaded();
+		if (thread >= 0) {
+			fEncoderThread = thread;
+			BMessage message(kMsgControllerEncodeStarted);
+			message.AddInt32("frames_total", job->frames);
+			SendNotices(kMsgControllerEncodeStarted, &message);
+			return;
+		}
+		std::cerr << "BSCApp: cannot start encoding: " << ::strerror(thread) << std::endl;
+		fEncodeJobs.RemoveItemAt(0);
+		delete job;
+		BMessage message(kMsgControllerEncodeFinished);
+		message.AddInt32("status", (int32)thread);
+		SendNotices(kMsgControllerEncodeFinished, &message);
+	}
+}
+
+
+// The job encoding while a capture runs is throttled, unless
+// it's encoding that same capture
+void
+BSCApp::_UpdateEncodeThrottle()
 {
-	if (RecordTime() == 0)
-		return 0;
-
-	return CalculateFPS(RecordedFrames(), RecordTime());
+	encode_job* job = fEncodeJobs.FirstItem();
+	if (job != NULL && job->encoder != fLiveEncoder)
+		job->encoder->SetThrottled(fCaptureThread > 0);
 }
 
 
+// The first one is encoding, the others didn't start yet.
+// Deleting them also deletes their frames
 void
-BSCApp::EncodeMovie()
+BSCApp::_CancelEncodeJobs()
 {
-	BAutolock _(this);
+	for (int32 i = 0; i < fEncodeJobs.CountItems(); i++)
+		fEncodeJobs.ItemAt(i)->encoder->Cancel();
+	fEncodeJobs.MakeEmpty(true);
+	fEncoderThread = -1;
+	fLiveEncoder = NULL;
+}
 
-	if (RecordedFrames() <= 0) {
-		_EncodingFinished(B_ERROR, NULL);
-		return;
-	}
 
-	// Write to a temp file
+// Tells the encoder to write to a temp file
+status_t
+BSCApp::_SetTempOutputFile(MovieEncoder* encoder)
+{
 	BPath path;
 	status_t status = find_directory(B_SYSTEM_TEMP_DIRECTORY, &path);
 	if (status != B_OK)
-		throw status;
+		return status;
 	char tempFileName[B_PATH_NAME_LENGTH];
 	::snprintf(tempFileName, sizeof(tempFileName), "%s/BSC_clip_XXXXXXX", path.Path());
 	// mkstemp creates a fd with an unique file name.
@@ -751,7 +1806,7 @@ BSCApp::EncodeMovie()
 	// creates a file with this exact name, but it's not likely to happen.
 	int tempFile = ::mkstemp(tempFileName);
 	if (tempFile < 0)
-		throw errno;
+		return errno;
 
 	BString fileName = tempFileName;
 	::close(tempFile);
@@ -761,16 +1816,7 @@ BSCApp::EncodeMovie()
 	BEntry(fileName).Remove();
 
 	// Tell the encoder where to write
-	fEncoder->SetOutputFile(fileName);
-
-	BMessage message(kMsgControllerEncodeStarted);
-	message.AddInt32("frames_total", RecordedFrames());
-	SendNotices(kMsgControllerEncodeStarted, &message);
-
-	BMessenger messenger(this);
-	fEncoder->SetMessenger(messenger);
-
-	fEncoderThread = fEncoder->EncodeThreaded();
+	return encoder->SetOutputFile(fileName);
 }
 
 
@@ -810,6 +1856,25 @@ BSCApp::SetCaptureArea(const BRect& rect)
 }
 
 
+// They must be on the screen, like the capture area
+bool
+BSCApp::SetExtraCaptureAreas(const std::vector<BRect>& areas)
+{
+	BAutolock _(this);
+
+	const BRect screenRect = BScreen().Frame();
+	for (size_t i = 0; i < areas.size(); i++) {
+		if (!screenRect.Contains(areas[i]))
+			return false;
+	}
+
+	Settings& settings = Settings::Current();
+	settings.SetExtraCaptureAreas(areas);
+	// The frames, and so the clip, are as large as all the areas
+	return SetCaptureArea(settings.CaptureArea());
+}
+
+
 void
 BSCApp::SetCaptureFrameRate(const int fps)
 {
@@ -841,6 +1906,8 @@ BSCApp::SetScale(const float &scale)
 	message.AddRect("frame", rect);
 	message.AddFloat("scale", scale);
 	SendNotices(kMsgControllerTargetFrameChanged, &message);
+
+	_RefreshStandby();
 }
 
 
@@ -947,6 +2014,98 @@ BSCApp::GetCodecsList(BObjectList<media_codec_info>& codecList) const
 }
 
 
+bool
+BSCApp::MeasureCodecSpeed(bool selectFastest)
+{
+	BAutolock _(this);
+	// It would slow down the capture and the encoding,
+	// and be slowed down by them
+	if (fCodecTestThread >= 0 || State() != STATE_IDLE)
+		return false;
+
+	fCodecTestList.MakeEmpty(true);
+	const media_codec_info current = fEncoder->MediaCodecInfo();
+	for (int32 i = 0; i < fCodecList->CountItems(); i++) {
+		const media_codec_info* codec = fCodecList->ItemAt(i);
+		if (!selectFastest && (current.id != codec->id || current.sub_id != codec->sub_id))
+			continue;
+		media_codec_info* copy = new (std::nothrow) media_codec_info(*codec);
+		if (copy == NULL || !fCodecTestList.AddItem(copy)) {
+			delete copy;
+			return false;
+		}
+	}
+	if (fCodecTestList.IsEmpty())
+		return false;
+
+	fCodecTestFileFormat = fEncoder->MediaFileFormat();
+	fCodecTestFormat = fEncoder->MediaFormat();
+	fCodecTestSelect = selectFastest;
+	fCodecTestCanceled = false;
+	fCodecTestThread = spawn_thread((thread_entry)CodecTestStarter,
+		"Codec speed test", B_NORMAL_PRIORITY, this);
+	if (fCodecTestThread < 0 || resume_thread(fCodecTestThread) != B_OK) {
+		if (fCodecTestThread >= 0)
+			kill_thread(fCodecTestThread);
+		fCodecTestThread = -1;
+		return false;
+	}
+	return true;
+}
+
+
+float
+BSCApp::CodecFrameRate(const char* codecName) const
+{
+	BAutolock _(const_cast<BSCApp*>(this));
+	for (int32 i = 0; i < fCodecList->CountItems(); i++) {
+		const media_codec_info* codec = fCodecList->ItemAt(i);
+		if (::strcmp(codec->pretty_name, codecName) == 0)
+			return fCodecSpeedTest->CachedFrameRate(*codec, fEncoder->MediaFormat());
+	}
+	return -1;
+}
+
+
+// Called when the codec speed test thread is done
+void
+BSCApp::_CodecSpeedTestFinished(BMessage* message)
+{
+	// Already waited for by _CancelCodecSpeedTest()
+	thread_id thread;
+	if (message->FindInt32("thread", &thread) != B_OK
+		|| thread != fCodecTestThread)
+		return;
+	if (fCodecTestThread >= 0) {
+		status_t unused;
+		wait_for_thread(fCodecTestThread, &unused);
+		fCodecTestThread = -1;
+	}
+	fCodecTestList.MakeEmpty(true);
+
+	const char* codecName = NULL;
+	if (message->FindString("codec_name", &codecName) == B_OK) {
+		std::cout << "BSCApp: selecting " << codecName << ", the fastest codec" << std::endl;
+		SetMediaCodec(codecName);
+	}
+}
+
+
+// Its results are dropped, and the codec isn't changed
+void
+BSCApp::_CancelCodecSpeedTest()
+{
+	if (fCodecTestThread < 0)
+		return;
+	// Stops after the codec it's measuring
+	fCodecTestCanceled = true;
+	status_t unused;
+	wait_for_thread(fCodecTestThread, &unused);
+	fCodecTestThread = -1;
+	fCodecTestList.MakeEmpty(true);
+}
+
+
 media_format
 BSCApp::_ComputeMediaFormat(const int32 &width, const int32 &height,
 	const color_space &colorSpace, const float &fieldRate)
@@ -992,135 +2151,842 @@ BSCApp::UpdateMediaFormatAndCodecsForCurrentFamily()
 									targetRect.IntegerHeight(),
 									settings.ClipDepth(), frameRate);
 
-	fEncoder->SetMediaFormat(mediaFormat);
+	fEncoder->SetMediaFormat(mediaFormat);
+
+	delete fCodecList;
+	fCodecList = new BObjectList<media_codec_info> (1, true);
+
+	// Handle the NULL/GIF media_file_formats
+	media_file_format fileFormat = fEncoder->MediaFileFormat();
+	MediaCache* cache = MediaCache::Default();
+	if ((::strcmp(fileFormat.short_name, NULL_FORMAT_SHORT_NAME) != 0) &&
+		(::strcmp(fileFormat.short_name, GIF_FORMAT_SHORT_NAME) != 0)
+		&& cache != NULL) {
+		cache->GetEncoders(fileFormat, mediaFormat, *fCodecList);
+	}
+
+	SendNotices(kMsgControllerCodecListUpdated);
+	return B_OK;
+}
+
+
+// Called from the window's direct connection thread.
+// Doesn't lock the application: it could block the app_server
+void
+BSCApp::UpdateDirectInfo(direct_buffer_info* info)
+{
+	fDirectFrameBuffer->Update(info);
+}
+
+
+// Reads the screen into the bitmap, converting it to the bitmap's
+// color space. Only called by the capture thread
+status_t
+BSCApp::ReadBitmap(BBitmap* bitmap, bool includeCursor, BRect bounds)
+{
+	return _ReadBitmap(bitmap, includeCursor, bounds,
+		Settings::Current().UseDirectWindow());
+}
+
+
+FramePreview*
+BSCApp::Preview() const
+{
+	return fPreview;
+}
+
+
+status_t
+BSCApp::_ReadBitmap(BBitmap* bitmap, bool includeCursor, BRect bounds,
+	bool useDirectWindow)
+{
+	if (useDirectWindow) {
+		status_t status = fDirectFrameBuffer->ReadBitmap(bitmap, bounds);
+		if (status != B_NOT_ALLOWED)
+			return status;
+	}
+
+	BScreen screen;
+	const color_space screenSpace = screen.ColorSpace();
+	if (bitmap->ColorSpace() == screenSpace)
+		return screen.ReadBitmap(bitmap, includeCursor, &bounds);
+
+	// Read at the screen depth, then convert
+	if (fScreenBitmap == NULL || fScreenBitmap->ColorSpace() != screenSpace
+		|| fScreenBitmap->Bounds() != bitmap->Bounds()) {
+		FrameAllocator::Free(fScreenBitmap);
+		fScreenBitmap = FrameAllocator::Allocate(kFrameStageCapture,
+			bitmap->Bounds(), screenSpace);
+		if (fScreenBitmap == NULL) {
+			return B_NO_MEMORY;
+		}
+	}
+	status_t status = screen.ReadBitmap(fScreenBitmap, includeCursor, &bounds);
+	if (status != B_OK)
+		return status;
+	TraceScope trace("convert");
+	return DirectFrameBuffer::ConvertRows(fScreenBitmap->Bits(),
+		fScreenBitmap->BytesPerRow(), screenSpace, bitmap->Bits(),
+		bitmap->BytesPerRow(), bitmap->ColorSpace(),
+		bitmap->Bounds().IntegerWidth() + 1, bitmap->Bounds().IntegerHeight() + 1);
+}
+
+
+void
+BSCApp::StartCapture()
+{
+	// In standby, everything is ready if the settings
+	// didn't change meanwhile
+	session_config current = _CurrentSessionConfig();
+	if (current.frameRate <= 0)
+		current.frameRate = 10;
+	const bool standby = fStandbyThread >= 0 && current == *fSession;
+	if (!standby)
+		_LeaveStandby();
+	// It would compete with the capture for the CPU and the disk
+	_CancelCodecSpeedTest();
+
+	fNumFrames = 0;
+	fStats->Reset();
+	FrameAllocator::ResetPeaks();
+	if (fTracePath != "")
+		TraceRecorder::Start();
+	fKillCaptureThread = false;
+	fPaused = false;
+
+	status_t poolStatus = standby ? B_OK : _PrepareCapture();
+	// The frames of the replay buffer are only encoded when saved
+	if (poolStatus == B_OK && fSession->encodeWhileRecording
+		&& !fSession->replayBuffer) {
+		// The other outputs are made with it, from the recorded frames
+		if (!fSession->extraOutputs.empty())
+			std::cout << "BSCApp: not encoding while recording, there are other outputs" << std::endl;
+		else if (!fEncodeJobs.IsEmpty())
+			std::cout << "BSCApp: not encoding while recording, the previous clips are still encoding" << std::endl;
+		else
+			_StartLiveEncoding();
+	}
+	if (poolStatus != B_OK) {
+		_StopFrameWriters();
+		fFramePool->Dispose();
+		BMessage message(kMsgControllerCaptureStopped);
+		message.AddInt32("status", poolStatus);
+		SendNotices(kMsgControllerCaptureStopped, &message);
+		return;
+	}
+
+	if (standby) {
+		// The thread is waiting for this
+		fCaptureThread = fStandbyThread;
+		fStandbyThread = -1;
+		fStandingBy = false;
+		release_sem(fPauseSem);
+	} else {
+		fCaptureThread = spawn_thread((thread_entry)CaptureStarter,
+			"Capture thread", B_DISPLAY_PRIORITY, this);
+
+		if (fCaptureThread < 0) {
+			_StopFrameWriters();
+			_CancelLiveEncoding();
+			BMessage message(kMsgControllerCaptureStopped);
+			message.AddInt32("status", fCaptureThread);
+			SendNotices(kMsgControllerCaptureStopped, &message);
+			return;
+		}
+
+		status_t status = resume_thread(fCaptureThread);
+		if (status < B_OK) {
+			kill_thread(fCaptureThread);
+			_StopFrameWriters();
+			_CancelLiveEncoding();
+			BMessage message(kMsgControllerCaptureStopped);
+			message.AddInt32("status", status);
+			SendNotices(kMsgControllerCaptureStopped, &message);
+			return;
+		}
+	}
+
+	// The clips of the previous captures are encoded meanwhile,
+	// without slowing it down
+	_UpdateEncodeThrottle();
+
+	delete fRecordWatch;
+	fRecordWatch = new BStopWatch("record_time", true);
+
+	delete fStopRunner;
+	fStopRunner = NULL;
+
+	// With the replay buffer, it's how much a saved clip keeps
+	if (fRequestedRecordTime != 0 && !fSession->replayBuffer) {
+		BMessenger messenger(NULL, this);
+		// TODO: Use a specific message instead of kMsgGUIToggleCapture
+		// since this could trigger start instead of stopping
+		fStopRunner = new BMessageRunner(messenger,
+							new BMessage(kMsgGUIToggleCapture),
+							fRequestedRecordTime, 1);
+		// reset requested record time, so
+		// it won't be used for the next time
+		// TODO: rework this
+		fRequestedRecordTime = 0;
+	}
+	// The capture thread only counts the frames: the progress
+	// is read from the counters and sent from here
+	fLastGrabbedFrames = 0;
+	fLastSpoolBytes = 0;
+	fLastStatsTime = system_time();
+	delete fStatsRunner;
+	fStatsRunner = new BMessageRunner(BMessenger(this),
+		new BMessage(kPublishStats), kStatsInterval);
+
+	SendNotices(kMsgControllerCaptureStarted);
+}
+
+
+// What a capture needs before the capture thread runs:
+// the settings it uses, the buffers, and the store with its writers
+status_t
+BSCApp::_PrepareCapture()
+{
+	// The recording uses these until it's encoded,
+	// whatever happens to the settings meanwhile
+	*fSession = _CurrentSessionConfig();
+	if (fSession->frameRate <= 0)
+		fSession->frameRate = 10;
+	fEncoder->SetSessionConfig(*fSession);
+
+	// Allocate all the frame buffers upfront, so the capture thread
+	// doesn't have to allocate memory for every frame
+	// Frames are converted to the clip depth while they're copied,
+	// if possible
+	// With more than one area, the frames hold all of them
+	const BRect frameBounds = fSession->frameBounds;
+	const color_space screenSpace = BScreen().ColorSpace();
+	color_space captureSpace = fSession->clipDepth;
+	if (!DirectFrameBuffer::CanConvert(screenSpace, captureSpace))
+		captureSpace = screenSpace;
+	status_t status = fFramePool->Init(frameBounds,
+		captureSpace, FrameBufferCount(frameBounds), kFrameStageCapture,
+		fSession->lockFrameBuffers ? B_FULL_LOCK : B_NO_LOCK);
+	if (status == B_OK) {
+		delete fCursorTrack;
+		fCursorTrack = new (std::nothrow) CursorTrack;
+		if (fCursorTrack == NULL)
+			status = B_NO_MEMORY;
+		else if (fSession->replayBuffer) {
+			// Only the samples of the frames in the buffer are needed
+			status = fCursorTrack->SetCapacity(fSession->replaySeconds
+				* fSession->frameRate);
+		}
+	}
+	if (status == B_OK)
+		status = _StartFrameWriters();
+	return status;
+}
+
+
+// The settings, with the outputs given on the command line
+session_config
+BSCApp::_CurrentSessionConfig() const
+{
+	session_config config = Settings::Current().SessionConfig();
+	const BStringList& outputs = fArgs->Outputs();
+	if (!outputs.IsEmpty()) {
+		config.extraOutputs.clear();
+		for (int32 i = 0; i < outputs.CountStrings(); i++) {
+			encode_output output;
+			if (Settings::ParseEncodeOutput(outputs.StringAt(i), &output))
+				config.extraOutputs.push_back(output);
+		}
+	}
+	return config;
+}
+
+
+// Prepares the next capture while idle, and parks the capture
+// thread, so that starting only has to wake it up
+void
+BSCApp::_EnterStandby()
+{
+	if (!Settings::Current().Standby() || fStandbyThread >= 0
+		|| State() != STATE_IDLE)
+		return;
+
+	fKillCaptureThread = false;
+	fPaused = false;
+	fStandingBy = true;
+	status_t status = _PrepareCapture();
+	if (status == B_OK) {
+		fStandbyThread = spawn_thread((thread_entry)CaptureStarter,
+			"Capture thread", B_DISPLAY_PRIORITY, this);
+		status = fStandbyThread >= 0 ? resume_thread(fStandbyThread) : fStandbyThread;
+		if (status != B_OK && fStandbyThread >= 0)
+			kill_thread(fStandbyThread);
+	}
+	if (status != B_OK) {
+		std::cerr << "BSCApp::_EnterStandby(): " << ::strerror(status) << std::endl;
+		fStandbyThread = -1;
+		fStandingBy = false;
+		_StopFrameWriters();
+		fFrameWriters.MakeEmpty(true);
+		fFramePool->Dispose();
+	}
+}
+
+
+// Frees what _EnterStandby() prepared
+void
+BSCApp::_LeaveStandby()
+{
+	if (fStandbyThread < 0)
+		return;
+
+	fKillCaptureThread = true;
+	release_sem(fPauseSem);
+	status_t unused;
+	wait_for_thread(fStandbyThread, &unused);
+	fStandbyThread = -1;
+	fStandingBy = false;
+
+	fFrameWriters.MakeEmpty(true);
+	fFramePool->Dispose();
+	if (fFrameStore != NULL) {
+		fFrameStore->Release();
+		delete fFrameStore;
+		fFrameStore = NULL;
+	}
+}
+
+
+// The standby capture has its buffers and store sized for the
+// frames it spools: they're made again when the frame changes
+void
+BSCApp::_RefreshStandby()
+{
+	if (fStandbyThread < 0)
+		return;
+	session_config current = _CurrentSessionConfig();
+	if (current.frameRate <= 0)
+		current.frameRate = 10;
+	if (current == *fSession)
+		return;
+	_LeaveStandby();
+	_EnterStandby();
+}
+
+
+void
+BSCApp::EndCapture()
+{
+	BAutolock _(this);
+	if (fCaptureThread > 0) {
+		fPaused = false;
+		fKillCaptureThread = true;
+		// Wake it up, in case it's paused
+		release_sem(fPauseSem);
+		status_t unused;
+		wait_for_thread(fCaptureThread, &unused);
+	}
+	_UpdateEncodeThrottle();
+	// It reads the buffer, which goes away now
+	if (fReplayThread >= 0)
+		_ReplaySaved();
+
+	// The capture thread already waited for the writers:
+	// frames are all on disk now, no need to keep the buffers around
+	// once the encoder is done with the ones it was given
+	if (fLiveEncoder != NULL)
+		fLiveEncoder->StopLiveEncoding();
+	fFrameWriters.MakeEmpty(true);
+	fFramePool->Dispose();
+	FrameAllocator::Free(fScreenBitmap);
+	fScreenBitmap = NULL;
+
+	fRecordWatch->Suspend();
+	delete fStatsRunner;
+	fStatsRunner = NULL;
+	_PublishStats();
+	SendNotices(kMsgControllerCaptureStopped);
+
+	if (fSession->replayBuffer) {
+		// Only the clips saved meanwhile are kept
+		_DiscardReplayBuffer();
+		_DumpTrace();
+		return;
+	}
+	EncodeMovie();
+}
+
+
+// Copies the last seconds of the replay buffer to a new store in
+// the background, then encodes them. The capture goes on meanwhile
+status_t
+BSCApp::SaveReplay(bigtime_t duration)
+{
+	BAutolock _(this);
+	if (fCaptureThread < 0 || !fSession->replayBuffer || fFrameStore == NULL)
+		return B_NOT_ALLOWED;
+	// The clips saved before are still encoded meanwhile
+	if (fReplayThread >= 0)
+		return B_BUSY;
+
+	fReplayDuration = duration != 0 ? duration : fRequestedRecordTime;
+	fReplayStatus = B_OK;
+	fReplayClip = NULL;
+	fReplayTrack = NULL;
+	fReplayThread = spawn_thread((thread_entry)ReplayStarter,
+		"Replay export", B_LOW_PRIORITY, this);
+	if (fReplayThread < 0) {
+		status_t status = fReplayThread;
+		fReplayThread = -1;
+		return status;
+	}
+	status_t status = resume_thread(fReplayThread);
+	if (status != B_OK) {
+		kill_thread(fReplayThread);
+		fReplayThread = -1;
+	}
+	return status;
+}
+
+
+// The replay thread is done, or about to be: its clip is encoded
+void
+BSCApp::_ReplaySaved()
+{
+	if (fReplayThread < 0)
+		return;
+	status_t unused;
+	wait_for_thread(fReplayThread, &unused);
+	fReplayThread = -1;
+
+	FramesList* frames = NULL;
+	encode_job* job = NULL;
+	status_t status = fReplayStatus;
+	if (status == B_OK) {
+		frames = new (std::nothrow) FramesList();
+		job = _CreateEncodeJob();
+		if (frames == NULL || job == NULL)
+			status = B_NO_MEMORY;
+	}
+	if (status == B_OK) {
+		// The clip folder goes with the list
+		frames->AdoptTempPath(fReplayClipPath);
+		fReplayClipPath = "";
+		frames->SetCursorTrack(fReplayTrack);
+		fReplayTrack = NULL;
+		// The list owns the store, even on failure
+		status = frames->AddItemsFromStore(fReplayClip);
+		fReplayClip = NULL;
+	}
+	if (status == B_OK) {
+		job->frames = frames->CountItems();
+		status = job->encoder->SetSource(frames);
+	}
+	if (status == B_OK) {
+		// The job owns the list now
+		frames = NULL;
+		status = _SetTempOutputFile(job->encoder);
+	}
+	if (status == B_OK && !fEncodeJobs.AddItem(job))
+		status = B_NO_MEMORY;
+	if (status != B_OK) {
+		std::cerr << "BSCApp: cannot save the replay: " << ::strerror(status) << std::endl;
+		delete job;
+		delete frames;
+		if (fReplayClip != NULL)
+			fReplayClip->Release();
+		delete fReplayClip;
+		fReplayClip = NULL;
+		if (fReplayClipPath != "")
+			BEntry(fReplayClipPath.String()).Remove();
+		fReplayClipPath = "";
+		delete fReplayTrack;
+		fReplayTrack = NULL;
+		BMessage message(kMsgControllerEncodeFinished);
+		message.AddInt32("status", (int32)status);
+		SendNotices(kMsgControllerEncodeFinished, &message);
+		return;
+	}
+
+	_StartEncodeJob();
+}
+
+
+void
+BSCApp::_DiscardReplayBuffer()
+{
+	if (fFrameStore != NULL) {
+		fFrameStore->Release();
+		delete fFrameStore;
+		fFrameStore = NULL;
+	}
+	delete fCursorTrack;
+	fCursorTrack = NULL;
+	// The saved clips have their own folders
+	FramesList::DeleteTempPath();
+	fNumFrames = 0;
+	fRequestedRecordTime = 0;
+	_EnterStandby();
+}
+
 
-	delete fCodecList;
-	fCodecList = new BObjectList<media_codec_info> (1, true);
+status_t
+BSCApp::_StartFrameWriters()
+{
+	fFrameWriters.MakeEmpty(true);
+
+	// When scaling at capture, the writers scale the frames,
+	// and the store only gets the scaled ones
+	const color_space colorSpace = fFramePool->ColorSpace();
+	BRect spoolFrame = fFramePool->Frame();
+	int32 spoolBytesPerRow = fFramePool->BytesPerRow();
+	bool scaled = false;
+	if (fSession->scaleAtCapture && fSession->targetRect.IsValid()
+		&& fSession->targetRect.OffsetToCopy(B_ORIGIN)
+			!= spoolFrame.OffsetToCopy(B_ORIGIN)) {
+		if (FrameScaler::CanScale(colorSpace, colorSpace)) {
+			spoolFrame = fSession->targetRect.OffsetToCopy(B_ORIGIN);
+			spoolBytesPerRow = (spoolFrame.IntegerWidth() + 1) * 4;
+			scaled = true;
+		} else
+			std::cout << "BSCApp: frames can't be scaled at capture, scaling them when encoding" << std::endl;
+	}
 
-	// Handle the NULL/GIF media_file_formats
-	media_file_format fileFormat = fEncoder->MediaFileFormat();
-	if ((::strcmp(fileFormat.short_name, NULL_FORMAT_SHORT_NAME) != 0) &&
-		(::strcmp(fileFormat.short_name, GIF_FORMAT_SHORT_NAME) != 0)) {
-		int32 cookie = 0;
-		media_codec_info codec;
-		media_format dummyFormat;
-		while (get_next_encoder(&cookie, &fileFormat, &mediaFormat,
-				&dummyFormat, &codec) == B_OK) {
-			media_codec_info* newCodec = new media_codec_info;
-			*newCodec = codec;
-			fCodecList->AddItem(newCodec);
+	// Volumes without room for some seconds of raw frames
+	// aren't used
+	const int64 frameLength = int64(spoolBytesPerRow)
+		* (spoolFrame.IntegerHeight() + 1);
+	const int64 minFreeSpace = std::max(kMinSpoolSpace,
+		frameLength * fSession->frameRate * kSpoolSpaceSeconds);
+	status_t status = FramesList::CreateTempPaths(fSession->spoolFolders,
+		minFreeSpace);
+	if (status != B_OK) {
+		std::cerr << "BSCApp: cannot create the spool folders: " << ::strerror(status) << std::endl;
+		return status;
+	}
+
+	// A new store for every capture, so the next one uses
+	// the kind of store in the settings. One which wasn't given
+	// to the encoder is left by a failed capture
+	if (fFrameStore != NULL) {
+		fFrameStore->Release();
+		delete fFrameStore;
+	}
+	StripedFrameStore* striped = NULL;
+	if (fSession->replayBuffer) {
+		ReplayBuffer* replay = new (std::nothrow) ReplayBuffer;
+		if (replay != NULL) {
+			replay->SetCapacity(fSession->replaySeconds * fSession->frameRate,
+				fSession->replayOnDisk);
 		}
+		fFrameStore = replay;
+	} else if (FramesList::CountPaths() > 1) {
+		// A stripe in every folder, each with its own writer
+		striped = new (std::nothrow) StripedFrameStore;
+		const int32 stripeCount = std::min(FramesList::CountPaths(), kMaxWriterStats);
+		for (int32 i = 0; striped != NULL && i < stripeCount; i++) {
+			status = striped->AddStripe(FrameStore::CreateStore(
+				fSession->frameStoreType), FramesList::PathAt(i));
+			if (status != B_OK) {
+				delete striped;
+				return status;
+			}
+		}
+		fFrameStore = striped;
+	} else
+		fFrameStore = FrameStore::CreateStore(fSession->frameStoreType);
+	if (fFrameStore == NULL)
+		return B_NO_MEMORY;
+
+	// All the writers append to the same store, or to its
+	// stripes. Frames are kept in memory as long as they fit in the configured
+	// share of the free memory (the buffers are already allocated)
+	const int64 memoryBudget = GetFreeMemory() / 100 * fSession->memoryShare;
+	fFrameStore->SetUnbufferedWrites(fSession->unbufferedWrites);
+	status = fFrameStore->Create(FramesList::Path(), spoolFrame,
+		colorSpace, spoolBytesPerRow, memoryBudget);
+	if (status != B_OK)
+		return status;
+
+	// The frames are compressed by the shared threads. The writers
+	// also get them when they may have to start compressing if they
+	// fall behind
+	// The replay buffer only takes whole frames
+	const bool compress = fSession->compressFrames && !fSession->replayBuffer;
+	WorkerPool* compressionPool = NULL;
+	if (compress || fSession->captureBackpressure == kBackpressureCompressFrames) {
+		compressionPool = WorkerPool::Shared(WorkerPool::kNormalWork);
+		if (compressionPool == NULL)
+			return B_NO_MEMORY;
 	}
 
-	SendNotices(kMsgControllerCodecListUpdated);
+	const int32 writerCount = striped != NULL
+		? striped->CountStripes() : kFrameWriterCount;
+	for (int32 i = 0; i < writerCount; i++) {
+		// Every queue must be able to hold all the buffers,
+		// so that Enqueue() can't fail
+		FrameStore* store = striped != NULL ? striped->StripeAt(i) : fFrameStore;
+		FrameWriter* writer = new (std::nothrow) FrameWriter(fFramePool,
+				store, fFramePool->CountBuffers(), compressionPool);
+		if (writer == NULL)
+			return B_NO_MEMORY;
+		writer->SetCompression(compress);
+		writer->SetStats(&fStats->Write(i));
+		fFrameWriters.AddItem(writer);
+		if (scaled) {
+			status = writer->SetScale(spoolFrame, spoolBytesPerRow,
+				WorkerPool::Shared(WorkerPool::kNormalWork));
+			if (status != B_OK)
+				return status;
+		}
+		BString name;
+		name.SetToFormat("Frame writer %" B_PRId32, i + 1);
+		status = writer->Start(name.String());
+		if (status != B_OK)
+			return status;
+	}
 	return B_OK;
 }
 
 
+// Stops the capture before a spool volume fills up: the
+// frames written until then can still be encoded
 void
-BSCApp::UpdateDirectInfo(direct_buffer_info* info)
+BSCApp::_CheckSpoolSpace()
 {
-	BAutolock _(this);
-	if (!fDirectWindowAvailable)
-		fDirectWindowAvailable = true;
-	fDirectInfo = *info;
+	// The replay buffer doesn't grow
+	if (fSession == NULL || fSession->replayBuffer)
+		return;
+	for (int32 i = 0; i < FramesList::CountPaths(); i++) {
+		const int64 freeSpace = GetFreeSpace(FramesList::PathAt(i));
+		if (freeSpace >= 0 && freeSpace < kMinSpoolSpace) {
+			std::cerr << "BSCApp: the volume of " << FramesList::PathAt(i)
+				<< " is almost full, stopping the capture" << std::endl;
+			EndCapture();
+			return;
+		}
+	}
 }
 
 
+// Gives the store to the encoder, since some of the frames
+// may only be in memory, with the folders of the session.
+// The next capture makes new ones
 status_t
-BSCApp::ReadBitmap(BBitmap* bitmap, bool includeCursor, BRect bounds)
+BSCApp::_HandOverFrames(MovieEncoder* encoder)
 {
-	const bool &useDirectWindow = fDirectWindowAvailable && Settings::Current().UseDirectWindow();
-
-	if (!useDirectWindow)
-		return BScreen().ReadBitmap(bitmap, includeCursor, &bounds);
+	FramesList* frames = new (std::nothrow) FramesList();
+	if (frames == NULL)
+		return B_NO_MEMORY;
+	frames->TakeTempPaths();
+
+	// The pointer can still be left out now, unless the encoder
+	// is already drawing it. Then it keeps using our track
+	if (fLiveEncoder == NULL) {
+		if (fSession->includeCursor)
+			frames->SetCursorTrack(fCursorTrack);
+		else
+			delete fCursorTrack;
+		fCursorTrack = NULL;
+	}
 
-	const int32 bytesPerPixel = fDirectInfo.bits_per_pixel >> 3;
-	if (bytesPerPixel <= 0)
-		return B_ERROR;
+	// The list owns the store, even on failure
+	status_t status = frames->AddItemsFromStore(fFrameStore);
+	fFrameStore = NULL;
+	// The frames spooled while encoding live are only the
+	// ones the encoder didn't get
+	if (status == B_OK && fLiveEncoder == NULL)
+		status = _TrimToEncodeRange(frames);
+	if (status == B_OK)
+		status = encoder->SetSource(frames);
+	if (status != B_OK) {
+		// Also deletes the captured frames
+		delete frames;
+	}
+	return status;
+}
 
-	const uint32 rowBytes = fDirectInfo.bytes_per_row / bytesPerPixel;
-	const int32 offset = ((uint32)bounds.left +
-		 ((uint32)bounds.top * rowBytes)) * bytesPerPixel;
 
-	const int32 height = bounds.IntegerHeight() + 1;
-	void* from = (void*)((uint8*)fDirectInfo.bits + offset);
-	void* to = bitmap->Bits();
-	const int32 bytesPerRow = bitmap->BytesPerRow();
-	const int32 areaSize = (bounds.IntegerWidth() + 1) * bytesPerPixel;
-	for (int32 y = 0; y < height; y++) {
-		::memcpy(to, from, areaSize);
-	   	to = (void*)((uint8*)to + bytesPerRow);
-		from = (void*)((uint8*)from + fDirectInfo.bytes_per_row);
+// The range is read from the settings now, so it can still be
+// changed while recording. The store keeps the records before it,
+// which the first delta frames are rebuilt from
+status_t
+BSCApp::_TrimToEncodeRange(FramesList* frames)
+{
+	const Settings& settings = Settings::Current();
+	const int32 start = settings.EncodeRangeStart();
+	const int32 end = settings.EncodeRangeEnd();
+	if (start == 0 && end == 0)
+		return B_OK;
+
+	const int32 count = frames->CountItems();
+	int32 first;
+	int32 last;
+	if (settings.EncodeRangeInFrames()) {
+		first = start;
+		last = end > 0 ? std::min(end, count) : count;
+	} else {
+		first = frames->IndexAt(bigtime_t(start) * 1000);
+		last = end > 0 ? frames->IndexAt(bigtime_t(end) * 1000) : count;
 	}
-
-	return B_OK;
+	if (first >= last) {
+		// Better than losing the recording
+		std::cerr << "BSCApp: no frames in the encode range, encoding all of them" << std::endl;
+		return B_OK;
+	}
+	std::cout << "Encoding frames " << first << " to " << last - 1
+		<< " of " << count << std::endl;
+	return frames->Trim(first, last - first);
 }
 
 
+// Failing isn't an error: the frames are then
+// encoded when the recording stops.
+// Only when no other job is left, it's then the first one
 void
-BSCApp::StartCapture()
+BSCApp::_StartLiveEncoding()
 {
-	fNumFrames = 0;
-	fKillCaptureThread = false;
-	fPaused = false;
-
-	fCaptureThread = spawn_thread((thread_entry)CaptureStarter,
-		"Capture thread", B_DISPLAY_PRIORITY, this);
-
-	if (fCaptureThread < 0) {
-		BMessage message(kMsgControllerCaptureStopped);
-		message.AddInt32("status", fCaptureThread);
-		SendNotices(kMsgControllerCaptureStopped, &message);
+	encode_job* job = _CreateEncodeJob();
+	status_t status = job != NULL ? B_OK : B_NO_MEMORY;
+	if (status == B_OK)
+		status = _SetTempOutputFile(job->encoder);
+	if (status == B_OK && !fEncodeJobs.AddItem(job))
+		status = B_NO_MEMORY;
+	if (status == B_OK) {
+		job->encoder->SetMessenger(BMessenger(this));
+		thread_id thread = job->encoder->StartLiveEncoding(fFramePool,
+			fSession->includeCursor ? fCursorTrack : NULL, fSession->frameRate);
+		if (thread < 0)
+			status = thread;
+		else
+			fEncoderThread = thread;
+	}
+	if (status != B_OK) {
+		std::cerr << "BSCApp: cannot encode while recording: " << ::strerror(status) << std::endl;
+		fEncodeJobs.RemoveItem(job, false);
+		delete job;
 		return;
 	}
+	fLiveEncoder = job->encoder;
+}
 
-	status_t status = resume_thread(fCaptureThread);
-	if (status < B_OK) {
-		kill_thread(fCaptureThread);
-		BMessage message(kMsgControllerCaptureStopped);
-		message.AddInt32("status", status);
-		SendNotices(kMsgControllerCaptureStopped, &message);
+
+// The capture thread must be gone already
+void
+BSCApp::_CancelLiveEncoding()
+{
+	if (fLiveEncoder == NULL)
 		return;
-	}
 
-	delete fRecordWatch;
-	fRecordWatch = new BStopWatch("record_time", true);
+	fLiveEncoder->Cancel();
+	delete fEncodeJobs.RemoveItemAt(0);
+	fEncoderThread = -1;
+	fLiveEncoder = NULL;
+}
 
-	delete fStopRunner;
-	fStopRunner = NULL;
 
-	if (fRequestedRecordTime != 0) {
-		BMessenger messenger(NULL, this);
-		// TODO: Use a specific message instead of kMsgGUIToggleCapture
-		// since this could trigger start instead of stopping
-		fStopRunner = new BMessageRunner(messenger,
-							new BMessage(kMsgGUIToggleCapture),
-							fRequestedRecordTime, 1);
-		// reset requested record time, so
-		// it won't be used for the next time
-		// TODO: rework this
-		fRequestedRecordTime = 0;
+// Batch encoding: the other outputs of the session are
+// encoded in the same pass over the frames as the output file
+void
+BSCApp::_AddEncodeOutputs(encode_job* job)
+{
+	for (size_t i = 0; i < job->session.extraOutputs.size(); i++) {
+		const encode_output& spec = job->session.extraOutputs[i];
+		MovieEncoder* output = _CreateEncodeOutput(spec, *job);
+		if (output != NULL && job->encoder->AddOutput(output) != B_OK) {
+			delete output;
+			output = NULL;
+		}
+		if (output == NULL)
+			std::cerr << "BSCApp: cannot encode to " << spec.fileFormat.String() << std::endl;
 	}
-	SendNotices(kMsgControllerCaptureStarted);
 }
 
 
-void
-BSCApp::EndCapture()
+// An encoder configured like the session, with the format, codec,
+// size and quality of the output. Its file goes next to the output
+// file, named after the format and the scale
+MovieEncoder*
+BSCApp::_CreateEncodeOutput(const encode_output& spec, const encode_job& job)
 {
-	BAutolock _(this);
-	if (fCaptureThread > 0) {
-		fPaused = false;
-		fKillCaptureThread = true;
-		status_t unused;
-		wait_for_thread(fCaptureThread, &unused);
+	media_file_format fileFormat;
+	if (!GetMediaFileFormat(spec.fileFormat, &fileFormat))
+		return NULL;
+
+	session_config config = job.session;
+	config.scale = spec.scale;
+	BRect targetRect = config.frameBounds;
+	targetRect.right = roundf((targetRect.right + 1) * spec.scale / 100 - 1);
+	targetRect.bottom = roundf((targetRect.bottom + 1) * spec.scale / 100 - 1);
+	config.targetRect = targetRect;
+
+	const media_format format = _ComputeMediaFormat(targetRect.IntegerWidth() + 1,
+		targetRect.IntegerHeight() + 1, config.clipDepth, float(config.frameRate));
+
+	media_codec_info codec;
+	::memset(&codec, 0, sizeof(codec));
+	if ((::strcmp(fileFormat.short_name, NULL_FORMAT_SHORT_NAME) != 0) &&
+		(::strcmp(fileFormat.short_name, GIF_FORMAT_SHORT_NAME) != 0)) {
+		BObjectList<media_codec_info> codecs(10, true);
+		MediaCache* cache = MediaCache::Default();
+		if (cache == NULL || cache->GetEncoders(fileFormat, format, codecs) != B_OK)
+			return NULL;
+		const media_codec_info* found = NULL;
+		for (int32 i = 0; i < codecs.CountItems() && found == NULL; i++) {
+			const media_codec_info* info = codecs.ItemAt(i);
+			if (spec.codec == "" || spec.codec == info->pretty_name
+				|| spec.codec == info->short_name)
+				found = info;
+		}
+		if (found == NULL) {
+			std::cerr << "BSCApp: no codec \"" << spec.codec.String() << "\" for " << fileFormat.pretty_name << std::endl;
+			return NULL;
+		}
+		codec = *found;
 	}
 
-	fRecordWatch->Suspend();
-	SendNotices(kMsgControllerCaptureStopped);
+	const BPath outputFile(job.outputFileName.String());
+	BString name = outputFile.Leaf();
+	const int32 extensionIndex = name.FindLast(".");
+	if (extensionIndex > 0)
+		name.Truncate(extensionIndex);
+	name << "-" << fileFormat.short_name;
+	if (spec.scale != 100)
+		name << "-" << int32(spec.scale);
+	if (fileFormat.file_extension[0] != '\0')
+		name << "." << fileFormat.file_extension;
+	BPath path;
+	if (outputFile.GetParent(&path) != B_OK || path.Append(name.String()) != B_OK)
+		return NULL;
+
+	MovieEncoder* output = new (std::nothrow) MovieEncoder;
+	if (output == NULL)
+		return NULL;
+	output->SetSessionConfig(config);
+	output->SetMediaFileFormat(fileFormat);
+	output->SetMediaFormatFamily(fileFormat.family);
+	output->SetMediaFormat(format);
+	output->SetMediaCodecInfo(codec);
+	output->SetColorSpace(config.clipDepth);
+	output->SetDestFrame(targetRect);
+	output->SetQuality(spec.quality);
+	output->SetOutputFile(GetUniqueFileName(path).Path());
+	return output;
+}
 
-	EncodeMovie();
+
+// Waits until all the queued frames are written.
+// Returns the first error encountered by any of the writers
+status_t
+BSCApp::_StopFrameWriters()
+{
+	status_t status = B_OK;
+	for (int32 i = 0; i < fFrameWriters.CountItems(); i++) {
+		status_t writerStatus = fFrameWriters.ItemAt(i)->Stop();
+		if (status == B_OK)
+			status = writerStatus;
+	}
+	return status;
 }
 
 
@@ -1137,29 +3003,18 @@ BSCApp::ResetSettings()
 }
 
 
+// Runs the benchmark (see Benchmark.h) in its own thread,
+// so the application can still serve the media kit and the
+// frame buffer connection. Quits when it's done
 void
 BSCApp::TestSystem()
 {
-#if 0
-	std::cout << "Testing system speed:" << std::endl;
-	int32 numFrames = 500;
-	FramesList* list = new FramesList(true);
-
-	BRect rect = BScreen().Frame();
-	color_space colorSpace = BScreen().ColorSpace();
-	bigtime_t startTime = system_time();
-
-	for (int32 i = 0; i < numFrames; i++)
-		list->AddItem(new BBitmap(rect, colorSpace), system_time());
-
-	bigtime_t elapsedTime = system_time() - startTime;
-
-	delete list;
-
-	std::cout << "Took " << (elapsedTime / 1000) << " msec to write ";
-	std::cout << numFrames << " frames: " << (numFrames / (elapsedTime / 1000000)) << " fps.";
-	std::cout << std::endl;
-#endif
+	thread_id thread = spawn_thread((thread_entry)BenchmarkStarter,
+		"Benchmark", B_NORMAL_PRIORITY, this);
+	if (thread < 0 || resume_thread(thread) != B_OK) {
+		std::cerr << "BSCApp::TestSystem(): cannot start the benchmark" << std::endl;
+		PostMessage(B_QUIT_REQUESTED);
+	}
 }
 
 
@@ -1169,9 +3024,9 @@ BSCApp::_PauseCapture()
 	SendNotices(kMsgControllerCapturePaused);
 	fRecordWatch->Suspend();
 
+	// The capture thread stops after the current frame
 	BAutolock _(this);
 	fPaused = true;
-	suspend_thread(fCaptureThread);
 }
 
 
@@ -1179,28 +3034,34 @@ void
 BSCApp::_ResumeCapture()
 {
 	BAutolock _(this);
-	resume_thread(fCaptureThread);
 	fPaused = false;
+	release_sem(fPauseSem);
 
 	fRecordWatch->Resume();
 	SendNotices(kMsgControllerCaptureResumed);
 }
 
 
+// The job is NULL when the frames couldn't be given to one.
+// Once it's deleted, the next one starts
 void
-BSCApp::_EncodingFinished(const status_t status, const char* fileName)
+BSCApp::_EncodingFinished(const status_t status, const char* fileName,
+	encode_job* job)
 {
-	fEncoderThread = -1;
-	fNumFrames = 0;
+	// A clip saved from the replay buffer, or a previous
+	// capture, while the next one goes on
+	const bool capturing = fCaptureThread > 0;
+	if (!capturing)
+		fNumFrames = 0;
 
 	const Settings& settings = Settings::Current();
 	// TODO: Remove special case handling
-	media_file_format fileFormat = fEncoder->MediaFileFormat();
 	BPath destFile = fileName;
-	if (::strcmp(fileFormat.short_name, NULL_FORMAT_SHORT_NAME) != 0) {
+	if (job != NULL && fileName != NULL && ::strcmp(
+			job->encoder->MediaFileFormat().short_name, NULL_FORMAT_SHORT_NAME) != 0) {
 		// Move temporary file to the correct destination
 		BEntry sourceFile(fileName);
-		destFile = GetUniqueFileName(settings.OutputFileName().String());
+		destFile = GetUniqueFileName(job->outputFileName.String());
 		BPath parent;
 		destFile.GetParent(&parent);
 		BDirectory dir(parent.Path());
@@ -1212,8 +3073,33 @@ BSCApp::_EncodingFinished(const status_t status, const char* fileName)
 		message.AddString("file_name", destFile.Path());
 	SendNotices(kMsgControllerEncodeFinished, &message);
 
+	delete job;
+	_StartEncodeJob();
+	if (capturing || !fEncodeJobs.IsEmpty())
+		return;
+	_DumpTrace();
 	if (settings.QuitWhenFinished())
 		be_app->PostMessage(B_QUIT_REQUESTED);
+	else
+		_EnterStandby();
+}
+
+
+// Once the session, and its encoding, is over
+void
+BSCApp::_DumpTrace()
+{
+	if (!TraceRecorder::IsRecording())
+		return;
+	TraceRecorder::Stop();
+	if (fTracePath == "")
+		return;
+	status_t status = TraceRecorder::Dump(fTracePath.String());
+	if (status != B_OK)
+		std::cerr << "BSCApp: cannot write the trace to " << fTracePath.String()
+			<< ": " << ::strerror(status) << std::endl;
+	else
+		std::cout << "BSCApp: trace written to " << fTracePath.String() << std::endl;
 }
 
 
@@ -1225,6 +3111,8 @@ BSCApp::_HandleTargetFrameChanged(const BRect& targetRect)
 	BMessage targetFrameMessage(kMsgControllerTargetFrameChanged);
 	targetFrameMessage.AddRect("frame", targetRect);
 	SendNotices(kMsgControllerTargetFrameChanged, &targetFrameMessage);
+
+	_RefreshStandby();
 }
 
 
@@ -1235,16 +3123,6 @@ BSCApp::_TestWaitForRetrace()
 }
 
 
-void
-BSCApp::_WaitForRetrace(bigtime_t time)
-{
-	if (fSupportsWaitForRetrace)
-		BScreen().WaitForRetrace(time);
-	else
-		snooze(time);
-}
-
-
 void
 BSCApp::_UpdateFromSettings()
 {
@@ -1269,6 +3147,34 @@ BSCApp::_UpdateFromSettings()
 }
 
 
+// The media plugins changed since the lists were cached.
+// The current file format and codec are looked up again
+void
+BSCApp::_MediaCacheChanged()
+{
+	SendNotices(kMsgControllerFileFormatListUpdated);
+	// The encoder is busy: they'll be looked up when they're changed
+	if (State() != STATE_IDLE)
+		return;
+
+	media_file_format fileFormat;
+	if (!GetMediaFileFormat(MediaFileFormatName(), &fileFormat)
+		&& !GetMediaFileFormat("", &fileFormat))
+		return;
+	const BString codecName = MediaCodecName();
+	SetMediaFileFormat(fileFormat);
+	if (fCodecList == NULL || fCodecList->ItemAt(0) == NULL)
+		return;
+	for (int32 i = 0; i < fCodecList->CountItems(); i++) {
+		if (codecName == fCodecList->ItemAt(i)->pretty_name) {
+			SetMediaCodec(codecName);
+			return;
+		}
+	}
+	SetMediaCodec(fCodecList->ItemAt(0)->pretty_name);
+}
+
+
 void
 BSCApp::_DumpSettings() const
 {
@@ -1279,90 +3185,205 @@ BSCApp::_DumpSettings() const
 int32
 BSCApp::CaptureThread()
 {
-	const Settings& settings = Settings::Current();
-
-	BRect bounds = settings.CaptureArea();
-	int32 frameRate = settings.CaptureFrameRate();
-	if (frameRate <= 0)
-		frameRate = 10;
-	bigtime_t captureDelay = 1000 * (1000 / frameRate);
-
-#if 0
-	TestSystem();
-#endif
+	BRect bounds = fSession->captureArea;
+	const int32 frameRate = fSession->frameRate;
 
 	_TestWaitForRetrace();
+	FramePacer pacer(frameRate, fSupportsWaitForRetrace);
+	CaptureThrottle throttle(fFramePool->CountBuffers());
+	ActivityDetector* detector = NULL;
+	if (fSession->adaptiveFrameRate) {
+		detector = new (std::nothrow) ActivityDetector(fSession->minFrameRate,
+			frameRate);
+	}
+	atomic_set(&fCaptureFrameRate, frameRate);
 
-	// TODO: Check status_t
-	FramesList::CreateTempPath();
+	// In standby, wait until StartCapture() or _LeaveStandby(). The
+	// window and the areas are only looked for then, since they can
+	// have changed meanwhile
+	while (fStandingBy && !fKillCaptureThread) {
+		if (acquire_sem(fPauseSem) == B_BAD_SEM_ID)
+			break;
+	}
+	if (fKillCaptureThread && fStandingBy) {
+		delete detector;
+		_StopFrameWriters();
+		return B_OK;
+	}
 
-	const int32 windowEdge = settings.WindowFrameEdgeSize();
+	const int32 windowEdge = fSession->windowFrameEdgeSize;
 	int32 token = GetWindowTokenForFrame(bounds, windowEdge);
-	status_t error = B_ERROR;
-	BBitmap *bitmap = NULL;
-	const color_space colorSpace = BScreen().ColorSpace();
-	while (!fKillCaptureThread) {
-		if (!fPaused) {
-			if (token != -1) {
-				BRect windowBounds = GetWindowFrameForToken(token, windowEdge);
-				if (windowBounds.IsValid())
-					bounds.OffsetTo(windowBounds.LeftTop());
+	// When following a window, its position is polled by another
+	// thread, so reading it doesn't block the capture
+	WindowTracker* tracker = NULL;
+	if (token != -1) {
+		tracker = new (std::nothrow) WindowTracker(token, windowEdge);
+		if (tracker != NULL && tracker->Start() != B_OK) {
+			delete tracker;
+			tracker = NULL;
+		}
+	}
+	// Windows are followed before the pointer
+	CursorFollower* follower = NULL;
+	if (tracker == NULL && fSession->followCursor) {
+		follower = new (std::nothrow) CursorFollower(bounds, BScreen().Frame(),
+			fSession->followCursorDeadZone, fSession->followCursorSmoothing);
+	}
+	// The other areas are grabbed at the same time as the first one,
+	// on the same clock
+	status_t error = B_OK;
+	AreaGrabber* grabber = NULL;
+	if (!fSession->extraAreas.empty()) {
+		grabber = new (std::nothrow) AreaGrabber;
+		error = grabber != NULL ? grabber->Init(bounds, fSession->extraAreas,
+			fFramePool->ColorSpace()) : B_NO_MEMORY;
+		if (error != B_OK) {
+			std::cerr << "BSCApp::CaptureThread(): cannot grab the areas: ";
+			std::cerr << ::strerror(error) << std::endl;
+		}
+	}
+	pacer.Restart();
+	throttle.Restart();
+
+	// Frame times don't include the time spent paused
+	bigtime_t pausedTime = 0;
+	while (error == B_OK && !fKillCaptureThread) {
+		if (fPaused) {
+			const bigtime_t pauseStart = system_time();
+			// Released by _ResumeCapture() and EndCapture().
+			// Could have been released more than once, so check again
+			while (fPaused && !fKillCaptureThread) {
+				if (acquire_sem(fPauseSem) == B_BAD_SEM_ID)
+					break;
 			}
-
-			bitmap = new (std::nothrow) BBitmap(bounds, colorSpace);
+			pausedTime += system_time() - pauseStart;
+			pacer.Restart();
+			throttle.Restart();
+			if (detector != NULL) {
+				detector->Restart();
+				pacer.SetFrameRate(detector->FrameRate());
+			}
+		} else {
+			pacer.WaitForNextFrame();
+			fStats->SetDroppedFrames(pacer.DroppedFrames());
+			if (throttle.NeedsSample(system_time()))
+				_CheckBackpressure(throttle, pacer, detector, frameRate);
+			BPoint windowPosition;
+			if (tracker != NULL && tracker->GetPosition(windowPosition))
+				bounds.OffsetTo(windowPosition);
+
+			BBitmap* bitmap = fFramePool->Acquire();
 			if (bitmap == NULL) {
-				error = B_NO_MEMORY;
-				std::cerr << "BSCApp::CaptureThread(): error creating bitmap: " << ::strerror(error) << std::endl;
-				break;
+				// All the buffers are in use: skip this frame.
+				// FramePool keeps count of these.
+				fStats->AddSkippedFrame();
+				continue;
 			}
 
-			error = bitmap->InitCheck();
-			if (error != B_OK) {
-				delete bitmap;
-				std::cerr << "BSCApp::CaptureThread(): error initializing bitmap: " << ::strerror(error) << std::endl;
-				break;
+			// The frame shows the screen as it was when
+			// the copy started. The pointer is recorded
+			// apart, relative to the area, and drawn
+			// when encoding. Where the area was goes
+			// with the frame, in the index of the store
+			const bigtime_t frameTime = system_time() - pausedTime;
+			BPoint mousePosition;
+			uint32 buttons;
+			if (get_mouse(&mousePosition, &buttons) == B_OK) {
+				if (follower != NULL)
+					bounds = follower->Update(mousePosition);
+				fCursorTrack->AddSample(frameTime, mousePosition - bounds.LeftTop());
 			}
-
-			error = ReadBitmap(bitmap, true, bounds);
+			const bigtime_t readStart = system_time();
+			TraceRecorder::Begin("grab", fNumFrames);
+			if (grabber != NULL)
+				error = grabber->ReadFrame(bitmap, bounds);
+			else
+				error = _ReadBitmap(bitmap, false, bounds, fSession->useDirectWindow);
+			TraceRecorder::End("grab", fNumFrames);
 			if (error != B_OK) {
-				delete bitmap;
+				fFramePool->Release(bitmap);
 				std::cerr << "BSCApp::CaptureThread(): error reading bitmap" << ::strerror(error) << std::endl;
 				break;
 			}
-
-			bigtime_t lastFrameTime = system_time();
-
-			// TODO: set path ?
-			BString fileName;
-			fileName << FramesList::Path() << "/" << lastFrameTime;
-
-			status_t status = FramesList::WriteFrame(bitmap, lastFrameTime, fileName);
-			delete bitmap;
-
-			if (status != B_OK) {
-				std::cerr << "BSCApp::CaptureThread(): WriteFrame failed: " << ::strerror(error) << std::endl;
-				break;
+			fStats->Grab().AddFrame(system_time() - readStart, bitmap->BitsLength());
+			// The frames keep the time they were taken at,
+			// whatever the rate was
+			if (detector != NULL)
+				pacer.SetFrameRate(detector->AddFrame(bitmap, frameTime));
+			if (pacer.FrameRate() != atomic_get(&fCaptureFrameRate))
+				atomic_set(&fCaptureFrameRate, pacer.FrameRate());
+			// Only when the preview asked for a frame
+			fPreview->AddFrame(bitmap);
+
+			// When encoding while recording, the frames only
+			// go to the writers once the encoder falls behind
+			if (fLiveEncoder == NULL || !fLiveEncoder->EncodeLiveFrame(bitmap, frameTime)) {
+				// Hand the frame over to the writers, round robin.
+				FrameWriter* writer = fFrameWriters.ItemAt(
+					fNumFrames % fFrameWriters.CountItems());
+				error = writer->Status();
+				if (error != B_OK) {
+					fFramePool->Release(bitmap);
+					break;
+				}
+				if (!writer->Enqueue(bitmap, frameTime, fNumFrames,
+						bounds.LeftTop())) {
+					// Can't happen, since the queue can hold all
+					// the buffers, but don't lose the bitmap anyway
+					fFramePool->Release(bitmap);
+					continue;
+				}
 			}
 
 			atomic_add(&fNumFrames, 1);
+		}
+	}
 
-			// Send notices every tenth frame so we don't
-			// overload receivers
-			if (fNumFrames % 10 == 0)
-				SendNotices(kMsgControllerCaptureProgress);
-
-			bigtime_t toWait = (lastFrameTime + captureDelay) - system_time();
-			if (toWait > 0)
-				_WaitForRetrace(toWait); // Wait for Vsync
-		} else
-			snooze(500000);
+	delete tracker;
+	delete follower;
+	delete detector;
+	delete grabber;
+	atomic_set(&fCaptureFrameRate, 0);
+
+	// Wait until all the frames are written
+	status_t writeError = _StopFrameWriters();
+	if (error == B_OK)
+		error = writeError;
+	writeError = fFrameStore->Finish();
+	if (error == B_OK)
+		error = writeError;
+
+	std::cout << "BSCApp::CaptureThread(): " << fFrameStore->CountFramesInMemory();
+	std::cout << " of " << fFrameStore->CountFrames() << " frames kept in memory" << std::endl;
+
+	if (pacer.DroppedFrames() > 0) {
+		std::cerr << "BSCApp::CaptureThread(): " << pacer.DroppedFrames();
+		std::cerr << " frames dropped because the capture was too slow" << std::endl;
+	}
+	const int32 skippedFrames = fFramePool->ExhaustedCount();
+	if (skippedFrames > 0) {
+		std::cerr << "BSCApp::CaptureThread(): " << skippedFrames;
+		std::cerr << " frames skipped because no buffer was available" << std::endl;
+	}
+	// Don't use CaptureQueueHighWaterMark() here: it locks the
+	// application, which could be waiting for us in EndCapture()
+	int32 highWaterMark = 0;
+	for (int32 i = 0; i < fFrameWriters.CountItems(); i++)
+		highWaterMark = std::max(highWaterMark, fFrameWriters.ItemAt(i)->QueueHighWaterMark());
+	std::cout << "BSCApp::CaptureThread(): frame queue high water mark: ";
+	std::cout << highWaterMark << std::endl;
+	if (throttle.FallingBehind()) {
+		BMessage message(kMsgControllerCaptureFallingBehind);
+		message.AddBool("falling_behind", false);
+		message.AddInt64("write_rate", throttle.WriteRate());
+		message.AddInt32("frame_rate", pacer.FrameRate());
+		SendNotices(kMsgControllerCaptureFallingBehind, &message);
 	}
 
 	fCaptureThread = -1;
 	fKillCaptureThread = true;
 
 	if (error != B_OK) {
-		delete bitmap;
 		BMessage message(kMsgControllerCaptureStopped);
 		message.AddInt32("status", (int32)error);
 		SendNotices(kMsgControllerCaptureStopped, &message);
@@ -1372,6 +3393,76 @@ BSCApp::CaptureThread()
 }
 
 
+// Called by the capture thread: doesn't lock the application.
+// While the writers are behind, every new warning lowers the
+// frame rate by a quarter, or switches on compression. Once they
+// have caught up, the rate goes back up a step at a time
+void
+BSCApp::_CheckBackpressure(CaptureThrottle& throttle, FramePacer& pacer,
+	ActivityDetector* detector, int32 frameRate)
+{
+	int64 bytesWritten = 0;
+	int32 queueDepth = 0;
+	for (int32 i = 0; i < fFrameWriters.CountItems(); i++) {
+		FrameWriter* writer = fFrameWriters.ItemAt(i);
+		bytesWritten += writer->BytesWritten();
+		queueDepth += writer->QueueDepth();
+	}
+
+	const throttle_event event = throttle.AddSample(system_time(),
+		bytesWritten, queueDepth, fFramePool->ExhaustedCount());
+	if (event == kThrottleNoChange)
+		return;
+
+	const bool fallingBehind = event == kThrottleFallingBehind;
+	switch (fSession->captureBackpressure) {
+		case kBackpressureLowerFrameRate:
+		{
+			// With the adaptive frame rate, it's its highest
+			// rate which is lowered
+			const int32 current = detector != NULL
+				? detector->MaxFrameRate() : pacer.FrameRate();
+			const int32 rate = fallingBehind ? current * 3 / 4
+				: std::min(frameRate, std::max(current * 4 / 3, current + 1));
+			if (detector != NULL) {
+				detector->SetMaxFrameRate(rate);
+				pacer.SetFrameRate(detector->FrameRate());
+			} else
+				pacer.SetFrameRate(rate);
+			// Raised a step at every recovery, up to the session rate
+			if (!fallingBehind && rate >= frameRate)
+				throttle.RecoveryDone();
+			break;
+		}
+		case kBackpressureCompressFrames:
+			// Compression stays on once started: the writers
+			// would fall behind again without it
+			if (fallingBehind) {
+				for (int32 i = 0; i < fFrameWriters.CountItems(); i++)
+					fFrameWriters.ItemAt(i)->SetCompression(true);
+			} else
+				throttle.RecoveryDone();
+			break;
+		case kBackpressureNotify:
+		default:
+			if (!fallingBehind)
+				throttle.RecoveryDone();
+			break;
+	}
+
+	std::cerr << "BSCApp::CaptureThread(): frame writers ";
+	std::cerr << (fallingBehind ? "falling behind" : "caught up");
+	std::cerr << " (" << throttle.WriteRate() / 1024 << " KiB/s, ";
+	std::cerr << pacer.FrameRate() << " frames/s)" << std::endl;
+
+	BMessage message(kMsgControllerCaptureFallingBehind);
+	message.AddBool("falling_behind", fallingBehind);
+	message.AddInt64("write_rate", throttle.WriteRate());
+	message.AddInt32("frame_rate", pacer.FrameRate());
+	SendNotices(kMsgControllerCaptureFallingBehind, &message);
+}
+
+
 /* static */
 int32
 BSCApp::CaptureStarter(void *arg)
@@ -1380,7 +3471,155 @@ BSCApp::CaptureStarter(void *arg)
 }
 
 
+// Doesn't lock the application: what it needs was copied
+// by MeasureCodecSpeed(), and isn't changed until it's done
+int32
+BSCApp::CodecTestThread()
+{
+	const media_codec_info* fastest = NULL;
+	float fastestRate = 0;
+	for (int32 i = 0; i < fCodecTestList.CountItems() && !fCodecTestCanceled; i++) {
+		const media_codec_info* codec = fCodecTestList.ItemAt(i);
+		float frameRate = 0;
+		status_t status = fCodecSpeedTest->Measure(fCodecTestFileFormat,
+			fCodecTestFormat, *codec, &frameRate);
+
+		BMessage message(kCodecSpeedMeasured);
+		message.AddString("codec_name", codec->pretty_name);
+		message.AddInt32("status", status);
+		if (status == B_OK) {
+			message.AddFloat("fps", frameRate);
+			if (frameRate > fastestRate) {
+				fastest = codec;
+				fastestRate = frameRate;
+			}
+		}
+		PostMessage(&message);
+	}
+
+	BMessage message(kCodecSpeedTestFinished);
+	message.AddInt32("thread", find_thread(NULL));
+	if (fCodecTestSelect && fastest != NULL && !fCodecTestCanceled)
+		message.AddString("codec_name", fastest->pretty_name);
+	PostMessage(&message);
+	return B_OK;
+}
+
+
+/* static */
+int32
+BSCApp::CodecTestStarter(void *arg)
+{
+	return static_cast<BSCApp*>(arg)->CodecTestThread();
+}
+
+
+// Doesn't lock the application: the capture goes on meanwhile.
+// The buffer and the cursor track stay until the thread is waited for
+int32
+BSCApp::ReplayThread()
+{
+	const ReplayBuffer* replay = dynamic_cast<const ReplayBuffer*>(fFrameStore);
+	FrameSpool* clip = new (std::nothrow) FrameSpool;
+	status_t status = (replay != NULL && clip != NULL) ? B_OK : B_NO_MEMORY;
+	// The clips are encoded after the buffer goes on, or is
+	// discarded with its folder, so each is on its own
+	BString clipPath;
+	if (status == B_OK)
+		status = FramesList::CreateClipPath(clipPath);
+	if (status == B_OK) {
+		const int64 memoryBudget = GetFreeMemory() / 100 * fSession->memoryShare;
+		status = clip->Create(clipPath.String(), replay->Bounds(),
+			replay->ColorSpace(), replay->BytesPerRow(), memoryBudget);
+	}
+	int32 count = 0;
+	if (status == B_OK)
+		status = replay->CopyTo(clip, fReplayDuration, &count);
+	if (status == B_OK)
+		status = clip->Finish();
+	if (status == B_OK && count == 0)
+		status = B_ENTRY_NOT_FOUND;
+
+	CursorTrack* track = NULL;
+	if (status == B_OK && fSession->includeCursor) {
+		track = new (std::nothrow) CursorTrack;
+		if (track == NULL)
+			status = B_NO_MEMORY;
+		else
+			status = track->CopySamples(*fCursorTrack, clip->FrameTime(0));
+	}
+	std::cout << "BSCApp::ReplayThread(): " << count << " frames saved" << std::endl;
+
+	if (status != B_OK) {
+		if (clip != NULL)
+			clip->Release();
+		delete clip;
+		clip = NULL;
+		delete track;
+		track = NULL;
+		if (clipPath != "")
+			BEntry(clipPath.String()).Remove();
+		clipPath = "";
+	}
+	fReplayClip = clip;
+	fReplayClipPath = clipPath;
+	fReplayTrack = track;
+	fReplayStatus = status;
+	BMessenger(this).SendMessage(kReplaySaved);
+	return status;
+}
+
+
+/* static */
+int32
+BSCApp::ReplayStarter(void *arg)
+{
+	return static_cast<BSCApp*>(arg)->ReplayThread();
+}
+
+
+// The codecs are the ones of the current file format, tried
+// with frames of the size and the depth of the screen
+int32
+BSCApp::BenchmarkThread()
+{
+	BScreen screen;
+	const BRect frame = screen.Frame();
+	Benchmark benchmark(frame, kBenchmarkFrames);
+	BObjectList<media_codec_info> codecList(1, true);
+	if (GetCodecsList(codecList) == B_OK) {
+		const media_format format = _ComputeMediaFormat(
+			frame.IntegerWidth() + 1, frame.IntegerHeight() + 1,
+			screen.ColorSpace(), 30);
+		benchmark.SetCodecs(fEncoder->MediaFileFormat(), format, codecList);
+	}
+
+	status_t status = benchmark.Run();
+	if (status != B_OK)
+		std::cerr << "BSCApp::BenchmarkThread(): " << ::strerror(status) << std::endl;
+
+	PostMessage(B_QUIT_REQUESTED);
+	return status;
+}
+
+
+/* static */
+int32
+BSCApp::BenchmarkStarter(void *arg)
+{
+	return static_cast<BSCApp*>(arg)->BenchmarkThread();
+}
+
+
 void
 BSCApp::_UsageRequested()
 {
+	std::cout << "Usage: BeScreenCapture [options]" << std::endl;
+	std::cout << "  -r, --recordnow       start recording right away" << std::endl;
+	std::cout << "  -b, --benchmark       test the system and quit" << std::endl;
+	std::cout << "  -o, --output <spec>   also encode to format[:codec[:scale[:quality]]]," << std::endl;
+	std::cout << "                        can be repeated" << std::endl;
+	std::cout << "  -t, --trace <file>    write a trace of the session to file," << std::endl;
+	std::cout << "                        in the Chrome trace format" << std::endl;
+	std::cout << "  -h, --help            show this help" << std::endl;
 }
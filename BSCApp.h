@@ -13,15 +13,32 @@
 #include <MediaFile.h>
 #include <ObjectList.h>
 #include <OS.h>
+#include <String.h>
+
+#include <vector>
 
 #define kAppSignature "application/x-vnd.BeScreenCapture"
 
 class BBitmap;
 class BMessageRunner;
 class BStopWatch;
-class BString;
+class CaptureThrottle;
+class CodecSpeedTest;
+class CursorTrack;
+class DirectFrameBuffer;
+class FramePacer;
+class FramePreview;
+class FramePool;
+class FrameStore;
+class FrameWriter;
+class PipelineStats;
+struct encode_job;
+struct encode_output;
+struct session_config;
+class WorkerPool;
 class FramesList;
 class MovieEncoder;
+class ActivityDetector;
 class Arguments;
 class BSCApp : public BApplication {
 public:
@@ -62,10 +79,19 @@ public:
 
 	float		AverageFPS() const;
 
+	int32		CaptureQueueDepth() const;
+	int32		CaptureQueueHighWaterMark() const;
+
 	void		EncodeMovie();
+	// Encodes the last duration microseconds of the replay buffer,
+	// while it goes on capturing. If 0, the recording time, or all
+	// of it if that's not set either. Fails if not
+	// capturing into one, or if the last clip isn't encoded yet
+	status_t	SaveReplay(bigtime_t duration = 0);
 
 	void		SetUseDirectWindow(const bool &use);
 	bool		SetCaptureArea(const BRect &rect);
+	bool		SetExtraCaptureAreas(const std::vector<BRect>& areas);
 	void		SetCaptureFrameRate(const int fps);
 	void		SetPlaybackFrameRate(const int rate);
 
@@ -84,11 +110,20 @@ public:
 	void		SetMediaCodec(const char* codecName);
 
 	status_t	GetCodecsList(BObjectList<media_codec_info>& codecList) const;
+	// Measures in the background how fast the current codec encodes
+	// the clip frames, or all the codecs, and then selects the fastest.
+	// Sends kMsgControllerCodecSpeedMeasured for every codec.
+	// Fails while recording or encoding, or already measuring
+	bool		MeasureCodecSpeed(bool selectFastest);
+	// Negative if not measured yet
+	float		CodecFrameRate(const char* codecName) const;
 	status_t	UpdateMediaFormatAndCodecsForCurrentFamily();
 
 	void		UpdateDirectInfo(direct_buffer_info *info);
 
 	status_t	ReadBitmap(BBitmap *bitmap, bool includeCursor, BRect bounds);
+	// Scaled down frames, while recording
+	FramePreview*	Preview() const;
 
 	void		ResetSettings();
 
@@ -107,20 +142,60 @@ private:
 	bool fShouldStartRecording;
 
 	thread_id			fCaptureThread;
+	// Parked, with everything ready, until the capture starts
+	thread_id			fStandbyThread;
+	bool				fStandingBy;
 	int32				fNumFrames;
+	// Set by the capture thread, when it changes
+	int32				fCaptureFrameRate;
 	BStopWatch*			fRecordWatch;
 	bool				fKillCaptureThread;
 	bool				fPaused;
-
-	bool				fDirectWindowAvailable;
-	direct_buffer_info	fDirectInfo;
+	sem_id				fPauseSem;
+	FramePool*			fFramePool;
+	FrameStore*			fFrameStore;
+	CursorTrack*		fCursorTrack;
+	session_config*		fSession;
+	PipelineStats*		fStats;
+	FramePreview*		fPreview;
+	BObjectList<FrameWriter> fFrameWriters;
+
+	DirectFrameBuffer*	fDirectFrameBuffer;
+	BBitmap*			fScreenBitmap;
 	MovieEncoder*		fEncoder;
+	// Of the first job, which is the only one encoding
 	thread_id			fEncoderThread;
+	// The first job, while it encodes the capture which goes on
+	MovieEncoder*		fLiveEncoder;
+	// The captures waiting to be encoded, in order
+	BObjectList<encode_job> fEncodeJobs;
 
 	BObjectList<media_codec_info>* fCodecList;
 
+	CodecSpeedTest*		fCodecSpeedTest;
+	thread_id			fCodecTestThread;
+	bool				fCodecTestSelect;
+	bool				fCodecTestCanceled;
+	BObjectList<media_codec_info> fCodecTestList;
+	media_file_format	fCodecTestFileFormat;
+	media_format		fCodecTestFormat;
+
+	thread_id			fReplayThread;
+	bigtime_t			fReplayDuration;
+	status_t			fReplayStatus;
+	FrameStore*			fReplayClip;
+	// Every saved clip has its own folder
+	BString				fReplayClipPath;
+	CursorTrack*		fReplayTrack;
+
 	BMessageRunner*		fStopRunner;
+	BMessageRunner*		fStatsRunner;
+	int64				fLastGrabbedFrames;
+	int64				fLastSpoolBytes;
+	bigtime_t			fLastStatsTime;
 	bigtime_t			fRequestedRecordTime;
+	// Where the trace of the session goes, if any
+	BString				fTracePath;
 
 	bool		fSupportsWaitForRetrace;
 
@@ -129,24 +204,68 @@ private:
 
 	void		StartCapture();
 	void		EndCapture();
+	status_t	_PrepareCapture();
+	session_config _CurrentSessionConfig() const;
+	void		_EnterStandby();
+	void		_LeaveStandby();
+	void		_RefreshStandby();
+
+	status_t	_StartFrameWriters();
+	status_t	_StopFrameWriters();
+	status_t	_HandOverFrames(MovieEncoder* encoder);
+	void		_CheckSpoolSpace();
+	status_t	_TrimToEncodeRange(FramesList* frames);
+	void		_CheckBackpressure(CaptureThrottle& throttle,
+					FramePacer& pacer, ActivityDetector* detector,
+					int32 frameRate);
+	status_t	_SetTempOutputFile(MovieEncoder* encoder);
+	void		_StartLiveEncoding();
+	void		_CancelLiveEncoding();
+	encode_job*	_CreateEncodeJob();
+	void		_StartEncodeJob();
+	void		_UpdateEncodeThrottle();
+	void		_CancelEncodeJobs();
+	void		_AddEncodeOutputs(encode_job* job);
+	MovieEncoder* _CreateEncodeOutput(const encode_output& spec,
+					const encode_job& job);
+	void		_ReplaySaved();
+	void		_DiscardReplayBuffer();
+
+	void		_PublishStats();
+	void		_CodecSpeedTestFinished(BMessage* message);
+	void		_CancelCodecSpeedTest();
 
 	void		_PauseCapture();
 	void		_ResumeCapture();
 
-	void		_EncodingFinished(const status_t status, const char* fileName);
+	void		_EncodingFinished(const status_t status, const char* fileName,
+					encode_job* job);
+	void		_DumpTrace();
 	void		_HandleTargetFrameChanged(const BRect& targetRect);
 	void		_ForwardGUIMessage(BMessage *message);
 
 	media_format	_ComputeMediaFormat(const int32 &width, const int32 &height,
 							const color_space &colorSpace, const float &fieldRate);
 
+	status_t	_ReadBitmap(BBitmap *bitmap, bool includeCursor,
+					BRect bounds, bool useDirectWindow);
+
 	void		_TestWaitForRetrace();
-	void		_WaitForRetrace(bigtime_t time);
 	void		_UpdateFromSettings();
+	void		_MediaCacheChanged();
 	void		_DumpSettings() const;
 
 	status_t CaptureThread();
 	static int32 CaptureStarter(void *arg);
+
+	int32 CodecTestThread();
+	static int32 CodecTestStarter(void *arg);
+
+	int32 ReplayThread();
+	static int32 ReplayStarter(void *arg);
+
+	int32 BenchmarkThread();
+	static int32 BenchmarkStarter(void *arg);
 };
 
 #endif // __BSCAPP_H
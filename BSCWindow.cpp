@@ -196,9 +196,6 @@ BSCWindow::MessageReceived(BMessage *message)
 					fPauseButton->SetLabel(LABEL_PAUSE);
 					break;
 				}
-				case kMsgControllerEncodeStarted:
-					fStartStopButton->SetEnabled(false);
-					break;
 				case kMsgControllerEncodeFinished:
 				{
 					// We're set to quit, bail out
@@ -278,9 +275,10 @@ BSCWindow::DirectConnected(direct_buffer_info *info)
 	switch (info->buffer_state & B_DIRECT_MODE_MASK) {
 		case B_DIRECT_START:
 		case B_DIRECT_MODIFY:
-			app->UpdateDirectInfo(info);
-			break;
 		case B_DIRECT_STOP:
+			// The capture thread must stop using the
+			// frame buffer before we return
+			app->UpdateDirectInfo(info);
 			break;
 		default:
 			break;
@@ -0,0 +1,409 @@
+/*
+ * Copyright 2026 Stefano Ceccherini <stefano.ceccherini@gmail.com>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+#include "Benchmark.h"
+
+#include "DirectFrameBuffer.h"
+#include "FramePool.h"
+#include "FrameScaler.h"
+#include "FrameStore.h"
+#include "FrameWriter.h"
+#include "FramesList.h"
+#include "WorkerPool.h"
+
+#include <Bitmap.h>
+#include <DirectWindow.h>
+#include <Entry.h>
+#include <MediaFile.h>
+#include <MediaTrack.h>
+#include <Screen.h>
+#include <String.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <new>
+
+// Enough for the writers not to wait for the capture
+const static int32 kStoreBuffers = 8;
+const static bigtime_t kConnectionTimeout = 2000000;
+// The frames are timed as if captured at this rate
+const static float kFrameRate = 30;
+
+
+// The frame buffer is only available to a BDirectWindow on screen:
+// this one is just one pixel big, and doesn't take the focus
+class BenchmarkWindow : public BDirectWindow {
+public:
+	BenchmarkWindow(DirectFrameBuffer* frameBuffer)
+		:
+		BDirectWindow(BRect(0, 0, 0, 0), "Benchmark",
+			B_NO_BORDER_WINDOW_LOOK, B_FLOATING_ALL_WINDOW_FEEL,
+			B_NOT_MOVABLE | B_NOT_RESIZABLE | B_AVOID_FOCUS),
+		fFrameBuffer(frameBuffer)
+	{
+	}
+
+	virtual void DirectConnected(direct_buffer_info* info)
+	{
+		BDirectWindow::DirectConnected(info);
+		switch (info->buffer_state & B_DIRECT_MODE_MASK) {
+			case B_DIRECT_START:
+			case B_DIRECT_MODIFY:
+			case B_DIRECT_STOP:
+				fFrameBuffer->Update(info);
+				break;
+			default:
+				break;
+		}
+	}
+
+private:
+	DirectFrameBuffer* fFrameBuffer;
+};
+
+
+Benchmark::Benchmark(const BRect& frame, int32 frameCount)
+	:
+	fFrame(frame),
+	fColorSpace(BScreen().ColorSpace()),
+	fFrameCount(frameCount > 0 ? frameCount : 1),
+	fSource(NULL),
+	fWorkerPool(NULL),
+	fFrameBuffer(NULL),
+	fCodecs(10, true)
+{
+	fFrame.OffsetTo(B_ORIGIN);
+	::memset(&fFileFormat, 0, sizeof(fFileFormat));
+}
+
+
+Benchmark::~Benchmark()
+{
+	delete fSource;
+	delete fWorkerPool;
+	delete fFrameBuffer;
+}
+
+
+void
+Benchmark::SetCodecs(const media_file_format& fileFormat,
+	const media_format& format, const BObjectList<media_codec_info>& codecs)
+{
+	fFileFormat = fileFormat;
+	fFormat = format;
+	// Makes copies of the codecs, since the list is owning
+	fCodecs = codecs;
+}
+
+
+status_t
+Benchmark::Run()
+{
+	// Every stage works on what's on the screen now
+	fSource = new (std::nothrow) BBitmap(fFrame, fColorSpace);
+	if (fSource == NULL || fSource->InitCheck() != B_OK)
+		return B_NO_MEMORY;
+	status_t status = BScreen().ReadBitmap(fSource, false, &fFrame);
+	if (status != B_OK)
+		return status;
+
+	fWorkerPool = new (std::nothrow) WorkerPool("Benchmark");
+	if (fWorkerPool == NULL || fWorkerPool->InitCheck() != B_OK)
+		return B_NO_MEMORY;
+
+	status = FramesList::CreateTempPath();
+	if (status != B_OK)
+		return status;
+
+	system_info info;
+	get_system_info(&info);
+	printf("# BeScreenCapture benchmark: %" B_PRId32 "x%" B_PRId32
+		", color space 0x%x, %" B_PRIu32 " cpus, %" B_PRId32 " frames\n",
+		fFrame.IntegerWidth() + 1, fFrame.IntegerHeight() + 1,
+		(unsigned int)fColorSpace, info.cpu_count, fFrameCount);
+	printf("stage\tvariant\tstatus\tframes\tseconds\tframes/s"
+		"\tinput MB/s\toutput MB/s\n");
+
+	_ReadScreen();
+	_ReadFrameBuffer();
+	_WriteStores();
+	_Scale();
+	_Encode();
+	fflush(stdout);
+	return B_OK;
+}
+
+
+void
+Benchmark::_ReadScreen()
+{
+	BBitmap bitmap(fFrame, fColorSpace);
+	status_t status = bitmap.InitCheck();
+	BScreen screen;
+	const bigtime_t start = system_time();
+	for (int32 i = 0; i < fFrameCount && status == B_OK; i++)
+		status = screen.ReadBitmap(&bitmap, false, &fFrame);
+	const bigtime_t elapsed = system_time() - start;
+
+	const int64 bytes = int64(bitmap.BitsLength()) * fFrameCount;
+	_PrintResult("read", "BScreen", status, elapsed, bytes, bytes);
+}
+
+
+void
+Benchmark::_ReadFrameBuffer()
+{
+	fFrameBuffer = new (std::nothrow) DirectFrameBuffer;
+	if (fFrameBuffer == NULL) {
+		_PrintResult("read", "frame_buffer", B_NO_MEMORY);
+		return;
+	}
+
+	BenchmarkWindow* window = new (std::nothrow) BenchmarkWindow(fFrameBuffer);
+	if (window == NULL) {
+		_PrintResult("read", "frame_buffer", B_NO_MEMORY);
+		return;
+	}
+	window->Show();
+	const bigtime_t timeout = system_time() + kConnectionTimeout;
+	while (!fFrameBuffer->IsAvailable() && system_time() < timeout)
+		snooze(10000);
+
+	BBitmap bitmap(fFrame, fColorSpace);
+	status_t status = bitmap.InitCheck();
+	if (!fFrameBuffer->IsAvailable())
+		status = B_NOT_ALLOWED;
+	const bigtime_t start = system_time();
+	for (int32 i = 0; i < fFrameCount && status == B_OK; i++)
+		status = fFrameBuffer->ReadBitmap(&bitmap, fFrame);
+	const bigtime_t elapsed = system_time() - start;
+
+	// Waits for the connection to be closed
+	if (window->Lock())
+		window->Quit();
+
+	const int64 bytes = int64(bitmap.BitsLength()) * fFrameCount;
+	_PrintResult("read", "frame_buffer", status, elapsed, bytes, bytes);
+}
+
+
+void
+Benchmark::_WriteStores()
+{
+	const struct {
+		int32 type;
+		const char* name;
+	} kStores[] = {
+		{ kSpoolFrameStore, "spool" },
+		{ kBMPFrameStore, "bmp" }
+	};
+
+	const int64 inputBytes = int64(fSource->BitsLength()) * fFrameCount;
+	for (size_t i = 0; i < sizeof(kStores) / sizeof(kStores[0]); i++) {
+		bigtime_t elapsed = 0;
+		int64 bytes = 0;
+		status_t status = _WriteStore(kStores[i].type, elapsed, bytes);
+		_PrintResult("store", kStores[i].name, status, elapsed,
+			inputBytes, bytes);
+	}
+}
+
+
+// Goes through a FrameWriter, like the capture does. Nothing is
+// kept in memory, so every frame reaches the disk
+status_t
+Benchmark::_WriteStore(int32 type, bigtime_t& elapsed, int64& bytes)
+{
+	FrameStore* store = FrameStore::CreateStore(type);
+	if (store == NULL)
+		return B_NO_MEMORY;
+
+	FramePool pool;
+	status_t status = pool.Init(fFrame, fColorSpace, kStoreBuffers);
+	if (status == B_OK) {
+		status = store->Create(FramesList::Path(), fFrame, fColorSpace,
+			pool.BytesPerRow(), 0);
+	}
+
+	FrameWriter* writer = NULL;
+	if (status == B_OK) {
+		writer = new (std::nothrow) FrameWriter(&pool, store,
+			pool.CountBuffers());
+		status = writer != NULL ? writer->Start("Benchmark writer") : B_NO_MEMORY;
+	}
+
+	const bigtime_t start = system_time();
+	for (int32 i = 0; i < fFrameCount && status == B_OK; i++) {
+		BBitmap* bitmap = NULL;
+		while ((bitmap = pool.Acquire()) == NULL)
+			snooze(500);
+		_FillFrame(bitmap, i);
+		if (!writer->Enqueue(bitmap, bigtime_t(i * 1000000 / kFrameRate)))
+			pool.Release(bitmap);
+		status = writer->Status();
+	}
+	if (writer != NULL) {
+		status_t writeStatus = writer->Stop();
+		if (status == B_OK)
+			status = writeStatus;
+		bytes = writer->BytesWritten();
+	}
+	if (status == B_OK)
+		status = store->Finish();
+	elapsed = system_time() - start;
+
+	delete writer;
+	store->Release();
+	delete store;
+	pool.Dispose();
+	return status;
+}
+
+
+void
+Benchmark::_Scale()
+{
+	const struct {
+		FrameScaler::scale_kernel kernel;
+		const char* name;
+	} kKernels[] = {
+		{ FrameScaler::kKernelBox, "box" },
+		{ FrameScaler::kKernelBilinear, "bilinear" },
+		{ FrameScaler::kKernelLanczos, "lanczos" }
+	};
+
+	// To half the size, as when scaling the clip down
+	BRect destFrame(0, 0, (fFrame.IntegerWidth() + 1) / 2 - 1,
+		(fFrame.IntegerHeight() + 1) / 2 - 1);
+	BBitmap dest(destFrame, fColorSpace);
+	for (size_t i = 0; i < sizeof(kKernels) / sizeof(kKernels[0]); i++) {
+		status_t status = dest.InitCheck();
+		if (!FrameScaler::CanScale(fColorSpace, fColorSpace))
+			status = B_NOT_SUPPORTED;
+
+		FrameScaler scaler(kKernels[i].kernel);
+		scaler.SetWorkerPool(fWorkerPool);
+		const bigtime_t start = system_time();
+		for (int32 frame = 0; frame < fFrameCount && status == B_OK; frame++)
+			status = scaler.Scale(fSource, &dest);
+		const bigtime_t elapsed = system_time() - start;
+
+		_PrintResult("scale", kKernels[i].name, status, elapsed,
+			int64(fSource->BitsLength()) * fFrameCount,
+			int64(dest.BitsLength()) * fFrameCount);
+	}
+}
+
+
+void
+Benchmark::_Encode()
+{
+	if (fCodecs.IsEmpty()) {
+		_PrintResult("encode", fFileFormat.short_name, B_NOT_SUPPORTED);
+		return;
+	}
+
+	for (int32 i = 0; i < fCodecs.CountItems(); i++) {
+		const media_codec_info* codec = fCodecs.ItemAt(i);
+		BString variant;
+		variant << fFileFormat.short_name << "/" << codec->short_name;
+		bigtime_t elapsed = 0;
+		int64 bytes = 0;
+		status_t status = _EncodeWith(*codec, elapsed, bytes);
+		_PrintResult("encode", variant.String(), status, elapsed,
+			int64(fSource->BitsLength()) * fFrameCount, bytes);
+	}
+}
+
+
+// Writes the frames with the Media Kit, as MovieEncoder does.
+// The output is the size of the file
+status_t
+Benchmark::_EncodeWith(const media_codec_info& codec, bigtime_t& elapsed,
+	int64& bytes)
+{
+	BString path;
+	path << FramesList::Path() << "/benchmark";
+	entry_ref ref;
+	status_t status = get_ref_for_path(path.String(), &ref);
+	if (status != B_OK)
+		return status;
+
+	BBitmap bitmap(fFrame, fColorSpace);
+	status = bitmap.InitCheck();
+	if (status != B_OK)
+		return status;
+
+	const bigtime_t start = system_time();
+	BMediaFile* file = new (std::nothrow) BMediaFile(&ref, &fFileFormat);
+	if (file == NULL)
+		return B_NO_MEMORY;
+	status = file->InitCheck();
+	BMediaTrack* track = NULL;
+	if (status == B_OK) {
+		track = file->CreateTrack(&fFormat, &codec);
+		if (track == NULL)
+			status = B_ERROR;
+	}
+	if (status == B_OK)
+		status = file->CommitHeader();
+	for (int32 i = 0; i < fFrameCount && status == B_OK; i++) {
+		_FillFrame(&bitmap, i);
+		media_encode_info info;
+		info.flags = i == 0 ? B_MEDIA_KEY_FRAME : 0;
+		info.start_time = bigtime_t(i * 1000000 / kFrameRate);
+		status = track->WriteFrames(bitmap.Bits(), 1, &info);
+	}
+	if (file->CloseFile() != B_OK && status == B_OK)
+		status = B_IO_ERROR;
+	elapsed = system_time() - start;
+	delete file;
+
+	BEntry entry(&ref);
+	off_t size = 0;
+	if (entry.GetSize(&size) == B_OK)
+		bytes = size;
+	entry.Remove();
+	return status;
+}
+
+
+// The screen, with a band which moves down a bit at every frame,
+// so deltas and codecs have something to do
+void
+Benchmark::_FillFrame(BBitmap* bitmap, int32 index) const
+{
+	const int32 height = fFrame.IntegerHeight() + 1;
+	const int32 band = std::max(height / 16, int32(1));
+	const int32 bytesPerRow = bitmap->BytesPerRow();
+	::memcpy(bitmap->Bits(), fSource->Bits(), bitmap->BitsLength());
+
+	uint8* bits = (uint8*)bitmap->Bits();
+	const int32 first = (index * band / 4) % height;
+	for (int32 y = first; y < std::min(first + band, height); y++) {
+		uint8* row = bits + y * bytesPerRow;
+		for (int32 x = 0; x < bytesPerRow; x++)
+			row[x] = ~row[x];
+	}
+}
+
+
+void
+Benchmark::_PrintResult(const char* stage, const char* variant,
+	status_t status, bigtime_t elapsed, int64 inputBytes,
+	int64 outputBytes) const
+{
+	const char* statusString = status == B_OK ? "ok" : ::strerror(status);
+	if (status != B_OK || elapsed <= 0) {
+		printf("%s\t%s\t%s\t0\t0\t0\t0\t0\n", stage, variant, statusString);
+		return;
+	}
+
+	const double seconds = elapsed / 1000000.0;
+	printf("%s\t%s\t%s\t%" B_PRId32 "\t%.3f\t%.1f\t%.1f\t%.1f\n",
+		stage, variant, statusString, fFrameCount, seconds,
+		fFrameCount / seconds, inputBytes / seconds / 1048576,
+		outputBytes / seconds / 1048576);
+}
@@ -0,0 +1,63 @@
+/*
+ * Copyright 2026 Stefano Ceccherini <stefano.ceccherini@gmail.com>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+#ifndef __BENCHMARK_H
+#define __BENCHMARK_H
+
+#include <MediaDefs.h>
+#include <MediaFormats.h>
+#include <ObjectList.h>
+#include <Rect.h>
+
+class BBitmap;
+class DirectFrameBuffer;
+class WorkerPool;
+// Measures every stage of the capture on its own, with the real
+// code, so that machines and releases can be compared:
+// reading the screen, with BScreen and from the frame buffer,
+// writing the frames to every kind of frame store, scaling them
+// with every kernel, and encoding them with every codec.
+// The results are printed on the standard output, one stage
+// per line, as tab separated values.
+class Benchmark {
+public:
+	Benchmark(const BRect& frame, int32 frameCount);
+	~Benchmark();
+
+	// The codecs are tried with the given file format, with frames
+	// in the given format (which must have the size of the frame)
+	void SetCodecs(const media_file_format& fileFormat,
+			const media_format& format,
+			const BObjectList<media_codec_info>& codecs);
+
+	status_t Run();
+
+private:
+	void _ReadScreen();
+	void _ReadFrameBuffer();
+	void _WriteStores();
+	status_t _WriteStore(int32 type, bigtime_t& elapsed, int64& bytes);
+	void _Scale();
+	void _Encode();
+	status_t _EncodeWith(const media_codec_info& codec,
+			bigtime_t& elapsed, int64& bytes);
+
+	void _FillFrame(BBitmap* bitmap, int32 index) const;
+	void _PrintResult(const char* stage, const char* variant,
+			status_t status, bigtime_t elapsed = 0,
+			int64 inputBytes = 0, int64 outputBytes = 0) const;
+
+	BRect fFrame;
+	color_space fColorSpace;
+	int32 fFrameCount;
+	BBitmap* fSource;
+	WorkerPool* fWorkerPool;
+	DirectFrameBuffer* fFrameBuffer;
+
+	media_file_format fFileFormat;
+	media_format fFormat;
+	BObjectList<media_codec_info> fCodecs;
+};
+
+#endif // __BENCHMARK_H
@@ -4,7 +4,6 @@
  */
 #include "CamStatusView.h"
 
-#include "BSCApp.h"
 #include "ControllerObserver.h"
 
 #include <Application.h>
@@ -62,15 +61,19 @@ private:
 
 CamStatusView::CamStatusView()
 	:
-	BView("cam_status_view", B_WILL_DRAW|B_PULSE_NEEDED),
+	BView("cam_status_view", B_WILL_DRAW),
 	fStringView(NULL),
 	fBitmapView(NULL),
 	fEncodingStringView(NULL),
 	fStatusBar(NULL),
 	fNumFrames(0),
+	fRecordTime(0),
+	fAverageFPS(0),
 	fStatusText(""),
 	fRecording(false),
+	fEncoding(false),
 	fPaused(false),
+	fFallingBehind(false),
 	fRecordingBitmap(NULL),
 	fPauseBitmap(NULL)
 {
@@ -120,8 +123,10 @@ CamStatusView::AttachedToWindow()
 	if (be_app->LockLooper()) {
 		be_app->StartWatching(this, kMsgControllerCaptureStarted);
 		be_app->StartWatching(this, kMsgControllerCaptureStopped);
+		be_app->StartWatching(this, kMsgControllerCaptureProgress);
 		be_app->StartWatching(this, kMsgControllerCapturePaused);
 		be_app->StartWatching(this, kMsgControllerCaptureResumed);
+		be_app->StartWatching(this, kMsgControllerCaptureFallingBehind);
 		be_app->StartWatching(this, kMsgControllerEncodeStarted);
 		be_app->StartWatching(this, kMsgControllerEncodeProgress);
 		be_app->StartWatching(this, kMsgControllerEncodeFinished);
@@ -175,11 +180,26 @@ CamStatusView::MessageReceived(BMessage *message)
 				case kMsgControllerCaptureResumed:
 					TogglePause(what == kMsgControllerCapturePaused);
 					break;
+				case kMsgControllerCaptureProgress:
+				{
+					if (!fRecording)
+						break;
+					message->FindInt32("frames_total", &fNumFrames);
+					message->FindInt64("record_time", &fRecordTime);
+					message->FindFloat("average_fps", &fAverageFPS);
+					BString str = _GetRecordingStatusString();
+					fStringView->SetText(str.String());
+					break;
+				}
+				case kMsgControllerCaptureFallingBehind:
+					message->FindBool("falling_behind", &fFallingBehind);
+					break;
 				case kMsgControllerEncodeStarted:
 				{
+					fEncoding = true;
 					fEncodingStringView->SetText(fStatusText);
 					BCardLayout* cardLayout = dynamic_cast<BCardLayout*>(GetLayout());
-					if (cardLayout != NULL)
+					if (cardLayout != NULL && !fRecording)
 						cardLayout->SetVisibleItem(1);
 					int32 totalFrames = 0;
 					if (message->FindInt32("frames_total", &totalFrames) == B_OK)
@@ -220,6 +240,7 @@ CamStatusView::MessageReceived(BMessage *message)
 				}
 				case kMsgControllerEncodeFinished:
 				{
+					fEncoding = false;
 					BCardLayout* cardLayout = dynamic_cast<BCardLayout*>(GetLayout());
 					if (cardLayout != NULL)
 						cardLayout->SetVisibleItem((int32)0);
@@ -238,20 +259,6 @@ CamStatusView::MessageReceived(BMessage *message)
 }
 
 
-void
-CamStatusView::Pulse()
-{
-	if (!fRecording)
-		return;
-
-	BSCApp* app = dynamic_cast<BSCApp*>(be_app);
-	fNumFrames = app->RecordedFrames();
-	BString str = _GetRecordingStatusString();
-	fStringView->SetText(str.String());
-	Invalidate();
-}
-
-
 void
 CamStatusView::TogglePause(const bool paused)
 {
@@ -275,15 +282,24 @@ void
 CamStatusView::SetRecording(const bool recording)
 {
 	fRecording = recording;
+	fFallingBehind = false;
+	fNumFrames = 0;
+	fRecordTime = 0;
+	fAverageFPS = 0;
 	if (recording) {
 		fBitmapView->SetBitmap(fRecordingBitmap);
 		BCardLayout* cardLayout = dynamic_cast<BCardLayout*>(GetLayout());
 		if (cardLayout != NULL)
 			cardLayout->SetVisibleItem((int32)0);
-		fStatusBar->Reset();
+		if (!fEncoding)
+			fStatusBar->Reset();
 	} else {
 		fBitmapView->SetBitmap(NULL);
 		fStringView->SetText("");
+		// Back to the clip which was encoding meanwhile
+		BCardLayout* cardLayout = dynamic_cast<BCardLayout*>(GetLayout());
+		if (cardLayout != NULL && fEncoding)
+			cardLayout->SetVisibleItem(1);
 	}
 	Invalidate();
 }
@@ -313,8 +329,7 @@ CamStatusView::MaxSize()
 BString
 CamStatusView::_GetRecordingStatusString() const
 {
-	BSCApp* app = dynamic_cast<BSCApp*>(be_app);
-	time_t recordTime = (time_t)app->RecordTime() / 1000000;
+	time_t recordTime = (time_t)fRecordTime / 1000000;
 	if (recordTime < 0)
 		recordTime = 0;
 	struct tm timeStruct;
@@ -326,8 +341,11 @@ CamStatusView::_GetRecordingStatusString() const
 	avgFrames.SetToFormat(B_TRANSLATE_COMMENT(
 		", %" B_PRId32 " frames (%.1f frames/s)",
 		"Progress as in '230 frames (14.9 frames/s)'"),
-		fNumFrames, app->AverageFPS());
+		fNumFrames, fAverageFPS);
 
 	timeString << avgFrames;
+	// Shown before the buffers run out and frames are lost
+	if (fFallingBehind)
+		timeString << B_TRANSLATE(", disk too slow");
 	return timeString;
 }
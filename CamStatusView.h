@@ -18,7 +18,6 @@ public:
 	virtual void AttachedToWindow();
 	virtual void Draw(BRect updateRect);
 	virtual void MessageReceived(BMessage *message);
-	virtual void Pulse();
 
 	void TogglePause(const bool paused);
 	bool Paused() const;
@@ -37,9 +36,14 @@ private:
 	BStringView* fEncodingStringView;
 	BStatusBar* fStatusBar;
 	int32 fNumFrames;
+	bigtime_t fRecordTime;
+	float fAverageFPS;
 	BString fStatusText;
 	bool fRecording;
+	// The previous clips can still be encoded while recording
+	bool fEncoding;
 	bool fPaused;
+	bool fFallingBehind;
 	BBitmap* fRecordingBitmap;
 	BBitmap* fPauseBitmap;
 };
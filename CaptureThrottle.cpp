@@ -0,0 +1,119 @@
+/*
+ * Copyright 2026 Stefano Ceccherini <stefano.ceccherini@gmail.com>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+#include "CaptureThrottle.h"
+
+#include <algorithm>
+
+const static bigtime_t kSampleInterval = 250000;
+// About one second of full queues
+const static int32 kPressureSamples = 4;
+// Recovering takes longer, so the capture doesn't
+// keep switching between the two
+const static int32 kCalmSamples = 12;
+
+
+CaptureThrottle::CaptureThrottle(int32 queueCapacity)
+	:
+	fQueueCapacity(std::max(queueCapacity, int32(1))),
+	fFallingBehind(false),
+	fRecovering(false)
+{
+	Restart();
+}
+
+
+// Whether the writers are behind is kept
+void
+CaptureThrottle::Restart()
+{
+	fLastSampleTime = -1;
+	fLastBytesWritten = 0;
+	fLastQueueDepth = 0;
+	fLastSkippedFrames = 0;
+	fWriteRate = 0;
+	fPressureSamples = 0;
+	fCalmSamples = 0;
+}
+
+
+bool
+CaptureThrottle::NeedsSample(bigtime_t now) const
+{
+	return fLastSampleTime < 0 || now - fLastSampleTime >= kSampleInterval;
+}
+
+
+throttle_event
+CaptureThrottle::AddSample(bigtime_t now, int64 bytesWritten,
+	int32 queueDepth, int32 skippedFrames)
+{
+	if (fLastSampleTime < 0 || now <= fLastSampleTime) {
+		// Nothing to compare with yet
+		fLastSampleTime = now;
+		fLastBytesWritten = bytesWritten;
+		fLastQueueDepth = queueDepth;
+		fLastSkippedFrames = skippedFrames;
+		return kThrottleNoChange;
+	}
+
+	// Moving average over about eight samples
+	const int64 rate = (bytesWritten - fLastBytesWritten) * 1000000
+		/ (now - fLastSampleTime);
+	fWriteRate = fWriteRate == 0 ? rate : (fWriteRate * 7 + rate) / 8;
+
+	// Skipped frames are already lost: a full queue, or
+	// one which keeps growing, is on the way there
+	const bool skipped = skippedFrames > fLastSkippedFrames;
+	const bool full = queueDepth > fQueueCapacity / 2;
+	const bool growing = queueDepth > fQueueCapacity / 4
+		&& queueDepth > fLastQueueDepth;
+	const bool calm = !skipped && queueDepth <= fQueueCapacity / 4;
+
+	fLastSampleTime = now;
+	fLastBytesWritten = bytesWritten;
+	fLastQueueDepth = queueDepth;
+	fLastSkippedFrames = skippedFrames;
+
+	if (skipped || full || growing) {
+		fCalmSamples = 0;
+		if (++fPressureSamples >= kPressureSamples) {
+			fPressureSamples = 0;
+			fFallingBehind = true;
+			fRecovering = false;
+			return kThrottleFallingBehind;
+		}
+	} else if (calm) {
+		fPressureSamples = 0;
+		if ((fFallingBehind || fRecovering) && ++fCalmSamples >= kCalmSamples) {
+			fCalmSamples = 0;
+			fFallingBehind = false;
+			fRecovering = true;
+			return kThrottleRecovered;
+		}
+	}
+	return kThrottleNoChange;
+}
+
+
+bool
+CaptureThrottle::FallingBehind() const
+{
+	return fFallingBehind;
+}
+
+
+void
+CaptureThrottle::RecoveryDone()
+{
+	fRecovering = false;
+	fCalmSamples = 0;
+}
+
+
+int64
+CaptureThrottle::WriteRate() const
+{
+	return fWriteRate;
+}
@@ -0,0 +1,67 @@
+/*
+ * Copyright 2026 Stefano Ceccherini <stefano.ceccherini@gmail.com>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+#ifndef __CAPTURETHROTTLE_H
+#define __CAPTURETHROTTLE_H
+
+#include <OS.h>
+
+enum capture_backpressure_policy {
+	// Only tell the observers
+	kBackpressureNotify = 0,
+	// Capture less frames per second until the writers catch up
+	kBackpressureLowerFrameRate = 1,
+	// Compress the frames before writing them
+	kBackpressureCompressFrames = 2
+};
+
+enum throttle_event {
+	kThrottleNoChange = 0,
+	// Sent again as long as the writers keep falling behind
+	kThrottleFallingBehind,
+	// Sent again after as many calm samples, until RecoveryDone()
+	kThrottleRecovered
+};
+
+// Tells when the frame writers can't keep up with the capture,
+// before the frames are lost because all the buffers are in use.
+// The capture thread samples the writers a few times per
+// second: the writers are behind when their
+// queues stay more than half full, or frames get skipped, for
+// a few samples in a row. They have recovered once the queues
+// stay almost empty for longer.
+// Not thread safe: only used by the capture thread.
+class CaptureThrottle {
+public:
+	// queueCapacity is the number of frames the queues can hold
+	// together, that is, the number of frame buffers
+	CaptureThrottle(int32 queueCapacity);
+
+	// Starts sampling again, for example after a pause
+	void Restart();
+
+	bool NeedsSample(bigtime_t now) const;
+	throttle_event AddSample(bigtime_t now, int64 bytesWritten,
+				int32 queueDepth, int32 skippedFrames);
+
+	bool FallingBehind() const;
+	// Once whatever was lowered is back where it was
+	void RecoveryDone();
+	// Smoothed, in bytes per second
+	int64 WriteRate() const;
+
+private:
+	int32 fQueueCapacity;
+	bigtime_t fLastSampleTime;
+	int64 fLastBytesWritten;
+	int32 fLastQueueDepth;
+	int32 fLastSkippedFrames;
+	int64 fWriteRate;
+	int32 fPressureSamples;
+	int32 fCalmSamples;
+	bool fFallingBehind;
+	bool fRecovering;
+};
+
+#endif // __CAPTURETHROTTLE_H
@@ -0,0 +1,188 @@
+/*
+ * Copyright 2026 Stefano Ceccherini <stefano.ceccherini@gmail.com>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+#include "CodecSpeedTest.h"
+
+#include <Autolock.h>
+#include <Bitmap.h>
+#include <Entry.h>
+#include <FindDirectory.h>
+#include <MediaFile.h>
+#include <MediaTrack.h>
+#include <Path.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <new>
+
+#include <errno.h>
+#include <unistd.h>
+
+// Long enough for the codec to settle, short enough to be done
+// in a few seconds with the slow ones
+const static int32 kSampleFrames = 16;
+
+
+CodecSpeedTest::CodecSpeedTest()
+	:
+	fLocker("codec speed test")
+{
+}
+
+
+float
+CodecSpeedTest::CachedFrameRate(const media_codec_info& codec,
+	const media_format& format) const
+{
+	BAutolock _(fLocker);
+	for (size_t i = 0; i < fSpeeds.size(); i++) {
+		if (_Matches(fSpeeds[i], codec, format))
+			return fSpeeds[i].frameRate;
+	}
+	return -1;
+}
+
+
+// Codecs are only measured once for every frame format
+status_t
+CodecSpeedTest::Measure(const media_file_format& fileFormat,
+	const media_format& format, const media_codec_info& codec,
+	float* frameRate)
+{
+	float cached = CachedFrameRate(codec, format);
+	if (cached >= 0) {
+		*frameRate = cached;
+		return B_OK;
+	}
+
+	// Not locked meanwhile: other codecs can be looked up
+	status_t status = _Encode(fileFormat, format, codec, frameRate);
+	if (status != B_OK)
+		return status;
+
+	codec_speed speed;
+	speed.id = codec.id;
+	speed.subId = codec.sub_id;
+	speed.width = format.u.raw_video.display.line_width;
+	speed.height = format.u.raw_video.display.line_count;
+	speed.colorSpace = format.u.raw_video.display.format;
+	speed.frameRate = *frameRate;
+
+	BAutolock _(fLocker);
+	fSpeeds.push_back(speed);
+	return B_OK;
+}
+
+
+/* static */
+bool
+CodecSpeedTest::_Matches(const codec_speed& speed,
+	const media_codec_info& codec, const media_format& format)
+{
+	return speed.id == codec.id && speed.subId == codec.sub_id
+		&& speed.width == format.u.raw_video.display.line_width
+		&& speed.height == format.u.raw_video.display.line_count
+		&& speed.colorSpace == format.u.raw_video.display.format;
+}
+
+
+// Writes the clip to a temporary file, as MovieEncoder does.
+// Two frames, filled beforehand, take turns. Creating the file and
+// the first frame, which can take longer, aren't counted
+status_t
+CodecSpeedTest::_Encode(const media_file_format& fileFormat,
+	const media_format& format, const media_codec_info& codec,
+	float* frameRate) const
+{
+	const BRect frame(0, 0, format.u.raw_video.display.line_width - 1,
+		format.u.raw_video.display.line_count - 1);
+	BBitmap first(frame, format.u.raw_video.display.format);
+	BBitmap second(frame, format.u.raw_video.display.format);
+	status_t status = first.InitCheck();
+	if (status == B_OK)
+		status = second.InitCheck();
+	if (status != B_OK)
+		return status;
+	_FillFrame(&first, 0);
+	_FillFrame(&second, 1);
+
+	BPath path;
+	status = find_directory(B_SYSTEM_TEMP_DIRECTORY, &path);
+	if (status != B_OK)
+		return status;
+	char fileName[B_PATH_NAME_LENGTH];
+	::snprintf(fileName, sizeof(fileName), "%s/BSC_codec_XXXXXX", path.Path());
+	int tempFile = ::mkstemp(fileName);
+	if (tempFile < 0)
+		return errno;
+	::close(tempFile);
+	entry_ref ref;
+	status = get_ref_for_path(fileName, &ref);
+	if (status != B_OK) {
+		BEntry(fileName).Remove();
+		return status;
+	}
+
+	const float fieldRate = std::max(format.u.raw_video.field_rate, 1.0f);
+	BMediaFile* file = new (std::nothrow) BMediaFile(&ref, &fileFormat);
+	if (file == NULL) {
+		BEntry(&ref).Remove();
+		return B_NO_MEMORY;
+	}
+	status = file->InitCheck();
+	BMediaTrack* track = NULL;
+	if (status == B_OK) {
+		media_format trackFormat = format;
+		track = file->CreateTrack(&trackFormat, &codec);
+		if (track == NULL)
+			status = B_ERROR;
+	}
+	if (status == B_OK)
+		status = file->CommitHeader();
+
+	bigtime_t start = 0;
+	for (int32 i = 0; i < kSampleFrames && status == B_OK; i++) {
+		const BBitmap& bitmap = (i & 1) == 0 ? first : second;
+		media_encode_info info;
+		info.flags = i == 0 ? B_MEDIA_KEY_FRAME : 0;
+		info.start_time = bigtime_t(i * 1000000 / fieldRate);
+		status = track->WriteFrames(bitmap.Bits(), 1, &info);
+		if (i == 0)
+			start = system_time();
+	}
+	const bigtime_t elapsed = system_time() - start;
+	file->CloseFile();
+	delete file;
+	BEntry(&ref).Remove();
+
+	if (status != B_OK)
+		return status;
+	*frameRate = float(kSampleFrames - 1) * 1000000 / std::max(elapsed, bigtime_t(1));
+	return B_OK;
+}
+
+
+// Gradients with some noise, and a band which is somewhere else in
+// every frame, so the codec has something to do. Filled byte by byte,
+// so it works with every color space
+void
+CodecSpeedTest::_FillFrame(BBitmap* bitmap, int32 index) const
+{
+	const int32 height = bitmap->Bounds().IntegerHeight() + 1;
+	const int32 bytesPerRow = bitmap->BytesPerRow();
+	const int32 band = std::max(height / 16, int32(1));
+	const int32 first = (height / 4 + index * band * 2) % height;
+	uint8* bits = (uint8*)bitmap->Bits();
+	uint32 seed = 1;
+	for (int32 y = 0; y < height; y++) {
+		uint8* row = bits + y * bytesPerRow;
+		const bool inverted = y >= first && y < first + band;
+		for (int32 x = 0; x < bytesPerRow; x++) {
+			seed = seed * 1103515245 + 12345;
+			const uint8 value = uint8((x * 255 / bytesPerRow + y) ^ ((seed >> 16) & 0x0f));
+			row[x] = inverted ? ~value : value;
+		}
+	}
+}
@@ -0,0 +1,54 @@
+/*
+ * Copyright 2026 Stefano Ceccherini <stefano.ceccherini@gmail.com>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+#ifndef __CODECSPEEDTEST_H
+#define __CODECSPEEDTEST_H
+
+#include <Locker.h>
+#include <MediaDefs.h>
+#include <MediaFormats.h>
+
+#include <vector>
+
+class BBitmap;
+// Measures how many frames per second a codec encodes, by writing
+// a short synthetic clip with frames of the given format, so a codec
+// which can't keep up with the capture can be told apart.
+// The results are kept for every codec and frame format, for as long
+// as the object lives. Thread safe, but Measure() takes a while:
+// better not call it from a window thread.
+class CodecSpeedTest {
+public:
+	CodecSpeedTest();
+
+	// Negative if not measured yet
+	float CachedFrameRate(const media_codec_info& codec,
+			const media_format& format) const;
+
+	status_t Measure(const media_file_format& fileFormat,
+			const media_format& format, const media_codec_info& codec,
+			float* frameRate);
+
+private:
+	struct codec_speed {
+		int32 id;
+		int32 subId;
+		uint32 width;
+		uint32 height;
+		color_space colorSpace;
+		float frameRate;
+	};
+
+	static bool _Matches(const codec_speed& speed,
+			const media_codec_info& codec, const media_format& format);
+	status_t _Encode(const media_file_format& fileFormat,
+			const media_format& format, const media_codec_info& codec,
+			float* frameRate) const;
+	void _FillFrame(BBitmap* bitmap, int32 index) const;
+
+	mutable BLocker fLocker;
+	std::vector<codec_speed> fSpeeds;
+};
+
+#endif // __CODECSPEEDTEST_H
@@ -0,0 +1,335 @@
+/*
+ * Copyright 2026 Stefano Ceccherini <stefano.ceccherini@gmail.com>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+#include "ColorConverter.h"
+
+#include "DirectFrameBuffer.h"
+#include "WorkerPool.h"
+
+#include <algorithm>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// Must be even, for 4:2:0
+const static int32 kBandRows = 16;
+// Pixels converted to 32 bit at a time, on the stack
+const static int32 kChunkPixels = 256;
+
+struct convert_job {
+	const uint8* source;
+	int32 sourceBytesPerRow;
+	color_space sourceSpace;
+	uint8* dest;
+	int32 destBytesPerRow;
+	color_space destSpace;
+	int32 width;
+	int32 height;
+};
+
+
+static bool
+IsRGB32(color_space colorSpace)
+{
+	return colorSpace == B_RGB32 || colorSpace == B_RGBA32;
+}
+
+
+static bool
+IsRGB16(color_space colorSpace)
+{
+	return colorSpace == B_RGB16 || colorSpace == B_RGB15 || colorSpace == B_RGBA15;
+}
+
+
+static bool
+IsYCbCr(color_space colorSpace)
+{
+	return colorSpace == B_YCbCr422 || colorSpace == B_YCbCr420;
+}
+
+
+static void
+ExpandRow16(const uint8* source, color_space colorSpace, uint32* dest, int32 count)
+{
+	const uint16* from = (const uint16*)source;
+	for (int32 x = 0; x < count; x++) {
+		const uint32 pixel = from[x];
+		uint32 red, green, blue;
+		if (colorSpace == B_RGB16) {
+			red = (pixel >> 11) & 0x1f;
+			green = (pixel >> 5) & 0x3f;
+			blue = pixel & 0x1f;
+			green = (green << 2) | (green >> 4);
+		} else {
+			red = (pixel >> 10) & 0x1f;
+			green = (pixel >> 5) & 0x1f;
+			blue = pixel & 0x1f;
+			green = (green << 3) | (green >> 2);
+		}
+		red = (red << 3) | (red >> 2);
+		blue = (blue << 3) | (blue >> 2);
+		dest[x] = 0xff000000 | (red << 16) | (green << 8) | blue;
+	}
+}
+
+
+// Returns "count" pixels of the row, starting at "x", as B_RGB32
+static const uint32*
+SourcePixels(const convert_job& job, int32 y, int32 x, int32 count, uint32* buffer)
+{
+	const uint8* row = job.source + y * job.sourceBytesPerRow;
+	if (IsRGB32(job.sourceSpace))
+		return (const uint32*)row + x;
+	ExpandRow16(row + x * 2, job.sourceSpace, buffer, count);
+	return buffer;
+}
+
+
+// ITU-R BT.601, video range
+static inline uint8
+Luma(uint32 pixel)
+{
+	const int32 red = (pixel >> 16) & 0xff;
+	const int32 green = (pixel >> 8) & 0xff;
+	const int32 blue = pixel & 0xff;
+	return (uint8)(((66 * red + 129 * green + 25 * blue + 128) >> 8) + 16);
+}
+
+
+static inline uint8
+ChromaBlue(int32 red, int32 green, int32 blue)
+{
+	return (uint8)((112 * blue - 38 * red - 74 * green + 128 + (128 << 8)) >> 8);
+}
+
+
+static inline uint8
+ChromaRed(int32 red, int32 green, int32 blue)
+{
+	return (uint8)((112 * red - 94 * green - 18 * blue + 128 + (128 << 8)) >> 8);
+}
+
+
+static void
+ComputeLuma(const uint32* pixels, uint8* luma, int32 count)
+{
+	int32 x = 0;
+#if defined(__SSE2__)
+	// Blue, green, red and alpha weights for two pixels
+	const __m128i weights = _mm_setr_epi16(25, 129, 66, 0, 25, 129, 66, 0);
+	const __m128i rounding = _mm_set1_epi32(128 + (16 << 8));
+	const __m128i zero = _mm_setzero_si128();
+	for (; x + 8 <= count; x += 8) {
+		__m128i sums[2];
+		for (int32 half = 0; half < 2; half++) {
+			const __m128i quad = _mm_loadu_si128((const __m128i*)(pixels + x + half * 4));
+			const __m128i low = _mm_madd_epi16(_mm_unpacklo_epi8(quad, zero), weights);
+			const __m128i high = _mm_madd_epi16(_mm_unpackhi_epi8(quad, zero), weights);
+			// Add the two partial sums of every pixel
+			const __m128i even = _mm_castps_si128(_mm_shuffle_ps(_mm_castsi128_ps(low),
+				_mm_castsi128_ps(high), _MM_SHUFFLE(2, 0, 2, 0)));
+			const __m128i odd = _mm_castps_si128(_mm_shuffle_ps(_mm_castsi128_ps(low),
+				_mm_castsi128_ps(high), _MM_SHUFFLE(3, 1, 3, 1)));
+			sums[half] = _mm_srli_epi32(_mm_add_epi32(_mm_add_epi32(even, odd), rounding), 8);
+		}
+		const __m128i packed = _mm_packs_epi32(sums[0], sums[1]);
+		_mm_storel_epi64((__m128i*)(luma + x), _mm_packus_epi16(packed, packed));
+	}
+#endif
+	for (; x < count; x++)
+		luma[x] = Luma(pixels[x]);
+}
+
+
+static void
+ConvertRowsTo422(const convert_job& job, int32 first, int32 last)
+{
+	uint32 buffer[kChunkPixels];
+	uint8 luma[kChunkPixels];
+	for (int32 y = first; y < last; y++) {
+		uint8* dest = job.dest + y * job.destBytesPerRow;
+		for (int32 x = 0; x < job.width; x += kChunkPixels) {
+			const int32 count = std::min(kChunkPixels, job.width - x);
+			const uint32* pixels = SourcePixels(job, y, x, count, buffer);
+			ComputeLuma(pixels, luma, count);
+			for (int32 i = 0; i < count; i += 2) {
+				// An odd last pixel shares the chroma with itself
+				const int32 next = std::min(i + 1, count - 1);
+				const int32 red = (((pixels[i] >> 16) & 0xff) + ((pixels[next] >> 16) & 0xff) + 1) >> 1;
+				const int32 green = (((pixels[i] >> 8) & 0xff) + ((pixels[next] >> 8) & 0xff) + 1) >> 1;
+				const int32 blue = ((pixels[i] & 0xff) + (pixels[next] & 0xff) + 1) >> 1;
+				*dest++ = luma[i];
+				*dest++ = ChromaBlue(red, green, blue);
+				*dest++ = luma[next];
+				*dest++ = ChromaRed(red, green, blue);
+			}
+		}
+	}
+}
+
+
+static void
+ConvertRowsTo420(const convert_job& job, int32 first, int32 last)
+{
+	const int32 chromaWidth = (job.width + 1) / 2;
+	const int32 chromaHeight = (job.height + 1) / 2;
+	uint8* cbPlane = job.dest + job.width * job.height;
+	uint8* crPlane = cbPlane + chromaWidth * chromaHeight;
+
+	uint32 buffers[2][kChunkPixels];
+	for (int32 y = first; y < last; y += 2) {
+		// An odd last row shares the chroma with itself
+		const int32 nextY = std::min(y + 1, job.height - 1);
+		uint8* cb = cbPlane + (y / 2) * chromaWidth;
+		uint8* cr = crPlane + (y / 2) * chromaWidth;
+		for (int32 x = 0; x < job.width; x += kChunkPixels) {
+			const int32 count = std::min(kChunkPixels, job.width - x);
+			const uint32* top = SourcePixels(job, y, x, count, buffers[0]);
+			const uint32* bottom = SourcePixels(job, nextY, x, count, buffers[1]);
+			ComputeLuma(top, job.dest + y * job.width + x, count);
+			if (nextY != y)
+				ComputeLuma(bottom, job.dest + nextY * job.width + x, count);
+
+			for (int32 i = 0; i < count; i += 2) {
+				const int32 next = std::min(i + 1, count - 1);
+				int32 red = 0, green = 0, blue = 0;
+				const uint32 block[4] = { top[i], top[next], bottom[i], bottom[next] };
+				for (int32 p = 0; p < 4; p++) {
+					red += (block[p] >> 16) & 0xff;
+					green += (block[p] >> 8) & 0xff;
+					blue += block[p] & 0xff;
+				}
+				red = (red + 2) >> 2;
+				green = (green + 2) >> 2;
+				blue = (blue + 2) >> 2;
+				cb[(x + i) / 2] = ChromaBlue(red, green, blue);
+				cr[(x + i) / 2] = ChromaRed(red, green, blue);
+			}
+		}
+	}
+}
+
+
+static void
+ConvertRowsToRGB32(const convert_job& job, int32 first, int32 last)
+{
+	for (int32 y = first; y < last; y++) {
+		ExpandRow16(job.source + y * job.sourceBytesPerRow, job.sourceSpace,
+			(uint32*)(job.dest + y * job.destBytesPerRow), job.width);
+	}
+}
+
+
+static void
+ConvertBand(void* cookie, int32 band)
+{
+	const convert_job& job = *static_cast<const convert_job*>(cookie);
+	const int32 first = band * kBandRows;
+	const int32 last = std::min(first + kBandRows, job.height);
+	switch (job.destSpace) {
+		case B_YCbCr422:
+			ConvertRowsTo422(job, first, last);
+			break;
+		case B_YCbCr420:
+			ConvertRowsTo420(job, first, last);
+			break;
+		default:
+			if (IsRGB16(job.sourceSpace))
+				ConvertRowsToRGB32(job, first, last);
+			else {
+				DirectFrameBuffer::ConvertRows(job.source + first * job.sourceBytesPerRow,
+					job.sourceBytesPerRow, job.sourceSpace,
+					job.dest + first * job.destBytesPerRow, job.destBytesPerRow,
+					job.destSpace, job.width, last - first);
+			}
+			break;
+	}
+}
+
+
+/* static */
+bool
+ColorConverter::CanConvert(color_space from, color_space to)
+{
+	if (DirectFrameBuffer::CanConvert(from, to))
+		return true;
+	if (IsRGB16(from) && IsRGB32(to))
+		return true;
+	return (IsRGB32(from) || IsRGB16(from)) && IsYCbCr(to);
+}
+
+
+/* static */
+status_t
+ColorConverter::GetFrameLayout(color_space colorSpace, int32 width,
+	int32 height, int32* _bytesPerRow, size_t* _size)
+{
+	if (width <= 0 || height <= 0)
+		return B_BAD_VALUE;
+
+	int32 bytesPerRow;
+	size_t size;
+	switch (colorSpace) {
+		case B_YCbCr422:
+			bytesPerRow = ((width + 1) / 2) * 4;
+			size = (size_t)bytesPerRow * height;
+			break;
+		case B_YCbCr420:
+			bytesPerRow = width;
+			size = (size_t)width * height
+				+ 2 * (size_t)((width + 1) / 2) * ((height + 1) / 2);
+			break;
+		default:
+		{
+			size_t pixelChunk;
+			size_t rowAlignment;
+			size_t pixelsPerChunk;
+			status_t status = get_pixel_size_for(colorSpace, &pixelChunk,
+				&rowAlignment, &pixelsPerChunk);
+			if (status != B_OK)
+				return status;
+			bytesPerRow = (width + pixelsPerChunk - 1) / pixelsPerChunk * pixelChunk;
+			bytesPerRow = (bytesPerRow + rowAlignment - 1) / rowAlignment * rowAlignment;
+			size = (size_t)bytesPerRow * height;
+			break;
+		}
+	}
+	if (_bytesPerRow != NULL)
+		*_bytesPerRow = bytesPerRow;
+	if (_size != NULL)
+		*_size = size;
+	return B_OK;
+}
+
+
+/* static */
+status_t
+ColorConverter::Convert(WorkerPool* pool, const void* source,
+	int32 sourceBytesPerRow, color_space sourceSpace, void* dest,
+	int32 destBytesPerRow, color_space destSpace, int32 width, int32 height)
+{
+	if (source == NULL || dest == NULL || width <= 0 || height <= 0)
+		return B_BAD_VALUE;
+	if (!CanConvert(sourceSpace, destSpace))
+		return B_NOT_SUPPORTED;
+
+	convert_job job;
+	job.source = (const uint8*)source;
+	job.sourceBytesPerRow = sourceBytesPerRow;
+	job.sourceSpace = sourceSpace;
+	job.dest = (uint8*)dest;
+	job.destBytesPerRow = destBytesPerRow;
+	job.destSpace = destSpace;
+	job.width = width;
+	job.height = height;
+
+	const int32 bands = (height + kBandRows - 1) / kBandRows;
+	if (pool != NULL && bands > 1)
+		return pool->Run(ConvertBand, &job, bands);
+	for (int32 band = 0; band < bands; band++)
+		ConvertBand(&job, band);
+	return B_OK;
+}
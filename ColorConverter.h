@@ -0,0 +1,35 @@
+/*
+ * Copyright 2026 Stefano Ceccherini <stefano.ceccherini@gmail.com>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+#ifndef __COLORCONVERTER_H
+#define __COLORCONVERTER_H
+
+#include <GraphicsDefs.h>
+#include <SupportDefs.h>
+
+class WorkerPool;
+// Converts frames between the color spaces used to capture
+// and to encode them, splitting the work in bands of rows
+// which run on the worker pool.
+// B_YCbCr422 frames are packed as Y0 Cb0 Y1 Cr0.
+// B_YCbCr420 frames are planar: the luma plane is followed by the
+// Cb and the Cr planes, at half the width and height, without
+// any padding.
+class ColorConverter {
+public:
+	static bool CanConvert(color_space from, color_space to);
+
+	// For B_YCbCr420, the bytes per row of the luma plane
+	static status_t GetFrameLayout(color_space colorSpace, int32 width,
+		int32 height, int32* _bytesPerRow, size_t* _size);
+
+	// The destination bytes per row are ignored for B_YCbCr420,
+	// which always uses the layout given by GetFrameLayout()
+	static status_t Convert(WorkerPool* pool, const void* source,
+		int32 sourceBytesPerRow, color_space sourceSpace, void* dest,
+		int32 destBytesPerRow, color_space destSpace, int32 width,
+		int32 height);
+};
+
+#endif // __COLORCONVERTER_H
@@ -26,7 +26,12 @@ enum appMessages {
 	kCaptureFinished,
 	kEncodingFinished,
 	kEncodingProgress,
-	kFileNameChanged
+	kFileNameChanged,
+	kPublishStats,
+	kCodecSpeedMeasured,
+	kCodecSpeedTestFinished,
+	kMediaCacheChanged,
+	kReplaySaved
 };
 
 
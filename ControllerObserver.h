@@ -12,6 +12,13 @@ enum {
 	kMsgControllerCapturePaused,
 	kMsgControllerCaptureResumed,
 	kMsgControllerCaptureProgress,			// int32 "frames_total"
+											// bigtime_t "record_time"
+											// float "fps", "average_fps"
+											// int32 "target_fps"
+											// int32 "queue_capacity"
+											// int64 "disk_rate"
+											// and the fields of the
+											// Stats scripting property
 
 	kMsgControllerEncodeStarted,			// int32 "frames_total"
 
@@ -34,7 +41,18 @@ enum {
 
 	kMsgControllerCaptureFrameRateChanged,	// int32 "frame_rate"
 
-	kMsgControllerResetSettings
+	kMsgControllerResetSettings,
+
+	kMsgControllerCaptureFallingBehind,		// bool "falling_behind"
+											// int64 "write_rate"
+											// int32 "frame_rate"
+
+	kMsgControllerCodecSpeedMeasured,		// const char* "codec_name"
+											// status_t "status"
+											// float "fps"
+											// float "target_fps"
+
+	kMsgControllerFileFormatListUpdated
 };
 
 
@@ -0,0 +1,68 @@
+/*
+ * Copyright 2026 Stefano Ceccherini <stefano.ceccherini@gmail.com>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+#include "CursorFollower.h"
+
+#include <algorithm>
+#include <cmath>
+
+
+CursorFollower::CursorFollower(const BRect& area, const BRect& screen,
+	int32 deadZone, int32 smoothing)
+	:
+	fScreen(screen),
+	fWidth(area.Width()),
+	fHeight(area.Height()),
+	fSmoothing(std::min(std::max(smoothing, int32(0)), int32(95)) / 100.0f),
+	fPosition(area.LeftTop()),
+	fTarget(area.LeftTop())
+{
+	// There must be some room left in the middle
+	fDeadZoneX = std::min(float(std::max(deadZone, int32(0))), fWidth / 2 - 1);
+	fDeadZoneY = std::min(float(std::max(deadZone, int32(0))), fHeight / 2 - 1);
+	fDeadZoneX = std::max(fDeadZoneX, 0.0f);
+	fDeadZoneY = std::max(fDeadZoneY, 0.0f);
+}
+
+
+BRect
+CursorFollower::Update(const BPoint& pointer)
+{
+	// The target only changes when the pointer leaves the middle
+	// of the area where it would be
+	if (pointer.x < fTarget.x + fDeadZoneX)
+		fTarget.x = pointer.x - fDeadZoneX;
+	else if (pointer.x > fTarget.x + fWidth - fDeadZoneX)
+		fTarget.x = pointer.x - fWidth + fDeadZoneX;
+	if (pointer.y < fTarget.y + fDeadZoneY)
+		fTarget.y = pointer.y - fDeadZoneY;
+	else if (pointer.y > fTarget.y + fHeight - fDeadZoneY)
+		fTarget.y = pointer.y - fHeight + fDeadZoneY;
+
+	fTarget.x = _Clamp(fTarget.x, fScreen.left, fScreen.right - fWidth);
+	fTarget.y = _Clamp(fTarget.y, fScreen.top, fScreen.bottom - fHeight);
+
+	fPosition.x = fTarget.x + (fPosition.x - fTarget.x) * fSmoothing;
+	fPosition.y = fTarget.y + (fPosition.y - fTarget.y) * fSmoothing;
+	return Area();
+}
+
+
+// On whole pixels
+BRect
+CursorFollower::Area() const
+{
+	const BPoint leftTop(roundf(fPosition.x), roundf(fPosition.y));
+	return BRect(leftTop, leftTop + BPoint(fWidth, fHeight));
+}
+
+
+float
+CursorFollower::_Clamp(float value, float min, float max) const
+{
+	// An area larger than the screen stays at its left top
+	if (max < min)
+		return min;
+	return std::min(std::max(value, min), max);
+}
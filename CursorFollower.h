@@ -0,0 +1,39 @@
+/*
+ * Copyright 2026 Stefano Ceccherini <stefano.ceccherini@gmail.com>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+#ifndef __CURSORFOLLOWER_H
+#define __CURSORFOLLOWER_H
+
+#include <Rect.h>
+
+// Moves a capture area around the screen so that it follows the
+// pointer. The area keeps its size, so it stays as FixRect() made it.
+// It only moves when the pointer gets nearer than deadZone pixels
+// to one of its sides, and then it goes there a bit at a time:
+// smoothing is the percentage of the distance still left after
+// every frame, 0 jumps at once.
+class CursorFollower {
+public:
+	CursorFollower(const BRect& area, const BRect& screen,
+		int32 deadZone, int32 smoothing);
+
+	// Once per frame. Returns where the area is now
+	BRect Update(const BPoint& pointer);
+	BRect Area() const;
+
+private:
+	float _Clamp(float value, float min, float max) const;
+
+	BRect fScreen;
+	float fWidth;
+	float fHeight;
+	float fDeadZoneX;
+	float fDeadZoneY;
+	float fSmoothing;
+	// Not rounded, so slow movements aren't lost
+	BPoint fPosition;
+	BPoint fTarget;
+};
+
+#endif // __CURSORFOLLOWER_H
@@ -0,0 +1,259 @@
+/*
+ * Copyright 2026 Stefano Ceccherini <stefano.ceccherini@gmail.com>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+#include "CursorTrack.h"
+
+#include <Autolock.h>
+#include <Bitmap.h>
+
+#include <algorithm>
+#include <cstring>
+#include <new>
+
+// 'X' is black, 'o' is white, the rest is transparent.
+// The hot spot is the top left pixel
+static const char* const kArrowCursor[] = {
+	"X",
+	"XX",
+	"XoX",
+	"XooX",
+	"XoooX",
+	"XooooX",
+	"XoooooX",
+	"XooooooX",
+	"XoooooooX",
+	"XoooooXXXX",
+	"XooXooX",
+	"XoX XooX",
+	"XX  XooX",
+	"X    XooX",
+	"     XooX",
+	"      XX"
+};
+const static int32 kArrowCursorHeight = sizeof(kArrowCursor) / sizeof(kArrowCursor[0]);
+const static int32 kArrowCursorWidth = 10;
+
+
+static bool
+CompareSampleTime(const cursor_sample& sample, bigtime_t time)
+{
+	return sample.time < time;
+}
+
+
+static inline uint32
+BlendPixel(uint32 dest, uint32 source)
+{
+	const uint32 alpha = source >> 24;
+	if (alpha == 255)
+		return source;
+	if (alpha == 0)
+		return dest;
+	uint32 result = 0;
+	for (int32 shift = 0; shift < 24; shift += 8) {
+		const uint32 s = (source >> shift) & 0xff;
+		const uint32 d = (dest >> shift) & 0xff;
+		result |= ((s * alpha + d * (255 - alpha)) / 255) << shift;
+	}
+	return result | (dest & 0xff000000);
+}
+
+
+// The pointer is either opaque or transparent, so there's
+// no need to blend 16 bit pixels
+static inline uint16
+ConvertPixel16(uint32 pixel, color_space colorSpace)
+{
+	if (colorSpace == B_RGB16)
+		return ((pixel >> 8) & 0xf800) | ((pixel >> 5) & 0x07e0) | ((pixel >> 3) & 0x001f);
+	return ((pixel >> 9) & 0x7c00) | ((pixel >> 6) & 0x03e0) | ((pixel >> 3) & 0x001f)
+		| (colorSpace == B_RGBA15 ? 0x8000 : 0);
+}
+
+
+CursorTrack::CursorTrack()
+	:
+	fLocker("Cursor track"),
+	fCapacity(0),
+	fArrow(NULL),
+	fArrowHotSpot(0, 0)
+{
+	fArrow = new (std::nothrow) BBitmap(BRect(0, 0, kArrowCursorWidth - 1,
+		kArrowCursorHeight - 1), B_RGBA32);
+	if (fArrow == NULL || fArrow->InitCheck() != B_OK) {
+		delete fArrow;
+		fArrow = NULL;
+		return;
+	}
+
+	for (int32 y = 0; y < kArrowCursorHeight; y++) {
+		uint32* bits = (uint32*)((uint8*)fArrow->Bits() + y * fArrow->BytesPerRow());
+		const int32 length = ::strlen(kArrowCursor[y]);
+		for (int32 x = 0; x < kArrowCursorWidth; x++) {
+			const char pixel = x < length ? kArrowCursor[y][x] : ' ';
+			if (pixel == 'X')
+				bits[x] = 0xff000000;
+			else if (pixel == 'o')
+				bits[x] = 0xffffffff;
+			else
+				bits[x] = 0x00000000;
+		}
+	}
+}
+
+
+CursorTrack::~CursorTrack()
+{
+	delete fArrow;
+}
+
+
+status_t
+CursorTrack::SetCapacity(int32 count)
+{
+	if (count < 0)
+		return B_BAD_VALUE;
+	BAutolock _(fLocker);
+	try {
+		fSamples.reserve(count * 2);
+	} catch (...) {
+		return B_NO_MEMORY;
+	}
+	fCapacity = count;
+	return B_OK;
+}
+
+
+status_t
+CursorTrack::CopySamples(const CursorTrack& source, bigtime_t since)
+{
+	std::vector<cursor_sample> samples;
+	{
+		BAutolock _(source.fLocker);
+		std::vector<cursor_sample>::const_iterator first = std::lower_bound(
+			source.fSamples.begin(), source.fSamples.end(), since,
+			CompareSampleTime);
+		// The one before is still the position at that time
+		if (first != source.fSamples.begin())
+			first--;
+		try {
+			samples.assign(first, source.fSamples.end());
+		} catch (...) {
+			return B_NO_MEMORY;
+		}
+	}
+	BAutolock _(fLocker);
+	try {
+		fSamples.insert(fSamples.end(), samples.begin(), samples.end());
+	} catch (...) {
+		return B_NO_MEMORY;
+	}
+	return B_OK;
+}
+
+
+status_t
+CursorTrack::AddSample(bigtime_t time, BPoint position, uint32 shape)
+{
+	cursor_sample sample;
+	sample.time = time;
+	sample.position = position;
+	sample.shape = shape;
+	BAutolock _(fLocker);
+	if (fCapacity > 0 && fSamples.size() >= fCapacity * 2)
+		fSamples.erase(fSamples.begin(), fSamples.begin() + fCapacity);
+	try {
+		fSamples.push_back(sample);
+	} catch (...) {
+		return B_NO_MEMORY;
+	}
+	return B_OK;
+}
+
+
+int32
+CursorTrack::CountSamples() const
+{
+	BAutolock _(fLocker);
+	return fSamples.size();
+}
+
+
+bool
+CursorTrack::SameSample(bigtime_t time, bigtime_t otherTime) const
+{
+	BAutolock _(fLocker);
+	const cursor_sample* sample = _SampleAt(time);
+	const cursor_sample* other = _SampleAt(otherTime);
+	if (sample == NULL || other == NULL)
+		return sample == other;
+	return sample->position == other->position && sample->shape == other->shape;
+}
+
+
+// Only 32, 16 and 15 bit frames are supported.
+// The others are left untouched
+status_t
+CursorTrack::DrawCursor(BBitmap* frame, bigtime_t time, BPoint scale) const
+{
+	if (frame == NULL)
+		return B_BAD_VALUE;
+	if (fArrow == NULL)
+		return B_NO_INIT;
+	const color_space colorSpace = frame->ColorSpace();
+	const bool is32Bit = colorSpace == B_RGB32 || colorSpace == B_RGBA32;
+	if (!is32Bit && colorSpace != B_RGB16 && colorSpace != B_RGB15
+		&& colorSpace != B_RGBA15)
+		return B_NOT_SUPPORTED;
+
+	// The sample is copied, since the vector can grow
+	// while the pointer is drawn
+	cursor_sample sample;
+	{
+		BAutolock _(fLocker);
+		const cursor_sample* found = _SampleAt(time);
+		if (found == NULL)
+			return B_OK;
+		sample = *found;
+	}
+
+	const BRect frameBounds = frame->Bounds();
+	const int32 left = (int32)(sample.position.x * scale.x - fArrowHotSpot.x);
+	const int32 top = (int32)(sample.position.y * scale.y - fArrowHotSpot.y);
+	const int32 startX = std::max(int32(0), -left);
+	const int32 startY = std::max(int32(0), -top);
+	const int32 endX = std::min(kArrowCursorWidth, frameBounds.IntegerWidth() + 1 - left);
+	const int32 endY = std::min(kArrowCursorHeight, frameBounds.IntegerHeight() + 1 - top);
+
+	for (int32 y = startY; y < endY; y++) {
+		const uint32* from = (const uint32*)((const uint8*)fArrow->Bits()
+			+ y * fArrow->BytesPerRow());
+		uint8* row = (uint8*)frame->Bits() + (top + y) * frame->BytesPerRow();
+		if (is32Bit) {
+			uint32* to = (uint32*)row + left;
+			for (int32 x = startX; x < endX; x++)
+				to[x] = BlendPixel(to[x], from[x]);
+		} else {
+			uint16* to = (uint16*)row + left;
+			for (int32 x = startX; x < endX; x++) {
+				if ((from[x] >> 24) >= 128)
+					to[x] = ConvertPixel16(from[x], colorSpace);
+			}
+		}
+	}
+	return B_OK;
+}
+
+
+// Returns the latest sample taken before or at the given time
+const cursor_sample*
+CursorTrack::_SampleAt(bigtime_t time) const
+{
+	// Samples are added in order
+	std::vector<cursor_sample>::const_iterator i = std::lower_bound(
+		fSamples.begin(), fSamples.end(), time + 1, CompareSampleTime);
+	if (i == fSamples.begin())
+		return NULL;
+	return &*(i - 1);
+}
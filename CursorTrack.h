@@ -0,0 +1,66 @@
+/*
+ * Copyright 2026 Stefano Ceccherini <stefano.ceccherini@gmail.com>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+#ifndef __CURSORTRACK_H
+#define __CURSORTRACK_H
+
+#include <Locker.h>
+#include <Point.h>
+
+#include <vector>
+
+// The app_server doesn't tell which cursor is shown,
+// so only the arrow is known for now
+enum cursor_shape {
+	kCursorArrow = 0
+};
+
+struct cursor_sample {
+	bigtime_t time;
+	// Relative to the captured area
+	BPoint position;
+	uint32 shape;
+};
+
+class BBitmap;
+// The position of the mouse pointer for every captured frame.
+// Frames are captured without the pointer, which is drawn over
+// them when they are encoded, so it can also be left out.
+// Samples are added by the capture thread, and can be read
+// by the encoder at the same time when encoding while recording.
+class CursorTrack {
+public:
+	CursorTrack();
+	~CursorTrack();
+
+	// Keeps at least the last count samples, and then no more than
+	// twice as many: the older half is dropped when it's full, so the
+	// track doesn't grow, and nothing is allocated, while the capture
+	// goes on. 0, the default, keeps them all
+	status_t SetCapacity(int32 count);
+	// Adds the samples of the source from the given time on
+	status_t CopySamples(const CursorTrack& source, bigtime_t since);
+
+	status_t AddSample(bigtime_t time, BPoint position,
+				uint32 shape = kCursorArrow);
+	int32 CountSamples() const;
+	// If the pointer would be drawn the same way at both times
+	bool SameSample(bigtime_t time, bigtime_t otherTime) const;
+
+	// Draws the pointer as it was at the given time. The position
+	// is scaled for frames of another size than the captured ones
+	status_t DrawCursor(BBitmap* frame, bigtime_t time,
+				BPoint scale = BPoint(1, 1)) const;
+
+private:
+	const cursor_sample* _SampleAt(bigtime_t time) const;
+
+	mutable BLocker fLocker;
+	std::vector<cursor_sample> fSamples;
+	size_t fCapacity;
+	BBitmap* fArrow;
+	BPoint fArrowHotSpot;
+};
+
+#endif // __CURSORTRACK_H
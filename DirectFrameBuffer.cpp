@@ -0,0 +1,325 @@
+/*
+ * Copyright 2026 Stefano Ceccherini <stefano.ceccherini@gmail.com>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+#include "DirectFrameBuffer.h"
+
+#include <Bitmap.h>
+#include <OS.h>
+#include <Screen.h>
+
+#include <algorithm>
+#include <cstring>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+typedef void (*row_function)(const uint8* source, uint8* dest, int32 width);
+
+
+static int32
+BytesPerPixel(color_space colorSpace)
+{
+	switch (colorSpace) {
+		case B_RGB32:
+		case B_RGBA32:
+			return 4;
+		case B_RGB24:
+			return 3;
+		case B_RGB16:
+		case B_RGB15:
+		case B_RGBA15:
+			return 2;
+		case B_CMAP8:
+		case B_GRAY8:
+			return 1;
+		default:
+			return 0;
+	}
+}
+
+
+static inline uint16
+To565(uint32 pixel)
+{
+	return ((pixel >> 8) & 0xf800) | ((pixel >> 5) & 0x07e0) | ((pixel >> 3) & 0x001f);
+}
+
+
+static inline uint16
+To555(uint32 pixel)
+{
+	return ((pixel >> 9) & 0x7c00) | ((pixel >> 6) & 0x03e0) | ((pixel >> 3) & 0x001f);
+}
+
+
+// The destination rows are written with non-temporal stores when
+// possible: the frames are not read again soon, so there's no point
+// in filling the cache with them.
+
+template<uint32 kAlpha>
+static void
+CopyRow32(const uint8* source, uint8* dest, int32 width)
+{
+	const uint32* from = (const uint32*)source;
+	uint32* to = (uint32*)dest;
+	int32 x = 0;
+#if defined(__SSE2__)
+	for (; x < width && ((addr_t)(to + x) & 15) != 0; x++)
+		to[x] = from[x] | kAlpha;
+	const __m128i alpha = _mm_set1_epi32(kAlpha);
+	for (; x + 4 <= width; x += 4) {
+		__m128i pixels = _mm_loadu_si128((const __m128i*)(from + x));
+		_mm_stream_si128((__m128i*)(to + x), _mm_or_si128(pixels, alpha));
+	}
+#endif
+	for (; x < width; x++)
+		to[x] = from[x] | kAlpha;
+}
+
+
+static void
+ConvertRow32To24(const uint8* source, uint8* dest, int32 width)
+{
+	for (int32 x = 0; x < width; x++) {
+		dest[0] = source[0];
+		dest[1] = source[1];
+		dest[2] = source[2];
+		source += 4;
+		dest += 3;
+	}
+}
+
+
+template<bool k555, uint16 kAlpha>
+static void
+ConvertRow32To16(const uint8* source, uint8* dest, int32 width)
+{
+	const uint32* from = (const uint32*)source;
+	uint16* to = (uint16*)dest;
+	int32 x = 0;
+#if defined(__SSE2__)
+	for (; x < width && ((addr_t)(to + x) & 15) != 0; x++)
+		to[x] = (k555 ? To555(from[x]) : To565(from[x])) | kAlpha;
+	const __m128i redMask = _mm_set1_epi32(k555 ? 0x7c00 : 0xf800);
+	const __m128i greenMask = _mm_set1_epi32(k555 ? 0x03e0 : 0x07e0);
+	const __m128i blueMask = _mm_set1_epi32(0x001f);
+	// There is no unsigned 32 to 16 bit pack in SSE2: move the values
+	// to the signed range and back
+	const __m128i bias32 = _mm_set1_epi32(0x8000);
+	const __m128i bias16 = _mm_set1_epi16((int16)0x8000);
+	const __m128i alpha = _mm_set1_epi16((int16)kAlpha);
+	for (; x + 8 <= width; x += 8) {
+		__m128i packed[2];
+		for (int32 half = 0; half < 2; half++) {
+			__m128i pixels = _mm_loadu_si128((const __m128i*)(from + x + half * 4));
+			__m128i red = _mm_and_si128(_mm_srli_epi32(pixels, k555 ? 9 : 8), redMask);
+			__m128i green = _mm_and_si128(_mm_srli_epi32(pixels, k555 ? 6 : 5), greenMask);
+			__m128i blue = _mm_and_si128(_mm_srli_epi32(pixels, 3), blueMask);
+			packed[half] = _mm_sub_epi32(
+				_mm_or_si128(_mm_or_si128(red, green), blue), bias32);
+		}
+		__m128i result = _mm_add_epi16(_mm_packs_epi32(packed[0], packed[1]), bias16);
+		_mm_stream_si128((__m128i*)(to + x), _mm_or_si128(result, alpha));
+	}
+#endif
+	for (; x < width; x++)
+		to[x] = (k555 ? To555(from[x]) : To565(from[x])) | kAlpha;
+}
+
+
+static row_function
+RowFunction(color_space from, color_space to)
+{
+	if (from == B_RGB32 || from == B_RGBA32) {
+		switch (to) {
+			case B_RGB32:
+				return CopyRow32<0>;
+			case B_RGBA32:
+				return from == B_RGBA32 ? CopyRow32<0> : CopyRow32<0xff000000>;
+			case B_RGB24:
+				return ConvertRow32To24;
+			case B_RGB16:
+				return ConvertRow32To16<false, 0>;
+			case B_RGB15:
+				return ConvertRow32To16<true, 0>;
+			case B_RGBA15:
+				return ConvertRow32To16<true, 0x8000>;
+			default:
+				return NULL;
+		}
+	}
+	return NULL;
+}
+
+
+DirectFrameBuffer::DirectFrameBuffer()
+	:
+	fReaders(0),
+	fAvailable(0),
+	fGeneration(0),
+	fFrameGeneration(-1)
+{
+	fInfo.bits = NULL;
+	fInfo.bytesPerRow = 0;
+	fInfo.colorSpace = B_NO_COLOR_SPACE;
+}
+
+
+DirectFrameBuffer::~DirectFrameBuffer()
+{
+	_Disconnect();
+}
+
+
+void
+DirectFrameBuffer::Update(const direct_buffer_info* info)
+{
+	// Whatever changed, the old buffer can't be used anymore
+	// once we return
+	_Disconnect();
+
+	switch (info->buffer_state & B_DIRECT_MODE_MASK) {
+		case B_DIRECT_START:
+		case B_DIRECT_MODIFY:
+			break;
+		case B_DIRECT_STOP:
+		default:
+			return;
+	}
+
+	if (info->bits == NULL || info->bytes_per_row <= 0
+		|| BytesPerPixel(info->pixel_format) * 8 != (int32)info->bits_per_pixel)
+		return;
+
+	fInfo.bits = (uint8*)info->bits;
+	fInfo.bytesPerRow = info->bytes_per_row;
+	fInfo.colorSpace = info->pixel_format;
+	// The screen size could be different now
+	atomic_add(&fGeneration, 1);
+	atomic_set(&fAvailable, 1);
+}
+
+
+bool
+DirectFrameBuffer::IsAvailable() const
+{
+	return atomic_get((int32*)&fAvailable) != 0;
+}
+
+
+color_space
+DirectFrameBuffer::ColorSpace() const
+{
+	return IsAvailable() ? fInfo.colorSpace : B_NO_COLOR_SPACE;
+}
+
+
+status_t
+DirectFrameBuffer::ReadBitmap(BBitmap* bitmap, BRect bounds)
+{
+	if (bitmap == NULL || !bounds.IsValid())
+		return B_BAD_VALUE;
+
+	for (;;) {
+		// The screen size isn't part of direct_buffer_info. Ask for it
+		// only when the connection changes, and not while the window
+		// thread could be waiting for us: it would block the app_server
+		const int32 generation = atomic_get(&fGeneration);
+		if (generation != fFrameGeneration) {
+			fScreenFrame = BScreen().Frame();
+			fFrameGeneration = generation;
+		}
+
+		atomic_add(&fReaders, 1);
+		if (atomic_get(&fAvailable) == 0) {
+			atomic_add(&fReaders, -1);
+			return B_NOT_ALLOWED;
+		}
+		if (atomic_get(&fGeneration) != generation) {
+			// Changed in the meantime
+			atomic_add(&fReaders, -1);
+			continue;
+		}
+
+		const BRect bitmapBounds = bitmap->Bounds();
+		bounds.right = std::min(bounds.right, bounds.left + bitmapBounds.Width());
+		bounds.bottom = std::min(bounds.bottom, bounds.top + bitmapBounds.Height());
+		const BRect visible = bounds & fScreenFrame;
+		// Anything outside the screen is black
+		if (visible != bounds)
+			::memset(bitmap->Bits(), 0, bitmap->BitsLength());
+
+		status_t status = B_OK;
+		if (visible.IsValid()) {
+			const int32 sourcePixel = BytesPerPixel(fInfo.colorSpace);
+			const int32 destPixel = BytesPerPixel(bitmap->ColorSpace());
+			const uint8* source = fInfo.bits
+				+ (int32)visible.top * fInfo.bytesPerRow
+				+ (int32)visible.left * sourcePixel;
+			uint8* dest = (uint8*)bitmap->Bits()
+				+ (int32)(visible.top - bounds.top) * bitmap->BytesPerRow()
+				+ (int32)(visible.left - bounds.left) * destPixel;
+			status = ConvertRows(source, fInfo.bytesPerRow, fInfo.colorSpace,
+				dest, bitmap->BytesPerRow(), bitmap->ColorSpace(),
+				visible.IntegerWidth() + 1, visible.IntegerHeight() + 1);
+		}
+
+		atomic_add(&fReaders, -1);
+		return status;
+	}
+}
+
+
+/* static */
+bool
+DirectFrameBuffer::CanConvert(color_space from, color_space to)
+{
+	return (from == to && BytesPerPixel(from) > 0) || RowFunction(from, to) != NULL;
+}
+
+
+/* static */
+status_t
+DirectFrameBuffer::ConvertRows(const void* source, int32 sourceBytesPerRow,
+	color_space sourceSpace, void* dest, int32 destBytesPerRow,
+	color_space destSpace, int32 width, int32 height)
+{
+	if (!CanConvert(sourceSpace, destSpace))
+		return B_NOT_SUPPORTED;
+
+	const uint8* from = (const uint8*)source;
+	uint8* to = (uint8*)dest;
+	row_function function = RowFunction(sourceSpace, destSpace);
+	if (function == NULL) {
+		const size_t rowLength = width * BytesPerPixel(sourceSpace);
+		for (int32 y = 0; y < height; y++) {
+			::memcpy(to, from, rowLength);
+			from += sourceBytesPerRow;
+			to += destBytesPerRow;
+		}
+		return B_OK;
+	}
+
+	for (int32 y = 0; y < height; y++) {
+		function(from, to, width);
+		from += sourceBytesPerRow;
+		to += destBytesPerRow;
+	}
+#if defined(__SSE2__)
+	// Make the non-temporal stores visible to the other threads
+	_mm_sfence();
+#endif
+	return B_OK;
+}
+
+
+// Waits until nobody is using the frame buffer
+void
+DirectFrameBuffer::_Disconnect()
+{
+	atomic_set(&fAvailable, 0);
+	while (atomic_get(&fReaders) > 0)
+		snooze(500);
+}
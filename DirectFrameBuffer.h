@@ -0,0 +1,63 @@
+/*
+ * Copyright 2026 Stefano Ceccherini <stefano.ceccherini@gmail.com>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+#ifndef __DIRECTFRAMEBUFFER_H
+#define __DIRECTFRAMEBUFFER_H
+
+#include <DirectWindow.h>
+#include <GraphicsDefs.h>
+#include <Rect.h>
+
+class BBitmap;
+// Gives access to the frame buffer of a BDirectWindow to
+// another thread.
+// The connection can change at any time from the window's thread,
+// which waits for the copies in progress to finish before doing so,
+// as required by BDirectWindow::DirectConnected().
+class DirectFrameBuffer {
+public:
+	DirectFrameBuffer();
+	~DirectFrameBuffer();
+
+	// Called from BDirectWindow::DirectConnected()
+	void Update(const direct_buffer_info* info);
+
+	bool IsAvailable() const;
+	color_space ColorSpace() const;
+
+	// Copies the given area of the screen to the bitmap,
+	// converting it to the bitmap's color space.
+	// The parts of the area outside the screen are cleared.
+	// Returns B_NOT_ALLOWED if the frame buffer is not available.
+	// Must not be called by more than one thread at the same time
+	status_t ReadBitmap(BBitmap* bitmap, BRect bounds);
+
+	static bool CanConvert(color_space from, color_space to);
+	// Converts the rows from one color space to the other.
+	// Returns B_NOT_SUPPORTED if CanConvert() is false
+	static status_t ConvertRows(const void* source, int32 sourceBytesPerRow,
+		color_space sourceSpace, void* dest, int32 destBytesPerRow,
+		color_space destSpace, int32 width, int32 height);
+
+private:
+	void _Disconnect();
+
+	struct buffer_info {
+		uint8* bits;
+		int32 bytesPerRow;
+		color_space colorSpace;
+	};
+
+	buffer_info fInfo;
+	int32 fReaders;
+	int32 fAvailable;
+	// Changes every time the connection does
+	int32 fGeneration;
+
+	// Only used by the reading thread
+	BRect fScreenFrame;
+	int32 fFrameGeneration;
+};
+
+#endif // __DIRECTFRAMEBUFFER_H
@@ -0,0 +1,191 @@
+/*
+ * Copyright 2026 Stefano Ceccherini <stefano.ceccherini@gmail.com>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+#include "FrameAllocator.h"
+
+#include <Autolock.h>
+#include <Bitmap.h>
+#include <Message.h>
+#include <String.h>
+
+#include <algorithm>
+#include <iostream>
+#include <map>
+#include <new>
+
+struct stage_counters {
+	int32 buffers;
+	int64 bytes;
+	int64 peak;
+};
+
+static const char* const kStageNames[kFrameStageCount] = {
+	"capture",
+	"write",
+	"spool",
+	"read",
+	"filter"
+};
+
+// Allocating a frame buffer takes much longer than the lock
+static BLocker sLocker("frame allocator lock");
+static std::map<const BBitmap*, frame_stage> sBuffers;
+static stage_counters sStages[kFrameStageCount];
+static int64 sBytes = 0;
+static int64 sPeak = 0;
+
+
+// Takes the bitmap, which is deleted if it can't be counted
+static BBitmap*
+AddBuffer(BBitmap* bitmap, frame_stage stage)
+{
+	if (bitmap == NULL || bitmap->InitCheck() != B_OK) {
+		delete bitmap;
+		return NULL;
+	}
+
+	BAutolock _(sLocker);
+	try {
+		sBuffers[bitmap] = stage;
+	} catch (...) {
+		delete bitmap;
+		return NULL;
+	}
+	stage_counters& counters = sStages[stage];
+	counters.buffers++;
+	counters.bytes += bitmap->BitsLength();
+	counters.peak = std::max(counters.peak, counters.bytes);
+	sBytes += bitmap->BitsLength();
+	sPeak = std::max(sPeak, sBytes);
+	return bitmap;
+}
+
+
+/* static */
+BBitmap*
+FrameAllocator::Allocate(frame_stage stage, BRect bounds,
+	color_space colorSpace, int32 bytesPerRow, uint32 flags)
+{
+	if (stage < 0 || stage >= kFrameStageCount)
+		return NULL;
+
+	return AddBuffer(new (std::nothrow) BBitmap(bounds, flags, colorSpace,
+		bytesPerRow), stage);
+}
+
+
+/* static */
+BBitmap*
+FrameAllocator::Allocate(frame_stage stage, area_id area, ptrdiff_t offset,
+	BRect bounds, color_space colorSpace, int32 bytesPerRow)
+{
+	if (stage < 0 || stage >= kFrameStageCount || area < 0)
+		return NULL;
+
+	return AddBuffer(new (std::nothrow) BBitmap(area, offset, bounds, 0,
+		colorSpace, bytesPerRow), stage);
+}
+
+
+/* static */
+void
+FrameAllocator::Free(BBitmap* bitmap)
+{
+	if (bitmap == NULL)
+		return;
+
+	{
+		BAutolock _(sLocker);
+		std::map<const BBitmap*, frame_stage>::iterator i = sBuffers.find(bitmap);
+		if (i != sBuffers.end()) {
+			stage_counters& counters = sStages[i->second];
+			counters.buffers--;
+			counters.bytes -= bitmap->BitsLength();
+			sBytes -= bitmap->BitsLength();
+			sBuffers.erase(i);
+		}
+	}
+	delete bitmap;
+}
+
+
+/* static */
+int32
+FrameAllocator::CountBuffers(frame_stage stage)
+{
+	BAutolock _(sLocker);
+	return stage >= 0 && stage < kFrameStageCount ? sStages[stage].buffers : 0;
+}
+
+
+/* static */
+int64
+FrameAllocator::Bytes(frame_stage stage)
+{
+	BAutolock _(sLocker);
+	return stage >= 0 && stage < kFrameStageCount ? sStages[stage].bytes : 0;
+}
+
+
+/* static */
+int64
+FrameAllocator::PeakBytes(frame_stage stage)
+{
+	BAutolock _(sLocker);
+	return stage >= 0 && stage < kFrameStageCount ? sStages[stage].peak : 0;
+}
+
+
+/* static */
+const char*
+FrameAllocator::StageName(frame_stage stage)
+{
+	return stage >= 0 && stage < kFrameStageCount ? kStageNames[stage] : "unknown";
+}
+
+
+/* static */
+void
+FrameAllocator::ResetPeaks()
+{
+	BAutolock _(sLocker);
+	for (int32 i = 0; i < kFrameStageCount; i++)
+		sStages[i].peak = sStages[i].bytes;
+	sPeak = sBytes;
+}
+
+
+/* static */
+void
+FrameAllocator::Archive(BMessage* message)
+{
+	BAutolock _(sLocker);
+	for (int32 i = 0; i < kFrameStageCount; i++) {
+		BString name;
+		name << "buffers_" << kStageNames[i];
+		message->AddInt32(name.String(), sStages[i].buffers);
+		name.SetToFormat("buffer_bytes_%s", kStageNames[i]);
+		message->AddInt64(name.String(), sStages[i].bytes);
+		name.SetToFormat("buffer_peak_%s", kStageNames[i]);
+		message->AddInt64(name.String(), sStages[i].peak);
+	}
+	message->AddInt64("buffer_bytes", sBytes);
+	message->AddInt64("buffer_peak", sPeak);
+}
+
+
+/* static */
+int32
+FrameAllocator::ReportOutstanding()
+{
+	BAutolock _(sLocker);
+	for (int32 i = 0; i < kFrameStageCount; i++) {
+		if (sStages[i].buffers == 0)
+			continue;
+		std::cerr << "FrameAllocator: " << sStages[i].buffers << " "
+			<< kStageNames[i] << " buffers still allocated ("
+			<< sStages[i].bytes << " bytes)" << std::endl;
+	}
+	return int32(sBuffers.size());
+}
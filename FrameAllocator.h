@@ -0,0 +1,60 @@
+/*
+ * Copyright 2026 Stefano Ceccherini <stefano.ceccherini@gmail.com>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+#ifndef __FRAMEALLOCATOR_H
+#define __FRAMEALLOCATOR_H
+
+#include <Bitmap.h>
+
+class BMessage;
+
+// Where the frame buffers are used
+enum frame_stage {
+	// Read from the screen
+	kFrameStageCapture = 0,
+	// Changed by the writers before they're spooled
+	kFrameStageWrite,
+	// Decoded frames kept by the spool
+	kFrameStageSpool,
+	// Read back from the store to be encoded
+	kFrameStageRead,
+	// Made by the image filters
+	kFrameStageFilter,
+	kFrameStageCount
+};
+
+// Creates the frame sized bitmaps of the pipeline, and keeps count
+// of them for every stage: how many there are, their bytes, and the
+// most bytes there were at the same time.
+// Every bitmap is remembered with its stage, so Free() knows which
+// one it was. Bitmaps which weren't allocated here are just deleted.
+class FrameAllocator {
+public:
+	static BBitmap* Allocate(frame_stage stage, BRect bounds,
+				color_space colorSpace,
+				int32 bytesPerRow = B_ANY_BYTES_PER_ROW,
+				uint32 flags = 0);
+	// The bitmap uses the memory of the area, from the offset on.
+	// The area isn't deleted with it
+	static BBitmap* Allocate(frame_stage stage, area_id area,
+				ptrdiff_t offset, BRect bounds, color_space colorSpace,
+				int32 bytesPerRow);
+	// Deletes the bitmap. NULL is fine
+	static void Free(BBitmap* bitmap);
+
+	static int32 CountBuffers(frame_stage stage);
+	static int64 Bytes(frame_stage stage);
+	static int64 PeakBytes(frame_stage stage);
+	static const char* StageName(frame_stage stage);
+
+	// The peaks start again from the bytes allocated now
+	static void ResetPeaks();
+	// As buffers_<stage>, buffer_bytes_<stage> and buffer_peak_<stage>,
+	// then buffer_bytes and buffer_peak for all the stages
+	static void Archive(BMessage* message);
+	// Prints the buffers which weren't freed. Returns how many
+	static int32 ReportOutstanding();
+};
+
+#endif // __FRAMEALLOCATOR_H
@@ -0,0 +1,435 @@
+/*
+ * Copyright 2026 Stefano Ceccherini <stefano.ceccherini@gmail.com>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+#include "FrameCompressor.h"
+
+#include "WorkerPool.h"
+
+#include <OS.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+// Big enough to compress well, small enough so
+// a frame gives work to all the threads
+const static uint32 kChunkSize = 256 * 1024;
+
+// LZ4 block format constants
+const static int32 kMinMatch = 4;
+const static int32 kLastLiterals = 5;
+const static int32 kMatchLimit = 12;
+const static int32 kHashLog = 12;
+const static size_t kMaxOffset = 65535;
+
+
+static inline size_t
+CompressBound(size_t length)
+{
+	return length + length / 255 + 16;
+}
+
+
+static inline uint32
+Read32(const uint8* data)
+{
+	uint32 value;
+	::memcpy(&value, data, sizeof(value));
+	return value;
+}
+
+
+static inline uint32
+Hash(uint32 value)
+{
+	return (value * 2654435761U) >> (32 - kHashLog);
+}
+
+
+static inline uint8*
+WriteLength(uint8* out, size_t length)
+{
+	while (length >= 255) {
+		*out++ = 255;
+		length -= 255;
+	}
+	*out++ = (uint8)length;
+	return out;
+}
+
+
+// Greedy LZ4 block compressor. Returns the compressed length,
+// or -1 if it doesn't fit in capacity.
+static ssize_t
+CompressBlock(const uint8* source, size_t length, uint8* dest, size_t capacity)
+{
+	uint32 table[1 << kHashLog];
+	::memset(table, 0, sizeof(table));
+
+	const uint8* in = source;
+	const uint8* anchor = source;
+	const uint8* end = source + length;
+	uint8* out = dest;
+	uint8* outEnd = dest + capacity;
+
+	if (length > (size_t)kMatchLimit) {
+		const uint8* matchLimit = end - kMatchLimit;
+		in++;
+		while (in < matchLimit) {
+			const uint32 hash = Hash(Read32(in));
+			const uint8* match = source + table[hash];
+			table[hash] = in - source;
+			if (match >= in || (size_t)(in - match) > kMaxOffset
+				|| Read32(match) != Read32(in)) {
+				// Move faster through data which doesn't compress
+				in += 1 + ((in - anchor) >> 6);
+				continue;
+			}
+
+			while (in > anchor && match > source && in[-1] == match[-1]) {
+				in--;
+				match--;
+			}
+
+			const uint8* matchEnd = in + kMinMatch;
+			const uint8* reference = match + kMinMatch;
+			while (matchEnd < end - kLastLiterals && *matchEnd == *reference) {
+				matchEnd++;
+				reference++;
+			}
+
+			const size_t literalLength = in - anchor;
+			const size_t matchLength = matchEnd - in - kMinMatch;
+			const size_t needed = 1 + literalLength / 255 + 1 + literalLength
+				+ 2 + matchLength / 255 + 1;
+			if (needed > (size_t)(outEnd - out))
+				return -1;
+
+			uint8* token = out++;
+			*token = std::min(literalLength, size_t(15)) << 4;
+			if (literalLength >= 15)
+				out = WriteLength(out, literalLength - 15);
+			::memcpy(out, anchor, literalLength);
+			out += literalLength;
+
+			const size_t offset = in - match;
+			*out++ = offset & 0xff;
+			*out++ = offset >> 8;
+
+			*token |= std::min(matchLength, size_t(15));
+			if (matchLength >= 15)
+				out = WriteLength(out, matchLength - 15);
+
+			in = anchor = matchEnd;
+			if (in < matchLimit)
+				table[Hash(Read32(in - 2))] = in - 2 - source;
+		}
+	}
+
+	const size_t literalLength = end - anchor;
+	if (1 + literalLength / 255 + 1 + literalLength > (size_t)(outEnd - out))
+		return -1;
+	uint8* token = out++;
+	*token = std::min(literalLength, size_t(15)) << 4;
+	if (literalLength >= 15)
+		out = WriteLength(out, literalLength - 15);
+	::memcpy(out, anchor, literalLength);
+	out += literalLength;
+
+	return out - dest;
+}
+
+
+// Returns the decompressed length, or -1 if the data is corrupted
+static ssize_t
+DecompressBlock(const uint8* source, size_t length, uint8* dest, size_t capacity)
+{
+	const uint8* in = source;
+	const uint8* inEnd = source + length;
+	uint8* out = dest;
+	uint8* outEnd = dest + capacity;
+
+	while (in < inEnd) {
+		const uint8 token = *in++;
+		size_t literalLength = token >> 4;
+		if (literalLength == 15) {
+			uint8 byte;
+			do {
+				if (in >= inEnd)
+					return -1;
+				byte = *in++;
+				literalLength += byte;
+			} while (byte == 255);
+		}
+		if (literalLength > (size_t)(inEnd - in)
+			|| literalLength > (size_t)(outEnd - out))
+			return -1;
+		::memcpy(out, in, literalLength);
+		in += literalLength;
+		out += literalLength;
+
+		// The last sequence has no match
+		if (in == inEnd)
+			break;
+
+		if (inEnd - in < 2)
+			return -1;
+		const size_t offset = in[0] | (in[1] << 8);
+		in += 2;
+		if (offset == 0 || offset > (size_t)(out - dest))
+			return -1;
+
+		size_t matchLength = token & 15;
+		if (matchLength == 15) {
+			uint8 byte;
+			do {
+				if (in >= inEnd)
+					return -1;
+				byte = *in++;
+				matchLength += byte;
+			} while (byte == 255);
+		}
+		matchLength += kMinMatch;
+		if (matchLength > (size_t)(outEnd - out))
+			return -1;
+
+		const uint8* match = out - offset;
+		if (offset >= matchLength) {
+			::memcpy(out, match, matchLength);
+			out += matchLength;
+		} else {
+			// Overlapping copy: repeats the last offset bytes.
+			// Copy them once, then double the copied run every time
+			::memcpy(out, match, offset);
+			size_t copied = offset;
+			while (copied < matchLength) {
+				const size_t run = std::min(copied, matchLength - copied);
+				::memcpy(out + copied, out, run);
+				copied += run;
+			}
+			out += matchLength;
+		}
+	}
+
+	return out - dest;
+}
+
+
+struct compress_job {
+	const uint8* source;
+	size_t length;
+	uint8* scratch;
+	size_t bound;
+	uint32* sizes;
+};
+
+
+static void
+CompressChunk(void* cookie, int32 index)
+{
+	compress_job* job = static_cast<compress_job*>(cookie);
+	const size_t offset = (size_t)index * kChunkSize;
+	const size_t length = std::min(size_t(kChunkSize), job->length - offset);
+	uint8* dest = job->scratch + index * job->bound;
+	ssize_t compressed = CompressBlock(job->source + offset, length, dest, job->bound);
+	if (compressed < 0 || (size_t)compressed >= length) {
+		::memcpy(dest, job->source + offset, length);
+		job->sizes[index] = length | kChunkStored;
+	} else
+		job->sizes[index] = compressed;
+}
+
+
+struct decompress_job {
+	const uint8* data;
+	const uint32* sizes;
+	const size_t* offsets;
+	uint8* buffer;
+	size_t length;
+	uint32 chunkSize;
+	int32 status;
+};
+
+
+static void
+DecompressChunk(void* cookie, int32 index)
+{
+	decompress_job* job = static_cast<decompress_job*>(cookie);
+	const size_t offset = (size_t)index * job->chunkSize;
+	const size_t length = std::min(size_t(job->chunkSize), job->length - offset);
+	const uint8* source = job->data + job->offsets[index];
+	const uint32 size = job->sizes[index] & ~kChunkStored;
+	if ((job->sizes[index] & kChunkStored) != 0) {
+		if (size != length) {
+			atomic_set(&job->status, B_BAD_DATA);
+			return;
+		}
+		::memcpy(job->buffer + offset, source, length);
+		return;
+	}
+	if (DecompressBlock(source, size, job->buffer + offset, length) != (ssize_t)length)
+		atomic_set(&job->status, B_BAD_DATA);
+}
+
+
+FrameCompressor::FrameCompressor(WorkerPool* pool)
+	:
+	fPool(pool),
+	fScratch(NULL),
+	fScratchSize(0),
+	fOutput(NULL),
+	fOutputSize(0)
+{
+}
+
+
+FrameCompressor::~FrameCompressor()
+{
+	free(fScratch);
+	free(fOutput);
+}
+
+
+status_t
+FrameCompressor::Compress(const void* source, size_t sourceLength,
+	const void** data, size_t* length)
+{
+	if (source == NULL || data == NULL || length == NULL
+		|| sourceLength != (uint32)sourceLength)
+		return B_BAD_VALUE;
+
+	const uint32 chunkCount = (sourceLength + kChunkSize - 1) / kChunkSize;
+	const size_t bound = CompressBound(kChunkSize);
+	const size_t scratchSize = chunkCount * bound;
+	if (scratchSize > fScratchSize) {
+		uint8* scratch = (uint8*)realloc(fScratch, scratchSize);
+		if (scratch == NULL)
+			return B_NO_MEMORY;
+		fScratch = scratch;
+		fScratchSize = scratchSize;
+	}
+
+	// The size table is at the beginning of the output,
+	// make sure there is room for it
+	const size_t tableSize = sizeof(compressed_header) + chunkCount * sizeof(uint32);
+	if (tableSize > fOutputSize) {
+		uint8* output = (uint8*)realloc(fOutput, tableSize);
+		if (output == NULL)
+			return B_NO_MEMORY;
+		fOutput = output;
+		fOutputSize = tableSize;
+	}
+
+	uint32* sizes = (uint32*)(fOutput + sizeof(compressed_header));
+	compress_job job;
+	job.source = (const uint8*)source;
+	job.length = sourceLength;
+	job.scratch = fScratch;
+	job.bound = bound;
+	job.sizes = sizes;
+	if (fPool != NULL && chunkCount > 1)
+		fPool->Run(CompressChunk, &job, chunkCount);
+	else {
+		for (uint32 i = 0; i < chunkCount; i++)
+			CompressChunk(&job, i);
+	}
+
+	size_t totalSize = tableSize;
+	for (uint32 i = 0; i < chunkCount; i++)
+		totalSize += sizes[i] & ~kChunkStored;
+	if (totalSize > fOutputSize) {
+		uint8* output = (uint8*)realloc(fOutput, totalSize);
+		if (output == NULL)
+			return B_NO_MEMORY;
+		fOutput = output;
+		fOutputSize = totalSize;
+		sizes = (uint32*)(fOutput + sizeof(compressed_header));
+	}
+
+	compressed_header* header = (compressed_header*)fOutput;
+	header->length = sourceLength;
+	header->chunkSize = kChunkSize;
+	header->chunkCount = chunkCount;
+	header->reserved = 0;
+
+	uint8* out = fOutput + tableSize;
+	for (uint32 i = 0; i < chunkCount; i++) {
+		const uint32 size = sizes[i] & ~kChunkStored;
+		::memcpy(out, fScratch + i * bound, size);
+		out += size;
+	}
+
+	*data = fOutput;
+	*length = totalSize;
+	return B_OK;
+}
+
+
+/* static */
+status_t
+FrameCompressor::Decompress(WorkerPool* pool, const void* source,
+	size_t sourceLength, void* buffer, size_t bufferLength)
+{
+	if (source == NULL || buffer == NULL)
+		return B_BAD_VALUE;
+	if (UncompressedLength(source, sourceLength) != bufferLength)
+		return B_MISMATCHED_VALUES;
+
+	const compressed_header* header = (const compressed_header*)source;
+	const uint32 chunkCount = header->chunkCount;
+	const uint32* sizes = (const uint32*)((const uint8*)source
+		+ sizeof(compressed_header));
+	const size_t tableSize = sizeof(compressed_header) + chunkCount * sizeof(uint32);
+
+	size_t* offsets = new (std::nothrow) size_t[std::max(chunkCount, uint32(1))];
+	if (offsets == NULL)
+		return B_NO_MEMORY;
+
+	size_t offset = 0;
+	for (uint32 i = 0; i < chunkCount; i++) {
+		offsets[i] = offset;
+		offset += sizes[i] & ~kChunkStored;
+	}
+	if (offset > sourceLength - tableSize) {
+		delete[] offsets;
+		return B_BAD_DATA;
+	}
+
+	decompress_job job;
+	job.data = (const uint8*)source + tableSize;
+	job.sizes = sizes;
+	job.offsets = offsets;
+	job.buffer = (uint8*)buffer;
+	job.length = bufferLength;
+	job.chunkSize = header->chunkSize;
+	job.status = B_OK;
+	if (pool != NULL && chunkCount > 1)
+		pool->Run(DecompressChunk, &job, chunkCount);
+	else {
+		for (uint32 i = 0; i < chunkCount; i++)
+			DecompressChunk(&job, i);
+	}
+
+	delete[] offsets;
+	return job.status;
+}
+
+
+// Returns 0 if the data doesn't look like compressed data
+/* static */
+size_t
+FrameCompressor::UncompressedLength(const void* source, size_t sourceLength)
+{
+	if (source == NULL || sourceLength < sizeof(compressed_header))
+		return 0;
+	const compressed_header* header = (const compressed_header*)source;
+	if (header->chunkSize == 0
+		|| header->chunkCount != (header->length + (uint64)header->chunkSize - 1)
+			/ header->chunkSize
+		|| (sourceLength - sizeof(compressed_header)) / sizeof(uint32)
+			< header->chunkCount)
+		return 0;
+	return header->length;
+}
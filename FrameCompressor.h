@@ -0,0 +1,49 @@
+/*
+ * Copyright 2026 Stefano Ceccherini <stefano.ceccherini@gmail.com>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+#ifndef __FRAMECOMPRESSOR_H
+#define __FRAMECOMPRESSOR_H
+
+#include <SupportDefs.h>
+
+// Compressed data is split in chunks, compressed independently
+// (LZ4 block format), so they can be (de)compressed in parallel.
+// The data starts with this header, followed by the compressed size
+// of every chunk and by the chunks themselves.
+struct compressed_header {
+	uint32 length;
+	uint32 chunkSize;
+	uint32 chunkCount;
+	uint32 reserved;
+};
+
+// Set in the chunk size when the chunk is stored uncompressed
+const static uint32 kChunkStored = 0x80000000;
+
+class WorkerPool;
+class FrameCompressor {
+public:
+	// pool can be NULL, and then all the work is done
+	// by the calling thread
+	FrameCompressor(WorkerPool* pool);
+	~FrameCompressor();
+
+	// On success, data and length point to the compressed data,
+	// which is valid until the next call
+	status_t Compress(const void* source, size_t sourceLength,
+		const void** data, size_t* length);
+
+	static status_t Decompress(WorkerPool* pool, const void* source,
+		size_t sourceLength, void* buffer, size_t bufferLength);
+	static size_t UncompressedLength(const void* source, size_t sourceLength);
+
+private:
+	WorkerPool* fPool;
+	uint8* fScratch;
+	size_t fScratchSize;
+	uint8* fOutput;
+	size_t fOutputSize;
+};
+
+#endif // __FRAMECOMPRESSOR_H
@@ -0,0 +1,78 @@
+/*
+ * Copyright 2026 Stefano Ceccherini <stefano.ceccherini@gmail.com>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+#include "FrameGrid.h"
+
+#include <algorithm>
+
+
+FrameGrid::FrameGrid(const BRect& area, int32 columns, int32 rows)
+	:
+	fArea(area),
+	fColumns(std::max(columns, int32(1))),
+	fRows(std::max(rows, int32(1))),
+	fCellWidth((area.Width() + 1) / fColumns),
+	fCellHeight((area.Height() + 1) / fRows),
+	fCells(fColumns * fRows)
+{
+}
+
+
+void
+FrameGrid::AddFrame(const BRect& frame)
+{
+	const BRect visible = frame & fArea;
+	if (!frame.IsValid() || !visible.IsValid())
+		return;
+
+	const int32 index = fFrames.size();
+	fFrames.push_back(frame);
+	const int32 lastRow = _Row(visible.bottom);
+	const int32 lastColumn = _Column(visible.right);
+	for (int32 row = _Row(visible.top); row <= lastRow; row++) {
+		for (int32 column = _Column(visible.left); column <= lastColumn; column++)
+			fCells[row * fColumns + column].push_back(index);
+	}
+}
+
+
+int32
+FrameGrid::CountFrames() const
+{
+	return fFrames.size();
+}
+
+
+BRect
+FrameGrid::HitTest(const BPoint& point) const
+{
+	if (!fArea.Contains(point))
+		return BRect(0, 0, -1, -1);
+
+	// Frames were added in z order, so the first match is on top
+	const std::vector<int32>& cell = fCells[_Row(point.y) * fColumns + _Column(point.x)];
+	for (size_t i = 0; i < cell.size(); i++) {
+		const BRect& frame = fFrames[cell[i]];
+		if (frame.Contains(point))
+			return frame;
+	}
+
+	return BRect(0, 0, -1, -1);
+}
+
+
+int32
+FrameGrid::_Column(float x) const
+{
+	const int32 column = int32((x - fArea.left) / fCellWidth);
+	return std::min(std::max(column, int32(0)), fColumns - 1);
+}
+
+
+int32
+FrameGrid::_Row(float y) const
+{
+	const int32 row = int32((y - fArea.top) / fCellHeight);
+	return std::min(std::max(row, int32(0)), fRows - 1);
+}
@@ -0,0 +1,41 @@
+/*
+ * Copyright 2026 Stefano Ceccherini <stefano.ceccherini@gmail.com>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+#ifndef __FRAMEGRID_H
+#define __FRAMEGRID_H
+
+#include <Rect.h>
+
+#include <vector>
+
+// Finds the topmost of many rectangles which contains a point,
+// without looking at all of them: the area is split in a grid of
+// cells, and every cell knows, in z order, the rectangles which
+// overlap it. Rectangles outside the area can't be found.
+class FrameGrid {
+public:
+	FrameGrid(const BRect& area, int32 columns = 16, int32 rows = 16);
+
+	// In z order: the first ones are on top
+	void AddFrame(const BRect& frame);
+	int32 CountFrames() const;
+
+	// An invalid rect if no frame contains the point
+	BRect HitTest(const BPoint& point) const;
+
+private:
+	int32 _Column(float x) const;
+	int32 _Row(float y) const;
+
+	BRect fArea;
+	int32 fColumns;
+	int32 fRows;
+	float fCellWidth;
+	float fCellHeight;
+	std::vector<BRect> fFrames;
+	// Indexes in fFrames, row by row
+	std::vector<std::vector<int32> > fCells;
+};
+
+#endif // __FRAMEGRID_H
@@ -0,0 +1,102 @@
+/*
+ * Copyright 2026 Stefano Ceccherini <stefano.ceccherini@gmail.com>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+#include "FramePacer.h"
+
+#include <Screen.h>
+
+#include <algorithm>
+
+// How far from the deadline a retrace can be to be waited for.
+// About half a refresh at 60Hz
+const static bigtime_t kRetraceWindow = 8000;
+
+
+FramePacer::FramePacer(int32 framesPerSecond, bool useRetrace)
+	:
+	fFramesPerSecond(std::max(framesPerSecond, int32(1))),
+	fUseRetrace(useRetrace),
+	fStartTime(0),
+	fNextFrame(0),
+	fDroppedFrames(0)
+{
+	Restart();
+}
+
+
+void
+FramePacer::Restart()
+{
+	fStartTime = system_time();
+	fNextFrame = 0;
+}
+
+
+// Deadlines are computed from the start, so they
+// start again from the last one, at the new rate
+void
+FramePacer::SetFrameRate(int32 framesPerSecond)
+{
+	framesPerSecond = std::max(framesPerSecond, int32(1));
+	if (framesPerSecond == fFramesPerSecond)
+		return;
+	fStartTime = _Deadline(fNextFrame);
+	fNextFrame = 0;
+	fFramesPerSecond = framesPerSecond;
+}
+
+
+int32
+FramePacer::FrameRate() const
+{
+	return fFramesPerSecond;
+}
+
+
+void
+FramePacer::WaitForNextFrame()
+{
+	bigtime_t deadline = _Deadline(fNextFrame);
+	const bigtime_t now = system_time();
+	if (now >= deadline + Period()) {
+		// Too late for one or more frames: skip them,
+		// rather than capturing them all in a burst
+		const int64 missed = (now - deadline) * fFramesPerSecond / 1000000;
+		fDroppedFrames += missed;
+		fNextFrame += missed;
+		deadline = _Deadline(fNextFrame);
+	}
+
+	if (fUseRetrace && deadline - now > kRetraceWindow) {
+		snooze_until(deadline - kRetraceWindow, B_SYSTEM_TIMEBASE);
+		if (BScreen().WaitForRetrace(2 * kRetraceWindow) != B_OK)
+			snooze_until(deadline, B_SYSTEM_TIMEBASE);
+	} else if (deadline > now)
+		snooze_until(deadline, B_SYSTEM_TIMEBASE);
+
+	fNextFrame++;
+}
+
+
+bigtime_t
+FramePacer::Period() const
+{
+	return 1000000 / fFramesPerSecond;
+}
+
+
+int32
+FramePacer::DroppedFrames() const
+{
+	return fDroppedFrames;
+}
+
+
+// Computed from the start every time, so the rounding
+// errors don't add up
+bigtime_t
+FramePacer::_Deadline(int64 frame) const
+{
+	return fStartTime + frame * 1000000 / fFramesPerSecond;
+}
@@ -0,0 +1,44 @@
+/*
+ * Copyright 2026 Stefano Ceccherini <stefano.ceccherini@gmail.com>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+#ifndef __FRAMEPACER_H
+#define __FRAMEPACER_H
+
+#include <OS.h>
+
+// Paces the capture at a fixed frame rate: frames are due at
+// absolute deadlines (start + n * period), so the time spent
+// capturing them doesn't slow down the rate.
+// Deadlines which are missed completely are skipped and counted.
+class FramePacer {
+public:
+	// If useRetrace is true, frames are taken right after
+	// the vertical retrace closest to their deadline
+	FramePacer(int32 framesPerSecond, bool useRetrace);
+
+	// Starts again from now, for example after a pause.
+	// Missed frames are not counted meanwhile
+	void Restart();
+
+	// Changes the rate from the next frame on
+	void SetFrameRate(int32 framesPerSecond);
+	int32 FrameRate() const;
+
+	// Waits until the next frame is due
+	void WaitForNextFrame();
+
+	bigtime_t Period() const;
+	int32 DroppedFrames() const;
+
+private:
+	bigtime_t _Deadline(int64 frame) const;
+
+	int32 fFramesPerSecond;
+	bool fUseRetrace;
+	bigtime_t fStartTime;
+	int64 fNextFrame;
+	int32 fDroppedFrames;
+};
+
+#endif // __FRAMEPACER_H
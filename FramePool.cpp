@@ -0,0 +1,269 @@
+/*
+ * Copyright 2026 Stefano Ceccherini <stefano.ceccherini@gmail.com>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+#include "FramePool.h"
+
+#include <Autolock.h>
+#include <Bitmap.h>
+#include <String.h>
+
+#include <cstring>
+#include <iostream>
+#include <new>
+
+
+FramePool::FramePool()
+	:
+	fBuffers(10, false),
+	fFreeList(NULL),
+	fFreeCount(0),
+	fExhaustedCount(0),
+	fColorSpace(B_NO_COLOR_SPACE),
+	fArea(-1),
+	fLocked(false),
+	fLocker("frame pool lock")
+{
+}
+
+
+FramePool::~FramePool()
+{
+	Dispose();
+}
+
+
+status_t
+FramePool::Init(const BRect& frame, const color_space& colorSpace, int32 count,
+	frame_stage stage, uint32 lock)
+{
+	if (!frame.IsValid() || count <= 0)
+		return B_BAD_VALUE;
+
+	Dispose();
+
+	BAutolock _(fLocker);
+
+	fFreeList = new (std::nothrow) BBitmap*[count];
+	if (fFreeList == NULL)
+		return B_NO_MEMORY;
+
+	fFrame = frame.OffsetToCopy(B_ORIGIN);
+	fColorSpace = colorSpace;
+
+	int32 bytesPerRow = B_ANY_BYTES_PER_ROW;
+	size_t slotSize = 0;
+	if (_CreateArea(count, stage, lock, &bytesPerRow, &slotSize) != B_OK)
+		std::cerr << "FramePool::Init(): cannot create area" << std::endl;
+
+	for (int32 i = 0; i < count; i++) {
+		BBitmap* bitmap = NULL;
+		if (fArea >= 0) {
+			bitmap = FrameAllocator::Allocate(stage, fArea, i * slotSize,
+				fFrame, fColorSpace, bytesPerRow);
+			if (bitmap == NULL && i == 0) {
+				// Bitmaps can't use it: allocate them on their own
+				delete_area(fArea);
+				fArea = -1;
+				fLocked = false;
+			}
+		}
+		if (fArea < 0)
+			bitmap = FrameAllocator::Allocate(stage, fFrame, fColorSpace);
+		if (bitmap == NULL) {
+			std::cerr << "FramePool::Init(): cannot create bitmap" << std::endl;
+			_FreeBuffers();
+			delete[] fFreeList;
+			fFreeList = NULL;
+			return B_NO_MEMORY;
+		}
+		// Touch the memory now, so the page faults don't happen
+		// while capturing
+		if (!fLocked)
+			::memset(bitmap->Bits(), 0, bitmap->BitsLength());
+		fBuffers.AddItem(bitmap);
+		fFreeList[i] = bitmap;
+	}
+	fFreeCount = count;
+	fExhaustedCount = 0;
+
+	return B_OK;
+}
+
+
+void
+FramePool::Dispose()
+{
+	BAutolock _(fLocker);
+	if (fFreeCount != fBuffers.CountItems()) {
+		std::cerr << "FramePool::Dispose(): ";
+		std::cerr << (fBuffers.CountItems() - fFreeCount) << " buffers still in use" << std::endl;
+	}
+	_FreeBuffers();
+	delete[] fFreeList;
+	fFreeList = NULL;
+	fFreeCount = 0;
+}
+
+
+BBitmap*
+FramePool::Acquire()
+{
+	BAutolock _(fLocker);
+	if (fFreeCount <= 0) {
+		fExhaustedCount++;
+		return NULL;
+	}
+
+	return fFreeList[--fFreeCount];
+}
+
+
+void
+FramePool::Release(BBitmap* bitmap)
+{
+	if (bitmap == NULL)
+		return;
+
+	BAutolock _(fLocker);
+	if (!fBuffers.HasItem(bitmap)) {
+		// Not one of ours: it was probably allocated
+		// before the pool was re-initialized
+		std::cerr << "FramePool::Release(): unknown bitmap" << std::endl;
+		return;
+	}
+	// Twice would give the same buffer to two users. There are
+	// only a few buffers, so the free list is just searched
+	for (int32 i = 0; i < fFreeCount; i++) {
+		if (fFreeList[i] == bitmap) {
+			std::cerr << "FramePool::Release(): bitmap released twice" << std::endl;
+			return;
+		}
+	}
+	fFreeList[fFreeCount++] = bitmap;
+}
+
+
+bool
+FramePool::HasBuffer(const BBitmap* bitmap) const
+{
+	BAutolock _(fLocker);
+	return fBuffers.HasItem(bitmap);
+}
+
+
+BRect
+FramePool::Frame() const
+{
+	BAutolock _(fLocker);
+	return fFrame;
+}
+
+
+color_space
+FramePool::ColorSpace() const
+{
+	BAutolock _(fLocker);
+	return fColorSpace;
+}
+
+
+int32
+FramePool::BytesPerRow() const
+{
+	BAutolock _(fLocker);
+	const BBitmap* bitmap = fBuffers.ItemAt(0);
+	return bitmap != NULL ? bitmap->BytesPerRow() : 0;
+}
+
+
+int32
+FramePool::CountBuffers() const
+{
+	BAutolock _(fLocker);
+	return fBuffers.CountItems();
+}
+
+
+int32
+FramePool::CountFree() const
+{
+	BAutolock _(fLocker);
+	return fFreeCount;
+}
+
+
+int32
+FramePool::ExhaustedCount() const
+{
+	BAutolock _(fLocker);
+	return fExhaustedCount;
+}
+
+
+bool
+FramePool::IsLocked() const
+{
+	BAutolock _(fLocker);
+	return fLocked;
+}
+
+
+// Every slot starts on a page, and its rows are as long as the
+// ones of the bitmaps allocated on their own, so the frames can
+// be copied to and from them as they are.
+// If the area can't be locked, it's created without the lock.
+// Must be called with the lock held
+status_t
+FramePool::_CreateArea(int32 count, frame_stage stage, uint32 lock,
+	int32* _bytesPerRow, size_t* _slotSize)
+{
+	size_t pixelChunk;
+	size_t rowAlignment;
+	size_t pixelsPerChunk;
+	status_t status = get_pixel_size_for(fColorSpace, &pixelChunk,
+		&rowAlignment, &pixelsPerChunk);
+	if (status != B_OK)
+		return status;
+
+	const size_t width = fFrame.IntegerWidth() + 1;
+	size_t bytesPerRow = (width + pixelsPerChunk - 1) / pixelsPerChunk
+		* pixelChunk;
+	bytesPerRow = (bytesPerRow + sizeof(int32) - 1) & ~(sizeof(int32) - 1);
+	const size_t slotSize = (bytesPerRow * (fFrame.IntegerHeight() + 1)
+		+ B_PAGE_SIZE - 1) & ~(B_PAGE_SIZE - 1);
+
+	BString name;
+	name << FrameAllocator::StageName(stage) << " frames";
+	void* address = NULL;
+	fArea = create_area(name.String(), &address, B_ANY_ADDRESS,
+		slotSize * count, lock, B_READ_AREA | B_WRITE_AREA);
+	if (fArea < 0 && lock != B_NO_LOCK) {
+		std::cerr << "FramePool: cannot lock " << slotSize * count
+			<< " bytes in memory" << std::endl;
+		lock = B_NO_LOCK;
+		fArea = create_area(name.String(), &address, B_ANY_ADDRESS,
+			slotSize * count, lock, B_READ_AREA | B_WRITE_AREA);
+	}
+	if (fArea < 0)
+		return fArea;
+
+	fLocked = lock == B_FULL_LOCK;
+	*_bytesPerRow = bytesPerRow;
+	*_slotSize = slotSize;
+	return B_OK;
+}
+
+
+// Must be called with the lock held
+void
+FramePool::_FreeBuffers()
+{
+	for (int32 i = 0; i < fBuffers.CountItems(); i++)
+		FrameAllocator::Free(fBuffers.ItemAt(i));
+	fBuffers.MakeEmpty(false);
+	if (fArea >= 0)
+		delete_area(fArea);
+	fArea = -1;
+	fLocked = false;
+}
@@ -0,0 +1,68 @@
+/*
+ * Copyright 2026 Stefano Ceccherini <stefano.ceccherini@gmail.com>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+#ifndef __FRAMEPOOL_H
+#define __FRAMEPOOL_H
+
+#include "FrameAllocator.h"
+
+#include <GraphicsDefs.h>
+#include <Locker.h>
+#include <ObjectList.h>
+#include <OS.h>
+#include <Rect.h>
+
+class BBitmap;
+// Fixed set of frame sized bitmaps, allocated once per capture session
+// and recycled between the capture and the write stages.
+// When all the buffers are in use, Acquire() returns NULL and
+// increments the exhaustion counter instead of allocating a new one.
+// The buffers are page aligned slots of a single area, named after
+// the stage, which can be locked in memory so they're never paged
+// out. Without the area, they're allocated on their own.
+class FramePool {
+public:
+	FramePool();
+	~FramePool();
+
+	// The buffers are counted in the given stage. The lock is the
+	// one of the area: B_FULL_LOCK keeps it in memory, if it fits
+	status_t Init(const BRect& frame, const color_space& colorSpace,
+					int32 count, frame_stage stage = kFrameStageCapture,
+					uint32 lock = B_NO_LOCK);
+	void Dispose();
+
+	BBitmap* Acquire();
+	void Release(BBitmap* bitmap);
+	bool HasBuffer(const BBitmap* bitmap) const;
+
+	BRect Frame() const;
+	color_space ColorSpace() const;
+	int32 BytesPerRow() const;
+
+	int32 CountBuffers() const;
+	int32 CountFree() const;
+	int32 ExhaustedCount() const;
+	bool IsLocked() const;
+
+private:
+	status_t _CreateArea(int32 count, frame_stage stage, uint32 lock,
+					int32* _bytesPerRow, size_t* _slotSize);
+	void _FreeBuffers();
+
+	BObjectList<BBitmap> fBuffers;
+	BBitmap** fFreeList;
+	int32 fFreeCount;
+	int32 fExhaustedCount;
+	BRect fFrame;
+	color_space fColorSpace;
+	area_id fArea;
+	bool fLocked;
+	mutable BLocker fLocker;
+
+	FramePool(const FramePool&) = delete;
+	FramePool& operator=(const FramePool&) = delete;
+};
+
+#endif // __FRAMEPOOL_H
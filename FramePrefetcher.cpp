@@ -0,0 +1,286 @@
+/*
+ * Copyright 2026 Stefano Ceccherini <stefano.ceccherini@gmail.com>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+#include "FramePrefetcher.h"
+
+#include "FrameAllocator.h"
+#include "FramePool.h"
+#include "FrameStore.h"
+#include "FramesList.h"
+#include "TraceRecorder.h"
+
+#include <Autolock.h>
+#include <Bitmap.h>
+#include <String.h>
+
+#include <algorithm>
+#include <new>
+
+
+FramePrefetcher::FramePrefetcher(FramesList* list, int32 depth, int32 threadCount)
+	:
+	fList(list),
+	fPool(NULL),
+	fSlots(NULL),
+	fDepth(std::max(depth, int32(1))),
+	fFirst(0),
+	fRangeCount(-1),
+	fCount(0),
+	fThreads(NULL),
+	fThreadCount(std::max(threadCount, int32(1))),
+	fFreeSem(-1),
+	fLocker("frame prefetcher lock"),
+	fNextLoad(0),
+	fNextFrame(0),
+	fLoadTime(0),
+	fWaitTime(0)
+{
+}
+
+
+FramePrefetcher::~FramePrefetcher()
+{
+	Stop();
+}
+
+
+void
+FramePrefetcher::SetRange(int32 first, int32 count)
+{
+	fFirst = std::max(first, int32(0));
+	fRangeCount = count;
+}
+
+
+status_t
+FramePrefetcher::Start()
+{
+	if (fList == NULL)
+		return B_NO_INIT;
+	if (fThreads != NULL)
+		return B_OK;
+
+	fCount = fList->CountItems();
+	if (fRangeCount >= 0)
+		fCount = std::min(fCount, fFirst + fRangeCount);
+	fNextLoad = fFirst;
+	fNextFrame = fFirst;
+
+	// Stored frames are read straight into recycled buffers:
+	// one for every slot, plus the one being encoded and the
+	// one kept to repeat it
+	const FrameStore* store = fList->Store();
+	if (store != NULL) {
+		fPool = new (std::nothrow) FramePool;
+		if (fPool != NULL && fPool->Init(store->Bounds(), store->ColorSpace(),
+				fDepth + 2, kFrameStageRead) != B_OK) {
+			delete fPool;
+			fPool = NULL;
+		}
+	}
+
+	fSlots = new (std::nothrow) frame_slot[fDepth];
+	fThreads = new (std::nothrow) thread_id[fThreadCount];
+	if (fSlots == NULL || fThreads == NULL) {
+		Stop();
+		return B_NO_MEMORY;
+	}
+	for (int32 i = 0; i < fDepth; i++) {
+		fSlots[i].bitmap = NULL;
+		fSlots[i].status = B_OK;
+		fSlots[i].readySem = create_sem(0, "prefetch slot");
+		if (fSlots[i].readySem < 0) {
+			status_t status = fSlots[i].readySem;
+			fDepth = i;
+			Stop();
+			return status;
+		}
+	}
+
+	fFreeSem = create_sem(fDepth, "prefetch free slots");
+	if (fFreeSem < 0) {
+		status_t status = fFreeSem;
+		Stop();
+		return status;
+	}
+
+	const int32 threadCount = fThreadCount;
+	fThreadCount = 0;
+	for (int32 i = 0; i < threadCount; i++) {
+		BString name;
+		name.SetToFormat("Frame prefetch %" B_PRId32, i + 1);
+		thread_id thread = spawn_thread((thread_entry)_LoaderStarter,
+			name.String(), B_NORMAL_PRIORITY, this);
+		if (thread < 0)
+			break;
+		if (resume_thread(thread) != B_OK) {
+			kill_thread(thread);
+			break;
+		}
+		fThreads[fThreadCount++] = thread;
+	}
+	if (fThreadCount == 0) {
+		Stop();
+		return B_ERROR;
+	}
+	return B_OK;
+}
+
+
+void
+FramePrefetcher::Stop()
+{
+	// Deleting the semaphore wakes up the loaders
+	if (fFreeSem >= 0) {
+		delete_sem(fFreeSem);
+		fFreeSem = -1;
+	}
+	for (int32 i = 0; fThreads != NULL && i < fThreadCount; i++) {
+		status_t unused;
+		wait_for_thread(fThreads[i], &unused);
+	}
+	delete[] fThreads;
+	fThreads = NULL;
+
+	for (int32 i = 0; fSlots != NULL && i < fDepth; i++) {
+		Recycle(fSlots[i].bitmap);
+		if (fSlots[i].readySem >= 0)
+			delete_sem(fSlots[i].readySem);
+	}
+	delete[] fSlots;
+	fSlots = NULL;
+
+	delete fPool;
+	fPool = NULL;
+}
+
+
+BBitmap*
+FramePrefetcher::NextFrame(status_t* _status)
+{
+	status_t unusedStatus;
+	if (_status == NULL)
+		_status = &unusedStatus;
+	*_status = B_OK;
+
+	if (fSlots == NULL) {
+		*_status = B_NO_INIT;
+		return NULL;
+	}
+	if (fNextFrame >= fCount)
+		return NULL;
+
+	frame_slot& slot = fSlots[fNextFrame % fDepth];
+	const bigtime_t waitStart = system_time();
+	status_t status;
+	while ((status = acquire_sem(slot.readySem)) == B_INTERRUPTED)
+		;
+	fWaitTime += system_time() - waitStart;
+	if (status != B_OK) {
+		*_status = status;
+		return NULL;
+	}
+
+	BBitmap* bitmap = slot.bitmap;
+	*_status = slot.status;
+	slot.bitmap = NULL;
+	fNextFrame++;
+
+	// The slot can be filled again
+	release_sem(fFreeSem);
+	return bitmap;
+}
+
+
+void
+FramePrefetcher::Recycle(BBitmap* bitmap)
+{
+	if (bitmap == NULL)
+		return;
+	if (fPool != NULL && fPool->HasBuffer(bitmap))
+		fPool->Release(bitmap);
+	else
+		FrameAllocator::Free(bitmap);
+}
+
+
+bigtime_t
+FramePrefetcher::LoadTime() const
+{
+	return atomic_get64(const_cast<int64*>(&fLoadTime));
+}
+
+
+bigtime_t
+FramePrefetcher::WaitTime() const
+{
+	return fWaitTime;
+}
+
+
+/* static */
+int32
+FramePrefetcher::_LoaderStarter(void* arg)
+{
+	return static_cast<FramePrefetcher*>(arg)->_LoaderThread();
+}
+
+
+int32
+FramePrefetcher::_LoaderThread()
+{
+	for (;;) {
+		// Never more than fDepth frames ahead
+		status_t status;
+		while ((status = acquire_sem(fFreeSem)) == B_INTERRUPTED)
+			;
+		if (status != B_OK)
+			break;
+
+		fLocker.Lock();
+		const int32 index = fNextLoad++;
+		fLocker.Unlock();
+		if (index >= fCount) {
+			// Let the other loaders find out too
+			release_sem(fFreeSem);
+			break;
+		}
+
+		const bigtime_t loadStart = system_time();
+		frame_slot& slot = fSlots[index % fDepth];
+		slot.bitmap = _LoadFrame(index, &slot.status);
+		atomic_add64(&fLoadTime, system_time() - loadStart);
+		release_sem(slot.readySem);
+	}
+	return B_OK;
+}
+
+
+BBitmap*
+FramePrefetcher::_LoadFrame(int32 index, status_t* _status)
+{
+	BitmapEntry* entry = fList->ItemAt(index);
+	if (entry == NULL) {
+		*_status = B_BAD_INDEX;
+		return NULL;
+	}
+	if (index > fFirst && fList->IsDuplicate(index)) {
+		*_status = B_OK;
+		return NULL;
+	}
+
+	TraceScope trace("decode", index);
+	BBitmap* bitmap = fPool != NULL ? fPool->Acquire() : NULL;
+	if (bitmap != NULL) {
+		*_status = entry->ReadBitmap(bitmap);
+		if (*_status == B_OK)
+			return bitmap;
+		fPool->Release(bitmap);
+	}
+
+	// Replaced frames, or no buffers left
+	bitmap = entry->Bitmap();
+	*_status = bitmap != NULL ? B_OK : B_ERROR;
+	return bitmap;
+}
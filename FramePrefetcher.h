@@ -0,0 +1,74 @@
+/*
+ * Copyright 2026 Stefano Ceccherini <stefano.ceccherini@gmail.com>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+#ifndef __FRAMEPREFETCHER_H
+#define __FRAMEPREFETCHER_H
+
+#include <Locker.h>
+#include <OS.h>
+
+class BBitmap;
+class FramePool;
+class FramesList;
+// Loads the frames of a list ahead of time from its own threads,
+// so the encoder doesn't wait for the disk or the decoding.
+// The frames are returned in order. The list must not be
+// changed while the prefetcher is running.
+class FramePrefetcher {
+public:
+	FramePrefetcher(FramesList* list, int32 depth,
+		int32 threadCount = 2);
+	~FramePrefetcher();
+
+	// Only loads "count" frames, from "first". Must be
+	// called before Start()
+	void SetRange(int32 first, int32 count);
+
+	status_t Start();
+	void Stop();
+
+	// Returns the next frame, waiting for it if it's not loaded
+	// yet, or NULL after the last frame or on error.
+	// Duplicate frames (see FramesList::IsDuplicate()) aren't
+	// loaded at all: for them, NULL is returned with B_OK.
+	// The first frame of the range is always loaded.
+	// The frame must be given back with Recycle()
+	BBitmap* NextFrame(status_t* _status = NULL);
+	void Recycle(BBitmap* bitmap);
+
+	// Total time spent loading frames, by all the threads,
+	// and waiting for them in NextFrame()
+	bigtime_t LoadTime() const;
+	bigtime_t WaitTime() const;
+
+private:
+	struct frame_slot {
+		BBitmap* bitmap;
+		status_t status;
+		sem_id readySem;
+	};
+
+	static int32 _LoaderStarter(void* arg);
+	int32 _LoaderThread();
+	BBitmap* _LoadFrame(int32 index, status_t* _status);
+
+	FramesList* fList;
+	FramePool* fPool;
+	frame_slot* fSlots;
+	int32 fDepth;
+	int32 fFirst;
+	int32 fRangeCount;
+	// The index after the last frame
+	int32 fCount;
+	thread_id* fThreads;
+	int32 fThreadCount;
+	sem_id fFreeSem;
+	BLocker fLocker;
+	int32 fNextLoad;
+	int32 fNextFrame;
+	int64 fLoadTime;
+	bigtime_t fWaitTime;
+};
+
+#endif // __FRAMEPREFETCHER_H
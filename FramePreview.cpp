@@ -0,0 +1,164 @@
+/*
+ * Copyright 2026 Stefano Ceccherini <stefano.ceccherini@gmail.com>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+#include "FramePreview.h"
+
+#include <Autolock.h>
+#include <Bitmap.h>
+
+#include <algorithm>
+#include <cstring>
+#include <new>
+
+
+static inline bool
+Is32Bit(color_space colorSpace)
+{
+	return colorSpace == B_RGB32 || colorSpace == B_RGBA32;
+}
+
+
+// Every byte is the average of the four
+static inline uint32
+Average(uint32 a, uint32 b, uint32 c, uint32 d)
+{
+	const uint32 redBlue = (((a & 0x00ff00ff) + (b & 0x00ff00ff)
+		+ (c & 0x00ff00ff) + (d & 0x00ff00ff)) >> 2) & 0x00ff00ff;
+	const uint32 alphaGreen = ((((a >> 8) & 0x00ff00ff) + ((b >> 8) & 0x00ff00ff)
+		+ ((c >> 8) & 0x00ff00ff) + ((d >> 8) & 0x00ff00ff)) >> 2) & 0x00ff00ff;
+	return redBlue | (alphaGreen << 8);
+}
+
+
+FramePreview::FramePreview()
+	:
+	fLocker("frame preview"),
+	fBitmap(NULL),
+	fReady(false),
+	fRequested(0)
+{
+}
+
+
+FramePreview::~FramePreview()
+{
+	delete fBitmap;
+}
+
+
+status_t
+FramePreview::SetSize(int32 width, int32 height)
+{
+	if (width <= 0 || height <= 0)
+		return B_BAD_VALUE;
+
+	const BRect frame(0, 0, width - 1, height - 1);
+	BAutolock _(fLocker);
+	if (fBitmap != NULL && fBitmap->Bounds() == frame)
+		return B_OK;
+
+	delete fBitmap;
+	fReady = false;
+	fBitmap = new (std::nothrow) BBitmap(frame, B_RGB32);
+	if (fBitmap == NULL || fBitmap->InitCheck() != B_OK) {
+		delete fBitmap;
+		fBitmap = NULL;
+		return B_NO_MEMORY;
+	}
+	return B_OK;
+}
+
+
+void
+FramePreview::Request()
+{
+	atomic_set(&fRequested, 1);
+}
+
+
+void
+FramePreview::AddFrame(const BBitmap* frame)
+{
+	if (atomic_test_and_set(&fRequested, 0, 1) != 1)
+		return;
+
+	if (fLocker.LockWithTimeout(0) != B_OK) {
+		// The view is reading the preview: try with the next frame
+		atomic_set(&fRequested, 1);
+		return;
+	}
+	if (fBitmap != NULL && Downsample(frame, fBitmap, &fBounds) == B_OK)
+		fReady = true;
+	fLocker.Unlock();
+}
+
+
+status_t
+FramePreview::CopyTo(BBitmap* bitmap, BRect* bounds)
+{
+	BAutolock _(fLocker);
+	if (!fReady || fBitmap == NULL)
+		return B_ERROR;
+	if (bitmap->Bounds().Width() < fBounds.Width()
+		|| bitmap->Bounds().Height() < fBounds.Height()
+		|| bitmap->ColorSpace() != fBitmap->ColorSpace())
+		return B_BAD_VALUE;
+
+	const int32 rowLength = (fBounds.IntegerWidth() + 1) * 4;
+	const uint8* source = (const uint8*)fBitmap->Bits();
+	uint8* dest = (uint8*)bitmap->Bits();
+	for (int32 y = 0; y <= fBounds.IntegerHeight(); y++) {
+		::memcpy(dest, source, rowLength);
+		source += fBitmap->BytesPerRow();
+		dest += bitmap->BytesPerRow();
+	}
+	*bounds = fBounds;
+	fReady = false;
+	return B_OK;
+}
+
+
+/* static */
+status_t
+FramePreview::Downsample(const BBitmap* source, BBitmap* dest, BRect* bounds)
+{
+	if (!Is32Bit(source->ColorSpace()) || !Is32Bit(dest->ColorSpace()))
+		return B_NOT_SUPPORTED;
+
+	const int32 sourceWidth = source->Bounds().IntegerWidth() + 1;
+	const int32 sourceHeight = source->Bounds().IntegerHeight() + 1;
+	const int32 maxWidth = dest->Bounds().IntegerWidth() + 1;
+	const int32 maxHeight = dest->Bounds().IntegerHeight() + 1;
+
+	// Never scaled up
+	int32 width = std::min(sourceWidth, maxWidth);
+	int32 height = int32(int64(sourceHeight) * width / sourceWidth);
+	if (height > maxHeight) {
+		height = maxHeight;
+		width = int32(int64(sourceWidth) * height / sourceHeight);
+	}
+	width = std::max(width, int32(1));
+	height = std::max(height, int32(1));
+
+	// Steps in 16.16 fixed point
+	const uint32 stepX = (uint32(sourceWidth) << 16) / width;
+	const uint32 stepY = (uint32(sourceHeight) << 16) / height;
+	const uint8* sourceBits = (const uint8*)source->Bits();
+	const int32 sourceBytesPerRow = source->BytesPerRow();
+	uint8* destBits = (uint8*)dest->Bits();
+	for (int32 y = 0; y < height; y++) {
+		const int32 sourceY = (y * stepY) >> 16;
+		const uint32* top = (const uint32*)(sourceBits + sourceY * sourceBytesPerRow);
+		const uint32* bottom = (const uint32*)(sourceBits
+			+ std::min(sourceY + 1, sourceHeight - 1) * sourceBytesPerRow);
+		uint32* row = (uint32*)(destBits + y * dest->BytesPerRow());
+		for (int32 x = 0; x < width; x++) {
+			const int32 left = (x * stepX) >> 16;
+			const int32 right = std::min(left + 1, sourceWidth - 1);
+			row[x] = Average(top[left], top[right], bottom[left], bottom[right]);
+		}
+	}
+	bounds->Set(0, 0, width - 1, height - 1);
+	return B_OK;
+}
@@ -0,0 +1,53 @@
+/*
+ * Copyright 2026 Stefano Ceccherini <stefano.ceccherini@gmail.com>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+#ifndef __FRAMEPREVIEW_H
+#define __FRAMEPREVIEW_H
+
+#include <Locker.h>
+#include <Rect.h>
+
+class BBitmap;
+// A small copy of the frames being captured, so they can be shown
+// while recording without reading the screen once more.
+// The capture thread only scales a frame down after the view asked
+// for one, so it's done at the rate the view is refreshed, and it
+// never waits for the view: if the view is reading the last preview,
+// the frame is skipped. Nothing is allocated while capturing.
+class FramePreview {
+public:
+	FramePreview();
+	~FramePreview();
+
+	// Window thread. The previews fit in this size
+	status_t SetSize(int32 width, int32 height);
+	// Window thread: the next frame should be scaled down
+	void Request();
+
+	// Capture thread
+	void AddFrame(const BBitmap* frame);
+
+	// Window thread. Copies the last preview to the top left of
+	// the given bitmap, which must be at least as large as the size,
+	// and returns its bounds. Fails if there's no new preview
+	status_t CopyTo(BBitmap* bitmap, BRect* bounds);
+
+	// Scales a 32 bit source down to fit in dest, keeping the aspect
+	// ratio, on the top left. Every pixel is the average of four,
+	// which is cheap and good enough for a preview
+	static status_t Downsample(const BBitmap* source, BBitmap* dest,
+			BRect* bounds);
+
+private:
+	BLocker fLocker;
+	BBitmap* fBitmap;
+	BRect fBounds;
+	bool fReady;
+	int32 fRequested;
+
+	FramePreview(const FramePreview&) = delete;
+	FramePreview& operator=(const FramePreview&) = delete;
+};
+
+#endif // __FRAMEPREVIEW_H
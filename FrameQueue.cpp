@@ -0,0 +1,130 @@
+/*
+ * Copyright 2026 Stefano Ceccherini <stefano.ceccherini@gmail.com>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+#include "FrameQueue.h"
+
+#include <new>
+
+
+FrameQueue::FrameQueue(int32 capacity)
+	:
+	fSlots(NULL),
+	fCapacity(capacity),
+	fHead(0),
+	fTail(0),
+	fHighWaterMark(0),
+	fClosed(0),
+	fFramesSem(-1)
+{
+	if (fCapacity > 0)
+		fSlots = new (std::nothrow) queued_frame[fCapacity];
+	fFramesSem = create_sem(0, "frame queue");
+}
+
+
+FrameQueue::~FrameQueue()
+{
+	if (fFramesSem >= 0)
+		delete_sem(fFramesSem);
+	delete[] fSlots;
+}
+
+
+status_t
+FrameQueue::InitCheck() const
+{
+	if (fSlots == NULL)
+		return B_NO_MEMORY;
+	if (fFramesSem < 0)
+		return fFramesSem;
+	return B_OK;
+}
+
+
+// Producer side
+bool
+FrameQueue::Push(BBitmap* bitmap, bigtime_t time, int32 number,
+	BPoint origin)
+{
+	if (atomic_get(&fClosed) != 0)
+		return false;
+
+	const int32 head = fHead;
+	const int32 depth = uint32(head) - uint32(atomic_get(&fTail));
+	if (depth >= fCapacity)
+		return false;
+
+	queued_frame& slot = fSlots[uint32(head) % fCapacity];
+	slot.bitmap = bitmap;
+	slot.time = time;
+	slot.number = number;
+	slot.origin = origin;
+	// atomic_set() is a full barrier, so the slot is visible
+	// to the consumer before the new head
+	atomic_set(&fHead, head + 1);
+
+	if (depth + 1 > fHighWaterMark)
+		fHighWaterMark = depth + 1;
+
+	release_sem_etc(fFramesSem, 1, B_DO_NOT_RESCHEDULE);
+	return true;
+}
+
+
+// Consumer side. Returns false when the queue has been
+// closed and there are no more frames in it.
+bool
+FrameQueue::Pop(queued_frame& frame)
+{
+	// Every Push() releases the semaphore once, and so does Close()
+	status_t status;
+	do {
+		status = acquire_sem(fFramesSem);
+	} while (status == B_INTERRUPTED);
+	if (status != B_OK)
+		return false;
+
+	const int32 tail = fTail;
+	if (atomic_get(&fHead) == tail) {
+		// Woken up by Close(): leave the semaphore signaled,
+		// so further calls return immediately
+		release_sem_etc(fFramesSem, 1, B_DO_NOT_RESCHEDULE);
+		return false;
+	}
+
+	frame = fSlots[uint32(tail) % fCapacity];
+	atomic_set(&fTail, tail + 1);
+	return true;
+}
+
+
+void
+FrameQueue::Close()
+{
+	// Wake up the consumer, if it's waiting
+	if (atomic_set(&fClosed, 1) == 0)
+		release_sem(fFramesSem);
+}
+
+
+int32
+FrameQueue::Capacity() const
+{
+	return fCapacity;
+}
+
+
+int32
+FrameQueue::Depth() const
+{
+	FrameQueue* queue = const_cast<FrameQueue*>(this);
+	return uint32(atomic_get(&queue->fHead)) - uint32(atomic_get(&queue->fTail));
+}
+
+
+int32
+FrameQueue::HighWaterMark() const
+{
+	return fHighWaterMark;
+}
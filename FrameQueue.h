@@ -0,0 +1,56 @@
+/*
+ * Copyright 2026 Stefano Ceccherini <stefano.ceccherini@gmail.com>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+#ifndef __FRAMEQUEUE_H
+#define __FRAMEQUEUE_H
+
+#include <OS.h>
+#include <Point.h>
+
+class BBitmap;
+struct queued_frame {
+	BBitmap* bitmap;
+	bigtime_t time;
+	// In the order of the capture, if known
+	int32 number;
+	// Where the captured area was on the screen
+	BPoint origin;
+};
+
+
+// Bounded single producer / single consumer queue of captured frames.
+// Push() never blocks, so the capture thread can keep its deadline;
+// Pop() waits until a frame is available or the queue is closed.
+class FrameQueue {
+public:
+	FrameQueue(int32 capacity);
+	~FrameQueue();
+
+	status_t InitCheck() const;
+
+	bool Push(BBitmap* bitmap, bigtime_t time, int32 number = -1,
+			BPoint origin = B_ORIGIN);
+	bool Pop(queued_frame& frame);
+	void Close();
+
+	int32 Capacity() const;
+	int32 Depth() const;
+	int32 HighWaterMark() const;
+
+private:
+	queued_frame* fSlots;
+	int32 fCapacity;
+	// Monotonic counters: only the producer writes fHead,
+	// only the consumer writes fTail
+	int32 fHead;
+	int32 fTail;
+	int32 fHighWaterMark;
+	int32 fClosed;
+	sem_id fFramesSem;
+
+	FrameQueue(const FrameQueue&) = delete;
+	FrameQueue& operator=(const FrameQueue&) = delete;
+};
+
+#endif // __FRAMEQUEUE_H
@@ -0,0 +1,360 @@
+/*
+ * Copyright 2026 Stefano Ceccherini <stefano.ceccherini@gmail.com>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+#include "FrameScaler.h"
+
+#include "WorkerPool.h"
+
+#include <Bitmap.h>
+
+#include <algorithm>
+#include <cmath>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// The weights are fixed point numbers with this many fractional bits
+const static int32 kWeightBits = 14;
+const static int32 kBandRows = 16;
+
+
+static double
+KernelSupport(FrameScaler::scale_kernel kernel)
+{
+	switch (kernel) {
+		case FrameScaler::kKernelBox:
+			return 0.5;
+		case FrameScaler::kKernelLanczos:
+			return 3.0;
+		case FrameScaler::kKernelBilinear:
+		default:
+			return 1.0;
+	}
+}
+
+
+static double
+Sinc(double x)
+{
+	if (x == 0.0)
+		return 1.0;
+	x *= M_PI;
+	return std::sin(x) / x;
+}
+
+
+static double
+KernelWeight(FrameScaler::scale_kernel kernel, double x)
+{
+	switch (kernel) {
+		case FrameScaler::kKernelBox:
+			return (x > -0.5 && x <= 0.5) ? 1.0 : 0.0;
+		case FrameScaler::kKernelLanczos:
+			return (x > -3.0 && x < 3.0) ? Sinc(x) * Sinc(x / 3.0) : 0.0;
+		case FrameScaler::kKernelBilinear:
+		default:
+			x = std::fabs(x);
+			return x < 1.0 ? 1.0 - x : 0.0;
+	}
+}
+
+
+static inline uint8
+ClampWeighted(int32 value)
+{
+	value = (value + (1 << (kWeightBits - 1))) >> kWeightBits;
+	return value < 0 ? 0 : (value > 255 ? 255 : value);
+}
+
+
+#if defined(__SSE2__)
+// Two weights, in the layout expected by _mm_madd_epi16()
+static inline __m128i
+WeightPair(int16 first, int16 second)
+{
+	return _mm_set1_epi32((int32)((uint32)(uint16)first | ((uint32)(uint16)second << 16)));
+}
+
+
+static inline __m128i
+RoundAndShift(__m128i sum)
+{
+	const __m128i rounding = _mm_set1_epi32(1 << (kWeightBits - 1));
+	return _mm_srai_epi32(_mm_add_epi32(sum, rounding), kWeightBits);
+}
+#endif
+
+
+static void
+ScaleRowHorizontally(const uint8* source, uint8* dest, int32 width,
+	const int32* start, const int16* weights, int32 taps)
+{
+	for (int32 x = 0; x < width; x++) {
+		const uint8* pixel = source + start[x] * 4;
+		const int16* weight = weights + x * taps;
+#if defined(__SSE2__)
+		const uint32* pixels = (const uint32*)pixel;
+		const __m128i zero = _mm_setzero_si128();
+		__m128i sum = _mm_setzero_si128();
+		int32 k = 0;
+		for (; k + 2 <= taps; k += 2) {
+			// b0 b1 g0 g1 r0 r1 a0 a1, as 16 bit values
+			__m128i pair = _mm_unpacklo_epi8(_mm_cvtsi32_si128(pixels[k]),
+				_mm_cvtsi32_si128(pixels[k + 1]));
+			pair = _mm_unpacklo_epi8(pair, zero);
+			sum = _mm_add_epi32(sum, _mm_madd_epi16(pair, WeightPair(weight[k], weight[k + 1])));
+		}
+		if (k < taps) {
+			__m128i single = _mm_unpacklo_epi8(_mm_cvtsi32_si128(pixels[k]), zero);
+			single = _mm_unpacklo_epi8(single, zero);
+			sum = _mm_add_epi32(sum, _mm_madd_epi16(single, WeightPair(weight[k], 0)));
+		}
+		sum = RoundAndShift(sum);
+		sum = _mm_packs_epi32(sum, sum);
+		((uint32*)dest)[x] = _mm_cvtsi128_si32(_mm_packus_epi16(sum, sum));
+#else
+		int32 sum[4] = { 0, 0, 0, 0 };
+		for (int32 k = 0; k < taps; k++) {
+			for (int32 c = 0; c < 4; c++)
+				sum[c] += pixel[c] * weight[k];
+			pixel += 4;
+		}
+		for (int32 c = 0; c < 4; c++)
+			dest[x * 4 + c] = ClampWeighted(sum[c]);
+#endif
+	}
+}
+
+
+static void
+ScaleRowVertically(const uint8* source, int32 sourceBytesPerRow, uint8* dest,
+	int32 length, const int16* weights, int32 taps)
+{
+	int32 c = 0;
+#if defined(__SSE2__)
+	const __m128i zero = _mm_setzero_si128();
+	for (; c + 16 <= length; c += 16) {
+		__m128i sum[4] = { zero, zero, zero, zero };
+		const uint8* row = source + c;
+		for (int32 k = 0; k < taps; k += 2) {
+			const __m128i first = _mm_loadu_si128((const __m128i*)row);
+			__m128i second = zero;
+			__m128i weight;
+			if (k + 1 < taps) {
+				second = _mm_loadu_si128((const __m128i*)(row + sourceBytesPerRow));
+				weight = WeightPair(weights[k], weights[k + 1]);
+			} else
+				weight = WeightPair(weights[k], 0);
+			row += 2 * sourceBytesPerRow;
+
+			// Interleave the two rows, so every pair of 16 bit values
+			// is multiplied by the pair of weights
+			const __m128i low = _mm_unpacklo_epi8(first, second);
+			const __m128i high = _mm_unpackhi_epi8(first, second);
+			sum[0] = _mm_add_epi32(sum[0], _mm_madd_epi16(_mm_unpacklo_epi8(low, zero), weight));
+			sum[1] = _mm_add_epi32(sum[1], _mm_madd_epi16(_mm_unpackhi_epi8(low, zero), weight));
+			sum[2] = _mm_add_epi32(sum[2], _mm_madd_epi16(_mm_unpacklo_epi8(high, zero), weight));
+			sum[3] = _mm_add_epi32(sum[3], _mm_madd_epi16(_mm_unpackhi_epi8(high, zero), weight));
+		}
+		const __m128i low = _mm_packs_epi32(RoundAndShift(sum[0]), RoundAndShift(sum[1]));
+		const __m128i high = _mm_packs_epi32(RoundAndShift(sum[2]), RoundAndShift(sum[3]));
+		_mm_storeu_si128((__m128i*)(dest + c), _mm_packus_epi16(low, high));
+	}
+#endif
+	for (; c < length; c++) {
+		int32 sum = 0;
+		const uint8* row = source + c;
+		for (int32 k = 0; k < taps; k++) {
+			sum += *row * weights[k];
+			row += sourceBytesPerRow;
+		}
+		dest[c] = ClampWeighted(sum);
+	}
+}
+
+
+FrameScaler::FrameScaler(scale_kernel kernel)
+	:
+	fKernel(kernel),
+	fWorkerPool(NULL)
+{
+	fHorizontal.inSize = fHorizontal.outSize = fHorizontal.taps = 0;
+	fVertical.inSize = fVertical.outSize = fVertical.taps = 0;
+}
+
+
+FrameScaler::~FrameScaler()
+{
+}
+
+
+void
+FrameScaler::SetWorkerPool(WorkerPool* pool)
+{
+	fWorkerPool = pool;
+}
+
+
+/* static */
+bool
+FrameScaler::CanScale(color_space from, color_space to)
+{
+	if (from != B_RGB32 && from != B_RGBA32)
+		return false;
+	// The alpha channel of B_RGB32 is undefined
+	return to == B_RGB32 || (to == B_RGBA32 && from == B_RGBA32);
+}
+
+
+status_t
+FrameScaler::Scale(const BBitmap* source, BBitmap* dest)
+{
+	if (source == NULL || dest == NULL)
+		return B_BAD_VALUE;
+	if (!CanScale(source->ColorSpace(), dest->ColorSpace()))
+		return B_NOT_SUPPORTED;
+
+	const BRect sourceBounds = source->Bounds();
+	const BRect destBounds = dest->Bounds();
+	return Scale(source->Bits(), source->BytesPerRow(),
+		sourceBounds.IntegerWidth() + 1, sourceBounds.IntegerHeight() + 1,
+		dest->Bits(), dest->BytesPerRow(),
+		destBounds.IntegerWidth() + 1, destBounds.IntegerHeight() + 1);
+}
+
+
+status_t
+FrameScaler::Scale(const void* source, int32 sourceBytesPerRow,
+	int32 sourceWidth, int32 sourceHeight, void* dest,
+	int32 destBytesPerRow, int32 destWidth, int32 destHeight)
+{
+	if (source == NULL || dest == NULL || sourceWidth <= 0 || sourceHeight <= 0
+		|| destWidth <= 0 || destHeight <= 0
+		|| sourceBytesPerRow < sourceWidth * 4 || destBytesPerRow < destWidth * 4)
+		return B_BAD_VALUE;
+
+	_ComputeCoefficients(fHorizontal, sourceWidth, destWidth);
+	_ComputeCoefficients(fVertical, sourceHeight, destHeight);
+
+	// Every source row is scaled horizontally first, then
+	// the resulting columns vertically
+	const int32 intermediateBytesPerRow = destWidth * 4;
+	fIntermediate.resize((size_t)intermediateBytesPerRow * sourceHeight);
+
+	scale_job job;
+	job.scaler = this;
+	job.source = (const uint8*)source;
+	job.sourceBytesPerRow = sourceBytesPerRow;
+	job.dest = fIntermediate.data();
+	job.destBytesPerRow = intermediateBytesPerRow;
+	job.rows = sourceHeight;
+	status_t status = _Run(_HorizontalBand, job);
+	if (status != B_OK)
+		return status;
+
+	job.source = fIntermediate.data();
+	job.sourceBytesPerRow = intermediateBytesPerRow;
+	job.dest = (uint8*)dest;
+	job.destBytesPerRow = destBytesPerRow;
+	job.rows = destHeight;
+	return _Run(_VerticalBand, job);
+}
+
+
+void
+FrameScaler::_ComputeCoefficients(coefficients& coeffs, int32 inSize,
+	int32 outSize) const
+{
+	if (coeffs.inSize == inSize && coeffs.outSize == outSize)
+		return;
+
+	// When shrinking, the kernel is stretched to cover
+	// all the source pixels
+	const double scale = double(inSize) / outSize;
+	const double filterScale = std::max(scale, 1.0);
+	const double support = KernelSupport(fKernel) * filterScale;
+	const int32 taps = std::min((int32)std::ceil(support) * 2 + 1, inSize);
+
+	coeffs.inSize = inSize;
+	coeffs.outSize = outSize;
+	coeffs.taps = taps;
+	coeffs.start.resize(outSize);
+	coeffs.weights.assign((size_t)outSize * taps, 0);
+
+	std::vector<double> weights(taps);
+	for (int32 i = 0; i < outSize; i++) {
+		const double center = (i + 0.5) * scale;
+		int32 first = std::max((int32)(center - support + 0.5), int32(0));
+		const int32 last = std::min((int32)(center + support + 0.5), inSize);
+		int32 count = std::min(last - first, taps);
+		if (count <= 0) {
+			first = std::min((int32)center, inSize - 1);
+			count = 1;
+		}
+
+		double total = 0.0;
+		for (int32 k = 0; k < count; k++) {
+			weights[k] = KernelWeight(fKernel, (first + k - center + 0.5) / filterScale);
+			total += weights[k];
+		}
+
+		// All the windows have the same size: move the ones
+		// at the right edge back inside the image
+		const int32 window = std::min(first, inSize - taps);
+		const int32 offset = first - window;
+		int16* weight = &coeffs.weights[(size_t)i * taps + offset];
+		if (total == 0.0)
+			weight[0] = 1 << kWeightBits;
+		else {
+			for (int32 k = 0; k < count; k++)
+				weight[k] = (int16)std::lround(weights[k] / total * (1 << kWeightBits));
+		}
+		coeffs.start[i] = window;
+	}
+}
+
+
+status_t
+FrameScaler::_Run(void (*function)(void*, int32), scale_job& job)
+{
+	const int32 bands = (job.rows + kBandRows - 1) / kBandRows;
+	if (fWorkerPool != NULL && bands > 1)
+		return fWorkerPool->Run(function, &job, bands);
+
+	for (int32 band = 0; band < bands; band++)
+		function(&job, band);
+	return B_OK;
+}
+
+
+/* static */
+void
+FrameScaler::_HorizontalBand(void* cookie, int32 band)
+{
+	const scale_job* job = static_cast<const scale_job*>(cookie);
+	const coefficients& coeffs = job->scaler->fHorizontal;
+	const int32 last = std::min((band + 1) * kBandRows, job->rows);
+	for (int32 y = band * kBandRows; y < last; y++) {
+		ScaleRowHorizontally(job->source + y * job->sourceBytesPerRow,
+			job->dest + y * job->destBytesPerRow, coeffs.outSize,
+			coeffs.start.data(), coeffs.weights.data(), coeffs.taps);
+	}
+}
+
+
+/* static */
+void
+FrameScaler::_VerticalBand(void* cookie, int32 band)
+{
+	const scale_job* job = static_cast<const scale_job*>(cookie);
+	const coefficients& coeffs = job->scaler->fVertical;
+	const int32 length = job->scaler->fHorizontal.outSize * 4;
+	const int32 last = std::min((band + 1) * kBandRows, job->rows);
+	for (int32 y = band * kBandRows; y < last; y++) {
+		ScaleRowVertically(job->source + coeffs.start[y] * job->sourceBytesPerRow,
+			job->sourceBytesPerRow, job->dest + y * job->destBytesPerRow, length,
+			&coeffs.weights[(size_t)y * coeffs.taps], coeffs.taps);
+	}
+}
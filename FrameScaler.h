@@ -0,0 +1,75 @@
+/*
+ * Copyright 2026 Stefano Ceccherini <stefano.ceccherini@gmail.com>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+#ifndef __FRAMESCALER_H
+#define __FRAMESCALER_H
+
+#include <GraphicsDefs.h>
+#include <SupportDefs.h>
+
+#include <vector>
+
+class BBitmap;
+class WorkerPool;
+// Resizes 32 bit frames in software, without going through
+// the app_server. The image is filtered in two separable passes,
+// each one split in bands of rows which run on the worker pool.
+// The weights are cached, so scaling many frames of the same size
+// doesn't allocate anything.
+class FrameScaler {
+public:
+	enum scale_kernel {
+		kKernelBox = 0,
+		kKernelBilinear,
+		kKernelLanczos
+	};
+
+	FrameScaler(scale_kernel kernel = kKernelBilinear);
+	~FrameScaler();
+
+	void SetWorkerPool(WorkerPool* pool);
+
+	static bool CanScale(color_space from, color_space to);
+
+	// Scales the whole source to the whole destination
+	status_t Scale(const BBitmap* source, BBitmap* dest);
+	status_t Scale(const void* source, int32 sourceBytesPerRow,
+		int32 sourceWidth, int32 sourceHeight, void* dest,
+		int32 destBytesPerRow, int32 destWidth, int32 destHeight);
+
+private:
+	struct coefficients {
+		int32 inSize;
+		int32 outSize;
+		int32 taps;
+		// For every output pixel, the first input pixel
+		// and "taps" weights
+		std::vector<int32> start;
+		std::vector<int16> weights;
+	};
+
+	struct scale_job {
+		FrameScaler* scaler;
+		const uint8* source;
+		int32 sourceBytesPerRow;
+		uint8* dest;
+		int32 destBytesPerRow;
+		int32 rows;
+	};
+
+	void _ComputeCoefficients(coefficients& coeffs, int32 inSize,
+		int32 outSize) const;
+	status_t _Run(void (*function)(void*, int32), scale_job& job);
+
+	static void _HorizontalBand(void* cookie, int32 band);
+	static void _VerticalBand(void* cookie, int32 band);
+
+	scale_kernel fKernel;
+	WorkerPool* fWorkerPool;
+	coefficients fHorizontal;
+	coefficients fVertical;
+	std::vector<uint8> fIntermediate;
+};
+
+#endif // __FRAMESCALER_H
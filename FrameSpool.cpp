@@ -0,0 +1,1000 @@
+/*
+ * Copyright 2026 Stefano Ceccherini <stefano.ceccherini@gmail.com>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+#include "FrameSpool.h"
+
+#include "FrameAllocator.h"
+#include "FrameCompressor.h"
+#include "TileDelta.h"
+
+#include <Autolock.h>
+#include <Bitmap.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <new>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#include <utility>
+
+// Frame data starts on a page boundary, and every record
+// is aligned to a cache line
+const static int64 kSpoolDataOffset = 4096;
+const static int64 kSpoolRecordAlignment = 64;
+// Unbuffered writes need whole blocks, from aligned buffers
+const static int64 kUnbufferedAlignment = 4096;
+#if defined(O_NOCACHE)
+const static int kUnbufferedOpenFlag = O_NOCACHE;
+#elif defined(O_DIRECT)
+const static int kUnbufferedOpenFlag = O_DIRECT;
+#else
+const static int kUnbufferedOpenFlag = 0;
+#endif
+
+// Records are moved to the file in batches: once the budget is
+// exceeded, until the memory used is 1/kSpillHysteresis below it
+const static int64 kSpillHysteresis = 16;
+const static int32 kMaxSpillRecords = 16;
+static const uint8 kZeroPadding[kSpoolRecordAlignment] = { 0 };
+
+
+typedef std::pair<bigtime_t, int32> time_index;
+
+
+FrameSpool::FrameSpool()
+	:
+	fNextOffset(0),
+	fMemoryBudget(0),
+	fMemoryUsed(0),
+	fNextSpill(0),
+	fSpillStatus(B_OK),
+	fWriteFD(-1),
+	fUnbufferedFD(-1),
+	fUnbuffered(false),
+	fAlignment(kSpoolRecordAlignment),
+	fFirstFrame(0),
+	fEndFrame(-1),
+	fLocker("frame spool lock"),
+	fFD(-1),
+	fMappedData(NULL),
+	fMappedSize(0),
+	fWorkerPool(NULL),
+	fCacheUse(0),
+	fCacheLocker("frame spool cache lock")
+{
+	::memset(&fHeader, 0, sizeof(fHeader));
+	for (int32 i = 0; i < kDecodeCacheSize; i++) {
+		fCache[i].bitmap = NULL;
+		fCache[i].index = -1;
+		fCache[i].lastUse = 0;
+	}
+}
+
+
+FrameSpool::~FrameSpool()
+{
+	Close();
+}
+
+
+// The spool is the kSpoolFileName file in the given folder
+/* virtual */
+status_t
+FrameSpool::Create(const char* path, const BRect& bounds,
+	color_space colorSpace, int32 bytesPerRow, int64 memoryBudget)
+{
+	if (path == NULL || !bounds.IsValid() || bytesPerRow <= 0 || memoryBudget < 0)
+		return B_BAD_VALUE;
+
+	Close();
+
+	BString fileName;
+	fileName << path << "/" << kSpoolFileName;
+	fWriteFD = ::open(fileName.String(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+	if (fWriteFD < 0) {
+		status_t status = errno;
+		std::cerr << "FrameSpool::Create(): cannot create file: " << ::strerror(status) << std::endl;
+		return status;
+	}
+
+	// Records moved from memory are then written around the file
+	// cache, if the file system can do it. Everything else still
+	// goes through the cache
+	if (fUnbuffered && kUnbufferedOpenFlag != 0) {
+		fUnbufferedFD = ::open(fileName.String(), O_WRONLY | kUnbufferedOpenFlag);
+		if (fUnbufferedFD < 0)
+			std::cerr << "FrameSpool::Create(): no unbuffered writes: " << ::strerror(errno) << std::endl;
+	}
+	fAlignment = fUnbufferedFD >= 0 ? kUnbufferedAlignment : kSpoolRecordAlignment;
+
+	fPath = fileName;
+	fHeader.magic = kSpoolMagic;
+	fHeader.version = kSpoolVersion;
+	fHeader.left = bounds.left;
+	fHeader.top = bounds.top;
+	fHeader.right = bounds.right;
+	fHeader.bottom = bounds.bottom;
+	fHeader.colorSpace = (uint32)colorSpace;
+	fHeader.bytesPerRow = bytesPerRow;
+	fHeader.indexOffset = 0;
+	fHeader.indexCount = 0;
+
+	// Written again by Finish(), but an unfinished spool
+	// should still be recognizable
+	ssize_t written = ::pwrite(fWriteFD, &fHeader, sizeof(fHeader), 0);
+	if (written != (ssize_t)sizeof(fHeader)) {
+		status_t status = written < 0 ? errno : B_IO_ERROR;
+		Close();
+		return status;
+	}
+
+	fNextOffset = kSpoolDataOffset;
+	fMemoryBudget = memoryBudget;
+	return B_OK;
+}
+
+
+/* virtual */
+status_t
+FrameSpool::WriteFrame(const BBitmap* bitmap, bigtime_t frameTime)
+{
+	if (bitmap == NULL)
+		return B_BAD_VALUE;
+	if (bitmap->BytesPerRow() != fHeader.bytesPerRow
+		|| (uint32)bitmap->ColorSpace() != fHeader.colorSpace)
+		return B_MISMATCHED_VALUES;
+
+	return WriteRecord(frameTime, bitmap->Bits(), bitmap->BitsLength(), 0, -1, -1, 0,
+		B_ORIGIN, NULL);
+}
+
+
+/* virtual */
+bool
+FrameSpool::StoresRecords() const
+{
+	return true;
+}
+
+
+// Can be called from many threads at the same time:
+// every caller gets its own region of the file, so
+// the actual writes don't need to be serialized.
+// Records are numbered in the order they are written: for delta
+// records, reference is the number of the reference record,
+// as returned in _record.
+/* virtual */
+status_t
+FrameSpool::WriteRecord(bigtime_t frameTime, const void* data, size_t length,
+	uint32 flags, int32 reference, float changeRatio, uint64 hash,
+	BPoint origin, int32* _record)
+{
+	if (data == NULL || length != (uint32)length
+		|| ((flags & kFrameDeltaRecord) != 0 && reference < 0))
+		return B_BAD_VALUE;
+	if (fWriteFD < 0)
+		return B_NO_INIT;
+	// If the records still can't be moved to the file,
+	// there's no room for this one
+	if (atomic_get(&fSpillStatus) != B_OK) {
+		status_t status = _SpillRecords();
+		if (status != B_OK)
+			return status;
+	}
+
+	spool_record record;
+	record.entry.time = frameTime;
+	record.entry.offset = -1;
+	record.entry.length = length;
+	record.entry.flags = flags;
+	record.entry.reference = (flags & kFrameDeltaRecord) != 0 ? reference : -1;
+	record.entry.changeRatio = changeRatio;
+	record.entry.originX = (int16)origin.x;
+	record.entry.originY = (int16)origin.y;
+	record.entry.hash = hash;
+	record.data = NULL;
+
+	// New records stay in memory, unless they don't fit at all:
+	// older ones are moved to the file to make room.
+	// For unbuffered writes the copy is padded to whole blocks
+	if ((int64)length <= fMemoryBudget) {
+		if (fUnbufferedFD >= 0) {
+			const size_t padded = _AlignedLength(length);
+			void* buffer = NULL;
+			if (::posix_memalign(&buffer, kUnbufferedAlignment, padded) == 0) {
+				::memset((uint8*)buffer + length, 0, padded - length);
+				record.data = (uint8*)buffer;
+			}
+		} else
+			record.data = (uint8*)malloc(length);
+		if (record.data != NULL)
+			::memcpy(record.data, data, length);
+	}
+
+	if (record.data == NULL) {
+		fLocker.Lock();
+		record.entry.offset = _ReserveSpace(length);
+		fLocker.Unlock();
+
+		// Straight from the caller's buffer
+		ssize_t written = ::pwrite(fWriteFD, data, length, record.entry.offset);
+		if (written != (ssize_t)length)
+			return written < 0 ? errno : B_IO_ERROR;
+	}
+
+	fLocker.Lock();
+	const int32 number = fRecords.size();
+	try {
+		fRecords.push_back(record);
+	} catch (...) {
+		fLocker.Unlock();
+		free(record.data);
+		return B_NO_MEMORY;
+	}
+	if (record.data != NULL)
+		fMemoryUsed += length;
+	fLocker.Unlock();
+
+	if (_record != NULL)
+		*_record = number;
+
+	// The record is stored even if the older ones can't be
+	// moved to the file now
+	status_t status = _SpillRecords();
+	if (status != B_OK) {
+		std::cerr << "FrameSpool: cannot move the records to the file: "
+			<< ::strerror(status) << std::endl;
+	}
+	return B_OK;
+}
+
+
+// Must be called once all the writers are done.
+// Appends the index and updates the header. Afterwards
+// the spool can be read.
+/* virtual */
+status_t
+FrameSpool::Finish()
+{
+	BAutolock _(fLocker);
+	if (fWriteFD < 0)
+		return B_NO_INIT;
+
+	// Writers don't complete in order
+	std::vector<time_index> order;
+	std::vector<int32> sortedIndex;
+	std::vector<spool_record> sorted;
+	try {
+		order.reserve(fRecords.size());
+		sortedIndex.resize(fRecords.size());
+		sorted.reserve(fRecords.size());
+	} catch (...) {
+		return B_NO_MEMORY;
+	}
+	for (size_t i = 0; i < fRecords.size(); i++)
+		order.push_back(time_index(fRecords[i].entry.time, i));
+	std::sort(order.begin(), order.end());
+	for (size_t i = 0; i < order.size(); i++) {
+		sortedIndex[order[i].second] = i;
+		sorted.push_back(fRecords[order[i].second]);
+	}
+
+	// Delta records now refer to their reference by index
+	bool allInFile = true;
+	for (size_t i = 0; i < sorted.size(); i++) {
+		spool_index_entry& entry = sorted[i].entry;
+		if (entry.reference >= (int64)sortedIndex.size())
+			entry.reference = -1;
+		else if (entry.reference >= 0)
+			entry.reference = sortedIndex[entry.reference];
+		if (sorted[i].data != NULL)
+			allInFile = false;
+	}
+	fRecords.swap(sorted);
+
+	// The index is only useful to open the spool again later,
+	// which can't be done if some records are only in memory
+	status_t status = B_OK;
+	if (allInFile) {
+		std::vector<spool_index_entry> index;
+		try {
+			index.reserve(fRecords.size());
+		} catch (...) {
+			return B_NO_MEMORY;
+		}
+		for (size_t i = 0; i < fRecords.size(); i++)
+			index.push_back(fRecords[i].entry);
+
+		fHeader.indexOffset = fNextOffset;
+		fHeader.indexCount = index.size();
+
+		const size_t indexSize = index.size() * sizeof(spool_index_entry);
+		if (indexSize > 0) {
+			ssize_t written = ::pwrite(fWriteFD, &index[0], indexSize, fHeader.indexOffset);
+			if (written != (ssize_t)indexSize)
+				status = written < 0 ? errno : B_IO_ERROR;
+		}
+		if (status == B_OK) {
+			ssize_t written = ::pwrite(fWriteFD, &fHeader, sizeof(fHeader), 0);
+			if (written != (ssize_t)sizeof(fHeader))
+				status = written < 0 ? errno : B_IO_ERROR;
+		}
+		if (status != B_OK)
+			std::cerr << "FrameSpool::Finish(): cannot write index: " << ::strerror(status) << std::endl;
+	}
+
+	_CloseWriteFiles();
+
+	fFD = ::open(fPath.String(), O_RDONLY);
+	if (fFD < 0) {
+		std::cerr << "FrameSpool::Finish(): cannot open " << fPath.String() << std::endl;
+		return status == B_OK ? errno : status;
+	}
+	if (fNextOffset > kSpoolDataOffset)
+		_MapFile(fNextOffset);
+
+	return status;
+}
+
+
+// Must be called before Create(). Then the records moved from
+// memory to the file don't go through the file cache, if the file
+// system allows it: they're padded to whole blocks
+/* virtual */
+void
+FrameSpool::SetUnbufferedWrites(bool unbuffered)
+{
+	fUnbuffered = unbuffered;
+}
+
+
+/* virtual */
+int32
+FrameSpool::CountFramesInMemory() const
+{
+	BAutolock _(fLocker);
+	int32 count = 0;
+	for (size_t i = 0; i < fRecords.size(); i++) {
+		if (fRecords[i].data != NULL)
+			count++;
+	}
+	return count;
+}
+
+
+// Opens the spool of a previous session, in the given folder
+/* virtual */
+status_t
+FrameSpool::Open(const char* folder)
+{
+	if (folder == NULL)
+		return B_BAD_VALUE;
+
+	Close();
+
+	BString fileName;
+	fileName << folder << "/" << kSpoolFileName;
+	const char* path = fileName.String();
+	fFD = ::open(path, O_RDONLY);
+	if (fFD < 0)
+		return errno;
+
+	status_t status = B_OK;
+	struct stat st;
+	if (::fstat(fFD, &st) != 0)
+		status = errno;
+	else if (::pread(fFD, &fHeader, sizeof(fHeader), 0) != (ssize_t)sizeof(fHeader))
+		status = B_IO_ERROR;
+	else if (fHeader.magic != kSpoolMagic || fHeader.version != kSpoolVersion)
+		status = B_BAD_DATA;
+	else if (fHeader.indexOffset < kSpoolDataOffset || fHeader.indexCount < 0
+		|| fHeader.indexOffset + (int64)(fHeader.indexCount
+			* sizeof(spool_index_entry)) > st.st_size)
+		status = B_BAD_DATA;
+
+	if (status == B_OK) {
+		const size_t indexSize = fHeader.indexCount * sizeof(spool_index_entry);
+		std::vector<spool_index_entry> index;
+		try {
+			index.resize(fHeader.indexCount);
+			fRecords.resize(fHeader.indexCount);
+		} catch (...) {
+			status = B_NO_MEMORY;
+		}
+		if (status == B_OK && indexSize > 0
+			&& ::pread(fFD, &index[0], indexSize, fHeader.indexOffset) != (ssize_t)indexSize)
+			status = B_IO_ERROR;
+		for (int32 i = 0; status == B_OK && i < fHeader.indexCount; i++) {
+			fRecords[i].entry = index[i];
+			fRecords[i].data = NULL;
+		}
+	}
+
+	for (int32 i = 0; status == B_OK && i < fHeader.indexCount; i++) {
+		const spool_index_entry& entry = fRecords[i].entry;
+		if (entry.offset < kSpoolDataOffset
+			|| entry.offset + (int64)entry.length > fHeader.indexOffset
+			|| ((entry.flags & kFrameDeltaRecord) != 0
+				&& (entry.reference < 0 || entry.reference >= fHeader.indexCount
+					|| entry.reference == i)))
+			status = B_BAD_DATA;
+	}
+
+	if (status != B_OK) {
+		std::cerr << "FrameSpool::Open(): cannot read " << path << ": " << ::strerror(status) << std::endl;
+		Close();
+		return status;
+	}
+
+	fPath = path;
+	_MapFile(fHeader.indexOffset);
+
+	return B_OK;
+}
+
+
+void
+FrameSpool::Close()
+{
+	BAutolock _(fLocker);
+	_FlushCache();
+	if (fMappedData != NULL) {
+		::munmap(fMappedData, fMappedSize);
+		fMappedData = NULL;
+		fMappedSize = 0;
+	}
+	if (fFD >= 0) {
+		::close(fFD);
+		fFD = -1;
+	}
+	_CloseWriteFiles();
+	for (size_t i = 0; i < fRecords.size(); i++)
+		free(fRecords[i].data);
+	fRecords.clear();
+	fNextOffset = 0;
+	fMemoryBudget = 0;
+	fMemoryUsed = 0;
+	fNextSpill = 0;
+	fSpillStatus = B_OK;
+	fFirstFrame = 0;
+	fEndFrame = -1;
+	::memset(&fHeader, 0, sizeof(fHeader));
+}
+
+
+// Used to decompress the frames in parallel
+/* virtual */
+void
+FrameSpool::SetWorkerPool(WorkerPool* pool)
+{
+	fWorkerPool = pool;
+}
+
+
+/* virtual */
+const char*
+FrameSpool::Path() const
+{
+	return fPath.String();
+}
+
+
+/* virtual */
+BRect
+FrameSpool::Bounds() const
+{
+	return BRect(fHeader.left, fHeader.top, fHeader.right, fHeader.bottom);
+}
+
+
+/* virtual */
+color_space
+FrameSpool::ColorSpace() const
+{
+	return (color_space)fHeader.colorSpace;
+}
+
+
+/* virtual */
+int32
+FrameSpool::BytesPerRow() const
+{
+	return fHeader.bytesPerRow;
+}
+
+
+/* virtual */
+int32
+FrameSpool::CountFrames() const
+{
+	const int32 end = fEndFrame >= 0 ? fEndFrame : (int32)fRecords.size();
+	return end - fFirstFrame;
+}
+
+
+/* virtual */
+bigtime_t
+FrameSpool::FrameTime(int32 index) const
+{
+	if (index < 0 || index >= CountFrames())
+		return -1;
+	return fRecords[fFirstFrame + index].entry.time;
+}
+
+
+bool
+FrameSpool::IsDeltaFrame(int32 index) const
+{
+	if (index < 0 || index >= CountFrames())
+		return false;
+	return (fRecords[fFirstFrame + index].entry.flags & kFrameDeltaRecord) != 0;
+}
+
+
+/* virtual */
+float
+FrameSpool::ChangeRatio(int32 index) const
+{
+	if (index < 0 || index >= CountFrames())
+		return -1;
+	return fRecords[fFirstFrame + index].entry.changeRatio;
+}
+
+
+/* virtual */
+uint64
+FrameSpool::FrameHash(int32 index) const
+{
+	if (index < 0 || index >= CountFrames())
+		return 0;
+	return fRecords[fFirstFrame + index].entry.hash;
+}
+
+
+/* virtual */
+BPoint
+FrameSpool::AreaOrigin(int32 index) const
+{
+	if (index < 0 || index >= CountFrames())
+		return B_ORIGIN;
+	const spool_index_entry& entry = fRecords[fFirstFrame + index].entry;
+	return BPoint(entry.originX, entry.originY);
+}
+
+
+// Frames are only compared by their hash, which can be shared
+// by different contents, though it's not likely
+/* virtual */
+bool
+FrameSpool::SameAsPrevious(int32 index) const
+{
+	if (index <= 0 || index >= CountFrames())
+		return false;
+	const int32 record = fFirstFrame + index;
+	const uint64 hash = fRecords[record].entry.hash;
+	return hash != 0 && hash == fRecords[record - 1].entry.hash;
+}
+
+
+// Returns a pointer to the frame data, either in memory or
+// mapped, or NULL if the file couldn't be mapped
+const void*
+FrameSpool::FrameData(int32 index, size_t* length) const
+{
+	if (index < 0 || index >= CountFrames())
+		return NULL;
+	return _RecordData(fFirstFrame + index, length);
+}
+
+
+// Reads the frame into an existing bitmap, which must have the
+// same size and layout as the frames. Delta frames are rebuilt
+// from the previous ones
+/* virtual */
+status_t
+FrameSpool::ReadBitmap(int32 index, BBitmap* bitmap) const
+{
+	if (bitmap == NULL || index < 0 || index >= CountFrames())
+		return B_BAD_VALUE;
+	if (bitmap->ColorSpace() != ColorSpace()
+		|| bitmap->BytesPerRow() != BytesPerRow()
+		|| bitmap->BitsLength() != BytesPerRow() * (Bounds().IntegerHeight() + 1))
+		return B_MISMATCHED_VALUES;
+
+	const int32 record = fFirstFrame + index;
+	if (IsDeltaFrame(index)) {
+		BAutolock _(fCacheLocker);
+		return _Reconstruct(record, bitmap);
+	}
+	return _ReadFrame(record, bitmap->Bits(), bitmap->BitsLength());
+}
+
+
+// Only changes which records are seen as frames: the file and
+// its index are left as they are
+/* virtual */
+status_t
+FrameSpool::Trim(int32 first, int32 count)
+{
+	if (fWriteFD >= 0)
+		return B_NOT_ALLOWED;
+	if (first < 0 || count < 0 || first + count > CountFrames())
+		return B_BAD_VALUE;
+
+	fEndFrame = fFirstFrame + first + count;
+	fFirstFrame += first;
+	return B_OK;
+}
+
+
+/* virtual */
+void
+FrameSpool::Release()
+{
+	Close();
+	if (fPath != "")
+		::unlink(fPath.String());
+	fPath = "";
+}
+
+
+// Must be called with the lock held
+int64
+FrameSpool::_ReserveSpace(size_t length)
+{
+	const int64 offset = fNextOffset;
+	fNextOffset += _AlignedLength(length);
+	return offset;
+}
+
+
+size_t
+FrameSpool::_AlignedLength(size_t length) const
+{
+	return (length + fAlignment - 1) & ~(fAlignment - 1);
+}
+
+
+void
+FrameSpool::_CloseWriteFiles()
+{
+	if (fUnbufferedFD >= 0) {
+		::close(fUnbufferedFD);
+		fUnbufferedFD = -1;
+	}
+	if (fWriteFD >= 0) {
+		::close(fWriteFD);
+		fWriteFD = -1;
+	}
+	fAlignment = kSpoolRecordAlignment;
+}
+
+
+status_t
+FrameSpool::_SpillRecords()
+{
+	bool spilled = false;
+	status_t status;
+	while ((status = _SpillOldest(&spilled)) == B_OK && spilled)
+		;
+	atomic_set(&fSpillStatus, status);
+	return status;
+}
+
+
+// Moves the oldest records in memory to the file, with a single
+// write, until the memory used is below the low water mark
+status_t
+FrameSpool::_SpillOldest(bool* _spilled)
+{
+	*_spilled = false;
+
+	struct iovec vectors[kMaxSpillRecords * 2];
+	size_t numbers[kMaxSpillRecords];
+	int32 vectorCount = 0;
+	int32 count = 0;
+	int64 offset = -1;
+	int64 end = -1;
+
+	fLocker.Lock();
+	if (fMemoryUsed <= fMemoryBudget) {
+		fLocker.Unlock();
+		return B_OK;
+	}
+	const int64 lowWater = fMemoryBudget - fMemoryBudget / kSpillHysteresis;
+	while (count < kMaxSpillRecords && fMemoryUsed > lowWater) {
+		while (fNextSpill < fRecords.size()
+			&& (fRecords[fNextSpill].data == NULL || fRecords[fNextSpill].entry.offset >= 0))
+			fNextSpill++;
+		if (fNextSpill >= fRecords.size())
+			break;
+		const size_t number = fNextSpill++;
+		spool_record& record = fRecords[number];
+		// The space is reserved while holding the lock, so the
+		// records are next to each other, up to the alignment
+		const int64 recordOffset = _ReserveSpace(record.entry.length);
+		if (offset < 0)
+			offset = recordOffset;
+		else if (recordOffset > end) {
+			vectors[vectorCount].iov_base = (void*)kZeroPadding;
+			vectors[vectorCount].iov_len = recordOffset - end;
+			vectorCount++;
+		}
+		// Unbuffered writes take the padded copy as a whole
+		const size_t writeLength = fUnbufferedFD >= 0
+			? _AlignedLength(record.entry.length) : record.entry.length;
+		vectors[vectorCount].iov_base = record.data;
+		vectors[vectorCount].iov_len = writeLength;
+		vectorCount++;
+		end = recordOffset + writeLength;
+		record.entry.offset = recordOffset;
+		fMemoryUsed -= record.entry.length;
+		numbers[count++] = number;
+	}
+	const int64 reservedEnd = fNextOffset;
+	fLocker.Unlock();
+
+	if (count == 0)
+		return B_OK;
+
+	// The data stays in memory until it's written,
+	// so the records can still be read meanwhile
+	const int fd = fUnbufferedFD >= 0 ? fUnbufferedFD : fWriteFD;
+	ssize_t written = ::writev_pos(fd, offset, vectors, vectorCount);
+	const status_t status = written < 0 ? errno : B_IO_ERROR;
+
+	BAutolock _(fLocker);
+	if (written != (ssize_t)(end - offset)) {
+		// The records are tried again later, and their space
+		// given back if nobody took more meanwhile
+		for (int32 i = 0; i < count; i++) {
+			fRecords[numbers[i]].entry.offset = -1;
+			fMemoryUsed += fRecords[numbers[i]].entry.length;
+		}
+		fNextSpill = std::min(fNextSpill, numbers[0]);
+		if (fNextOffset == reservedEnd)
+			fNextOffset = offset;
+		return status;
+	}
+	for (int32 i = 0; i < count; i++) {
+		free(fRecords[numbers[i]].data);
+		fRecords[numbers[i]].data = NULL;
+	}
+	*_spilled = true;
+	return B_OK;
+}
+
+
+status_t
+FrameSpool::_MapFile(int64 size)
+{
+	// If the file doesn't fit in the address space, fall back to
+	// plain reads. Only the frame data needs to be mapped.
+	void* data = ::mmap(NULL, size, PROT_READ, MAP_SHARED, fFD, 0);
+	if (data == MAP_FAILED) {
+		std::cerr << "FrameSpool: cannot map file, using reads" << std::endl;
+		return errno;
+	}
+	fMappedData = (uint8*)data;
+	fMappedSize = size;
+	return B_OK;
+}
+
+
+// Like FrameData(), but takes the number of the record,
+// which can be before the frames left by Trim()
+const void*
+FrameSpool::_RecordData(int32 record, size_t* length) const
+{
+	const spool_record& entry = fRecords[record];
+	const uint8* data = entry.data;
+	if (data == NULL) {
+		if (fMappedData == NULL || entry.entry.offset < 0
+			|| entry.entry.offset + (int64)entry.entry.length > (int64)fMappedSize)
+			return NULL;
+		data = fMappedData + entry.entry.offset;
+	}
+	if (length != NULL)
+		*length = entry.entry.length;
+	return data;
+}
+
+
+// Returns the record as it's stored: either in memory, mapped,
+// or read into a buffer which the caller must free()
+status_t
+FrameSpool::_LoadRecord(int32 index, const void** data, void** allocated) const
+{
+	*allocated = NULL;
+	*data = _RecordData(index, NULL);
+	if (*data != NULL)
+		return B_OK;
+
+	const spool_index_entry& entry = fRecords[index].entry;
+	void* buffer = malloc(entry.length);
+	if (buffer == NULL)
+		return B_NO_MEMORY;
+	if (::pread(fFD, buffer, entry.length, entry.offset) != (ssize_t)entry.length) {
+		free(buffer);
+		return B_IO_ERROR;
+	}
+	*data = *allocated = buffer;
+	return B_OK;
+}
+
+
+status_t
+FrameSpool::_ReadFrame(int32 index, void* buffer, size_t length) const
+{
+	const spool_index_entry& entry = fRecords[index].entry;
+	const bool compressed = (entry.flags & kFrameCompressedRecord) != 0;
+	if (!compressed && entry.length != length)
+		return B_MISMATCHED_VALUES;
+
+	const void* data = _RecordData(index, NULL);
+	if (data == NULL && !compressed) {
+		// Read straight into the buffer
+		if (::pread(fFD, buffer, length, entry.offset) != (ssize_t)length)
+			return B_IO_ERROR;
+		return B_OK;
+	}
+
+	void* allocated = NULL;
+	status_t status = _LoadRecord(index, &data, &allocated);
+	if (status != B_OK)
+		return status;
+	if (compressed) {
+		status = FrameCompressor::Decompress(fWorkerPool, data, entry.length,
+			buffer, length);
+	} else
+		::memcpy(buffer, data, length);
+	free(allocated);
+	return status;
+}
+
+
+status_t
+FrameSpool::_ApplyDelta(int32 index, BBitmap* bitmap) const
+{
+	const spool_index_entry& entry = fRecords[index].entry;
+	const void* data = NULL;
+	void* allocated = NULL;
+	status_t status = _LoadRecord(index, &data, &allocated);
+	if (status != B_OK)
+		return status;
+
+	if ((entry.flags & kFrameCompressedRecord) != 0) {
+		const size_t length = FrameCompressor::UncompressedLength(data, entry.length);
+		void* delta = length > 0 ? malloc(length) : NULL;
+		if (delta == NULL)
+			status = length > 0 ? B_NO_MEMORY : B_BAD_DATA;
+		else {
+			status = FrameCompressor::Decompress(fWorkerPool, data, entry.length,
+				delta, length);
+			if (status == B_OK)
+				status = ApplyTileDelta(delta, length, bitmap);
+			free(delta);
+		}
+	} else
+		status = ApplyTileDelta(data, entry.length, bitmap);
+
+	free(allocated);
+	return status;
+}
+
+
+// Must be called with the cache locked
+status_t
+FrameSpool::_Reconstruct(int32 index, BBitmap* bitmap) const
+{
+	// Walk back until a frame which is either cached or complete
+	std::vector<int32> chain;
+	int32 current = index;
+	const BBitmap* base = NULL;
+	const int32 recordCount = fRecords.size();
+	while ((base = _CachedFrame(current)) == NULL
+		&& (fRecords[current].entry.flags & kFrameDeltaRecord) != 0) {
+		if ((int32)chain.size() >= recordCount)
+			return B_BAD_DATA;
+		try {
+			chain.push_back(current);
+		} catch (...) {
+			return B_NO_MEMORY;
+		}
+		current = fRecords[current].entry.reference;
+		if (current < 0 || current >= recordCount)
+			return B_BAD_DATA;
+	}
+
+	if (chain.empty() && base != NULL) {
+		::memcpy(bitmap->Bits(), base->Bits(), bitmap->BitsLength());
+		return B_OK;
+	}
+
+	BBitmap* work = _CacheSlot(index, base);
+	if (work == NULL)
+		return B_NO_MEMORY;
+
+	status_t status = B_OK;
+	if (base != NULL)
+		::memcpy(work->Bits(), base->Bits(), work->BitsLength());
+	else
+		status = _ReadFrame(current, work->Bits(), work->BitsLength());
+
+	// Deltas only contain the tiles which changed, so
+	// they can be applied one after the other on the same bitmap
+	for (int32 i = chain.size() - 1; status == B_OK && i >= 0; i--) {
+		if ((fRecords[chain[i]].entry.flags & kFrameUnchangedRecord) == 0)
+			status = _ApplyDelta(chain[i], work);
+	}
+
+	if (status != B_OK) {
+		for (int32 i = 0; i < kDecodeCacheSize; i++) {
+			if (fCache[i].bitmap == work)
+				fCache[i].index = -1;
+		}
+		return status;
+	}
+
+	::memcpy(bitmap->Bits(), work->Bits(), bitmap->BitsLength());
+	return B_OK;
+}
+
+
+BBitmap*
+FrameSpool::_CachedFrame(int32 index) const
+{
+	for (int32 i = 0; i < kDecodeCacheSize; i++) {
+		if (fCache[i].index == index && fCache[i].bitmap != NULL) {
+			fCache[i].lastUse = ++fCacheUse;
+			return fCache[i].bitmap;
+		}
+	}
+	return NULL;
+}
+
+
+// Returns the least recently used cache bitmap, other than keep,
+// and assigns it to the given frame
+BBitmap*
+FrameSpool::_CacheSlot(int32 index, const BBitmap* keep) const
+{
+	cached_frame* slot = NULL;
+	for (int32 i = 0; i < kDecodeCacheSize; i++) {
+		if (fCache[i].bitmap != NULL && fCache[i].bitmap == keep)
+			continue;
+		if (slot == NULL || fCache[i].lastUse < slot->lastUse)
+			slot = &fCache[i];
+	}
+
+	if (slot->bitmap == NULL) {
+		slot->bitmap = FrameAllocator::Allocate(kFrameStageSpool, Bounds(),
+			ColorSpace(), BytesPerRow());
+		if (slot->bitmap == NULL)
+			return NULL;
+	}
+	slot->index = index;
+	slot->lastUse = ++fCacheUse;
+	return slot->bitmap;
+}
+
+
+void
+FrameSpool::_FlushCache() const
+{
+	BAutolock _(fCacheLocker);
+	for (int32 i = 0; i < kDecodeCacheSize; i++) {
+		FrameAllocator::Free(fCache[i].bitmap);
+		fCache[i].bitmap = NULL;
+		fCache[i].index = -1;
+		fCache[i].lastUse = 0;
+	}
+	fCacheUse = 0;
+}
@@ -0,0 +1,182 @@
+/*
+ * Copyright 2026 Stefano Ceccherini <stefano.ceccherini@gmail.com>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+#ifndef __FRAMESPOOL_H
+#define __FRAMESPOOL_H
+
+#include "FrameStore.h"
+
+#include <GraphicsDefs.h>
+#include <Locker.h>
+#include <Rect.h>
+#include <String.h>
+
+#include <vector>
+
+const static uint32 kSpoolMagic = 'BSCS';
+const static uint32 kSpoolVersion = 4;
+const static char* const kSpoolFileName = "frames.spool";
+
+// On disk layout:
+// spool_header, padded to kSpoolDataOffset
+// frame data, every record aligned to kSpoolRecordAlignment
+// spool_index_entry array (indexCount entries), starting at indexOffset.
+// The index is written when the spool is finished, sorted
+// by timestamp, if all the records were moved to the file.
+// Records are either full frames or tile deltas (see TileDelta.h)
+// against a reference record, optionally compressed.
+// The record flags are the frame_record_flags of FrameStore.h
+struct spool_header {
+	uint32 magic;
+	uint32 version;
+	float left;
+	float top;
+	float right;
+	float bottom;
+	uint32 colorSpace;
+	int32 bytesPerRow;
+	int64 indexOffset;
+	int32 indexCount;
+	uint32 reserved;
+};
+
+struct spool_index_entry {
+	bigtime_t time;
+	int64 offset;
+	uint32 length;
+	uint32 flags;
+	// Index of the reference record for delta records, -1 otherwise.
+	// While writing, this is the order in which the reference
+	// record was written
+	int64 reference;
+	// The share of the frame which changed since the previous
+	// frame stored by the same writer, negative if not known
+	float changeRatio;
+	// Where the captured area was on the screen, when it
+	// follows a window or the pointer
+	int16 originX;
+	int16 originY;
+	// Of the whole frame, 0 if not known
+	uint64 hash;
+};
+
+class BBitmap;
+class WorkerPool;
+// Stores all the frames of a capture session as raw bitmap data
+// in a single append-only file.
+// Records are kept in memory until the memory budget is used,
+// then the oldest ones are moved to the file to make room, several
+// at a time, with one vectored write.
+// Writing is thread safe: many writers can append at the same time.
+// Reading is done through a read-only memory mapping of the file.
+// A finished spool can be read without opening it again.
+class FrameSpool : public FrameStore {
+public:
+	FrameSpool();
+	virtual ~FrameSpool();
+
+	// Writing
+	virtual status_t Create(const char* path, const BRect& bounds,
+				color_space colorSpace, int32 bytesPerRow,
+				int64 memoryBudget = 0);
+	virtual status_t WriteFrame(const BBitmap* bitmap, bigtime_t frameTime);
+	virtual bool StoresRecords() const;
+	virtual status_t WriteRecord(bigtime_t frameTime, const void* data,
+				size_t length, uint32 flags, int32 reference,
+				float changeRatio, uint64 hash, BPoint origin,
+				int32* _record);
+	virtual status_t Finish();
+
+	virtual void SetUnbufferedWrites(bool unbuffered);
+	virtual int32 CountFramesInMemory() const;
+
+	// Reading
+	virtual status_t Open(const char* path);
+	virtual void SetWorkerPool(WorkerPool* pool);
+
+	void Close();
+
+	virtual const char* Path() const;
+	virtual BRect Bounds() const;
+	virtual color_space ColorSpace() const;
+	virtual int32 BytesPerRow() const;
+
+	virtual int32 CountFrames() const;
+	virtual bigtime_t FrameTime(int32 index) const;
+	bool IsDeltaFrame(int32 index) const;
+	virtual float ChangeRatio(int32 index) const;
+	virtual uint64 FrameHash(int32 index) const;
+	virtual BPoint AreaOrigin(int32 index) const;
+	// Compares the frame with the one before it
+	virtual bool SameAsPrevious(int32 index) const;
+	const void* FrameData(int32 index, size_t* length) const;
+	virtual status_t ReadBitmap(int32 index, BBitmap* bitmap) const;
+
+	virtual status_t Trim(int32 first, int32 count);
+	virtual void Release();
+
+private:
+	struct spool_record {
+		spool_index_entry entry;
+		// The record data, while it's kept in memory.
+		// The offset is -1 until the record is in the file
+		uint8* data;
+	};
+
+	int64 _ReserveSpace(size_t length);
+	size_t _AlignedLength(size_t length) const;
+	void _CloseWriteFiles();
+	status_t _SpillRecords();
+	status_t _SpillOldest(bool* _spilled);
+	status_t _MapFile(int64 size);
+	const void* _RecordData(int32 record, size_t* length) const;
+	status_t _LoadRecord(int32 index, const void** data,
+				void** allocated) const;
+	status_t _ReadFrame(int32 index, void* buffer, size_t length) const;
+	status_t _ApplyDelta(int32 index, BBitmap* bitmap) const;
+	status_t _Reconstruct(int32 index, BBitmap* bitmap) const;
+	BBitmap* _CachedFrame(int32 index) const;
+	BBitmap* _CacheSlot(int32 index, const BBitmap* keep) const;
+	void _FlushCache() const;
+
+	BString fPath;
+	spool_header fHeader;
+	std::vector<spool_record> fRecords;
+	int64 fNextOffset;
+	int64 fMemoryBudget;
+	int64 fMemoryUsed;
+	size_t fNextSpill;
+	// Of the last spill: the records which couldn't be
+	// moved are tried again by the next write
+	int32 fSpillStatus;
+	int fWriteFD;
+	// Only used to move records from memory to the file
+	int fUnbufferedFD;
+	bool fUnbuffered;
+	int64 fAlignment;
+	// The records of the frames left by Trim(). The ones before
+	// are still needed to rebuild the delta frames
+	int32 fFirstFrame;
+	int32 fEndFrame;
+	mutable BLocker fLocker;
+
+	int fFD;
+	uint8* fMappedData;
+	size_t fMappedSize;
+	WorkerPool* fWorkerPool;
+
+	// Rebuilt frames, so reading in order applies a single delta
+	// for every frame
+	struct cached_frame {
+		BBitmap* bitmap;
+		int32 index;
+		uint32 lastUse;
+	};
+	enum { kDecodeCacheSize = 4 };
+	mutable cached_frame fCache[kDecodeCacheSize];
+	mutable uint32 fCacheUse;
+	mutable BLocker fCacheLocker;
+};
+
+#endif // __FRAMESPOOL_H
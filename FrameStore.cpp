@@ -0,0 +1,154 @@
+/*
+ * Copyright 2026 Stefano Ceccherini <stefano.ceccherini@gmail.com>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+#include "FrameStore.h"
+
+#include "BMPFrameStore.h"
+#include "FrameAllocator.h"
+#include "FrameSpool.h"
+
+#include <Bitmap.h>
+
+#include <cstring>
+#include <iostream>
+#include <new>
+
+
+FrameStore::FrameStore()
+{
+}
+
+
+/* virtual */
+FrameStore::~FrameStore()
+{
+}
+
+
+/* static */
+FrameStore*
+FrameStore::CreateStore(int32 type)
+{
+	switch (type) {
+		case kBMPFrameStore:
+			return new (std::nothrow) BMPFrameStore;
+		case kSpoolFrameStore:
+		default:
+			return new (std::nothrow) FrameSpool;
+	}
+}
+
+
+/* virtual */
+bool
+FrameStore::StoresRecords() const
+{
+	return false;
+}
+
+
+/* virtual */
+status_t
+FrameStore::WriteRecord(bigtime_t frameTime, const void* data, size_t length,
+	uint32 flags, int32 reference, float changeRatio, uint64 hash,
+	BPoint origin, int32* _record)
+{
+	return B_NOT_SUPPORTED;
+}
+
+
+/* virtual */
+void
+FrameStore::SetUnbufferedWrites(bool unbuffered)
+{
+}
+
+
+/* virtual */
+int32
+FrameStore::CountFramesInMemory() const
+{
+	return 0;
+}
+
+
+/* virtual */
+void
+FrameStore::SetWorkerPool(WorkerPool* pool)
+{
+}
+
+
+/* virtual */
+float
+FrameStore::ChangeRatio(int32 index) const
+{
+	return -1;
+}
+
+
+/* virtual */
+uint64
+FrameStore::FrameHash(int32 index) const
+{
+	return 0;
+}
+
+
+/* virtual */
+BPoint
+FrameStore::AreaOrigin(int32 index) const
+{
+	return B_ORIGIN;
+}
+
+
+/* virtual */
+bool
+FrameStore::SameAsPrevious(int32 index) const
+{
+	return false;
+}
+
+
+/* virtual */
+BBitmap*
+FrameStore::CreateBitmap(int32 index) const
+{
+	if (index < 0 || index >= CountFrames())
+		return NULL;
+
+	BBitmap* bitmap = FrameAllocator::Allocate(kFrameStageRead, Bounds(),
+		ColorSpace(), BytesPerRow());
+	if (bitmap == NULL)
+		return NULL;
+
+	status_t status = ReadBitmap(index, bitmap);
+	if (status != B_OK) {
+		std::cerr << "FrameStore::CreateBitmap(): cannot read frame " << index;
+		std::cerr << ": " << ::strerror(status) << std::endl;
+		FrameAllocator::Free(bitmap);
+		return NULL;
+	}
+	return bitmap;
+}
+
+
+status_t
+FrameStore::GetNextFrame(int32* cookie, BBitmap* bitmap,
+	bigtime_t* _frameTime) const
+{
+	if (cookie == NULL || *cookie < 0)
+		return B_BAD_VALUE;
+	if (*cookie >= CountFrames())
+		return B_ENTRY_NOT_FOUND;
+
+	status_t status = ReadBitmap(*cookie, bitmap);
+	if (status != B_OK)
+		return status;
+	if (_frameTime != NULL)
+		*_frameTime = FrameTime(*cookie);
+	(*cookie)++;
+	return B_OK;
+}
@@ -0,0 +1,107 @@
+/*
+ * Copyright 2026 Stefano Ceccherini <stefano.ceccherini@gmail.com>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+#ifndef __FRAMESTORE_H
+#define __FRAMESTORE_H
+
+#include <GraphicsDefs.h>
+#include <Rect.h>
+#include <SupportDefs.h>
+
+enum frame_store_type {
+	// All the frames in one file, as tile deltas (see FrameSpool.h)
+	kSpoolFrameStore = 0,
+	// One BMP file per frame
+	kBMPFrameStore = 1
+};
+
+enum frame_record_flags {
+	kFrameDeltaRecord = 0x1,
+	// Compressed records are stored as described in FrameCompressor.h
+	kFrameCompressedRecord = 0x2,
+	// Delta records without any changed tile: the frame is
+	// the same as the reference one
+	kFrameUnchangedRecord = 0x4
+};
+
+class BBitmap;
+class WorkerPool;
+// Where the frames of a capture session are kept, between
+// the capture and the encoder.
+// A store is created, written to by the capture (from many threads
+// at the same time), finished, and then read by the encoder:
+// frames are read by index, in any order, into the caller's bitmap.
+// Release() removes whatever the store left on disk.
+class FrameStore {
+public:
+	FrameStore();
+	virtual ~FrameStore();
+
+	static FrameStore* CreateStore(int32 type);
+
+	// Writing.
+	// The path is the folder of the session: every store puts
+	// its own files in it. Stores which keep frames in memory
+	// use up to memoryBudget bytes for them
+	virtual status_t Create(const char* path, const BRect& bounds,
+				color_space colorSpace, int32 bytesPerRow,
+				int64 memoryBudget = 0) = 0;
+	// Thread safe
+	virtual status_t WriteFrame(const BBitmap* bitmap,
+				bigtime_t frameTime) = 0;
+	// Stores which can keep tile deltas (see TileDelta.h) take
+	// encoded records, numbered in the order they're written.
+	// The others only take whole frames with WriteFrame()
+	virtual bool StoresRecords() const;
+	virtual status_t WriteRecord(bigtime_t frameTime, const void* data,
+				size_t length, uint32 flags, int32 reference,
+				float changeRatio, uint64 hash, BPoint origin,
+				int32* _record);
+	// Must be called once all the writers are done
+	virtual status_t Finish() = 0;
+	// Lets the store write around the file cache, where it can.
+	// Must be called before Create()
+	virtual void SetUnbufferedWrites(bool unbuffered);
+	virtual int32 CountFramesInMemory() const;
+
+	// Reading
+	virtual status_t Open(const char* path) = 0;
+	// Used to decode the frames in parallel
+	virtual void SetWorkerPool(WorkerPool* pool);
+
+	virtual const char* Path() const = 0;
+	virtual BRect Bounds() const = 0;
+	virtual color_space ColorSpace() const = 0;
+	virtual int32 BytesPerRow() const = 0;
+
+	virtual int32 CountFrames() const = 0;
+	virtual bigtime_t FrameTime(int32 index) const = 0;
+	// Negative when not known
+	virtual float ChangeRatio(int32 index) const;
+	// Of the frame contents, 0 when not known
+	virtual uint64 FrameHash(int32 index) const;
+	// Where the captured area was on the screen
+	virtual BPoint AreaOrigin(int32 index) const;
+	virtual bool SameAsPrevious(int32 index) const;
+	// Reads the frame into a bitmap with the same size and layout
+	// as the frames
+	virtual status_t ReadBitmap(int32 index, BBitmap* bitmap) const = 0;
+	// Returns a new bitmap, which the caller owns
+	virtual BBitmap* CreateBitmap(int32 index) const;
+	// Reads the frames in order. The cookie must be 0 at the start
+	status_t GetNextFrame(int32* cookie, BBitmap* bitmap,
+				bigtime_t* _frameTime) const;
+
+	// Only keeps count frames, starting at first. Indexes
+	// then start from the first one kept
+	virtual status_t Trim(int32 first, int32 count) = 0;
+	// Frees the frames and removes the files of the store
+	virtual void Release() = 0;
+
+private:
+	FrameStore(const FrameStore&) = delete;
+	FrameStore& operator=(const FrameStore&) = delete;
+};
+
+#endif // __FRAMESTORE_H
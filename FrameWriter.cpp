@@ -0,0 +1,301 @@
+/*
+ * Copyright 2026 Stefano Ceccherini <stefano.ceccherini@gmail.com>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+#include "FrameWriter.h"
+
+#include "FrameAllocator.h"
+#include "FrameCompressor.h"
+#include "FramePool.h"
+#include "FrameQueue.h"
+#include "FrameScaler.h"
+#include "FrameStore.h"
+#include "PipelineStats.h"
+#include "TileDelta.h"
+#include "TraceRecorder.h"
+
+#include <Bitmap.h>
+
+#include <cstring>
+#include <iostream>
+#include <new>
+
+
+FrameWriter::FrameWriter(FramePool* pool, FrameStore* store, int32 queueSize,
+	WorkerPool* compressionPool)
+	:
+	fPool(pool),
+	fStore(store),
+	fQueue(NULL),
+	fEncoder(NULL),
+	fCompressor(NULL),
+	fStats(NULL),
+	fScaler(NULL),
+	fScaled(NULL),
+	fReferenceRecord(-1),
+	fThread(-1),
+	fStatus(B_OK),
+	fFramesWritten(0),
+	fBytesWritten(0),
+	fCompress(1)
+{
+	fQueue = new (std::nothrow) FrameQueue(queueSize);
+	// Stores which only take whole frames don't need an encoder
+	if (fStore != NULL && fStore->StoresRecords()) {
+		fEncoder = new (std::nothrow) TileDeltaEncoder();
+		if (compressionPool != NULL)
+			fCompressor = new (std::nothrow) FrameCompressor(compressionPool);
+	}
+}
+
+
+FrameWriter::~FrameWriter()
+{
+	Stop();
+	delete fQueue;
+	delete fEncoder;
+	delete fCompressor;
+	delete fScaler;
+	FrameAllocator::Free(fScaled);
+}
+
+
+status_t
+FrameWriter::InitCheck() const
+{
+	if (fPool == NULL || fStore == NULL)
+		return B_BAD_VALUE;
+	if (fQueue == NULL || (fStore->StoresRecords() && fEncoder == NULL))
+		return B_NO_MEMORY;
+	return fQueue->InitCheck();
+}
+
+
+status_t
+FrameWriter::Start(const char* name, int32 priority)
+{
+	status_t status = InitCheck();
+	if (status != B_OK)
+		return status;
+
+	fThread = spawn_thread((thread_entry)_WriterStarter, name, priority, this);
+	if (fThread < 0)
+		return fThread;
+
+	status = resume_thread(fThread);
+	if (status != B_OK) {
+		kill_thread(fThread);
+		fThread = -1;
+	}
+	return status;
+}
+
+
+void
+FrameWriter::SetStats(StageStats* stats)
+{
+	fStats = stats;
+}
+
+
+status_t
+FrameWriter::SetScale(const BRect& frame, int32 bytesPerRow, WorkerPool* pool)
+{
+	const color_space colorSpace = fPool->ColorSpace();
+	if (!FrameScaler::CanScale(colorSpace, colorSpace))
+		return B_NOT_SUPPORTED;
+
+	delete fScaler;
+	FrameAllocator::Free(fScaled);
+	fScaler = new (std::nothrow) FrameScaler(FrameScaler::kKernelBilinear);
+	fScaled = FrameAllocator::Allocate(kFrameStageWrite,
+		frame.OffsetToCopy(B_ORIGIN), colorSpace, bytesPerRow);
+	if (fScaler == NULL || fScaled == NULL) {
+		delete fScaler;
+		fScaler = NULL;
+		FrameAllocator::Free(fScaled);
+		fScaled = NULL;
+		return B_NO_MEMORY;
+	}
+	fScaler->SetWorkerPool(pool);
+	return B_OK;
+}
+
+
+// Waits until all the queued frames are written
+status_t
+FrameWriter::Stop()
+{
+	if (fThread < 0)
+		return Status();
+
+	fQueue->Close();
+	status_t unused;
+	wait_for_thread(fThread, &unused);
+	fThread = -1;
+
+	return Status();
+}
+
+
+// Called by the capture thread. On success, the bitmap is owned
+// by the writer until it's given back to the pool
+bool
+FrameWriter::Enqueue(BBitmap* bitmap, bigtime_t frameTime, int32 number,
+	BPoint origin)
+{
+	return fQueue->Push(bitmap, frameTime, number, origin);
+}
+
+
+status_t
+FrameWriter::Status() const
+{
+	return atomic_get(const_cast<int32*>(&fStatus));
+}
+
+
+int32
+FrameWriter::FramesWritten() const
+{
+	return atomic_get(const_cast<int32*>(&fFramesWritten));
+}
+
+
+int64
+FrameWriter::BytesWritten() const
+{
+	return atomic_get64(const_cast<int64*>(&fBytesWritten));
+}
+
+
+// Called by the capture thread: takes effect from
+// the next frame the writer picks up
+void
+FrameWriter::SetCompression(bool compress)
+{
+	atomic_set(&fCompress, compress ? 1 : 0);
+}
+
+
+bool
+FrameWriter::Compression() const
+{
+	return fCompressor != NULL
+		&& atomic_get(const_cast<int32*>(&fCompress)) != 0;
+}
+
+
+int32
+FrameWriter::QueueDepth() const
+{
+	return fQueue->Depth();
+}
+
+
+int32
+FrameWriter::QueueHighWaterMark() const
+{
+	return fQueue->HighWaterMark();
+}
+
+
+/* static */
+int32
+FrameWriter::_WriterStarter(void* arg)
+{
+	return static_cast<FrameWriter*>(arg)->_WriterThread();
+}
+
+
+int32
+FrameWriter::_WriterThread()
+{
+	queued_frame frame;
+	while (fQueue->Pop(frame)) {
+		// After an error, keep draining the queue so
+		// the buffers are given back to the pool
+		if (Status() == B_OK) {
+			const BBitmap* bitmap = frame.bitmap;
+			status_t status = B_OK;
+			if (fScaler != NULL) {
+				TraceRecorder::Begin("scale", frame.number);
+				status = fScaler->Scale(frame.bitmap, fScaled);
+				TraceRecorder::End("scale", frame.number);
+				fPool->Release(frame.bitmap);
+				frame.bitmap = NULL;
+				bitmap = fScaled;
+			}
+			if (status == B_OK)
+				status = _WriteFrame(bitmap, frame.time, frame.number,
+					frame.origin);
+			if (status == B_OK)
+				atomic_add(&fFramesWritten, 1);
+			else {
+				std::cerr << "FrameWriter: WriteFrame failed: " << ::strerror(status) << std::endl;
+				atomic_set(&fStatus, status);
+			}
+		}
+		if (frame.bitmap != NULL)
+			fPool->Release(frame.bitmap);
+	}
+
+	return B_OK;
+}
+
+
+status_t
+FrameWriter::_WriteFrame(const BBitmap* bitmap, bigtime_t frameTime,
+	int32 number, BPoint origin)
+{
+	TraceScope trace("write", number);
+	const bigtime_t start = system_time();
+	if (fEncoder == NULL) {
+		status_t status = fStore->WriteFrame(bitmap, frameTime);
+		if (status == B_OK) {
+			atomic_add64(&fBytesWritten, bitmap->BitsLength());
+			if (fStats != NULL)
+				fStats->AddFrame(system_time() - start, bitmap->BitsLength());
+		}
+		return status;
+	}
+
+	const void* data = NULL;
+	size_t length = 0;
+	bool keyFrame = true;
+	status_t status = fEncoder->Encode(bitmap, &data, &length, &keyFrame);
+	if (status != B_OK)
+		return status;
+
+	uint32 flags = keyFrame ? 0 : kFrameDeltaRecord;
+	// Nothing to gain from compressing an empty delta
+	if (!keyFrame && fEncoder->ChangedRatio() == 0)
+		flags |= kFrameUnchangedRecord;
+	else if (Compression()) {
+		TraceRecorder::Begin("compress", number);
+		status = fCompressor->Compress(data, length, &data, &length);
+		TraceRecorder::End("compress", number);
+		if (status != B_OK) {
+			fEncoder->Reset();
+			return status;
+		}
+		flags |= kFrameCompressedRecord;
+	}
+
+	int32 record = -1;
+	status = fStore->WriteRecord(frameTime, data, length,
+		flags, fReferenceRecord, fEncoder->ChangedRatio(),
+		fEncoder->FrameHash(), origin, &record);
+	if (status != B_OK) {
+		// The next frame can't refer to this one
+		fEncoder->Reset();
+		return status;
+	}
+	fReferenceRecord = record;
+	atomic_add64(&fBytesWritten, length);
+	if (fStats != NULL) {
+		fStats->AddFrame(system_time() - start, length,
+			(flags & kFrameUnchangedRecord) != 0);
+	}
+	return B_OK;
+}
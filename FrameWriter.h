@@ -0,0 +1,88 @@
+/*
+ * Copyright 2026 Stefano Ceccherini <stefano.ceccherini@gmail.com>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+#ifndef __FRAMEWRITER_H
+#define __FRAMEWRITER_H
+
+#include <OS.h>
+#include <Rect.h>
+
+class BBitmap;
+class FramePool;
+class FrameCompressor;
+class FrameQueue;
+class FrameScaler;
+class FrameStore;
+class StageStats;
+class TileDeltaEncoder;
+class WorkerPool;
+// Writes the captured frames to the frame store from its own thread,
+// so disk latency doesn't affect the capture thread.
+// Frames are handed over with Enqueue(): the buffers are given back
+// to the FramePool once written.
+// When the store takes records, every writer stores the frames as
+// tile deltas against the previous frame it wrote, so writers don't
+// depend on each other.
+// If a compression pool is given, records are also compressed, in
+// parallel, on the pool threads. Compression can then be switched
+// off and on again while writing.
+// Frames can also be scaled before they're written: the buffer is
+// then given back as soon as it's scaled.
+class FrameWriter {
+public:
+	FrameWriter(FramePool* pool, FrameStore* store, int32 queueSize,
+		WorkerPool* compressionPool = NULL);
+	~FrameWriter();
+
+	status_t InitCheck() const;
+
+	// Every frame written is counted there, if given. Before Start()
+	void SetStats(StageStats* stats);
+	// The frames are scaled to the given size, with the given
+	// bytes per row, before they're written. Before Start()
+	status_t SetScale(const BRect& frame, int32 bytesPerRow,
+				WorkerPool* pool);
+
+	status_t Start(const char* name, int32 priority = B_NORMAL_PRIORITY);
+	status_t Stop();
+
+	// The number is only used to trace the frame
+	bool Enqueue(BBitmap* bitmap, bigtime_t frameTime, int32 number = -1,
+			BPoint origin = B_ORIGIN);
+
+	status_t Status() const;
+	int32 FramesWritten() const;
+	// What was given to the store, after encoding
+	int64 BytesWritten() const;
+
+	// Only works when the writer was given a compression pool
+	void SetCompression(bool compress);
+	bool Compression() const;
+
+	int32 QueueDepth() const;
+	int32 QueueHighWaterMark() const;
+
+private:
+	static int32 _WriterStarter(void* arg);
+	int32 _WriterThread();
+	status_t _WriteFrame(const BBitmap* bitmap, bigtime_t frameTime,
+				int32 number, BPoint origin);
+
+	FramePool* fPool;
+	FrameStore* fStore;
+	FrameQueue* fQueue;
+	TileDeltaEncoder* fEncoder;
+	FrameCompressor* fCompressor;
+	StageStats* fStats;
+	FrameScaler* fScaler;
+	BBitmap* fScaled;
+	int32 fReferenceRecord;
+	thread_id fThread;
+	int32 fStatus;
+	int32 fFramesWritten;
+	int64 fBytesWritten;
+	int32 fCompress;
+};
+
+#endif // __FRAMEWRITER_H
@@ -5,31 +5,43 @@
 
 #include "FramesList.h"
 
+#include "BMPFrameStore.h"
+#include "CursorTrack.h"
+#include "FrameAllocator.h"
+#include "FrameSpool.h"
 #include "Utils.h"
 
 #include <Bitmap.h>
 #include <BitmapStream.h>
-#include <Directory.h>
 #include <Entry.h>
 #include <File.h>
 #include <FindDirectory.h>
 #include <Path.h>
+#include <StringList.h>
 #include <TranslationUtils.h>
 #include <TranslatorRoster.h>
 
+#include <cerrno>
 #include <cstdio>
 #include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
 #include <iostream>
 #include <new>
+#include <sys/uio.h>
+#include <unistd.h>
 
 static BTranslatorRoster* sTranslatorRoster = NULL;
-char* FramesList::sTemporaryPath = NULL;
+std::vector<BString> FramesList::sTemporaryPaths;
 
 const uint32 kBitmapFormat = 'BMP ';
+const static int32 kMaxWriteVectors = 64;
 
 FramesList::FramesList(bool diskOnly)
 	:
-	BObjectList<BitmapEntry>(20, true)
+	fStore(NULL),
+	fWorkerPool(NULL),
+	fCursorTrack(NULL)
 {
 }
 
@@ -37,11 +49,17 @@ FramesList::FramesList(bool diskOnly)
 /* virtual */
 FramesList::~FramesList()
 {
-	// Empty the list, which incidentally deletes the files
-	// on disk. Must be done before deleting the folder
-	BObjectList<BitmapEntry>::MakeEmpty(true);
+	// Empty the list, which incidentally deletes the files of
+	// the replaced frames. Must be done before deleting the folder
+	fEntries.clear();
 
-	DeleteTempPath();
+	if (fStore != NULL) {
+		fStore->Release();
+		delete fStore;
+	}
+	delete fCursorTrack;
+
+	_DeleteTempPaths();
 }
 
 
@@ -49,18 +67,50 @@ FramesList::~FramesList()
 status_t
 FramesList::CreateTempPath()
 {
-	BPath path;
-	status_t status = find_directory(B_SYSTEM_TEMP_DIRECTORY, &path);
-	if (status != B_OK)
-		return status;
-	char* pathName = (char*)malloc(B_PATH_NAME_LENGTH);
-	if (pathName == NULL)
-		return B_NO_MEMORY;
-	::snprintf(pathName, B_PATH_NAME_LENGTH, "%s/_BSCXXXXXX", path.Path());
-	sTemporaryPath = ::mkdtemp(pathName);
-	if (sTemporaryPath == NULL)
-		return B_ERROR;
-	return B_OK;
+	return CreateTempPaths(BStringList(), 0);
+}
+
+
+// Folders which can't be used, or are on a volume without enough
+// free space, are skipped: it fails only if none is left
+/* static */
+status_t
+FramesList::CreateTempPaths(const BStringList& folders, int64 minFreeSpace)
+{
+	// Like before, the folders of the previous session are left to
+	// whoever still uses them
+	sTemporaryPaths.clear();
+
+	BStringList parents(folders);
+	if (parents.IsEmpty()) {
+		BPath path;
+		status_t status = find_directory(B_SYSTEM_TEMP_DIRECTORY, &path);
+		if (status != B_OK)
+			return status;
+		parents.Add(path.Path());
+	}
+
+	status_t status = B_ERROR;
+	for (int32 i = 0; i < parents.CountStrings(); i++) {
+		const BString parent = parents.StringAt(i);
+		const int64 freeSpace = GetFreeSpace(parent.String());
+		if (minFreeSpace > 0 && freeSpace >= 0 && freeSpace < minFreeSpace) {
+			std::cerr << "FramesList: not enough free space in " << parent.String()
+				<< ": " << freeSpace / (1024 * 1024) << " MB" << std::endl;
+			status = B_DEVICE_FULL;
+			continue;
+		}
+		char pathName[B_PATH_NAME_LENGTH];
+		::snprintf(pathName, sizeof(pathName), "%s/_BSCXXXXXX", parent.String());
+		if (::mkdtemp(pathName) == NULL) {
+			status = errno;
+			std::cerr << "FramesList: cannot create a folder in " << parent.String()
+				<< ": " << ::strerror(status) << std::endl;
+			continue;
+		}
+		sTemporaryPaths.push_back(pathName);
+	}
+	return sTemporaryPaths.empty() ? status : B_OK;
 }
 
 
@@ -68,68 +118,212 @@ FramesList::CreateTempPath()
 status_t
 FramesList::DeleteTempPath()
 {
-	// Delete the folder on disk
-	if (sTemporaryPath != NULL) {
-		BEntry(sTemporaryPath).Remove();
-		free(sTemporaryPath);
-		sTemporaryPath = NULL;
+	// Delete the folders on disk
+	for (size_t i = 0; i < sTemporaryPaths.size(); i++)
+		BEntry(sTemporaryPaths[i].String()).Remove();
+	sTemporaryPaths.clear();
+	return B_OK;
+}
+
+
+void
+FramesList::TakeTempPaths()
+{
+	_DeleteTempPaths();
+	fTemporaryPaths.swap(sTemporaryPaths);
+}
+
+
+/* static */
+status_t
+FramesList::CreateClipPath(BString& path)
+{
+	if (Path() == NULL)
+		return B_NO_INIT;
+	char pathName[B_PATH_NAME_LENGTH];
+	::snprintf(pathName, sizeof(pathName), "%s_clipXXXXXX", Path());
+	if (::mkdtemp(pathName) == NULL) {
+		status_t status = errno;
+		std::cerr << "FramesList: cannot create a clip folder: "
+			<< ::strerror(status) << std::endl;
+		return status;
 	}
+	path = pathName;
 	return B_OK;
 }
 
 
-static int
-CompareTimestamps(const BitmapEntry* A, const BitmapEntry* B)
+void
+FramesList::AdoptTempPath(const BString& path)
+{
+	fTemporaryPaths.push_back(path);
+}
+
+
+const char*
+FramesList::TempPath() const
+{
+	if (fTemporaryPaths.empty())
+		return Path();
+	return fTemporaryPaths[0].String();
+}
+
+
+// The pool is used to decompress spooled frames in parallel
+void
+FramesList::SetWorkerPool(WorkerPool* pool)
+{
+	fWorkerPool = pool;
+	if (fStore != NULL)
+		fStore->SetWorkerPool(pool);
+}
+
+
+// The pointer as it was recorded, to be drawn over the frames
+// by an ImageFilterCursor. The list owns the track
+void
+FramesList::SetCursorTrack(CursorTrack* track)
+{
+	delete fCursorTrack;
+	fCursorTrack = track;
+}
+
+
+const CursorTrack*
+FramesList::GetCursorTrack() const
 {
-	return A->TimeStamp() > B->TimeStamp();
+	return fCursorTrack;
 }
 
 
 status_t
 FramesList::AddItemsFromDisk()
 {
-	BDirectory dir(Path());
-	BEntry entry;
-	while (dir.GetNextEntry(&entry) == B_OK) {
-		bigtime_t timeStamp = (bigtime_t)strtoull(entry.Name(), NULL, 10);
-		BString fullName;
-		fullName << Path() << "/" << entry.Name();
-		BitmapEntry* bitmapEntry =
-			new (std::nothrow) BitmapEntry(fullName, timeStamp);
-		BObjectList<BitmapEntry>::AddItem(bitmapEntry);
+	// Only used to recover the frames of a previous session: the
+	// capture gives its store with AddItemsFromStore(). Without
+	// a spool, the folder holds one BMP file per frame
+	FrameStore* store = NULL;
+	if (BEntry(SpoolPath()).Exists())
+		store = new (std::nothrow) FrameSpool();
+	else
+		store = new (std::nothrow) BMPFrameStore();
+	return _AddItemsFromStore(store);
+}
+
+
+// Adds all the frames of a finished store, which is then owned
+// by the list. Only one store can be added.
+status_t
+FramesList::AddItemsFromStore(FrameStore* store)
+{
+	if (store == NULL)
+		return B_BAD_VALUE;
+	if (fStore != NULL) {
+		delete store;
+		return B_NOT_ALLOWED;
 	}
 
-	// Sort items based on timestamps
-	SortItems(CompareTimestamps);
+	fStore = store;
+	fStore->SetWorkerPool(fWorkerPool);
+
+	// The store index is already sorted
+	const int32 count = fStore->CountFrames();
+	try {
+		fEntries.reserve(count);
+	} catch (...) {
+		return B_NO_MEMORY;
+	}
+	for (int32 i = 0; i < count; i++)
+		fEntries.emplace_back(fStore, i, fStore->FrameTime(i));
 	return B_OK;
 }
 
 
-BitmapEntry*
-FramesList::Pop()
+// The entries are made again, since the indexes of the store
+// change: frames which were replaced are lost
+status_t
+FramesList::Trim(int32 first, int32 count)
+{
+	if (fStore == NULL)
+		return B_NO_INIT;
+	if (first < 0 || count < 0 || first + count > CountItems())
+		return B_BAD_VALUE;
+
+	fEntries.clear();
+	status_t status = fStore->Trim(first, count);
+	const int32 frames = fStore->CountFrames();
+	for (int32 i = 0; i < frames; i++)
+		fEntries.emplace_back(fStore, i, fStore->FrameTime(i));
+	return status;
+}
+
+
+int32
+FramesList::IndexAt(bigtime_t offset) const
+{
+	if (fEntries.empty())
+		return 0;
+	const bigtime_t time = fEntries.front().TimeStamp() + offset;
+	int32 low = 0;
+	int32 high = fEntries.size();
+	while (low < high) {
+		const int32 middle = (low + high) / 2;
+		if (fEntries[middle].TimeStamp() < time)
+			low = middle + 1;
+		else
+			high = middle;
+	}
+	return low;
+}
+
+
+status_t
+FramesList::_AddItemsFromStore(FrameStore* store)
 {
-	return BObjectList<BitmapEntry>::RemoveItemAt(int32(0));
+	if (store == NULL)
+		return B_NO_MEMORY;
+
+	status_t status = store->Open(TempPath());
+	if (status != B_OK) {
+		delete store;
+		return status;
+	}
+	return AddItemsFromStore(store);
 }
 
 
 BitmapEntry*
 FramesList::ItemAt(int32 index) const
 {
-	return BObjectList<BitmapEntry>::ItemAt(index);
+	return const_cast<FramesList*>(this)->ItemAt(index);
 }
 
 
 BitmapEntry*
 FramesList::ItemAt(int32 index)
 {
-	return BObjectList<BitmapEntry>::ItemAt(index);
+	if (index < 0 || index >= (int32)fEntries.size())
+		return NULL;
+	return &fEntries[index];
 }
 
 
 int32
 FramesList::CountItems() const
 {
-	return BObjectList<BitmapEntry>::CountItems();
+	return fEntries.size();
+}
+
+
+// The screen didn't change, and neither did the pointer drawn over it
+bool
+FramesList::IsDuplicate(int32 index) const
+{
+	const BitmapEntry* entry = ItemAt(index);
+	if (index <= 0 || entry == NULL || !entry->IsDuplicate())
+		return false;
+	return fCursorTrack == NULL || fCursorTrack->SameSample(entry->TimeStamp(),
+		ItemAt(index - 1)->TimeStamp());
 }
 
 
@@ -137,39 +331,71 @@ FramesList::CountItems() const
 const char*
 FramesList::Path()
 {
-	return sTemporaryPath;
+	return PathAt(0);
 }
 
 
-status_t
-FramesList::WriteFrames(const char* path)
+/* static */
+int32
+FramesList::CountPaths()
 {
-	uint32 i = 0;
-	status_t status = B_OK;
-	while (CountItems() > 0) {
-		BString fileName;
-		fileName.SetToFormat("frame_%07" B_PRIu32 ".bmp", i + 1);
-		BitmapEntry* entry = Pop();
-		BString fullPath(path);
-		fullPath.Append("/").Append(fileName.String());
-		BBitmap* bitmap = entry->Bitmap();
-		status = FramesList::WriteFrame(bitmap, entry->TimeStamp(), fullPath);
-		delete bitmap;
-		delete entry;
-		if (status != B_OK)
-			break;
-		i++;
-	}
-	return status;
+	return sTemporaryPaths.size();
+}
+
+
+/* static */
+const char*
+FramesList::PathAt(int32 index)
+{
+	if (index < 0 || index >= (int32)sTemporaryPaths.size())
+		return NULL;
+	return sTemporaryPaths[index].String();
+}
+
+
+const FrameStore*
+FramesList::Store() const
+{
+	return fStore;
+}
+
+
+BString
+FramesList::SpoolPath() const
+{
+	BString path;
+	path << TempPath() << "/" << kSpoolFileName;
+	return path;
+}
+
+
+void
+FramesList::_DeleteTempPaths()
+{
+	for (size_t i = 0; i < fTemporaryPaths.size(); i++)
+		BEntry(fTemporaryPaths[i].String()).Remove();
+	fTemporaryPaths.clear();
 }
 
 
 // BitmapEntry
-BitmapEntry::BitmapEntry(const BString& fileName, bigtime_t time)
+BitmapEntry::BitmapEntry(const FrameStore* store, int32 index, bigtime_t time)
+	:
+	fFrameTime(time),
+	fStore(store),
+	fIndex(index)
+{
+}
+
+
+BitmapEntry::BitmapEntry(BitmapEntry&& other)
 	:
-	fFileName(fileName),
-	fFrameTime(time)
+	fFileName(other.fFileName),
+	fFrameTime(other.fFrameTime),
+	fStore(other.fStore),
+	fIndex(other.fIndex)
 {
+	other.fFileName = "";
 }
 
 
@@ -183,18 +409,37 @@ BitmapEntry::~BitmapEntry()
 BBitmap*
 BitmapEntry::Bitmap()
 {
-	if (fFileName == "")
+	// A replaced frame is stored in its own file
+	if (fFileName != "")
+		return BTranslationUtils::GetBitmapFile(fFileName);
+	if (fStore == NULL)
 		return NULL;
-	return BTranslationUtils::GetBitmapFile(fFileName);
+	return fStore->CreateBitmap(fIndex);
+}
+
+
+// Reads the frame into the given bitmap, without allocating
+// a new one. Only works for frames which are still in the store
+status_t
+BitmapEntry::ReadBitmap(BBitmap* bitmap)
+{
+	if (fFileName != "" || fStore == NULL)
+		return B_NOT_SUPPORTED;
+	return fStore->ReadBitmap(fIndex, bitmap);
 }
 
 
 void
 BitmapEntry::Replace(BBitmap* bitmap)
 {
+	if (fFileName == "" && fStore != NULL) {
+		// Stored frames can't be replaced in place, since
+		// the replacement could have a different size
+		fFileName << FramesList::Path() << "/" << TimeStamp();
+	}
 	if (fFileName != "") {
 		FramesList::WriteFrame(bitmap, TimeStamp(), fFileName);
-		delete bitmap;
+		FrameAllocator::Free(bitmap);
 	}
 }
 
@@ -206,11 +451,115 @@ BitmapEntry::TimeStamp() const
 }
 
 
+// Negative when not known, as for replaced frames
+float
+BitmapEntry::ChangeRatio() const
+{
+	if (fFileName != "" || fStore == NULL)
+		return -1;
+	return fStore->ChangeRatio(fIndex);
+}
+
+
+// True if the frame is the same as the one before it
+bool
+BitmapEntry::IsDuplicate() const
+{
+	return fFileName == "" && fStore != NULL
+		&& fStore->SameAsPrevious(fIndex);
+}
+
+
+static void
+PutInt32(uint8* data, uint32 value)
+{
+	data[0] = value & 0xff;
+	data[1] = (value >> 8) & 0xff;
+	data[2] = (value >> 16) & 0xff;
+	data[3] = (value >> 24) & 0xff;
+}
+
+
+static status_t
+WriteVectors(int fd, const struct iovec* vectors, int32 count)
+{
+	size_t length = 0;
+	for (int32 i = 0; i < count; i++)
+		length += vectors[i].iov_len;
+	ssize_t written = ::writev(fd, vectors, count);
+	if (written != (ssize_t)length)
+		return written < 0 ? errno : B_IO_ERROR;
+	return B_OK;
+}
+
+
+// B_RGB32 frames are already laid out as a 32 bit BMP file, so
+// they're written directly from the bitmap, without the translator.
+// The file is top-down (negative height), so the header and rows
+// without padding go in a single write
+static status_t
+WriteBMPFile(const BBitmap* bitmap, const BString& fileName)
+{
+	const int32 width = bitmap->Bounds().IntegerWidth() + 1;
+	const int32 height = bitmap->Bounds().IntegerHeight() + 1;
+	const uint32 rowLength = width * 4;
+	const uint32 imageSize = rowLength * height;
+
+	uint8 header[54];
+	memset(header, 0, sizeof(header));
+	header[0] = 'B';
+	header[1] = 'M';
+	PutInt32(header + 2, sizeof(header) + imageSize);
+	PutInt32(header + 10, sizeof(header));
+	// BITMAPINFOHEADER, uncompressed
+	PutInt32(header + 14, 40);
+	PutInt32(header + 18, width);
+	PutInt32(header + 22, (uint32)-height);
+	header[26] = 1;
+	header[28] = 32;
+	PutInt32(header + 34, imageSize);
+	PutInt32(header + 38, 2835);
+	PutInt32(header + 42, 2835);
+
+	int fd = ::open(fileName.String(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (fd < 0)
+		return errno;
+
+	struct iovec vectors[kMaxWriteVectors];
+	vectors[0].iov_base = header;
+	vectors[0].iov_len = sizeof(header);
+	int32 count = 1;
+
+	status_t status = B_OK;
+	uint8* bits = (uint8*)bitmap->Bits();
+	if ((uint32)bitmap->BytesPerRow() == rowLength) {
+		vectors[1].iov_base = bits;
+		vectors[1].iov_len = imageSize;
+		status = WriteVectors(fd, vectors, 2);
+	} else {
+		// One vector for every row, to leave the padding out
+		for (int32 y = 0; status == B_OK && y < height; y++) {
+			vectors[count].iov_base = bits + y * bitmap->BytesPerRow();
+			vectors[count].iov_len = rowLength;
+			if (++count == kMaxWriteVectors || y == height - 1) {
+				status = WriteVectors(fd, vectors, count);
+				count = 0;
+			}
+		}
+	}
+	::close(fd);
+	return status;
+}
+
+
 /* static */
 status_t
-FramesList::WriteFrame(BBitmap* bitmap, bigtime_t frameTime, const BString& fileName)
+FramesList::WriteFrame(const BBitmap* bitmap, bigtime_t frameTime, const BString& fileName)
 {
 	// Does not take ownership of the passed BBitmap.
+	if (bitmap->ColorSpace() == B_RGB32)
+		return WriteBMPFile(bitmap, fileName);
+
 	if (sTranslatorRoster == NULL) {
 		sTranslatorRoster = BTranslatorRoster::Default();
 	}
@@ -220,32 +569,30 @@ FramesList::WriteFrame(BBitmap* bitmap, bigtime_t frameTime, const BString& file
 		return B_NO_MEMORY;
 	}
 
-	BBitmap *tempBitmap = new (std::nothrow) BBitmap(*bitmap);
-	if (tempBitmap == NULL) {
-		std::cerr << "BitmapEntry::WriteFrame(): cannot create bitmap" << std::endl;
-		return B_NO_MEMORY;
-	}
-
-	BBitmapStream bitmapStream(tempBitmap);
+	// The stream only reads the bitmap, so it's given the
+	// frame itself, and detached before the stream deletes it
+	BBitmapStream bitmapStream(const_cast<BBitmap*>(bitmap));
 	translator_info translatorInfo;
 	status_t status = sTranslatorRoster->Identify(&bitmapStream, NULL,
 			&translatorInfo, 0, NULL, kBitmapFormat);
-	if (status != B_OK) {
+	if (status != B_OK)
 		std::cerr << "BitmapEntry::WriteFrame(): cannot identify bitmap stream: " << ::strerror(status) << std::endl;
-		return status;
-	}
 
 	BFile outFile;
-	status = outFile.SetTo(fileName.String(), B_WRITE_ONLY|B_CREATE_FILE);
-	if (status != B_OK) {
-		std::cerr << "BitmapEntry::WriteFrame(): cannot create file" << ::strerror(status) << std::endl;
-		return status;
+	if (status == B_OK) {
+		status = outFile.SetTo(fileName.String(), B_WRITE_ONLY|B_CREATE_FILE);
+		if (status != B_OK)
+			std::cerr << "BitmapEntry::WriteFrame(): cannot create file" << ::strerror(status) << std::endl;
 	}
 
-	status = sTranslatorRoster->Translate(&bitmapStream,
-		&translatorInfo, NULL, &outFile, kBitmapFormat);
-	if (status != B_OK)
-		std::cerr << "BitmapEntry::WriteFrame(): cannot translate bitmap: " << ::strerror(status) << std::endl;
+	if (status == B_OK) {
+		status = sTranslatorRoster->Translate(&bitmapStream,
+			&translatorInfo, NULL, &outFile, kBitmapFormat);
+		if (status != B_OK)
+			std::cerr << "BitmapEntry::WriteFrame(): cannot translate bitmap: " << ::strerror(status) << std::endl;
+	}
 
+	BBitmap* detached = NULL;
+	bitmapStream.DetachBitmap(&detached);
 	return status;
 }
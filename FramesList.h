@@ -6,48 +6,101 @@
 #ifndef __FRAMESLIST_H_
 #define __FRAMESLIST_H_
 
-#include <ObjectList.h>
 #include <String.h>
 
+#include <vector>
+
 class BBitmap;
+class BStringList;
+class CursorTrack;
+class FrameStore;
+class WorkerPool;
 class BitmapEntry {
 public:
-	BitmapEntry(const BString& fileName, bigtime_t time);
-	BitmapEntry(BitmapEntry*);
-	BitmapEntry(const BitmapEntry&);
+	BitmapEntry(const FrameStore* store, int32 index, bigtime_t time);
+	// The file of a replaced frame goes to the new entry
+	BitmapEntry(BitmapEntry&& other);
 	~BitmapEntry();
 
 	BBitmap* Bitmap();
+	status_t ReadBitmap(BBitmap* bitmap);
 	void Replace(BBitmap* bitmap);
 	bigtime_t TimeStamp() const;
+	float ChangeRatio() const;
+	bool IsDuplicate() const;
 private:
+	BitmapEntry(const BitmapEntry&) = delete;
+	BitmapEntry& operator=(const BitmapEntry&) = delete;
+
 	BString fFileName;
 	bigtime_t fFrameTime;
+	const FrameStore* fStore;
+	int32 fIndex;
 };
 
 
 class BPath;
-class FramesList : private BObjectList<BitmapEntry> {
+class FramesList {
 public:
 	FramesList(bool diskOnly = false);
 	virtual ~FramesList();
 
 	// TODO: Move this away from here
 	static status_t CreateTempPath();
+	// One session folder in every given folder (the system temporary
+	// directory if none) whose volume has at least minFreeSpace bytes
+	static status_t CreateTempPaths(const BStringList& folders,
+				int64 minFreeSpace);
+	// Of the current session
 	static status_t DeleteTempPath();
+	// Takes the folders of the current session, which are then
+	// deleted with the list: the next session makes its own.
+	// Lists which don't take them only borrow them
+	void TakeTempPaths();
+	// A new folder next to the first one of the session, for frames
+	// which outlive it. The list given it deletes it
+	static status_t CreateClipPath(BString& path);
+	void AdoptTempPath(const BString& path);
+	// The first folder the list took, or else the first one
+	// of the current session
+	const char* TempPath() const;
 
+	void SetWorkerPool(WorkerPool* pool);
+	void SetCursorTrack(CursorTrack* track);
+	const CursorTrack* GetCursorTrack() const;
 	status_t AddItemsFromDisk();
+	status_t AddItemsFromStore(FrameStore* store);
+
+	// Only keeps count frames, starting at first. The store skips
+	// the others, so they're never read
+	status_t Trim(int32 first, int32 count);
+	// Of the first frame at least offset after the first one
+	int32 IndexAt(bigtime_t offset) const;
 
-	BitmapEntry* Pop();
 	BitmapEntry* ItemAt(int32 index) const;
 	BitmapEntry* ItemAt(int32 index);
 	int32 CountItems() const;
+	// The frame would be encoded the same as the one before it
+	bool IsDuplicate(int32 index) const;
+	// The first session folder
 	static const char* Path();
+	static int32 CountPaths();
+	static const char* PathAt(int32 index);
 
-	status_t WriteFrames(const char* path);
-	static status_t WriteFrame(BBitmap* bitmap, bigtime_t frameTime, const BString& fileName);
+	static status_t WriteFrame(const BBitmap* bitmap, bigtime_t frameTime, const BString& fileName);
+	BString SpoolPath() const;
+	const FrameStore* Store() const;
 private:
-	static char* sTemporaryPath;
+	status_t _AddItemsFromStore(FrameStore* store);
+	void _DeleteTempPaths();
+
+	FrameStore* fStore;
+	// The frames of the store, in one block, in the order of its index
+	std::vector<BitmapEntry> fEntries;
+	WorkerPool* fWorkerPool;
+	CursorTrack* fCursorTrack;
+	std::vector<BString> fTemporaryPaths;
+	static std::vector<BString> sTemporaryPaths;
 };
 
 
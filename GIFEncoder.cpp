@@ -0,0 +1,642 @@
+/*
+ * Copyright 2026 Stefano Ceccherini <stefano.ceccherini@gmail.com>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+#include "GIFEncoder.h"
+
+#include "WorkerPool.h"
+
+#include <Bitmap.h>
+
+#include <algorithm>
+#include <cstring>
+
+// Colors are counted with 5 bits per channel
+const static int32 kHistogramBins = 1 << 15;
+// Each slice of the changed rectangle gets its own histogram
+const static int32 kHistogramSlices = 8;
+const static int32 kBandRows = 16;
+
+// GIF timings are in hundredths of a second. Most viewers play
+// images shorter than two hundredths slower, instead of faster
+const static int32 kMinDelay = 2;
+const static bigtime_t kDefaultInterval = 100000;
+
+const static int32 kMinCodeSize = 8;
+const static int32 kClearCode = 1 << kMinCodeSize;
+const static int32 kEndCode = kClearCode + 1;
+const static int32 kFirstCode = kClearCode + 2;
+const static int32 kMaxCodeBits = 12;
+// As giflib, the table is reset before the last code is given
+const static int32 kMaxCode = (1 << kMaxCodeBits) - 1;
+const static int32 kHashSize = 8192;
+
+struct gif_job {
+	const uint8* bits;
+	int32 bytesPerRow;
+	// NULL for the first frame
+	const uint32* previous;
+	int32 frameWidth;
+	int32 left;
+	int32 top;
+	int32 width;
+	int32 height;
+	int32 sliceRows;
+	uint32* histograms;
+	const uint8* colorMap;
+	uint8* indices;
+	uint8 transparentIndex;
+};
+
+struct histogram_bin {
+	uint16 color;
+	uint32 count;
+};
+
+struct color_box {
+	int32 begin;
+	int32 end;
+	// The channel with the widest range, and the range
+	int32 channel;
+	int32 range;
+};
+
+// Packs the codes into the 255 bytes sub-blocks of the image data
+struct lzw_output {
+	std::vector<uint8>& data;
+	uint8 block[255];
+	int32 blockLength;
+	uint32 bits;
+	int32 bitCount;
+	int32 codeSize;
+	int32 nextCode;
+};
+
+
+static inline uint32
+ColorBin(uint32 pixel)
+{
+	return ((pixel >> 9) & 0x7c00) | ((pixel >> 6) & 0x3e0) | ((pixel >> 3) & 0x1f);
+}
+
+
+static inline int32
+BinChannel(uint32 bin, int32 channel)
+{
+	return (bin >> (10 - channel * 5)) & 0x1f;
+}
+
+
+static inline bool
+SameColor(uint32 pixel, uint32 other)
+{
+	return ((pixel ^ other) & 0x00ffffff) == 0;
+}
+
+
+static inline const uint32*
+SourceRow(const gif_job& job, int32 y)
+{
+	return (const uint32*)(job.bits + (job.top + y) * job.bytesPerRow) + job.left;
+}
+
+
+static inline const uint32*
+PreviousRow(const gif_job& job, int32 y)
+{
+	return job.previous + (job.top + y) * job.frameWidth + job.left;
+}
+
+
+static void
+CountSlice(void* cookie, int32 slice)
+{
+	const gif_job& job = *static_cast<const gif_job*>(cookie);
+	uint32* histogram = job.histograms + slice * kHistogramBins;
+	memset(histogram, 0, kHistogramBins * sizeof(uint32));
+	const int32 first = slice * job.sliceRows;
+	const int32 last = std::min(first + job.sliceRows, job.height);
+	for (int32 y = first; y < last; y++) {
+		const uint32* row = SourceRow(job, y);
+		if (job.previous == NULL) {
+			for (int32 x = 0; x < job.width; x++)
+				histogram[ColorBin(row[x])]++;
+			continue;
+		}
+		const uint32* previous = PreviousRow(job, y);
+		for (int32 x = 0; x < job.width; x++) {
+			if (!SameColor(row[x], previous[x]))
+				histogram[ColorBin(row[x])]++;
+		}
+	}
+}
+
+
+static void
+MapBand(void* cookie, int32 band)
+{
+	const gif_job& job = *static_cast<const gif_job*>(cookie);
+	const int32 first = band * kBandRows;
+	const int32 last = std::min(first + kBandRows, job.height);
+	for (int32 y = first; y < last; y++) {
+		const uint32* row = SourceRow(job, y);
+		uint8* indices = job.indices + y * job.width;
+		if (job.previous == NULL) {
+			for (int32 x = 0; x < job.width; x++)
+				indices[x] = job.colorMap[ColorBin(row[x])];
+			continue;
+		}
+		const uint32* previous = PreviousRow(job, y);
+		for (int32 x = 0; x < job.width; x++) {
+			indices[x] = SameColor(row[x], previous[x])
+				? job.transparentIndex : job.colorMap[ColorBin(row[x])];
+		}
+	}
+}
+
+
+static void
+FindRange(const std::vector<histogram_bin>& bins, color_box& box)
+{
+	int32 low[3] = { 31, 31, 31 };
+	int32 high[3] = { 0, 0, 0 };
+	for (int32 i = box.begin; i < box.end; i++) {
+		for (int32 channel = 0; channel < 3; channel++) {
+			const int32 value = BinChannel(bins[i].color, channel);
+			low[channel] = std::min(low[channel], value);
+			high[channel] = std::max(high[channel], value);
+		}
+	}
+	box.channel = 0;
+	box.range = -1;
+	for (int32 channel = 0; channel < 3; channel++) {
+		if (high[channel] - low[channel] > box.range) {
+			box.range = high[channel] - low[channel];
+			box.channel = channel;
+		}
+	}
+}
+
+
+// Splits the box at the median of its widest channel, weighted
+// by how many pixels have each color
+static color_box
+SplitBox(std::vector<histogram_bin>& bins, color_box& box)
+{
+	const int32 channel = box.channel;
+	std::sort(bins.begin() + box.begin, bins.begin() + box.end,
+		[channel](const histogram_bin& a, const histogram_bin& b) {
+			return BinChannel(a.color, channel) < BinChannel(b.color, channel);
+		});
+
+	uint64 total = 0;
+	for (int32 i = box.begin; i < box.end; i++)
+		total += bins[i].count;
+	uint64 count = 0;
+	int32 middle = box.begin + 1;
+	for (int32 i = box.begin; i < box.end - 1; i++) {
+		count += bins[i].count;
+		middle = i + 1;
+		if (count * 2 >= total)
+			break;
+	}
+
+	color_box other;
+	other.begin = middle;
+	other.end = box.end;
+	box.end = middle;
+	FindRange(bins, box);
+	FindRange(bins, other);
+	return other;
+}
+
+
+static void
+PutCode(lzw_output& output, int32 code)
+{
+	output.bits |= (uint32)code << output.bitCount;
+	output.bitCount += output.codeSize;
+	while (output.bitCount >= 8) {
+		output.block[output.blockLength++] = output.bits & 0xff;
+		output.bits >>= 8;
+		output.bitCount -= 8;
+		if (output.blockLength == 255) {
+			output.data.push_back(255);
+			output.data.insert(output.data.end(), output.block, output.block + 255);
+			output.blockLength = 0;
+		}
+	}
+	// The decoder grows the codes when it adds this code to its table
+	if (output.nextCode >= (1 << output.codeSize) && output.codeSize < kMaxCodeBits)
+		output.codeSize++;
+}
+
+
+static void
+Compress(const uint8* indices, size_t count, std::vector<uint8>& data)
+{
+	std::vector<int32> keys(kHashSize, -1);
+	std::vector<int16> codes(kHashSize);
+
+	data.push_back(kMinCodeSize);
+	lzw_output output = { data, {}, 0, 0, 0, kMinCodeSize + 1, kFirstCode };
+	PutCode(output, kClearCode);
+
+	int32 prefix = indices[0];
+	for (size_t i = 1; i < count; i++) {
+		const int32 key = (prefix << 8) | indices[i];
+		uint32 slot = (key ^ (key >> 9)) & (kHashSize - 1);
+		while (keys[slot] != -1 && keys[slot] != key)
+			slot = (slot + 1) & (kHashSize - 1);
+		if (keys[slot] == key) {
+			prefix = codes[slot];
+			continue;
+		}
+
+		PutCode(output, prefix);
+		prefix = indices[i];
+		if (output.nextCode >= kMaxCode) {
+			PutCode(output, kClearCode);
+			output.codeSize = kMinCodeSize + 1;
+			output.nextCode = kFirstCode;
+			std::fill(keys.begin(), keys.end(), -1);
+		} else {
+			keys[slot] = key;
+			codes[slot] = output.nextCode++;
+		}
+	}
+	PutCode(output, prefix);
+	PutCode(output, kEndCode);
+
+	if (output.bitCount > 0)
+		output.block[output.blockLength++] = output.bits & 0xff;
+	if (output.blockLength > 0) {
+		data.push_back(output.blockLength);
+		data.insert(data.end(), output.block, output.block + output.blockLength);
+	}
+	data.push_back(0);
+}
+
+
+static void
+PutInt16(std::vector<uint8>& data, int32 value)
+{
+	data.push_back(value & 0xff);
+	data.push_back((value >> 8) & 0xff);
+}
+
+
+GIFEncoder::GIFEncoder(WorkerPool* pool)
+	:
+	fWorkerPool(pool),
+	fWidth(0),
+	fHeight(0),
+	fImageCount(0),
+	fHasPrevious(false),
+	fPendingDelayOffset(0),
+	fFirstFrameTime(0),
+	fLastFrameTime(0),
+	fLastInterval(kDefaultInterval),
+	fWrittenDelay(0)
+{
+	memset(fPalette, 0, sizeof(fPalette));
+}
+
+
+GIFEncoder::~GIFEncoder()
+{
+}
+
+
+status_t
+GIFEncoder::Open(const char* path)
+{
+	return fFile.SetTo(path, B_WRITE_ONLY | B_CREATE_FILE | B_ERASE_FILE);
+}
+
+
+status_t
+GIFEncoder::WriteFrame(const BBitmap* bitmap, bigtime_t frameTime)
+{
+	if (bitmap == NULL)
+		return B_BAD_VALUE;
+	if (bitmap->ColorSpace() != B_RGB32 && bitmap->ColorSpace() != B_RGBA32)
+		return B_NOT_SUPPORTED;
+
+	const int32 width = bitmap->Bounds().IntegerWidth() + 1;
+	const int32 height = bitmap->Bounds().IntegerHeight() + 1;
+	if (fWidth == 0) {
+		status_t status = _WriteHeader(width, height);
+		if (status != B_OK)
+			return status;
+		fFirstFrameTime = frameTime;
+	} else if (width != fWidth || height != fHeight)
+		return B_MISMATCHED_VALUES;
+
+	if (fImageCount > 0)
+		fLastInterval = std::max(frameTime - fLastFrameTime, bigtime_t(0));
+	fLastFrameTime = frameTime;
+
+	pixel_rect rect;
+	if (!_FindChangedRect(bitmap, rect))
+		return B_OK;
+
+	status_t status = _FlushPending(frameTime);
+	if (status != B_OK)
+		return status;
+
+	// The first frame has nothing to show through
+	const int32 transparentIndex = fHasPrevious ? 255 : -1;
+	_BuildPalette(bitmap, rect, fHasPrevious ? 255 : 256);
+	_MapPixels(bitmap, rect, transparentIndex);
+	_UpdatePrevious(bitmap, rect);
+
+	// Graphic control extension: leave the image there, so the
+	// next ones only need to draw what changed
+	fPending.clear();
+	fPending.push_back(0x21);
+	fPending.push_back(0xf9);
+	fPending.push_back(4);
+	fPending.push_back((1 << 2) | (transparentIndex >= 0 ? 1 : 0));
+	fPendingDelayOffset = fPending.size();
+	PutInt16(fPending, 0);
+	fPending.push_back(transparentIndex >= 0 ? transparentIndex : 0);
+	fPending.push_back(0);
+
+	// Image descriptor, with a local table of 256 colors
+	fPending.push_back(0x2c);
+	PutInt16(fPending, rect.left);
+	PutInt16(fPending, rect.top);
+	PutInt16(fPending, rect.width);
+	PutInt16(fPending, rect.height);
+	fPending.push_back(0x80 | 7);
+	fPending.insert(fPending.end(), fPalette, fPalette + sizeof(fPalette));
+
+	Compress(fIndices.data(), (size_t)rect.width * rect.height, fPending);
+	fImageCount++;
+	return B_OK;
+}
+
+
+status_t
+GIFEncoder::WriteDuplicate(bigtime_t frameTime)
+{
+	if (fImageCount == 0)
+		return B_NO_INIT;
+
+	fLastInterval = std::max(frameTime - fLastFrameTime, bigtime_t(0));
+	fLastFrameTime = frameTime;
+	return B_OK;
+}
+
+
+status_t
+GIFEncoder::Close()
+{
+	if (fFile.InitCheck() != B_OK)
+		return fFile.InitCheck();
+
+	status_t status = B_OK;
+	if (fWidth == 0)
+		status = B_ERROR;
+	else
+		status = _FlushPending(fLastFrameTime + fLastInterval);
+	if (status == B_OK) {
+		const uint8 trailer = 0x3b;
+		status = _Write(&trailer, 1);
+	}
+	fFile.Unset();
+	return status;
+}
+
+
+int32
+GIFEncoder::CountImages() const
+{
+	return fImageCount;
+}
+
+
+status_t
+GIFEncoder::_WriteHeader(int32 width, int32 height)
+{
+	if (width <= 0 || height <= 0 || width > 65535 || height > 65535)
+		return B_BAD_VALUE;
+
+	fWidth = width;
+	fHeight = height;
+	fPrevious.resize((size_t)width * height);
+	fHistograms.resize((size_t)kHistogramSlices * kHistogramBins);
+	fColorMap.resize(kHistogramBins);
+	fIndices.resize((size_t)width * height);
+
+	std::vector<uint8> header;
+	const char* signature = "GIF89a";
+	header.insert(header.end(), signature, signature + 6);
+	// Logical screen, without a global color table
+	PutInt16(header, width);
+	PutInt16(header, height);
+	header.push_back(0);
+	header.push_back(0);
+	header.push_back(0);
+	// Loop forever
+	const char* application = "NETSCAPE2.0";
+	header.push_back(0x21);
+	header.push_back(0xff);
+	header.push_back(11);
+	header.insert(header.end(), application, application + 11);
+	header.push_back(3);
+	header.push_back(1);
+	PutInt16(header, 0);
+	header.push_back(0);
+	return _Write(header.data(), header.size());
+}
+
+
+// Returns false if the frame is the same as the previous one
+bool
+GIFEncoder::_FindChangedRect(const BBitmap* bitmap, pixel_rect& rect) const
+{
+	const uint8* bits = (const uint8*)bitmap->Bits();
+	const int32 bytesPerRow = bitmap->BytesPerRow();
+	if (!fHasPrevious) {
+		rect.left = 0;
+		rect.top = 0;
+		rect.width = fWidth;
+		rect.height = fHeight;
+		return true;
+	}
+
+	int32 left = fWidth;
+	int32 right = -1;
+	int32 top = fHeight;
+	int32 bottom = -1;
+	for (int32 y = 0; y < fHeight; y++) {
+		const uint32* row = (const uint32*)(bits + y * bytesPerRow);
+		const uint32* previous = fPrevious.data() + (size_t)y * fWidth;
+		int32 first = 0;
+		while (first < fWidth && SameColor(row[first], previous[first]))
+			first++;
+		if (first == fWidth)
+			continue;
+		int32 last = fWidth - 1;
+		while (last > first && SameColor(row[last], previous[last]))
+			last--;
+		left = std::min(left, first);
+		right = std::max(right, last);
+		top = std::min(top, y);
+		bottom = y;
+	}
+	if (bottom < 0)
+		return false;
+
+	rect.left = left;
+	rect.top = top;
+	rect.width = right - left + 1;
+	rect.height = bottom - top + 1;
+	return true;
+}
+
+
+// Fills the palette and the color map, returns the number of colors
+int32
+GIFEncoder::_BuildPalette(const BBitmap* bitmap, const pixel_rect& rect,
+	int32 maxColors)
+{
+	gif_job job;
+	job.bits = (const uint8*)bitmap->Bits();
+	job.bytesPerRow = bitmap->BytesPerRow();
+	job.previous = fHasPrevious ? fPrevious.data() : NULL;
+	job.frameWidth = fWidth;
+	job.left = rect.left;
+	job.top = rect.top;
+	job.width = rect.width;
+	job.height = rect.height;
+	job.sliceRows = (rect.height + kHistogramSlices - 1) / kHistogramSlices;
+	job.histograms = fHistograms.data();
+
+	const int32 slices = (rect.height + job.sliceRows - 1) / job.sliceRows;
+	if (fWorkerPool == NULL || slices == 1
+		|| fWorkerPool->Run(CountSlice, &job, slices) != B_OK) {
+		for (int32 slice = 0; slice < slices; slice++)
+			CountSlice(&job, slice);
+	}
+
+	std::vector<histogram_bin> bins;
+	for (int32 color = 0; color < kHistogramBins; color++) {
+		uint32 count = 0;
+		for (int32 slice = 0; slice < slices; slice++)
+			count += fHistograms[slice * kHistogramBins + color];
+		if (count > 0) {
+			histogram_bin bin = { (uint16)color, count };
+			bins.push_back(bin);
+		}
+	}
+
+	std::vector<color_box> boxes;
+	if (!bins.empty()) {
+		color_box box = { 0, (int32)bins.size(), 0, 0 };
+		FindRange(bins, box);
+		boxes.push_back(box);
+	}
+	while ((int32)boxes.size() < maxColors) {
+		int32 widest = -1;
+		for (size_t i = 0; i < boxes.size(); i++) {
+			if (boxes[i].range > 0
+				&& (widest < 0 || boxes[i].range > boxes[widest].range))
+				widest = i;
+		}
+		if (widest < 0)
+			break;
+		boxes.push_back(SplitBox(bins, boxes[widest]));
+	}
+
+	memset(fPalette, 0, sizeof(fPalette));
+	for (size_t i = 0; i < boxes.size(); i++) {
+		uint64 sums[3] = { 0, 0, 0 };
+		uint64 total = 0;
+		for (int32 b = boxes[i].begin; b < boxes[i].end; b++) {
+			for (int32 channel = 0; channel < 3; channel++) {
+				const uint32 value = BinChannel(bins[b].color, channel);
+				sums[channel] += (uint64)((value << 3) | (value >> 2)) * bins[b].count;
+			}
+			total += bins[b].count;
+			fColorMap[bins[b].color] = i;
+		}
+		for (int32 channel = 0; channel < 3; channel++)
+			fPalette[i * 3 + channel] = (sums[channel] + total / 2) / total;
+	}
+	return boxes.size();
+}
+
+
+void
+GIFEncoder::_MapPixels(const BBitmap* bitmap, const pixel_rect& rect,
+	int32 transparentIndex)
+{
+	gif_job job;
+	job.bits = (const uint8*)bitmap->Bits();
+	job.bytesPerRow = bitmap->BytesPerRow();
+	job.previous = fHasPrevious ? fPrevious.data() : NULL;
+	job.frameWidth = fWidth;
+	job.left = rect.left;
+	job.top = rect.top;
+	job.width = rect.width;
+	job.height = rect.height;
+	job.colorMap = fColorMap.data();
+	job.indices = fIndices.data();
+	job.transparentIndex = transparentIndex >= 0 ? transparentIndex : 0;
+
+	const int32 bands = (rect.height + kBandRows - 1) / kBandRows;
+	if (fWorkerPool == NULL || bands == 1
+		|| fWorkerPool->Run(MapBand, &job, bands) != B_OK) {
+		for (int32 band = 0; band < bands; band++)
+			MapBand(&job, band);
+	}
+}
+
+
+void
+GIFEncoder::_UpdatePrevious(const BBitmap* bitmap, const pixel_rect& rect)
+{
+	const uint8* bits = (const uint8*)bitmap->Bits();
+	const int32 bytesPerRow = bitmap->BytesPerRow();
+	for (int32 y = rect.top; y < rect.top + rect.height; y++) {
+		memcpy(fPrevious.data() + (size_t)y * fWidth + rect.left,
+			(const uint32*)(bits + y * bytesPerRow) + rect.left,
+			rect.width * sizeof(uint32));
+	}
+	fHasPrevious = true;
+}
+
+
+// Writes the last image, which lasts until the given time.
+// Delays are rounded on the time since the first frame, so
+// they don't drift
+status_t
+GIFEncoder::_FlushPending(bigtime_t endTime)
+{
+	if (fPending.empty())
+		return B_OK;
+
+	const int64 end = (endTime - fFirstFrameTime + 5000) / 10000;
+	const int32 delay = std::min(std::max(end - fWrittenDelay, int64(kMinDelay)),
+		int64(65535));
+	fPending[fPendingDelayOffset] = delay & 0xff;
+	fPending[fPendingDelayOffset + 1] = (delay >> 8) & 0xff;
+	fWrittenDelay += delay;
+
+	status_t status = _Write(fPending.data(), fPending.size());
+	fPending.clear();
+	return status;
+}
+
+
+status_t
+GIFEncoder::_Write(const void* data, size_t length)
+{
+	ssize_t written = fFile.Write(data, length);
+	if (written < 0)
+		return written;
+	return (size_t)written == length ? B_OK : B_IO_ERROR;
+}
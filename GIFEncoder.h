@@ -0,0 +1,80 @@
+/*
+ * Copyright 2026 Stefano Ceccherini <stefano.ceccherini@gmail.com>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+#ifndef __GIFENCODER_H
+#define __GIFENCODER_H
+
+#include <File.h>
+#include <SupportDefs.h>
+
+#include <vector>
+
+class BBitmap;
+class WorkerPool;
+// Writes animated GIF files, without any external tool.
+// Every frame gets its own palette, made by median cut, and only
+// the rectangle which changed since the previous frame is stored:
+// the pixels in it which didn't change are transparent.
+// Frames the same as the previous one just make it last longer.
+// The histogram and the mapping of the pixels are done in bands
+// of rows, on the worker pool.
+class GIFEncoder {
+public:
+	GIFEncoder(WorkerPool* pool = NULL);
+	~GIFEncoder();
+
+	status_t Open(const char* path);
+	// Only 32 bit frames, all of the same size
+	status_t WriteFrame(const BBitmap* bitmap, bigtime_t frameTime);
+	// The previous frame again, without having to compare it
+	status_t WriteDuplicate(bigtime_t frameTime);
+	// Writes the last frame and finishes the file
+	status_t Close();
+
+	int32 CountImages() const;
+
+private:
+	struct pixel_rect {
+		int32 left;
+		int32 top;
+		int32 width;
+		int32 height;
+	};
+
+	status_t _WriteHeader(int32 width, int32 height);
+	bool _FindChangedRect(const BBitmap* bitmap, pixel_rect& rect) const;
+	int32 _BuildPalette(const BBitmap* bitmap, const pixel_rect& rect,
+		int32 maxColors);
+	void _MapPixels(const BBitmap* bitmap, const pixel_rect& rect,
+		int32 transparentIndex);
+	void _UpdatePrevious(const BBitmap* bitmap, const pixel_rect& rect);
+	status_t _FlushPending(bigtime_t endTime);
+	status_t _Write(const void* data, size_t length);
+
+	BFile fFile;
+	WorkerPool* fWorkerPool;
+	int32 fWidth;
+	int32 fHeight;
+	int32 fImageCount;
+
+	// The pixels of the previous frame, without padding
+	std::vector<uint32> fPrevious;
+	bool fHasPrevious;
+
+	std::vector<uint32> fHistograms;
+	std::vector<uint8> fColorMap;
+	uint8 fPalette[256 * 3];
+	std::vector<uint8> fIndices;
+
+	// The last image is only written when the next different
+	// frame comes, since its duration is known only then
+	std::vector<uint8> fPending;
+	size_t fPendingDelayOffset;
+	bigtime_t fFirstFrameTime;
+	bigtime_t fLastFrameTime;
+	bigtime_t fLastInterval;
+	int64 fWrittenDelay;
+};
+
+#endif // __GIFENCODER_H
@@ -4,71 +4,472 @@
  */
 #include "ImageFilter.h"
 
+#include "ColorConverter.h"
+#include "CursorTrack.h"
+#include "FrameAllocator.h"
+#include "FrameScaler.h"
+
 #include <Bitmap.h>
 #include <View.h>
 
-ImageFilter::ImageFilter(BRect frame, color_space colorSpace)
-	:
-	fBitmap(NULL),
-	fView(NULL)
+#include <algorithm>
+#include <cstring>
+#include <new>
+
+
+static int32
+BytesPerPixel(color_space colorSpace)
+{
+	size_t pixelChunk;
+	size_t rowAlignment;
+	size_t pixelsPerChunk;
+	if (get_pixel_size_for(colorSpace, &pixelChunk, &rowAlignment,
+			&pixelsPerChunk) != B_OK || pixelsPerChunk != 1)
+		return 0;
+	return (int32)pixelChunk;
+}
+
+
+ImageFilter::ImageFilter()
 {
-	// Bitmap and view used to convert the source bitmap
-	// to the correct size and depth
-	fBitmap = new BBitmap(frame, colorSpace, true);
-	fView = new BView(frame, "drawing view", B_FOLLOW_NONE, 0);
-	if (fBitmap->Lock()) {
-		fBitmap->AddChild(fView);
-		fBitmap->Unlock();
-	}
 }
 
 
 ImageFilter::~ImageFilter()
 {
-	delete fBitmap;
 }
 
 
+/* virtual */
+bool
+ImageFilter::InPlace() const
+{
+	return false;
+}
+
+
+/* virtual */
 BBitmap*
-ImageFilter::Bitmap()
+ImageFilter::CreateBitmap(BRect bounds, color_space colorSpace) const
+{
+	return FrameAllocator::Allocate(kFrameStageFilter, bounds, colorSpace);
+}
+
+
+// ImageFilterChain
+ImageFilterChain::ImageFilterChain()
+	:
+	fColorSpace(B_NO_COLOR_SPACE),
+	fPrepared(false)
+{
+}
+
+
+ImageFilterChain::~ImageFilterChain()
+{
+	_FreeBuffers();
+	for (size_t i = 0; i < fStages.size(); i++)
+		delete fStages[i].filter;
+}
+
+
+status_t
+ImageFilterChain::AddFilter(ImageFilter* filter)
 {
-	return fBitmap;
+	if (filter == NULL)
+		return B_BAD_VALUE;
+	filter_stage stage;
+	stage.filter = filter;
+	stage.buffer = NULL;
+	fStages.push_back(stage);
+	fPrepared = false;
+	return B_OK;
 }
 
 
-BView*
-ImageFilter::View()
+int32
+ImageFilterChain::CountFilters() const
 {
-	return fView;
+	return (int32)fStages.size();
+}
+
+
+status_t
+ImageFilterChain::Prepare(BRect bounds, color_space colorSpace)
+{
+	_FreeBuffers();
+	fPrepared = false;
+	fBounds = bounds;
+	fColorSpace = colorSpace;
+
+	for (size_t i = 0; i < fStages.size(); i++) {
+		ImageFilter* filter = fStages[i].filter;
+		BRect outBounds;
+		color_space outColorSpace;
+		status_t status = filter->Prepare(bounds, colorSpace, outBounds, outColorSpace);
+		if (status != B_OK)
+			return status;
+		if (filter->InPlace()) {
+			if (outBounds != bounds || outColorSpace != colorSpace)
+				return B_BAD_VALUE;
+			continue;
+		}
+		BBitmap* buffer = filter->CreateBitmap(outBounds, outColorSpace);
+		if (buffer == NULL || buffer->InitCheck() != B_OK) {
+			FrameAllocator::Free(buffer);
+			return B_NO_MEMORY;
+		}
+		fStages[i].buffer = buffer;
+		bounds = outBounds;
+		colorSpace = outColorSpace;
+	}
+
+	fPrepared = true;
+	return B_OK;
+}
+
+
+status_t
+ImageFilterChain::Apply(BBitmap* frame, bigtime_t frameTime, BBitmap** _result)
+{
+	if (frame == NULL || _result == NULL)
+		return B_BAD_VALUE;
+
+	// Only happens once, unless the frames change
+	if (!fPrepared || frame->Bounds() != fBounds
+		|| frame->ColorSpace() != fColorSpace) {
+		status_t status = Prepare(frame->Bounds(), frame->ColorSpace());
+		if (status != B_OK)
+			return status;
+	}
+
+	BBitmap* current = frame;
+	for (size_t i = 0; i < fStages.size(); i++) {
+		BBitmap* dest = fStages[i].buffer != NULL ? fStages[i].buffer : current;
+		status_t status = fStages[i].filter->Apply(current, dest, frameTime);
+		if (status != B_OK)
+			return status;
+		current = dest;
+	}
+	*_result = current;
+	return B_OK;
+}
+
+
+void
+ImageFilterChain::_FreeBuffers()
+{
+	for (size_t i = 0; i < fStages.size(); i++) {
+		FrameAllocator::Free(fStages[i].buffer);
+		fStages[i].buffer = NULL;
+	}
 }
 
 
 // ImageFilterScale
-ImageFilterScale::ImageFilterScale(BRect frame, color_space colorSpace)
+ImageFilterScale::ImageFilterScale(BRect frame, WorkerPool* pool)
 	:
-	ImageFilter(frame, colorSpace)
+	fFrame(frame.OffsetToCopy(B_ORIGIN)),
+	fSameSize(false),
+	fScaler(NULL),
+	fViewBitmap(NULL),
+	fView(NULL)
 {
+	fScaler = new (std::nothrow) FrameScaler(FrameScaler::kKernelBilinear);
+	if (fScaler != NULL)
+		fScaler->SetWorkerPool(pool);
 }
 
 
 ImageFilterScale::~ImageFilterScale()
 {
+	delete fScaler;
+	// Also deletes the view
+	FrameAllocator::Free(fViewBitmap);
 }
 
 
 /* virtual */
-BBitmap*
-ImageFilterScale::ApplyFilter(BBitmap* bitmap)
+status_t
+ImageFilterScale::Prepare(BRect bounds, color_space colorSpace,
+	BRect& outBounds, color_space& outColorSpace)
 {
+	outBounds = fFrame;
+	outColorSpace = colorSpace;
+
+	FrameAllocator::Free(fViewBitmap);
+	fViewBitmap = NULL;
+	fView = NULL;
+	fSameSize = bounds.OffsetToCopy(B_ORIGIN) == fFrame;
+	if (fSameSize) {
+		outBounds = bounds;
+		return B_OK;
+	}
+	if (fScaler != NULL && FrameScaler::CanScale(colorSpace, colorSpace))
+		return B_OK;
+
+	// Bitmap and view used to convert the source bitmap
+	// to the correct size
+	fViewBitmap = FrameAllocator::Allocate(kFrameStageFilter, fFrame, colorSpace,
+		B_ANY_BYTES_PER_ROW, B_BITMAP_ACCEPTS_VIEWS);
+	fView = new (std::nothrow) BView(fFrame, "drawing view", B_FOLLOW_NONE, 0);
+	if (fViewBitmap == NULL || fView == NULL) {
+		FrameAllocator::Free(fViewBitmap);
+		fViewBitmap = NULL;
+		delete fView;
+		fView = NULL;
+		return B_NO_MEMORY;
+	}
+	if (fViewBitmap->Lock()) {
+		fViewBitmap->AddChild(fView);
+		fViewBitmap->Unlock();
+	}
+	return B_OK;
+}
+
+
+/* virtual */
+status_t
+ImageFilterScale::Apply(const BBitmap* source, BBitmap* dest, bigtime_t frameTime)
+{
+	if (fSameSize)
+		return B_OK;
+	if (fViewBitmap == NULL)
+		return fScaler != NULL ? fScaler->Scale(source, dest) : B_NO_INIT;
+
 	// Draw scaled
-	if (bitmap != NULL) {
-		Bitmap()->Lock();
-		View()->DrawBitmap(bitmap, bitmap->Bounds().OffsetToCopy(B_ORIGIN),
-									View()->Bounds());
-		View()->Sync();
-		Bitmap()->Unlock();
-		delete bitmap;
+	fViewBitmap->Lock();
+	fView->DrawBitmap(source, source->Bounds().OffsetToCopy(B_ORIGIN),
+								fView->Bounds());
+	fView->Sync();
+	fViewBitmap->Unlock();
+	return dest->ImportBits(fViewBitmap);
+}
+
+
+/* virtual */
+bool
+ImageFilterScale::InPlace() const
+{
+	return fSameSize;
+}
+
+
+// ImageFilterCrop
+ImageFilterCrop::ImageFilterCrop(BRect rect)
+	:
+	fRect(rect)
+{
+}
+
+
+/* virtual */
+status_t
+ImageFilterCrop::Prepare(BRect bounds, color_space colorSpace,
+	BRect& outBounds, color_space& outColorSpace)
+{
+	if (BytesPerPixel(colorSpace) == 0)
+		return B_NOT_SUPPORTED;
+	const BRect rect = fRect & bounds;
+	if (!rect.IsValid())
+		return B_BAD_VALUE;
+	outBounds = rect.OffsetToCopy(B_ORIGIN);
+	outColorSpace = colorSpace;
+	return B_OK;
+}
+
+
+/* virtual */
+status_t
+ImageFilterCrop::Apply(const BBitmap* source, BBitmap* dest, bigtime_t frameTime)
+{
+	const BRect rect = fRect & source->Bounds();
+	const int32 bytesPerPixel = BytesPerPixel(source->ColorSpace());
+	const size_t rowLength = (rect.IntegerWidth() + 1) * bytesPerPixel;
+	const uint8* from = (const uint8*)source->Bits()
+		+ (int32)rect.top * source->BytesPerRow() + (int32)rect.left * bytesPerPixel;
+	uint8* to = (uint8*)dest->Bits();
+	for (int32 y = 0; y <= rect.IntegerHeight(); y++) {
+		::memcpy(to, from, rowLength);
+		from += source->BytesPerRow();
+		to += dest->BytesPerRow();
+	}
+	return B_OK;
+}
+
+
+// ImageFilterColorConvert
+ImageFilterColorConvert::ImageFilterColorConvert(color_space colorSpace,
+		WorkerPool* pool)
+	:
+	fFrom(B_NO_COLOR_SPACE),
+	fTo(colorSpace),
+	fWorkerPool(pool)
+{
+}
+
+
+/* virtual */
+status_t
+ImageFilterColorConvert::Prepare(BRect bounds, color_space colorSpace,
+	BRect& outBounds, color_space& outColorSpace)
+{
+	fFrom = colorSpace;
+	outBounds = bounds;
+	outColorSpace = fTo;
+	return B_OK;
+}
+
+
+/* virtual */
+status_t
+ImageFilterColorConvert::Apply(const BBitmap* source, BBitmap* dest, bigtime_t frameTime)
+{
+	if (fFrom == fTo)
+		return B_OK;
+	if (ColorConverter::CanConvert(fFrom, fTo)) {
+		const BRect bounds = source->Bounds();
+		return ColorConverter::Convert(fWorkerPool, source->Bits(),
+			source->BytesPerRow(), fFrom, dest->Bits(), dest->BytesPerRow(), fTo,
+			bounds.IntegerWidth() + 1, bounds.IntegerHeight() + 1);
+	}
+	return dest->ImportBits(source);
+}
+
+
+/* virtual */
+bool
+ImageFilterColorConvert::InPlace() const
+{
+	// Nothing to do
+	return fFrom == fTo;
+}
+
+
+/* virtual */
+BBitmap*
+ImageFilterColorConvert::CreateBitmap(BRect bounds, color_space colorSpace) const
+{
+	// The planar formats don't fit in bytes per row times height
+	int32 bytesPerRow;
+	size_t size;
+	const int32 height = bounds.IntegerHeight() + 1;
+	if (ColorConverter::GetFrameLayout(colorSpace, bounds.IntegerWidth() + 1,
+			height, &bytesPerRow, &size) != B_OK)
+		return ImageFilter::CreateBitmap(bounds, colorSpace);
+	bytesPerRow = std::max(bytesPerRow, int32((size + height - 1) / height));
+	return FrameAllocator::Allocate(kFrameStageFilter, bounds, colorSpace,
+		bytesPerRow);
+}
+
+
+// ImageFilterCursor
+ImageFilterCursor::ImageFilterCursor(const CursorTrack* track,
+	BRect capturedFrame)
+	:
+	fTrack(track),
+	fCapturedFrame(capturedFrame),
+	fScale(1, 1)
+{
+}
+
+
+/* virtual */
+status_t
+ImageFilterCursor::Prepare(BRect bounds, color_space colorSpace,
+	BRect& outBounds, color_space& outColorSpace)
+{
+	if (fTrack == NULL)
+		return B_BAD_VALUE;
+	outBounds = bounds;
+	outColorSpace = colorSpace;
+	fScale.Set(1, 1);
+	if (fCapturedFrame.IsValid()) {
+		fScale.Set((bounds.Width() + 1) / (fCapturedFrame.Width() + 1),
+			(bounds.Height() + 1) / (fCapturedFrame.Height() + 1));
 	}
+	return B_OK;
+}
+
+
+/* virtual */
+status_t
+ImageFilterCursor::Apply(const BBitmap* source, BBitmap* dest, bigtime_t frameTime)
+{
+	return fTrack->DrawCursor(dest, frameTime, fScale);
+}
+
+
+/* virtual */
+bool
+ImageFilterCursor::InPlace() const
+{
+	return true;
+}
+
+
+// ImageFilterWatermark
+ImageFilterWatermark::ImageFilterWatermark(BBitmap* image, BPoint position)
+	:
+	fImage(image),
+	fPosition(position)
+{
+}
 
-	return new BBitmap(*Bitmap());
+
+ImageFilterWatermark::~ImageFilterWatermark()
+{
+	delete fImage;
+}
+
+
+/* virtual */
+status_t
+ImageFilterWatermark::Prepare(BRect bounds, color_space colorSpace,
+	BRect& outBounds, color_space& outColorSpace)
+{
+	if (fImage == NULL || fImage->ColorSpace() != B_RGBA32)
+		return B_BAD_VALUE;
+	if (colorSpace != B_RGB32 && colorSpace != B_RGBA32)
+		return B_NOT_SUPPORTED;
+	fVisible = fImage->Bounds().OffsetToCopy(fPosition) & bounds;
+	outBounds = bounds;
+	outColorSpace = colorSpace;
+	return B_OK;
+}
+
+
+/* virtual */
+status_t
+ImageFilterWatermark::Apply(const BBitmap* source, BBitmap* dest, bigtime_t frameTime)
+{
+	if (!fVisible.IsValid())
+		return B_OK;
+
+	const int32 width = fVisible.IntegerWidth() + 1;
+	const uint8* from = (const uint8*)fImage->Bits()
+		+ (int32)(fVisible.top - fPosition.y) * fImage->BytesPerRow()
+		+ (int32)(fVisible.left - fPosition.x) * 4;
+	uint8* to = (uint8*)dest->Bits() + (int32)fVisible.top * dest->BytesPerRow()
+		+ (int32)fVisible.left * 4;
+	for (int32 y = 0; y <= fVisible.IntegerHeight(); y++) {
+		for (int32 x = 0; x < width; x++) {
+			const uint8* pixel = from + x * 4;
+			uint8* target = to + x * 4;
+			const uint32 alpha = pixel[3];
+			for (int32 c = 0; c < 3; c++)
+				target[c] = (pixel[c] * alpha + target[c] * (255 - alpha) + 127) / 255;
+		}
+		from += fImage->BytesPerRow();
+		to += dest->BytesPerRow();
+	}
+	return B_OK;
+}
+
+
+/* virtual */
+bool
+ImageFilterWatermark::InPlace() const
+{
+	return true;
 }
@@ -6,37 +6,177 @@
 #define IMAGEFILTER_H
 
 #include <GraphicsDefs.h>
+#include <Point.h>
 #include <Rect.h>
 #include <SupportDefs.h>
 
+#include <vector>
+
 class BBitmap;
 class BView;
+class CursorTrack;
+class FrameScaler;
+class WorkerPool;
+// A stage of an ImageFilterChain. Filters never allocate
+// the frames they work on: the chain gives them both the
+// source and the destination.
 class ImageFilter {
 public:
-	ImageFilter(BRect frame, color_space colorSpace);
+	ImageFilter();
 	virtual ~ImageFilter();
 
-	virtual BBitmap* ApplyFilter(BBitmap* bitmap) = 0;
-
-protected:
-	BBitmap* Bitmap();
-	BView* View();
+	// Called once before the frames are filtered, with the size
+	// and color space they have. Returns the ones of the frames
+	// the filter makes
+	virtual status_t Prepare(BRect bounds, color_space colorSpace,
+		BRect& outBounds, color_space& outColorSpace) = 0;
+	// Filters the source into the destination. Filters which work
+	// in place get the same bitmap as source and destination
+	virtual status_t Apply(const BBitmap* source, BBitmap* dest,
+		bigtime_t frameTime) = 0;
+	// Only valid after Prepare()
+	virtual bool InPlace() const;
+	// Allocates the frames the filter writes to
+	virtual BBitmap* CreateBitmap(BRect bounds, color_space colorSpace) const;
 
 private:
-	BBitmap* fBitmap;
-	BView* fView;
-
 	ImageFilter& operator=(const ImageFilter& other) = delete ;
 	ImageFilter(const ImageFilter& other) = delete ;
 };
 
 
+// Runs frames through a list of filters. The intermediate frames
+// are allocated once, when the chain sees the first frame,
+// so filtering doesn't allocate anything.
+class ImageFilterChain {
+public:
+	ImageFilterChain();
+	~ImageFilterChain();
+
+	// The chain takes ownership of the filter
+	status_t AddFilter(ImageFilter* filter);
+	int32 CountFilters() const;
+
+	status_t Prepare(BRect bounds, color_space colorSpace);
+	// Filters the frame. In place filters at the start of the
+	// chain change it. The result is either the frame itself or
+	// a bitmap owned by the chain, valid until the next call
+	status_t Apply(BBitmap* frame, bigtime_t frameTime,
+		BBitmap** _result);
+
+private:
+	struct filter_stage {
+		ImageFilter* filter;
+		// NULL for in place filters
+		BBitmap* buffer;
+	};
+
+	void _FreeBuffers();
+
+	std::vector<filter_stage> fStages;
+	BRect fBounds;
+	color_space fColorSpace;
+	bool fPrepared;
+};
+
+
+// Frames which already have the size, like the ones scaled
+// when they were captured, are left as they are
 class ImageFilterScale : public ImageFilter {
 public:
-	ImageFilterScale(BRect frame, color_space colorSpace);
+	ImageFilterScale(BRect frame, WorkerPool* pool = NULL);
 	virtual ~ImageFilterScale();
 
-	virtual BBitmap* ApplyFilter(BBitmap* bitmap);
+	virtual status_t Prepare(BRect bounds, color_space colorSpace,
+		BRect& outBounds, color_space& outColorSpace);
+	virtual status_t Apply(const BBitmap* source, BBitmap* dest,
+		bigtime_t frameTime);
+	virtual bool InPlace() const;
+
+private:
+	BRect fFrame;
+	bool fSameSize;
+	FrameScaler* fScaler;
+	// Used to scale through the app_server, when the
+	// scaler doesn't support the color space
+	BBitmap* fViewBitmap;
+	BView* fView;
+};
+
+
+class ImageFilterCrop : public ImageFilter {
+public:
+	ImageFilterCrop(BRect rect);
+
+	virtual status_t Prepare(BRect bounds, color_space colorSpace,
+		BRect& outBounds, color_space& outColorSpace);
+	virtual status_t Apply(const BBitmap* source, BBitmap* dest,
+		bigtime_t frameTime);
+
+private:
+	BRect fRect;
+};
+
+
+class ImageFilterColorConvert : public ImageFilter {
+public:
+	ImageFilterColorConvert(color_space colorSpace,
+		WorkerPool* pool = NULL);
+
+	virtual status_t Prepare(BRect bounds, color_space colorSpace,
+		BRect& outBounds, color_space& outColorSpace);
+	virtual status_t Apply(const BBitmap* source, BBitmap* dest,
+		bigtime_t frameTime);
+	virtual bool InPlace() const;
+	virtual BBitmap* CreateBitmap(BRect bounds, color_space colorSpace) const;
+
+private:
+	color_space fFrom;
+	color_space fTo;
+	WorkerPool* fWorkerPool;
+};
+
+
+// Draws the mouse pointer as it was when the frame was captured.
+// Must come before any filter which changes the frame's geometry
+class ImageFilterCursor : public ImageFilter {
+public:
+	// The positions are the ones in the captured frame: if given,
+	// the pointer is moved where it is in frames of another size
+	ImageFilterCursor(const CursorTrack* track,
+		BRect capturedFrame = BRect());
+
+	virtual status_t Prepare(BRect bounds, color_space colorSpace,
+		BRect& outBounds, color_space& outColorSpace);
+	virtual status_t Apply(const BBitmap* source, BBitmap* dest,
+		bigtime_t frameTime);
+	virtual bool InPlace() const;
+
+private:
+	const CursorTrack* fTrack;
+	BRect fCapturedFrame;
+	BPoint fScale;
+};
+
+
+// Blends a B_RGBA32 image over 32 bit frames.
+// Takes ownership of the image
+class ImageFilterWatermark : public ImageFilter {
+public:
+	ImageFilterWatermark(BBitmap* image, BPoint position);
+	virtual ~ImageFilterWatermark();
+
+	virtual status_t Prepare(BRect bounds, color_space colorSpace,
+		BRect& outBounds, color_space& outColorSpace);
+	virtual status_t Apply(const BBitmap* source, BBitmap* dest,
+		bigtime_t frameTime);
+	virtual bool InPlace() const;
+
+private:
+	BBitmap* fImage;
+	BPoint fPosition;
+	// The part of the image inside the frame
+	BRect fVisible;
 };
 
 #endif // IMAGEFILTER_H
@@ -71,6 +71,33 @@ GetFrameRateString(int32 fps)
 }
 
 
+static BString
+GetAchievedFrameRateString(float fps, int32 targetFps)
+{
+	BString string;
+	string.SetToFormat("%.1f of %" B_PRId32 " frames per second", fps, targetFps);
+	return string;
+}
+
+
+static BString
+GetQueueFillString(int32 depth, int32 capacity)
+{
+	BString string;
+	string << depth << " of " << capacity << " frames";
+	return string;
+}
+
+
+static BString
+GetDiskRateString(int64 bytesPerSecond)
+{
+	BString string;
+	string.SetToFormat("%.1f MB/s", bytesPerSecond / 1048576.0);
+	return string;
+}
+
+
 InfoView::InfoView()
 	:
 	BView("info", B_WILL_DRAW)
@@ -92,6 +119,14 @@ InfoView::InfoView()
 	codecView->SetExplicitAlignment(BAlignment(B_ALIGN_RIGHT, B_ALIGN_MIDDLE));
 	BStringView* rateView = new BStringView("frame_rate", "Capture frame rate:");
 	rateView->SetExplicitAlignment(BAlignment(B_ALIGN_RIGHT, B_ALIGN_MIDDLE));
+	BStringView* achievedRateView = new BStringView("achieved_frame_rate", "Achieved frame rate:");
+	achievedRateView->SetExplicitAlignment(BAlignment(B_ALIGN_RIGHT, B_ALIGN_MIDDLE));
+	BStringView* droppedView = new BStringView("dropped_frames", "Dropped frames:");
+	droppedView->SetExplicitAlignment(BAlignment(B_ALIGN_RIGHT, B_ALIGN_MIDDLE));
+	BStringView* queueView = new BStringView("queue_fill", "Frame queue:");
+	queueView->SetExplicitAlignment(BAlignment(B_ALIGN_RIGHT, B_ALIGN_MIDDLE));
+	BStringView* diskView = new BStringView("disk_rate", "Disk:");
+	diskView->SetExplicitAlignment(BAlignment(B_ALIGN_RIGHT, B_ALIGN_MIDDLE));
 	BLayoutBuilder::Grid<>(this, B_USE_DEFAULT_SPACING, B_USE_DEFAULT_SPACING)
 		.Add(sizeView, 0, 0)
 		.Add(fSourceSize = new BStringView("source_size_value", GetSourceRectString(sourceArea)), 1, 0)
@@ -105,7 +140,17 @@ InfoView::InfoView()
 		.Add(fCodec = new BStringView("codec value", ""), 1, 4)
 		.Add(rateView, 0, 5)
 		.Add(fCaptureFrameRate = new BStringView("frame_rate value", GetFrameRateString(settings.CaptureFrameRate())), 1, 5)
-		.AddGlue(0, 2, 6, 0);
+		.Add(achievedRateView, 0, 6)
+		.Add(fAchievedFrameRate = new BStringView("achieved_frame_rate value", ""), 1, 6)
+		.Add(droppedView, 0, 7)
+		.Add(fDroppedFrames = new BStringView("dropped_frames value", ""), 1, 7)
+		.Add(queueView, 0, 8)
+		.Add(fQueueFill = new BStringView("queue_fill value", ""), 1, 8)
+		.Add(diskView, 0, 9)
+		.Add(fDiskRate = new BStringView("disk_rate value", ""), 1, 9)
+		.AddGlue(0, 2, 10, 0);
+
+	_ResetCaptureStats();
 }
 
 
@@ -120,6 +165,8 @@ InfoView::AttachedToWindow()
 		be_app->StartWatching(this, kMsgControllerCodecChanged);
 		be_app->StartWatching(this, kMsgControllerMediaFileFormatChanged);
 		be_app->StartWatching(this, kMsgControllerCaptureFrameRateChanged);
+		be_app->StartWatching(this, kMsgControllerCaptureStarted);
+		be_app->StartWatching(this, kMsgControllerCaptureProgress);
 		be_app->UnlockLooper();
 	}
 
@@ -185,6 +232,12 @@ InfoView::MessageReceived(BMessage* message)
 					}
 					break;
 				}
+				case kMsgControllerCaptureStarted:
+					_ResetCaptureStats();
+					break;
+				case kMsgControllerCaptureProgress:
+					_UpdateCaptureStats(message);
+					break;
 				default:
 					break;
 			}
@@ -194,3 +247,46 @@ InfoView::MessageReceived(BMessage* message)
 			break;
 	}
 }
+
+
+// What the last capture achieved stays shown until the next one starts
+void
+InfoView::_ResetCaptureStats()
+{
+	fAchievedFrameRate->SetText("-");
+	fDroppedFrames->SetText("-");
+	fQueueFill->SetText("-");
+	fDiskRate->SetText("-");
+}
+
+
+void
+InfoView::_UpdateCaptureStats(const BMessage* message)
+{
+	float fps = 0;
+	int32 targetFps = 0;
+	if (message->FindFloat("fps", &fps) == B_OK
+		&& message->FindInt32("target_fps", &targetFps) == B_OK)
+		fAchievedFrameRate->SetText(GetAchievedFrameRateString(fps, targetFps));
+
+	// Both are lost: too late for the frame, or no buffer for it
+	int32 dropped = 0;
+	int32 skipped = 0;
+	if (message->FindInt32("frames_dropped", &dropped) == B_OK
+		&& message->FindInt32("frames_skipped", &skipped) == B_OK) {
+		BString string;
+		string << dropped + skipped;
+		fDroppedFrames->SetText(string.String());
+	}
+
+	int32 depth = 0;
+	int32 capacity = 0;
+	if (message->FindInt32("queue_depth", &depth) == B_OK
+		&& message->FindInt32("queue_capacity", &capacity) == B_OK
+		&& capacity > 0)
+		fQueueFill->SetText(GetQueueFillString(depth, capacity));
+
+	int64 diskRate = 0;
+	if (message->FindInt64("disk_rate", &diskRate) == B_OK)
+		fDiskRate->SetText(GetDiskRateString(diskRate));
+}
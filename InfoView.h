@@ -16,12 +16,19 @@ public:
 	virtual void MessageReceived(BMessage* message);
 
 private:
+	void _ResetCaptureStats();
+	void _UpdateCaptureStats(const BMessage* message);
+
 	BStringView* fSourceSize;
 	BStringView* fClipSize;
 	BStringView* fScale;
 	BStringView* fFormat;
 	BStringView* fCodec;
 	BStringView* fCaptureFrameRate;
+	BStringView* fAchievedFrameRate;
+	BStringView* fDroppedFrames;
+	BStringView* fQueueFill;
+	BStringView* fDiskRate;
 };
 
 
@@ -0,0 +1,477 @@
+/*
+ * Copyright 2026 Stefano Ceccherini <stefano.ceccherini@gmail.com>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+#include "MediaCache.h"
+
+#include "FunctionObject.h"
+#include "Utils.h"
+#include "WorkerPool.h"
+
+#include <Autolock.h>
+#include <Directory.h>
+#include <Entry.h>
+#include <File.h>
+#include <FindDirectory.h>
+#include <Message.h>
+#include <Path.h>
+
+#include <cstring>
+#include <iostream>
+#include <new>
+
+// Increase when the saved message changes
+const static int32 kCacheVersion = 1;
+
+const static char* kCacheFileName = "media_cache";
+const static char* kVersion = "version";
+const static char* kStructSizes = "struct_sizes";
+const static char* kStamp = "stamp";
+const static char* kFileFormat = "file_format";
+const static char* kEncoders = "encoders";
+const static char* kFormat = "format";
+const static char* kCodec = "codec";
+
+static BLocker sDefaultLocker("media cache");
+static MediaCache* sDefault = NULL;
+
+
+static inline bool
+SameInput(const media_format& a, const media_format& b)
+{
+	return a.type == b.type
+		&& a.u.raw_video.display.format == b.u.raw_video.display.format;
+}
+
+
+// Saved with the cache: a different build can't read it
+static inline int32
+StructSizes()
+{
+	return int32(sizeof(media_file_format) + (sizeof(media_format) << 10)
+		+ (sizeof(media_codec_info) << 20));
+}
+
+
+// FNV-1a
+static inline uint64
+HashBytes(uint64 hash, const void* data, size_t size)
+{
+	const uint8* bytes = (const uint8*)data;
+	for (size_t i = 0; i < size; i++) {
+		hash ^= bytes[i];
+		hash *= 1099511628211ULL;
+	}
+	return hash;
+}
+
+
+MediaCache::MediaCache()
+	:
+	fLocker("media cache lock"),
+	fHaveFileFormats(false),
+	fStamp(0),
+	fLoaded(false),
+	fDirty(false)
+{
+}
+
+
+/* static */
+MediaCache*
+MediaCache::Default()
+{
+	BAutolock _(sDefaultLocker);
+	if (sDefault == NULL) {
+		sDefault = new (std::nothrow) MediaCache;
+		if (sDefault != NULL)
+			sDefault->Load();
+	}
+	return sDefault;
+}
+
+
+/* static */
+void
+MediaCache::DeleteDefault()
+{
+	BAutolock _(sDefaultLocker);
+	if (sDefault != NULL)
+		sDefault->Save();
+	delete sDefault;
+	sDefault = NULL;
+}
+
+
+status_t
+MediaCache::GetFileFormats(BObjectList<media_file_format>& formats)
+{
+	BAutolock _(fLocker);
+	if (!fHaveFileFormats) {
+		_EnumerateFileFormats(fFileFormats);
+		fHaveFileFormats = true;
+		fDirty = true;
+	}
+	for (size_t i = 0; i < fFileFormats.size(); i++) {
+		media_file_format* format = new (std::nothrow) media_file_format(fFileFormats[i]);
+		if (format == NULL || !formats.AddItem(format)) {
+			delete format;
+			return B_NO_MEMORY;
+		}
+	}
+	return B_OK;
+}
+
+
+status_t
+MediaCache::GetEncoders(const media_file_format& fileFormat,
+	const media_format& format, BObjectList<media_codec_info>& codecs)
+{
+	BAutolock _(fLocker);
+	encoder_list* list = _FindEncoders(fEncoders, fileFormat.short_name, format);
+	if (list == NULL) {
+		encoder_list newList;
+		newList.fileFormat = fileFormat.short_name;
+		newList.format = format;
+		_EnumerateEncoders(fileFormat, format, newList.codecs);
+		fEncoders.push_back(newList);
+		fDirty = true;
+		list = &fEncoders.back();
+	}
+	for (size_t i = 0; i < list->codecs.size(); i++) {
+		media_codec_info* codec = new (std::nothrow) media_codec_info(list->codecs[i]);
+		if (codec == NULL || !codecs.AddItem(codec)) {
+			delete codec;
+			return B_NO_MEMORY;
+		}
+	}
+	return B_OK;
+}
+
+
+status_t
+MediaCache::Revalidate(const BMessenger& target, uint32 what)
+{
+	WorkerPool* pool = WorkerPool::Shared(WorkerPool::kBackgroundWork);
+	if (pool == NULL)
+		return B_NO_MEMORY;
+	FunctionObject* task = new (std::nothrow) TwoParamMemberFunctionObject
+		<MediaCache, BMessenger, uint32>(&MediaCache::_Revalidate, this,
+			target, what);
+	if (task == NULL)
+		return B_NO_MEMORY;
+	return pool->Post(task);
+}
+
+
+status_t
+MediaCache::Load()
+{
+	BPath path;
+	status_t status = _GetCachePath(path);
+	BFile file;
+	if (status == B_OK)
+		status = file.SetTo(path.Path(), B_READ_ONLY);
+	BMessage message;
+	if (status == B_OK)
+		status = message.Unflatten(&file);
+	if (status != B_OK)
+		return status;
+
+	int32 version = 0;
+	int32 structSizes = 0;
+	message.FindInt32(kVersion, &version);
+	message.FindInt32(kStructSizes, &structSizes);
+	if (version != kCacheVersion || structSizes != StructSizes())
+		return B_MISMATCHED_VALUES;
+
+	std::vector<media_file_format> fileFormats;
+	const void* data = NULL;
+	ssize_t size = 0;
+	for (int32 i = 0; message.FindData(kFileFormat, B_RAW_TYPE, i,
+			&data, &size) == B_OK; i++) {
+		if (size != sizeof(media_file_format))
+			return B_BAD_DATA;
+		fileFormats.push_back(*(const media_file_format*)data);
+	}
+
+	std::vector<encoder_list> encoders;
+	BMessage encodersMessage;
+	for (int32 i = 0; message.FindMessage(kEncoders, i,
+			&encodersMessage) == B_OK; i++) {
+		encoder_list list;
+		const char* fileFormat = NULL;
+		if (encodersMessage.FindString(kFileFormat, &fileFormat) != B_OK
+			|| encodersMessage.FindData(kFormat, B_RAW_TYPE, &data, &size) != B_OK
+			|| size != sizeof(media_format))
+			return B_BAD_DATA;
+		list.fileFormat = fileFormat;
+		list.format = *(const media_format*)data;
+		for (int32 c = 0; encodersMessage.FindData(kCodec, B_RAW_TYPE, c,
+				&data, &size) == B_OK; c++) {
+			if (size != sizeof(media_codec_info))
+				return B_BAD_DATA;
+			list.codecs.push_back(*(const media_codec_info*)data);
+		}
+		encoders.push_back(list);
+	}
+
+	BAutolock _(fLocker);
+	message.FindInt64(kStamp, (int64*)&fStamp);
+	fFileFormats = fileFormats;
+	// An empty list is enumerated again, in case it wasn't asked for
+	fHaveFileFormats = !fileFormats.empty();
+	fEncoders = encoders;
+	fLoaded = true;
+	fDirty = false;
+	return B_OK;
+}
+
+
+status_t
+MediaCache::Save()
+{
+	BMessage message;
+	{
+		BAutolock _(fLocker);
+		if (!fDirty)
+			return B_OK;
+		// Without a stamp it would be thrown away at the next launch
+		if (fStamp == 0)
+			fStamp = _PluginsStamp();
+		message.AddInt32(kVersion, kCacheVersion);
+		message.AddInt32(kStructSizes, StructSizes());
+		message.AddInt64(kStamp, int64(fStamp));
+		for (size_t i = 0; i < fFileFormats.size(); i++) {
+			message.AddData(kFileFormat, B_RAW_TYPE, &fFileFormats[i],
+				sizeof(media_file_format));
+		}
+		for (size_t i = 0; i < fEncoders.size(); i++) {
+			BMessage encodersMessage;
+			encodersMessage.AddString(kFileFormat, fEncoders[i].fileFormat);
+			encodersMessage.AddData(kFormat, B_RAW_TYPE, &fEncoders[i].format,
+				sizeof(media_format));
+			for (size_t c = 0; c < fEncoders[i].codecs.size(); c++) {
+				encodersMessage.AddData(kCodec, B_RAW_TYPE,
+					&fEncoders[i].codecs[c], sizeof(media_codec_info));
+			}
+			message.AddMessage(kEncoders, &encodersMessage);
+		}
+		fDirty = false;
+	}
+
+	BPath path;
+	status_t status = _GetCachePath(path);
+	BFile file;
+	if (status == B_OK)
+		status = file.SetTo(path.Path(), B_WRITE_ONLY | B_CREATE_FILE | B_ERASE_FILE);
+	if (status == B_OK)
+		status = message.Flatten(&file);
+	if (status != B_OK)
+		std::cerr << "MediaCache: can't save: " << ::strerror(status) << std::endl;
+	return status;
+}
+
+
+// Background thread. The Media Kit is enumerated without holding
+// the lock, so the lookups aren't blocked meanwhile
+void
+MediaCache::_Revalidate(BMessenger target, uint32 what)
+{
+	const uint64 stamp = _PluginsStamp();
+	std::vector<encoder_list> encoders;
+	bool enumerated = false;
+	{
+		BAutolock _(fLocker);
+		if (fLoaded && stamp == fStamp)
+			return;
+		// Not saved yet: everything was just enumerated
+		enumerated = !fLoaded;
+		if (enumerated) {
+			fStamp = stamp;
+			fLoaded = true;
+			fDirty = true;
+		} else
+			encoders = fEncoders;
+	}
+	if (enumerated) {
+		Save();
+		return;
+	}
+
+	std::cout << "MediaCache: the media plugins changed" << std::endl;
+	std::vector<media_file_format> fileFormats;
+	_EnumerateFileFormats(fileFormats);
+	std::vector<encoder_list> newEncoders;
+	for (size_t i = 0; i < encoders.size(); i++) {
+		// Only the file formats which are still there
+		for (size_t f = 0; f < fileFormats.size(); f++) {
+			if (encoders[i].fileFormat != fileFormats[f].short_name)
+				continue;
+			encoder_list list;
+			list.fileFormat = encoders[i].fileFormat;
+			list.format = encoders[i].format;
+			_EnumerateEncoders(fileFormats[f], list.format, list.codecs);
+			newEncoders.push_back(list);
+			break;
+		}
+	}
+
+	bool changed = false;
+	{
+		BAutolock _(fLocker);
+		changed = !_SameFileFormats(fFileFormats, fileFormats)
+			|| newEncoders.size() != encoders.size();
+		for (size_t i = 0; i < newEncoders.size() && !changed; i++) {
+			encoder_list* old = _FindEncoders(fEncoders,
+				newEncoders[i].fileFormat, newEncoders[i].format);
+			changed = old == NULL || !_SameCodecs(old->codecs, newEncoders[i].codecs);
+		}
+		// Looked up meanwhile: already up to date
+		for (size_t i = 0; i < fEncoders.size(); i++) {
+			if (_FindEncoders(encoders, fEncoders[i].fileFormat,
+					fEncoders[i].format) == NULL)
+				newEncoders.push_back(fEncoders[i]);
+		}
+		fFileFormats = fileFormats;
+		fHaveFileFormats = true;
+		fEncoders = newEncoders;
+		fStamp = stamp;
+		fDirty = true;
+	}
+	Save();
+
+	if (changed)
+		target.SendMessage(what);
+}
+
+
+/* static */
+MediaCache::encoder_list*
+MediaCache::_FindEncoders(std::vector<encoder_list>& lists,
+	const char* fileFormat, const media_format& format)
+{
+	for (size_t i = 0; i < lists.size(); i++) {
+		if (lists[i].fileFormat == fileFormat && SameInput(lists[i].format, format))
+			return &lists[i];
+	}
+	return NULL;
+}
+
+
+/* static */
+void
+MediaCache::_EnumerateFileFormats(std::vector<media_file_format>& formats)
+{
+	formats.clear();
+	media_file_format format;
+	int32 cookie = 0;
+	while (get_next_file_format(&cookie, &format) == B_OK) {
+		if (IsFileFormatUsable(format))
+			formats.push_back(format);
+	}
+}
+
+
+/* static */
+void
+MediaCache::_EnumerateEncoders(const media_file_format& fileFormat,
+	const media_format& format, std::vector<media_codec_info>& codecs)
+{
+	codecs.clear();
+	int32 cookie = 0;
+	media_codec_info codec;
+	media_format dummyFormat;
+	while (get_next_encoder(&cookie, &fileFormat, &format,
+			&dummyFormat, &codec) == B_OK) {
+		codecs.push_back(codec);
+	}
+}
+
+
+/* static */
+bool
+MediaCache::_SameFileFormats(const std::vector<media_file_format>& a,
+	const std::vector<media_file_format>& b)
+{
+	if (a.size() != b.size())
+		return false;
+	for (size_t i = 0; i < a.size(); i++) {
+		if (a[i].capabilities != b[i].capabilities
+			|| ::strcmp(a[i].short_name, b[i].short_name) != 0
+			|| ::strcmp(a[i].pretty_name, b[i].pretty_name) != 0)
+			return false;
+	}
+	return true;
+}
+
+
+/* static */
+bool
+MediaCache::_SameCodecs(const std::vector<media_codec_info>& a,
+	const std::vector<media_codec_info>& b)
+{
+	if (a.size() != b.size())
+		return false;
+	for (size_t i = 0; i < a.size(); i++) {
+		if (a[i].id != b[i].id || a[i].sub_id != b[i].sub_id
+			|| ::strcmp(a[i].pretty_name, b[i].pretty_name) != 0)
+			return false;
+	}
+	return true;
+}
+
+
+// The names and modification times of the media plugins, wherever
+// they can be installed. Every entry is hashed on its own and
+// summed, so the order they're read in doesn't matter
+/* static */
+uint64
+MediaCache::_PluginsStamp()
+{
+	const directory_which kDirectories[] = {
+		B_SYSTEM_ADDONS_DIRECTORY,
+		B_SYSTEM_NONPACKAGED_ADDONS_DIRECTORY,
+		B_USER_ADDONS_DIRECTORY,
+		B_USER_NONPACKAGED_ADDONS_DIRECTORY
+	};
+	uint64 stamp = 0;
+	for (size_t i = 0; i < sizeof(kDirectories) / sizeof(kDirectories[0]); i++) {
+		BPath path;
+		if (find_directory(kDirectories[i], &path) != B_OK
+			|| path.Append("media/plugins") != B_OK)
+			continue;
+		BDirectory directory(path.Path());
+		if (directory.InitCheck() != B_OK)
+			continue;
+		BEntry entry;
+		while (directory.GetNextEntry(&entry) == B_OK) {
+			char name[B_FILE_NAME_LENGTH];
+			time_t modified = 0;
+			if (entry.GetName(name) != B_OK
+				|| entry.GetModificationTime(&modified) != B_OK)
+				continue;
+			uint64 hash = HashBytes(14695981039346656037ULL, &i, sizeof(i));
+			hash = HashBytes(hash, name, ::strlen(name));
+			hash = HashBytes(hash, &modified, sizeof(modified));
+			stamp += hash;
+		}
+	}
+	// 0 means "not known"
+	return stamp != 0 ? stamp : 1;
+}
+
+
+/* static */
+status_t
+MediaCache::_GetCachePath(BPath& path)
+{
+	status_t status = find_directory(B_USER_SETTINGS_DIRECTORY, &path);
+	if (status == B_OK)
+		status = path.Append("BeScreenCapture");
+	if (status == B_OK)
+		status = create_directory(path.Path(), 0755);
+	if (status == B_OK)
+		status = path.Append(kCacheFileName);
+	return status;
+}
@@ -0,0 +1,86 @@
+/*
+ * Copyright 2026 Stefano Ceccherini <stefano.ceccherini@gmail.com>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+#ifndef __MEDIACACHE_H
+#define __MEDIACACHE_H
+
+#include <Locker.h>
+#include <MediaDefs.h>
+#include <MediaFormats.h>
+#include <Messenger.h>
+#include <ObjectList.h>
+#include <String.h>
+
+#include <vector>
+
+class BPath;
+// The usable file formats and their encoders, as the Media Kit
+// enumerates them, saved in the settings directory so the application
+// doesn't ask the media add-ons at every launch.
+// The saved lists are tagged with the names and modification times
+// of the media plugins: Revalidate() compares them in the background
+// and enumerates again only if the plugins changed.
+// The encoders are kept for every file format and color space: their
+// list doesn't depend on the size of the frames. Thread safe.
+class MediaCache {
+public:
+	// Created and loaded when first asked for
+	static MediaCache* Default();
+	// When quitting, after the worker pools are gone. Saves the cache
+	static void DeleteDefault();
+
+	// The file formats IsFileFormatUsable() accepts, enumerated if
+	// not cached yet
+	status_t GetFileFormats(BObjectList<media_file_format>& formats);
+	// The encoders which write the file format from raw frames of
+	// the given format
+	status_t GetEncoders(const media_file_format& fileFormat,
+				const media_format& format,
+				BObjectList<media_codec_info>& codecs);
+
+	// Checks the media plugins on a background thread. If the cached
+	// lists are outdated, they are enumerated again and, if they
+	// changed, a message with the given code is sent to target
+	status_t Revalidate(const BMessenger& target, uint32 what);
+
+	status_t Load();
+	status_t Save();
+
+private:
+	struct encoder_list {
+		BString fileFormat;
+		media_format format;
+		std::vector<media_codec_info> codecs;
+	};
+
+	MediaCache();
+
+	void _Revalidate(BMessenger target, uint32 what);
+	static encoder_list* _FindEncoders(std::vector<encoder_list>& lists,
+				const char* fileFormat, const media_format& format);
+
+	static void _EnumerateFileFormats(std::vector<media_file_format>& formats);
+	static void _EnumerateEncoders(const media_file_format& fileFormat,
+				const media_format& format,
+				std::vector<media_codec_info>& codecs);
+	static bool _SameFileFormats(const std::vector<media_file_format>& a,
+				const std::vector<media_file_format>& b);
+	static bool _SameCodecs(const std::vector<media_codec_info>& a,
+				const std::vector<media_codec_info>& b);
+	static uint64 _PluginsStamp();
+	static status_t _GetCachePath(BPath& path);
+
+	BLocker fLocker;
+	std::vector<media_file_format> fFileFormats;
+	bool fHaveFileFormats;
+	std::vector<encoder_list> fEncoders;
+	uint64 fStamp;
+	bool fLoaded;
+	bool fDirty;
+
+	MediaCache(const MediaCache&) = delete;
+	MediaCache& operator=(const MediaCache&) = delete;
+};
+
+#endif // __MEDIACACHE_H
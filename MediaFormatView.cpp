@@ -6,6 +6,8 @@
 #include "MediaFormatView.h"
 #include "BSCApp.h"
 #include "ControllerObserver.h"
+#include "MediaCache.h"
+#include "Settings.h"
 #include "Utils.h"
 
 #include <Button.h>
@@ -14,6 +16,7 @@
 #include <MenuItem.h>
 #include <MenuField.h>
 #include <PopUpMenu.h>
+#include <StringView.h>
 #include <TextControl.h>
 
 
@@ -23,6 +26,7 @@
 
 const static int32 kLocalCodecChanged = 'CdCh';
 const static int32 kLocalFileTypeChanged = 'FtyC';
+const static int32 kLocalFindFastestCodec = 'FfCo';
 
 class MediaFileFormatMenuItem : public BMenuItem {
 public:
@@ -37,7 +41,9 @@ MediaFormatView::MediaFormatView()
 	:
 	BView("media_options", B_WILL_DRAW),
 	fOutputFileType(NULL),
-	fCodecMenu(NULL)
+	fCodecMenu(NULL),
+	fCodecSpeed(NULL),
+	fFastestButton(NULL)
 {
 	const char *kOutputMenuLabel = B_TRANSLATE("File format:");
 	BPopUpMenu *fileFormatPopUp = new BPopUpMenu("format");
@@ -48,11 +54,20 @@ MediaFormatView::MediaFormatView()
 	BPopUpMenu *popUpMenu = new BPopUpMenu("codecs");
 	fCodecMenu = new BMenuField("outcodec", kCodecMenuLabel, popUpMenu);
 
+	fCodecSpeed = new BStringView("codec_speed", "");
+	fFastestButton = new BButton("fastest_codec", B_TRANSLATE("Find fastest"),
+		new BMessage(kLocalFindFastestCodec));
+
 	BLayoutBuilder::Grid<>(this, B_USE_DEFAULT_SPACING, B_USE_DEFAULT_SPACING)
 		.Add(fOutputFileType->CreateLabelLayoutItem(), 0, 0)
 		.Add(fOutputFileType->CreateMenuBarLayoutItem(), 1, 0)
 		.Add(fCodecMenu->CreateLabelLayoutItem(), 0, 1)
 		.Add(fCodecMenu->CreateMenuBarLayoutItem(), 1, 1)
+		.AddGroup(B_HORIZONTAL, B_USE_DEFAULT_SPACING, 1, 2)
+			.Add(fCodecSpeed)
+			.AddGlue()
+			.Add(fFastestButton)
+		.End()
 		.AddGlue(0, 3)
 		.SetInsets(0, 0);
 }
@@ -81,6 +96,8 @@ MediaFormatView::AttachedToWindow()
 		be_app->StartWatching(this, kMsgControllerMediaFileFormatChanged);
 		be_app->StartWatching(this, kMsgControllerVideoDepthChanged);
 		be_app->StartWatching(this, kMsgControllerCodecChanged);
+		be_app->StartWatching(this, kMsgControllerCodecSpeedMeasured);
+		be_app->StartWatching(this, kMsgControllerFileFormatListUpdated);
 		be_app->UnlockLooper();
 	}
 
@@ -100,6 +117,7 @@ MediaFormatView::AttachedToWindow()
 	}
 
 	fOutputFileType->Menu()->SetTargetForItems(this);
+	fFastestButton->SetTarget(this);
 	BString codecName = app->MediaCodecName();
 	if (codecName != "") {
 		BMenuItem* codecItem = fCodecMenu->Menu()->FindItem(codecName);
@@ -126,10 +144,17 @@ MediaFormatView::MessageReceived(BMessage *message)
 		case kLocalCodecChanged:
 		{
 			BMenuItem* marked = fCodecMenu->Menu()->FindMarked();
-			if (marked != NULL)
+			if (marked != NULL) {
 				app->SetMediaCodec(marked->Label());
+				// Tells if it's too slow, once measured
+				app->MeasureCodecSpeed(false);
+			}
 			break;
 		}
+		case kLocalFindFastestCodec:
+			if (app->MeasureCodecSpeed(true))
+				fCodecSpeed->SetText(B_TRANSLATE("Measuring" B_UTF8_ELLIPSIS));
+			break;
 		case B_OBSERVER_NOTICE_CHANGE:
 		{
 			int32 code;
@@ -138,6 +163,11 @@ MediaFormatView::MessageReceived(BMessage *message)
 				case kMsgControllerCodecListUpdated:
 					_RebuildCodecsMenu();
 					break;
+				case kMsgControllerFileFormatListUpdated:
+					_BuildFileFormatsMenu();
+					fOutputFileType->Menu()->SetTargetForItems(this);
+					_SelectFileFormatMenuItem(app->MediaFileFormatName().String());
+					break;
 				case kMsgControllerMediaFileFormatChanged:
 				{
 					const char* formatName = NULL;
@@ -156,6 +186,22 @@ MediaFormatView::MessageReceived(BMessage *message)
 							break;
 						}
 					}
+					_ShowCachedCodecSpeed();
+					break;
+				}
+				case kMsgControllerCodecSpeedMeasured:
+				{
+					// Only the speed of the current codec is shown
+					const char* codecName = NULL;
+					BMenuItem* marked = fCodecMenu->Menu()->FindMarked();
+					if (message->FindString("codec_name", &codecName) != B_OK
+						|| marked == NULL || ::strcmp(marked->Label(), codecName) != 0)
+						break;
+					float frameRate = -1;
+					float targetFrameRate = 0;
+					message->FindFloat("fps", &frameRate);
+					message->FindFloat("target_fps", &targetFrameRate);
+					_ShowCodecSpeed(frameRate, targetFrameRate);
 					break;
 				}
 				case kMsgControllerVideoDepthChanged:
@@ -165,10 +211,12 @@ MediaFormatView::MessageReceived(BMessage *message)
 				case kMsgControllerEncodeStarted:
 					fCodecMenu->SetEnabled(false);
 					fOutputFileType->SetEnabled(false);
+					fFastestButton->SetEnabled(false);
 					break;
 				case kMsgControllerEncodeFinished:
 					fCodecMenu->SetEnabled(true);
 					fOutputFileType->SetEnabled(true);
+					fFastestButton->SetEnabled(true);
 					break;
 				default:
 					break;
@@ -193,12 +241,12 @@ MediaFormatView::_BuildFileFormatsMenu()
 	if (numItems > 0)
 		menu->RemoveItems(0, numItems);
 
-	media_file_format mediaFileFormat;
-	int32 cookie = 0;
-	while (get_next_file_format(&cookie, &mediaFileFormat) == B_OK) {
-		if (IsFileFormatUsable(mediaFileFormat)) {
+	BObjectList<media_file_format> formats(20, true);
+	MediaCache* cache = MediaCache::Default();
+	if (cache != NULL && cache->GetFileFormats(formats) == B_OK) {
+		for (int32 i = 0; i < formats.CountItems(); i++) {
 			MediaFileFormatMenuItem* item = new MediaFileFormatMenuItem(
-					mediaFileFormat);
+					*formats.ItemAt(i));
 			menu->AddItem(item);
 		}
 	}
@@ -208,13 +256,11 @@ MediaFormatView::_BuildFileFormatsMenu()
 	MediaFileFormatMenuItem* nullItem = new MediaFileFormatMenuItem(nullFormat);
 	menu->AddItem(nullItem);
 
-	// TODO: Maybe Haiku could support this by enabling this in the ffmpeg addon ?
-	if (IsFFMPEGAvailable()) {
-		media_file_format gifFormat;
-		MakeGIFMediaFileFormat(gifFormat);
-		MediaFileFormatMenuItem* gifItem = new MediaFileFormatMenuItem(gifFormat);
-		menu->AddItem(gifItem);
-	}
+	// GIF files are written by GIFEncoder
+	media_file_format gifFormat;
+	MakeGIFMediaFileFormat(gifFormat);
+	MediaFileFormatMenuItem* gifItem = new MediaFileFormatMenuItem(gifFormat);
+	menu->AddItem(gifItem);
 }
 
 
@@ -265,6 +311,34 @@ MediaFormatView::_RebuildCodecsMenu(const char* currentCodec)
 			app->SetMediaCodec(codecsMenu->FindMarked()->Label());
 		codecsMenu->SetEnabled(true);
 	}
+	_ShowCachedCodecSpeed();
+}
+
+
+// The speed is only known once measured, for every frame size
+void
+MediaFormatView::_ShowCodecSpeed(float frameRate, float targetFrameRate)
+{
+	BString text;
+	if (frameRate >= 0 && frameRate < targetFrameRate) {
+		text.SetToFormat(B_TRANSLATE_COMMENT("%.1f frames/s: slower than the capture",
+			"Encoding speed of the codec"), frameRate);
+	} else if (frameRate >= 0) {
+		text.SetToFormat(B_TRANSLATE_COMMENT("%.1f frames/s",
+			"Encoding speed of the codec"), frameRate);
+	}
+	fCodecSpeed->SetText(text.String());
+}
+
+
+void
+MediaFormatView::_ShowCachedCodecSpeed()
+{
+	BSCApp* app = dynamic_cast<BSCApp*>(be_app);
+	BMenuItem* marked = fCodecMenu->Menu()->FindMarked();
+	const float frameRate = marked != NULL
+		? app->CodecFrameRate(marked->Label()) : -1;
+	_ShowCodecSpeed(frameRate, float(Settings::Current().CaptureFrameRate()));
 }
 
 
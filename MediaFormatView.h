@@ -9,7 +9,9 @@
 #include <String.h>
 #include <View.h>
 
+class BButton;
 class BMenuField;
+class BStringView;
 class MediaFormatView : public BView {
 public:
 	MediaFormatView();
@@ -23,9 +25,13 @@ public:
 private:
 	BMenuField *fOutputFileType;
 	BMenuField *fCodecMenu;
+	BStringView *fCodecSpeed;
+	BButton *fFastestButton;
 
 	void _BuildFileFormatsMenu();
 	void _RebuildCodecsMenu(const char* currentCodec = NULL);
+	void _ShowCodecSpeed(float frameRate, float targetFrameRate);
+	void _ShowCachedCodecSpeed();
 
 	void _SetFileNameExtension(const char* extension);
 
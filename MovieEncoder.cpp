@@ -41,11 +41,21 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include "MovieEncoder.h"
 
+#include "ColorConverter.h"
 #include "Constants.h"
+#include "FrameAllocator.h"
+#include "FramePool.h"
+#include "FramePrefetcher.h"
+#include "FrameQueue.h"
+#include "FrameStore.h"
 #include "FramesList.h"
+#include "GIFEncoder.h"
 #include "ImageFilter.h"
+#include "PipelineStats.h"
 #include "Settings.h"
+#include "TraceRecorder.h"
 #include "Utils.h"
+#include "WorkerPool.h"
 
 #include <Bitmap.h>
 #include <Debug.h>
@@ -53,21 +63,104 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <Entry.h>
 #include <FindDirectory.h>
 #include <MediaTrack.h>
+#include <String.h>
 #include <View.h>
 
+#include <algorithm>
 #include <iostream>
+#include <new>
+#include <vector>
+
+#include <signal.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+// Segments shorter than this aren't worth a thread
+const static int32 kMinSegmentFrames = 100;
+// Share of the frame which must change to start a new scene
+const static float kSceneChangeRatio = 0.5f;
+// The pause after every frame while throttled
+const static bigtime_t kThrottleDelay = 10000;
+
+
+// There's one interval less than the frames. Frames which were
+// the same as the previous one are in the list too, so this
+// is the rate they were captured at.
+// With the adaptive frame rate, it's the highest one: the
+// frames are written again to fill the gaps
+static float
+ClipFrameRate(const FramesList* list, const session_config& session)
+{
+	const int32 frames = list->CountItems();
+	const bigtime_t diff = frames > 1
+		? list->ItemAt(frames - 1)->TimeStamp() - list->ItemAt(0)->TimeStamp() : 0;
+	if (diff <= 0 || session.adaptiveFrameRate)
+		return std::max(session.frameRate, int32(1));
+	return CalculateFPS(frames - 1, diff);
+}
+
+
+// How many times a frame is written, so it lasts until the next
+// one: always once, unless the capture rate was adaptive. The frame
+// periods are counted from time 0, so the rounding doesn't add up
+static int32
+CountCopies(const session_config& session, bigtime_t frameTime,
+	bigtime_t nextTime)
+{
+	if (!session.adaptiveFrameRate || nextTime <= frameTime)
+		return 1;
+	const int64 rate = std::max(session.frameRate, int32(1));
+	const int64 copies = nextTime * rate / 1000000 - frameTime * rate / 1000000;
+	return int32(std::max(copies, int64(1)));
+}
+
+
+// Of the frame after the given one, or of the frame itself if last
+static bigtime_t
+NextFrameTime(const FramesList* list, int32 index)
+{
+	const BitmapEntry* next = list->ItemAt(index + 1);
+	return next != NULL ? next->TimeStamp() : list->ItemAt(index)->TimeStamp();
+}
 
 
 MovieEncoder::MovieEncoder()
 	:
 	fEncoderThread(-1),
 	fKillThread(false),
+	fPriority(B_DISPLAY_PRIORITY),
+	fThrottled(0),
+	fThreadThrottled(false),
 	fFileList(NULL),
-	fCursorQueue(NULL),
+	fDecompressionPool(NULL),
+	fStats(NULL),
+	fSession(Settings::Current().SessionConfig()),
 	fColorSpace(B_NO_COLOR_SPACE),
+	fQuality(-1),
 	fMediaFile(NULL),
 	fMediaTrack(NULL),
-	fHeaderCommitted(false)
+	fHeaderCommitted(false),
+	fLiveFramePool(NULL),
+	fLiveQueue(NULL),
+	fLiveFilters(NULL),
+	fLiveBehind(0),
+	fLiveWaiting(false),
+	fLiveDrainedSem(-1),
+	fLiveSourceSem(-1),
+	fKeyFrameInterval(1),
+	fSceneChangeKeyFrames(false),
+	fFramesSinceKeyFrame(-1),
+	fLastChangeRatio(-1),
+	fFirstFrameTime(-1),
+	fParent(NULL),
+	fSegmentFirst(0),
+	fSegmentEnd(-1),
+	fFramesEncoded(0),
+	fOutputFilters(NULL),
+	fOutputFiltered(NULL),
+	fGIFEncoder(NULL),
+	fOutputFrames(0),
+	fOutputStatus(B_OK)
 {
 }
 
@@ -75,6 +168,30 @@ MovieEncoder::MovieEncoder()
 MovieEncoder::~MovieEncoder()
 {
 	DisposeData();
+	_DeleteLiveData();
+}
+
+
+// Without the source, the output file and the outputs
+MovieEncoder*
+MovieEncoder::CreateCopy() const
+{
+	MovieEncoder* copy = new (std::nothrow) MovieEncoder;
+	if (copy == NULL)
+		return NULL;
+	copy->fPriority = fPriority;
+	copy->fMessenger = fMessenger;
+	copy->fDecompressionPool = fDecompressionPool;
+	copy->fStats = fStats;
+	copy->fSession = fSession;
+	copy->fDestFrame = fDestFrame;
+	copy->fColorSpace = fColorSpace;
+	copy->fQuality = fQuality;
+	copy->fFileFormat = fFileFormat;
+	copy->fFamily = fFamily;
+	copy->fFormat = fFormat;
+	copy->fCodecInfo = fCodecInfo;
+	return copy;
 }
 
 
@@ -82,8 +199,12 @@ void
 MovieEncoder::DisposeData()
 {
 	// If the movie is still opened, close it; this also flushes all tracks
-	if (fMediaFile != NULL)
-		_CloseFile();
+	if (fMediaFile != NULL || fGIFEncoder != NULL)
+		_CloseOutput();
+
+	for (size_t i = 0; i < fOutputs.size(); i++)
+		delete fOutputs[i];
+	fOutputs.clear();
 
 	// Deleting the filelist deletes the files referenced by it
 	// and also the temporary folder
@@ -97,12 +218,38 @@ MovieEncoder::Cancel()
 {
 	if (fEncoderThread > 0) {
 		fKillThread = true;
+		if (fLiveWaiting) {
+			// Wake up the live encoder, wherever it's waiting
+			fLiveWaiting = false;
+			fLiveQueue->Close();
+			release_sem(fLiveSourceSem);
+		}
 		status_t dummy;
 		wait_for_thread(fEncoderThread, &dummy);
 	}
 }
 
 
+// On success, the encoder takes ownership of the list.
+// If no source is set, the frames are read from the temporary folder.
+// Must be called before EncodeThreaded(), or after StopLiveEncoding()
+// when encoding while recording
+status_t
+MovieEncoder::SetSource(FramesList* fileList)
+{
+	if (fileList == NULL)
+		return B_BAD_VALUE;
+	if (fFileList != NULL)
+		return B_BUSY;
+	fFileList = fileList;
+	if (fLiveWaiting) {
+		fLiveWaiting = false;
+		release_sem(fLiveSourceSem);
+	}
+	return B_OK;
+}
+
+
 status_t
 MovieEncoder::SetOutputFile(const char* fileName)
 {
@@ -138,18 +285,30 @@ MovieEncoder::SetColorSpace(const color_space& space)
 status_t
 MovieEncoder::SetQuality(const float& quality)
 {
+	fQuality = quality;
 	return B_OK;
 }
 
 
+// Of the encoder thread and of the segment threads
 status_t
-MovieEncoder::SetCursorQueue(std::queue<BPoint> *queue)
+MovieEncoder::SetThreadPriority(const int32& value)
 {
-	fCursorQueue = queue;
+	if (value < B_LOWEST_ACTIVE_PRIORITY || value >= B_FIRST_REAL_TIME_PRIORITY)
+		return B_BAD_VALUE;
+	fPriority = value;
 	return B_OK;
 }
 
 
+// Can be called while encoding: it's seen at the next frame
+void
+MovieEncoder::SetThrottled(bool throttled)
+{
+	atomic_set(&fThrottled, throttled ? 1 : 0);
+}
+
+
 status_t
 MovieEncoder::SetMessenger(const BMessenger& messenger)
 {
@@ -161,6 +320,50 @@ MovieEncoder::SetMessenger(const BMessenger& messenger)
 }
 
 
+void
+MovieEncoder::SetSessionConfig(const session_config& config)
+{
+	fSession = config;
+}
+
+
+void
+MovieEncoder::SetStats(StageStats* stats)
+{
+	fStats = stats;
+}
+
+
+void
+MovieEncoder::SetWorkerPool(WorkerPool* pool)
+{
+	fDecompressionPool = pool;
+}
+
+
+status_t
+MovieEncoder::AddOutput(MovieEncoder* output)
+{
+	if (output == NULL || output == this)
+		return B_BAD_VALUE;
+	if (fLiveWaiting)
+		return B_NOT_ALLOWED;
+	try {
+		fOutputs.push_back(output);
+	} catch (...) {
+		return B_NO_MEMORY;
+	}
+	return B_OK;
+}
+
+
+int32
+MovieEncoder::CountOutputs() const
+{
+	return fOutputs.size();
+}
+
+
 status_t
 MovieEncoder::_CreateFile(
 	const char* path,
@@ -211,7 +414,8 @@ MovieEncoder::_CreateFile(
 
 
 status_t
-MovieEncoder::_WriteFrame(const BBitmap* bitmap, int32 frameNum, bool isKeyFrame)
+MovieEncoder::_WriteFrame(const BBitmap* bitmap, int32 frameNum, bool isKeyFrame,
+	bigtime_t frameTime)
 {
 	// NULL is not a valid bitmap pointer
 	if (!bitmap)
@@ -219,6 +423,7 @@ MovieEncoder::_WriteFrame(const BBitmap* bitmap, int32 frameNum, bool isKeyFrame
 
 	ASSERT((fMediaTrack != NULL));
 
+	TraceScope trace("encode", frameNum);
 	// okay, it's the right kind of bitmap -- commit the header if necessary, and
 	// write it as one video frame.  We defer committing the header until the first
 	// frame is written in order to allow the client to adjust the image quality at
@@ -231,13 +436,38 @@ MovieEncoder::_WriteFrame(const BBitmap* bitmap, int32 frameNum, bool isKeyFrame
 			fHeaderCommitted = true;
 	}
 
-	if (err == B_OK)
-		err = fMediaTrack->WriteFrames(bitmap->Bits(), 1, isKeyFrame ? B_MEDIA_KEY_FRAME : 0);
+	if (err == B_OK) {
+		// File formats with a variable frame rate use the time
+		// of the frames, the others just count them
+		if (fFirstFrameTime < 0)
+			fFirstFrameTime = frameTime;
+		media_encode_info info;
+		info.flags = isKeyFrame ? B_MEDIA_KEY_FRAME : 0;
+		info.start_time = frameTime - fFirstFrameTime;
+		err = fMediaTrack->WriteFrames(bitmap->Bits(), 1, &info);
+	}
 
 	return err;
 }
 
 
+// Written again with the times it would have had at the rate
+// of the capture, until the next one
+status_t
+MovieEncoder::_WriteFrameCopies(const BBitmap* bitmap, int32 frameNum,
+	bool isKeyFrame, bigtime_t frameTime, bigtime_t nextTime)
+{
+	const int32 copies = CountCopies(fSession, frameTime, nextTime);
+	const bigtime_t period = 1000000 / std::max(fSession.frameRate, int32(1));
+	status_t status = B_OK;
+	for (int32 i = 0; i < copies && status == B_OK; i++) {
+		status = _WriteFrame(bitmap, frameNum, isKeyFrame && i == 0,
+			frameTime + i * period);
+	}
+	return status;
+}
+
+
 status_t
 MovieEncoder::_CloseFile()
 {
@@ -259,8 +489,15 @@ MovieEncoder::_CloseFile()
 status_t
 MovieEncoder::_EncoderThread()
 {
-	fFileList = new FramesList();
-	fFileList->AddItemsFromDisk();
+	_InitDecompressionPool();
+
+	if (fFileList == NULL) {
+		fFileList = new FramesList();
+		fFileList->TakeTempPaths();
+		fFileList->SetWorkerPool(fDecompressionPool);
+		fFileList->AddItemsFromDisk();
+	} else
+		fFileList->SetWorkerPool(fDecompressionPool);
 
 	int32 framesLeft = fFileList->CountItems();
 	if (framesLeft <= 0) {
@@ -268,11 +505,7 @@ MovieEncoder::_EncoderThread()
 		_HandleEncodingFinished(B_ERROR);
 		return B_ERROR;
 	}
-	status_t status = _ApplyImageFilters();
-	if (status != B_OK) {
-		_HandleEncodingFinished(status);
-		return status;
-	}
+	status_t status = B_OK;
 
 	// If destination frame is not valid (I.E: something went wrong)
 	// then get source frame and use it as dest frame
@@ -288,89 +521,545 @@ MovieEncoder::_EncoderThread()
 		}
 		std::cerr << "OK" << std::endl;
 		BRect sourceFrame = bitmap->Bounds();
-		delete bitmap;
+		FrameAllocator::Free(bitmap);
 		fDestFrame = sourceFrame.OffsetToCopy(B_ORIGIN);
 	}
 
+	if (!fOutputs.empty()) {
+		int32 framesWritten = 0;
+		status = _EncodeOutputs(framesWritten);
+		if (status != B_OK) {
+			std::cerr << "MovieEncoder::_EncoderThread(): batch encoding failed after "
+				<< framesWritten << " frames: " << ::strerror(status) << std::endl;
+		}
+		_HandleEncodingFinished(status, status == B_OK ? framesWritten : 0);
+		return status;
+	}
+
+	// Frames are filtered in memory just before being written,
+	// so they are only read once
+	ImageFilterChain* filters = NULL;
+
 	// TODO: Improve this: we are using the name of the media format to see if it's a fake format
-	if ((strcmp(MediaFileFormat().short_name, NULL_FORMAT_SHORT_NAME) == 0) ||
-		(strcmp(MediaFileFormat().short_name, GIF_FORMAT_SHORT_NAME) == 0)) {
-		return _WriteRawFrames();
+	if (strcmp(MediaFileFormat().short_name, NULL_FORMAT_SHORT_NAME) == 0) {
+		filters = _CreateFilterChain(fColorSpace, fFileList->GetCursorTrack());
+		if (filters == NULL) {
+			_HandleEncodingFinished(B_NO_MEMORY);
+			return B_NO_MEMORY;
+		}
+		status = _WriteRawFrames(filters);
+		delete filters;
+		return status;
+	}
+	if (strcmp(MediaFileFormat().short_name, GIF_FORMAT_SHORT_NAME) == 0) {
+		filters = _CreateFilterChain(B_RGB32, fFileList->GetCursorTrack());
+		if (filters == NULL) {
+			_HandleEncodingFinished(B_NO_MEMORY);
+			return B_NO_MEMORY;
+		}
+		if (fSession.ffmpegGIF && IsFFMPEGAvailable()) {
+			status = _PipeToFFMPEG(filters, "-vf \"split[s0][s1];[s0]palettegen=stats_mode=diff[p];"
+				"[s1][p]paletteuse=new=1:diff_mode=rectangle\" -f gif");
+		} else
+			status = _WriteGIF(filters);
+		delete filters;
+		return status;
 	}
 
 	media_format mediaFormat = fFormat;
-	const BitmapEntry* firstEntry = fFileList->ItemAt(0);
-	const BitmapEntry* lastEntry = fFileList->ItemAt(framesLeft - 1);
-	ASSERT((firstEntry != NULL));
-	ASSERT((lastEntry != NULL));
-	const bigtime_t diff = lastEntry->TimeStamp() - firstEntry->TimeStamp();
-	float fps = CalculateFPS(framesLeft, diff);
-	std::cout << "CalculateFPS returned " << fps << std::endl;
+	_NegotiateColorSpace(mediaFormat, fFileList->Store() != NULL
+		? fFileList->Store()->ColorSpace() : fColorSpace);
+
+	float fps = ClipFrameRate(fFileList, fSession);
+	std::cout << "ClipFrameRate returned " << fps << std::endl;
 	mediaFormat.u.raw_video.field_rate = fps;
+	fTempPath = fFileList->TempPath();
+
+	int32 framesWritten = 0;
+	const int32 segments = _CountSegments();
+	if (segments > 1)
+		status = _EncodeSegments(mediaFormat, segments, framesWritten);
+	else
+		status = _EncodeFile(mediaFormat, framesWritten);
 
-	// Create movie
-	status = _CreateFile(fOutputFile.Path(), fFileFormat, mediaFormat, fCodecInfo);
-	fTempPath = FramesList::Path();
 	if (status != B_OK) {
-		std::cerr << "MovieEncoder::_EncoderThread(): _CreateFile failed with " << ::strerror(status) << std::endl;
-		_HandleEncodingFinished(status);
-		return status;
+		// Something went wrong during encoding
+		// TODO: at least save the frames somewhere ?
+		std::cerr << "Something went very wrong during encoding." << std::endl;
+		std::cerr << framesWritten << " frames were sent to the mediakit." << std::endl;
+		std::cerr << "The system returned: " << strerror(status) << std::endl;
 	}
+	_HandleEncodingFinished(status, framesWritten);
+
+	return status;
+}
+
+
+// Long clips are split in segments, encoded at the same time
+int32
+MovieEncoder::_CountSegments() const
+{
+	const int32 segments = std::min(fSession.encodeSegments,
+		fFileList->CountItems() / kMinSegmentFrames);
+	return std::max(segments, int32(1));
+}
+
 
-	const uint32 keyFrameFrequency = 10;
-	// TODO: Make this tunable
+// Encodes parts of the list into separate files, each from its own
+// thread, then joins them into the output file
+status_t
+MovieEncoder::_EncodeSegments(const media_format& format, int32 count,
+	int32& framesWritten)
+{
+	const int32 framesTotal = fFileList->CountItems();
+
+	// Every segment starts with a key frame. Starting them on the
+	// key frame interval gives the same key frames as a single file
+	const int32 interval = fSession.keyFrameInterval;
+	std::vector<int32> starts;
+	for (int32 i = 0; i < count; i++) {
+		int32 start = int32(int64(framesTotal) * i / count);
+		start = (start + interval / 2) / interval * interval;
+		if (start < framesTotal && (starts.empty() || start > starts.back()))
+			starts.push_back(start);
+	}
 
 	BMessage initialMessage(kEncodingProgress);
 	initialMessage.AddBool("reset", true);
-	initialMessage.AddInt32("frames_total", framesLeft);
+	initialMessage.AddInt32("frames_total", framesTotal);
 	initialMessage.AddString("text", "Encoding...");
 	fMessenger.SendMessage(&initialMessage);
 
-	int32 framesWritten = 0;
-	while (!fKillThread && framesLeft > 0) {
-		BitmapEntry* entry = const_cast<FramesList*>(fFileList)->Pop();
-		if (entry == NULL) {
+	fFramesEncoded = 0;
+	status_t status = B_OK;
+	std::vector<MovieEncoder*> segments;
+	for (size_t i = 0; i < starts.size(); i++) {
+		MovieEncoder* segment = new (std::nothrow) MovieEncoder;
+		if (segment == NULL) {
+			status = B_NO_MEMORY;
+			break;
+		}
+		// The list and the pool are only borrowed
+		segment->fParent = this;
+		segment->fPriority = fPriority;
+		segment->fMessenger = fMessenger;
+		segment->fFileList = fFileList;
+		segment->fDecompressionPool = fDecompressionPool;
+		segment->fStats = fStats;
+		segment->fSession = fSession;
+		segment->fDestFrame = fDestFrame;
+		segment->fColorSpace = fColorSpace;
+		segment->fQuality = fQuality;
+		segment->fFileFormat = fFileFormat;
+		segment->fFamily = fFamily;
+		segment->fFormat = format;
+		segment->fCodecInfo = fCodecInfo;
+		segment->fSegmentFirst = starts[i];
+		segment->fSegmentEnd = i + 1 < starts.size() ? starts[i + 1] : framesTotal;
+		BString path;
+		path.SetToFormat("%s.segment%" B_PRId32, fOutputFile.Path(), (int32)i);
+		segment->fOutputFile.SetTo(path.String());
+		segments.push_back(segment);
+
+		BString name;
+		name.SetToFormat("Segment encoder %" B_PRId32, (int32)i + 1);
+		segment->fEncoderThread = spawn_thread((thread_entry)SegmentStarter,
+			name.String(), fPriority, segment);
+		if (segment->fEncoderThread < 0
+			|| resume_thread(segment->fEncoderThread) != B_OK) {
+			if (segment->fEncoderThread >= 0)
+				kill_thread(segment->fEncoderThread);
+			segment->fEncoderThread = -1;
 			status = B_ERROR;
 			break;
 		}
+	}
+	if (status != B_OK)
+		fKillThread = true;
+
+	for (size_t i = 0; i < segments.size(); i++) {
+		MovieEncoder* segment = segments[i];
+		if (segment->fEncoderThread >= 0) {
+			status_t segmentStatus = B_ERROR;
+			wait_for_thread(segment->fEncoderThread, &segmentStatus);
+			if (status == B_OK)
+				status = segmentStatus;
+		}
+		framesWritten += segment->fFramesEncoded;
+	}
+	std::cout << "Encoded " << segments.size() << " segments" << std::endl;
+
+	if (status == B_OK && fKillThread)
+		status = B_CANCELED;
+	if (status == B_OK)
+		status = _JoinSegments(segments.data(), segments.size());
+
+	for (size_t i = 0; i < segments.size(); i++) {
+		BEntry(segments[i]->fOutputFile.Path()).Remove();
+		segments[i]->fFileList = NULL;
+		delete segments[i];
+	}
+	return status;
+}
+
+
+int32
+MovieEncoder::SegmentStarter(void* arg)
+{
+	return static_cast<MovieEncoder*>(arg)->_SegmentThread();
+}
+
 
-		// Makes a copy of the bitmap
-		BBitmap* frame = entry->Bitmap();
-		delete entry;
+status_t
+MovieEncoder::_SegmentThread()
+{
+	int32 framesWritten = 0;
+	status_t status = _EncodeFile(fFormat, framesWritten);
+	const status_t closeStatus = _CloseFile();
+	if (status == B_OK)
+		status = closeStatus;
+	if (status != B_OK)
+		std::cerr << "MovieEncoder::_SegmentThread(): " << fOutputFile.Path() << ": " << ::strerror(status) << std::endl;
+	fFramesEncoded = framesWritten;
+	return status;
+}
+
+
+bool
+MovieEncoder::_IsCanceled() const
+{
+	return fKillThread || (fParent != NULL && fParent->fKillThread);
+}
+
+
+// Called before every frame. While throttled, the frames are
+// encoded at the lowest priority, with a pause after each one,
+// so that a capture gets the processors and the disks first
+void
+MovieEncoder::_Throttle()
+{
+	MovieEncoder* owner = fParent != NULL ? fParent : this;
+	const bool throttled = atomic_get(&owner->fThrottled) != 0;
+	if (throttled != fThreadThrottled) {
+		set_thread_priority(find_thread(NULL),
+			throttled ? B_LOW_PRIORITY : fPriority);
+		fThreadThrottled = throttled;
+	}
+	if (throttled)
+		snooze(kThrottleDelay);
+}
+
+
+// Joins the segments with ffmpeg, when it's there, since it knows
+// the containers better. Otherwise the Media Kit copies the chunks
+status_t
+MovieEncoder::_JoinSegments(MovieEncoder* const* segments, int32 count)
+{
+	if (IsFFMPEGAvailable() && fFileFormat.file_extension[0] != '\0') {
+		status_t status = _ConcatSegments(segments, count);
+		if (status == B_OK)
+			return B_OK;
+		std::cerr << "MovieEncoder::_JoinSegments(): ffmpeg failed, copying the chunks" << std::endl;
+	}
+	return _CopySegments(segments, count);
+}
+
+
+status_t
+MovieEncoder::_ConcatSegments(MovieEncoder* const* segments, int32 count)
+{
+	BString list;
+	for (int32 i = 0; i < count; i++) {
+		BString path = segments[i]->fOutputFile.Path();
+		path.ReplaceAll("'", "'\\''");
+		list << "file '" << path << "'\n";
+	}
+	BString listPath = fOutputFile.Path();
+	listPath << ".segments";
+	BFile listFile(listPath.String(), B_WRITE_ONLY | B_CREATE_FILE | B_ERASE_FILE);
+	status_t status = listFile.InitCheck();
+	if (status == B_OK && listFile.Write(list.String(), list.Length()) != list.Length())
+		status = B_IO_ERROR;
+	listFile.Unset();
+
+	// ffmpeg finds out the container from the extension
+	BString joinedPath = fOutputFile.Path();
+	joinedPath << ".joined." << fFileFormat.file_extension;
+	if (status == B_OK) {
+		BString command;
+		command << "ffmpeg -v error -f concat -safe 0 -i "
+			<< QuoteShellArgument(listPath.String());
+		command << " -c copy -y " << QuoteShellArgument(joinedPath.String());
+		std::cout << "MovieEncoder::_ConcatSegments(): " << command.String() << std::endl;
+		if (::system(command.String()) != 0)
+			status = B_ERROR;
+	}
+	if (status == B_OK)
+		status = BEntry(joinedPath.String()).Rename(fOutputFile.Path(), true);
+
+	BEntry(listPath.String()).Remove();
+	if (status != B_OK)
+		BEntry(joinedPath.String()).Remove();
+	return status;
+}
+
+
+// Copies the encoded chunks into the output file, without decoding
+// them. The segments start at zero, and are moved to their time
+status_t
+MovieEncoder::_CopySegments(MovieEncoder* const* segments, int32 count)
+{
+	entry_ref ref;
+	status_t status = get_ref_for_path(fOutputFile.Path(), &ref);
+	if (status != B_OK)
+		return status;
 
-		if (frame == NULL) {
+	BMediaFile output(&ref, &fFileFormat);
+	status = output.InitCheck();
+	BMediaTrack* outputTrack = NULL;
+	const bigtime_t clipStart = fFileList->ItemAt(0)->TimeStamp();
+	for (int32 i = 0; status == B_OK && i < count; i++) {
+		entry_ref segmentRef;
+		status = get_ref_for_path(segments[i]->fOutputFile.Path(), &segmentRef);
+		if (status != B_OK)
+			break;
+		BMediaFile input(&segmentRef);
+		status = input.InitCheck();
+		BMediaTrack* track = status == B_OK ? input.TrackAt(0) : NULL;
+		if (status == B_OK && track == NULL)
 			status = B_ERROR;
+
+		if (status == B_OK && outputTrack == NULL) {
+			media_format format;
+			status = track->EncodedFormat(&format);
+			if (status == B_OK) {
+				outputTrack = output.CreateTrack(&format);
+				if (outputTrack == NULL)
+					status = B_ERROR;
+			}
+			if (status == B_OK)
+				status = output.CommitHeader();
+		}
+
+		const bigtime_t offset = fFileList->ItemAt(
+			segments[i]->fSegmentFirst)->TimeStamp() - clipStart;
+		while (status == B_OK) {
+			char* buffer = NULL;
+			int32 size = 0;
+			media_header header;
+			status_t readStatus = track->ReadChunk(&buffer, &size, &header);
+			if (readStatus == B_LAST_BUFFER_ERROR)
+				break;
+			if (readStatus != B_OK) {
+				status = readStatus;
+				break;
+			}
+			media_encode_info info;
+			info.flags = header.u.encoded_video.field_flags & B_MEDIA_KEY_FRAME;
+			info.start_time = header.start_time + offset;
+			status = outputTrack->WriteChunk(buffer, size, &info);
+		}
+		input.ReleaseAllTracks();
+	}
+
+	output.ReleaseAllTracks();
+	const status_t closeStatus = output.CloseFile();
+	return status == B_OK ? closeStatus : status;
+}
+
+
+// Creates the output file and encodes the frames of the list into it
+status_t
+MovieEncoder::_EncodeFile(const media_format& format, int32& framesWritten)
+{
+	ImageFilterChain* filters = _CreateFilterChain(format.u.raw_video.display.format,
+		fFileList->GetCursorTrack());
+	if (filters == NULL)
+		return B_NO_MEMORY;
+
+	status_t status = _CreateFile(fOutputFile.Path(), fFileFormat, format, fCodecInfo,
+		fQuality);
+	if (status != B_OK) {
+		std::cerr << "MovieEncoder::_EncodeFile(): _CreateFile failed with " << ::strerror(status) << std::endl;
+		delete filters;
+		return status;
+	}
+
+	_ResetEncodingState();
+	status = _EncodeFrames(filters, framesWritten);
+	delete filters;
+	return status;
+}
+
+
+// Encodes the frames of the list, after the ones already written.
+// Segment encoders only encode their part of the list
+status_t
+MovieEncoder::_EncodeFrames(ImageFilterChain* filters, int32& framesWritten)
+{
+	const int32 framesTotal = fFileList->CountItems();
+	const int32 first = fSegmentFirst;
+	const int32 end = fSegmentEnd >= 0 ? fSegmentEnd : framesTotal;
+
+	if (fParent == NULL) {
+		BMessage initialMessage(kEncodingProgress);
+		initialMessage.AddBool("reset", true);
+		initialMessage.AddInt32("frames_total", framesTotal);
+		initialMessage.AddString("text", "Encoding...");
+		fMessenger.SendMessage(&initialMessage);
+	}
+
+	// The next frames are loaded while the current one is encoded
+	FramePrefetcher prefetcher(fFileList, fSession.encodeLookahead);
+	prefetcher.SetRange(first, end - first);
+	status_t status = prefetcher.Start();
+	if (status != B_OK) {
+		std::cerr << "MovieEncoder::_EncodeFrames(): cannot start prefetcher: " << ::strerror(status) << std::endl;
+		return status;
+	}
+
+	bigtime_t encodeTime = 0;
+	int32 framesEncoded = 0;
+	int32 duplicates = 0;
+	// The last filtered frame, and the one it was made from,
+	// kept to be written again for the duplicates which follow
+	BBitmap* filtered = NULL;
+	BBitmap* lastFrame = NULL;
+	while (!_IsCanceled() && first + framesEncoded < end) {
+		const BitmapEntry* entry = fFileList->ItemAt(first + framesEncoded);
+		_Throttle();
+		BBitmap* frame = prefetcher.NextFrame(&status);
+		const bool duplicate = frame == NULL && status == B_OK
+			&& filtered != NULL && fFileList->IsDuplicate(first + framesEncoded);
+		if (frame == NULL && !duplicate) {
+			if (status == B_OK)
+				status = B_ERROR;
 			std::cerr << "Error while loading bitmap entry" << std::endl;
 			break;
 		}
 
-		bool keyFrame = (framesWritten % keyFrameFrequency == 0);
-		if (status == B_OK)
-			status = _WriteFrame(frame, framesWritten + 1, keyFrame);
-		delete frame;
+		bool keyFrame = _IsKeyFrame(entry->ChangeRatio());
+		const bigtime_t encodeStart = system_time();
+		if (frame != NULL && status == B_OK) {
+			prefetcher.Recycle(lastFrame);
+			lastFrame = frame;
+			TraceRecorder::Begin("filter", first + framesEncoded);
+			status = filters->Apply(frame, entry->TimeStamp(), &filtered);
+			TraceRecorder::End("filter", first + framesEncoded);
+		} else if (frame != NULL)
+			prefetcher.Recycle(frame);
+		if (status == B_OK) {
+			status = _WriteFrameCopies(filtered, framesWritten + 1, keyFrame,
+				entry->TimeStamp(), NextFrameTime(fFileList, first + framesEncoded));
+		}
+		const bigtime_t elapsed = system_time() - encodeStart;
+		encodeTime += elapsed;
+		if (duplicate)
+			duplicates++;
 
 		if (status != B_OK)
 			break;
+		if (fStats != NULL)
+			fStats->AddFrame(elapsed, 0, duplicate);
 
 		framesWritten++;
-		framesLeft--;
+		framesEncoded++;
 
 		if (!fMessenger.IsValid()) {
 			// BMessenger is no longer valid. This means that the application
 			// has been closed or it has crashed.
 			break;
 		}
+		// Segments share the count of the frames encoded
+		int32 framesDone = first + framesEncoded;
+		if (fParent != NULL)
+			framesDone = atomic_add(&fParent->fFramesEncoded, 1) + 1;
 		BMessage progressMessage(kEncodingProgress);
-		progressMessage.AddInt32("frames_remaining", fFileList->CountItems());
+		progressMessage.AddInt32("frames_remaining", framesTotal - framesDone);
 		fMessenger.SendMessage(&progressMessage);
 	}
+	prefetcher.Recycle(lastFrame);
+	prefetcher.Stop();
+
+	if (framesEncoded > 0) {
+		std::cout << "Per frame: load " << prefetcher.LoadTime() / framesEncoded / 1000.0
+			<< " ms, wait " << prefetcher.WaitTime() / framesEncoded / 1000.0
+			<< " ms, encode " << encodeTime / framesEncoded / 1000.0 << " ms" << std::endl;
+		std::cout << duplicates << " duplicate frames were not read again" << std::endl;
+	}
+	return status;
+}
 
-	if (status == B_OK)
-		status = _PostEncodingAction(fTempPath, framesWritten, int32(fps));
+
+// Encodes the frames while they're captured. When the capture
+// is over, finishes the file with the frames which were spooled
+// because the encoder couldn't keep up
+status_t
+MovieEncoder::_LiveEncoderThread()
+{
+	status_t status = B_OK;
+	bigtime_t encodeTime = 0;
+	int32 framesWritten = 0;
+	queued_frame frame;
+	while (fLiveQueue->Pop(frame)) {
+		if (status == B_OK && !fKillThread) {
+			// Not compared to the previous one
+			bool keyFrame = _IsKeyFrame(-1);
+			const bigtime_t encodeStart = system_time();
+			BBitmap* filtered = NULL;
+			TraceRecorder::Begin("filter", framesWritten);
+			status = fLiveFilters->Apply(frame.bitmap, frame.time, &filtered);
+			TraceRecorder::End("filter", framesWritten);
+			if (status == B_OK)
+				status = _WriteFrame(filtered, framesWritten + 1, keyFrame, frame.time);
+			const bigtime_t elapsed = system_time() - encodeStart;
+			encodeTime += elapsed;
+			if (status == B_OK) {
+				framesWritten++;
+				if (fStats != NULL)
+					fStats->AddFrame(elapsed);
+			} else {
+				// The file is of no use anymore: let the capture
+				// go on, so the recording can be stopped as usual
+				std::cerr << "MovieEncoder::_LiveEncoderThread(): cannot encode frame: " << ::strerror(status) << std::endl;
+				atomic_set(&fLiveBehind, 1);
+			}
+		}
+		fLiveFramePool->Release(frame.bitmap);
+	}
+
+	if (framesWritten > 0) {
+		std::cout << "Encoded " << framesWritten << " frames while recording, "
+			<< encodeTime / framesWritten / 1000.0 << " ms per frame" << std::endl;
+	}
+
+	// None of the capture buffers is used anymore
+	release_sem(fLiveDrainedSem);
+
+	// Released by SetSource() or Cancel()
+	while (acquire_sem(fLiveSourceSem) == B_INTERRUPTED)
+		;
+
+	if (fKillThread && fFileList == NULL) {
+		// The recording was aborted
+		delete fLiveFilters;
+		fLiveFilters = NULL;
+		_CloseFile();
+		BEntry(fOutputFile.Path()).Remove();
+		return B_CANCELED;
+	}
+
+	if (status == B_OK && fFileList != NULL && fFileList->CountItems() > 0) {
+		std::cout << fFileList->CountItems() << " frames were spooled while recording" << std::endl;
+		fFileList->SetWorkerPool(fDecompressionPool);
+		status = _EncodeFrames(fLiveFilters, framesWritten);
+	}
+	delete fLiveFilters;
+	fLiveFilters = NULL;
+	if (fFileList != NULL)
+		fTempPath = fFileList->TempPath();
 
 	if (status != B_OK) {
-		// Something went wrong during encoding
-		// TODO: at least save the frames somewhere ?
 		std::cerr << "Something went very wrong during encoding." << std::endl;
 		std::cerr << framesWritten << " frames were sent to the mediakit." << std::endl;
 		std::cerr << "The system returned: " << strerror(status) << std::endl;
@@ -381,44 +1070,90 @@ MovieEncoder::_EncoderThread()
 }
 
 
-status_t
-MovieEncoder::_ApplyImageFilters()
+// Picks the raw format the codec is given. Most codecs work
+// in YCbCr, so that's tried first: our conversion is faster
+// than the generic code they would use otherwise
+void
+MovieEncoder::_NegotiateColorSpace(media_format& format,
+	color_space sourceSpace) const
 {
-	// TODO: update progress
-	if (Settings::Current().Scale() != 100) {
-		const int32 framesTotal = fFileList->CountItems();
-
-		BMessage initialMessage(kEncodingProgress);
-		initialMessage.AddBool("reset", true);
-		initialMessage.AddInt32("frames_total", framesTotal);
-		initialMessage.AddString("text", "Scaling...");
-		fMessenger.SendMessage(&initialMessage);
-
-		// First pass: scale frames if needed
-		// TODO: we could apply different filters
-		ImageFilterScale* filter = new ImageFilterScale(fDestFrame, fColorSpace);
-		for (int32 c = 0; c < framesTotal; c++) {
-			if (fKillThread) {
-				delete filter;
-				return B_ERROR;
+	const color_space candidates[] = {
+		B_YCbCr420,
+		B_YCbCr422,
+		format.u.raw_video.display.format
+	};
+	const int32 width = format.u.raw_video.display.line_width;
+	const int32 height = format.u.raw_video.display.line_count;
+	for (size_t i = 0; i < sizeof(candidates) / sizeof(candidates[0]); i++) {
+		if (candidates[i] != sourceSpace
+			&& !ColorConverter::CanConvert(sourceSpace, candidates[i]))
+			continue;
+		int32 bytesPerRow;
+		if (ColorConverter::GetFrameLayout(candidates[i], width, height,
+				&bytesPerRow, NULL) != B_OK)
+			continue;
+
+		media_format candidate = format;
+		candidate.u.raw_video.display.format = candidates[i];
+		candidate.u.raw_video.display.bytes_per_row = bytesPerRow;
+		int32 cookie = 0;
+		media_format encodedFormat;
+		media_codec_info codecInfo;
+		while (get_next_encoder(&cookie, &fFileFormat, &candidate,
+				&encodedFormat, &codecInfo) == B_OK) {
+			if (codecInfo.id == fCodecInfo.id && codecInfo.sub_id == fCodecInfo.sub_id) {
+				std::cout << "MovieEncoder: the codec gets color space 0x"
+					<< std::hex << candidates[i] << std::dec << std::endl;
+				format = candidate;
+				return;
 			}
-			BitmapEntry* entry = fFileList->ItemAt(c);
-			BBitmap* filtered = filter->ApplyFilter(entry->Bitmap());
-			entry->Replace(filtered);
-
-			BMessage progressMessage(kEncodingProgress);
-			progressMessage.AddInt32("frames_remaining", framesTotal - c);
-			fMessenger.SendMessage(&progressMessage);
 		}
-		delete filter;
 	}
+}
 
-	return B_OK;
+
+// The size of the frames the pointer positions are in, when
+// the frames may have been scaled before they were spooled
+BRect
+MovieEncoder::_CapturedFrame() const
+{
+	if (!fSession.scaleAtCapture)
+		return BRect();
+	return fSession.frameBounds;
+}
+
+
+ImageFilterChain*
+MovieEncoder::_CreateFilterChain(color_space colorSpace,
+	const CursorTrack* cursorTrack) const
+{
+	ImageFilterChain* chain = new (std::nothrow) ImageFilterChain;
+	if (chain == NULL)
+		return NULL;
+
+	// The pointer goes in before the frame is scaled, unless
+	// it was scaled when captured
+	status_t status = B_OK;
+	if (cursorTrack != NULL)
+		status = chain->AddFilter(new (std::nothrow) ImageFilterCursor(cursorTrack,
+			_CapturedFrame()));
+	if (status == B_OK && fSession.scale != 100)
+		status = chain->AddFilter(new (std::nothrow) ImageFilterScale(fDestFrame, fDecompressionPool));
+	if (status == B_OK && colorSpace != B_NO_COLOR_SPACE) {
+		status = chain->AddFilter(new (std::nothrow) ImageFilterColorConvert(colorSpace,
+			fDecompressionPool));
+	}
+	if (status != B_OK) {
+		delete chain;
+		return NULL;
+	}
+	return chain;
 }
 
 
+// The raw frames are written there, which is then the result
 status_t
-MovieEncoder::_WriteRawFrames()
+MovieEncoder::_CreateFramesFolder()
 {
 	// TODO: Let the user select the output directory
 	BPath path;
@@ -426,12 +1161,20 @@ MovieEncoder::_WriteRawFrames()
 	if (status != B_OK)
 		return status;
 
-	// TODO: Code duplication between here and _EncoderThread
+	char tempDirectoryTemplate[PATH_MAX];
+	::snprintf(tempDirectoryTemplate, PATH_MAX, "%s/BeScreenCapture_XXXXXX", path.Path());
+	char* tempDirectoryName = ::mkdtemp(tempDirectoryTemplate);
+	if (tempDirectoryName == NULL || !BEntry(tempDirectoryName).IsDirectory())
+		return B_ERROR;
+	fTempPath = tempDirectoryName;
+	return B_OK;
+}
+
+
+status_t
+MovieEncoder::_WriteRawFrames(ImageFilterChain* filters)
+{
 	const int32 frames = fFileList->CountItems();
-	const BitmapEntry* firstEntry = fFileList->ItemAt(0);
-	const BitmapEntry* lastEntry = fFileList->ItemAt(frames - 1);
-	const bigtime_t diff = lastEntry->TimeStamp() - firstEntry->TimeStamp();
-	const float fps = CalculateFPS(fFileList->CountItems(), diff);
 
 	BMessage progressMessage(kEncodingProgress);
 	progressMessage.AddBool("reset", true);
@@ -439,21 +1182,494 @@ MovieEncoder::_WriteRawFrames()
 	progressMessage.AddInt32("frames_total", frames);
 	fMessenger.SendMessage(&progressMessage);
 
-	char tempDirectoryTemplate[PATH_MAX];
-	::snprintf(tempDirectoryTemplate, PATH_MAX, "%s/BeScreenCapture_XXXXXX", path.Path());
-	char* tempDirectoryName = ::mkdtemp(tempDirectoryTemplate);
-	if (tempDirectoryName == NULL)
-		status = B_ERROR;
-	else if (BEntry(tempDirectoryName).IsDirectory()) {
-		fTempPath = tempDirectoryName;
-		status = fFileList->WriteFrames(tempDirectoryName);
+	status_t status = _CreateFramesFolder();
+	if (status != B_OK) {
+		_HandleEncodingFinished(status);
+		return status;
+	}
+
+	// Nothing is encoded, so loading the frames is all the work:
+	// do it from as many threads as there are processors
+	system_info info;
+	get_system_info(&info);
+	const int32 loaders = std::min(std::max(int32(info.cpu_count), int32(2)), int32(8));
+	FramePrefetcher prefetcher(fFileList,
+		std::max(fSession.encodeLookahead, loaders * 2), loaders);
+	status = prefetcher.Start();
+
+	int32 framesWritten = 0;
+	BBitmap* filtered = NULL;
+	BBitmap* lastFrame = NULL;
+	BString lastFileName;
+	while (status == B_OK && !fKillThread && framesWritten < frames) {
+		const BitmapEntry* entry = fFileList->ItemAt(framesWritten);
+		BString fileName;
+		fileName.SetToFormat("%s/frame_%07" B_PRId32 ".bmp", fTempPath.Path(),
+			framesWritten + 1);
+		_Throttle();
+		BBitmap* frame = prefetcher.NextFrame(&status);
+		if (frame != NULL) {
+			prefetcher.Recycle(lastFrame);
+			lastFrame = frame;
+			if (status == B_OK) {
+				TraceScope trace("filter", framesWritten);
+				status = filters->Apply(frame, entry->TimeStamp(), &filtered);
+			}
+			if (status == B_OK)
+				status = FramesList::WriteFrame(filtered, entry->TimeStamp(), fileName);
+		} else if (status == B_OK && filtered != NULL
+			&& fFileList->IsDuplicate(framesWritten)) {
+			// Duplicates aren't loaded, and where the file system
+			// has hard links, they aren't written again either
+			if (::link(lastFileName.String(), fileName.String()) != 0)
+				status = FramesList::WriteFrame(filtered, entry->TimeStamp(), fileName);
+		} else if (status == B_OK)
+			status = B_ERROR;
+		if (status != B_OK) {
+			std::cerr << "MovieEncoder::_WriteRawFrames(): cannot write " << fileName.String() << ": " << ::strerror(status) << std::endl;
+			break;
+		}
+
+		lastFileName = fileName;
+		framesWritten++;
+		if (!fMessenger.IsValid())
+			break;
+		BMessage progressMessage(kEncodingProgress);
+		progressMessage.AddInt32("frames_remaining", frames - framesWritten);
+		fMessenger.SendMessage(&progressMessage);
+	}
+	prefetcher.Recycle(lastFrame);
+	prefetcher.Stop();
+
+	if (status == B_OK && fKillThread)
+		status = B_CANCELED;
+	_HandleEncodingFinished(status, status == B_OK ? framesWritten : 0);
+
+	return status;
+}
+
+
+status_t
+MovieEncoder::_WriteGIF(ImageFilterChain* filters)
+{
+	const int32 framesTotal = fFileList->CountItems();
+
+	BMessage initialMessage(kEncodingProgress);
+	initialMessage.AddBool("reset", true);
+	initialMessage.AddInt32("frames_total", framesTotal);
+	initialMessage.AddString("text", "Encoding...");
+	fMessenger.SendMessage(&initialMessage);
+
+	GIFEncoder encoder(fDecompressionPool);
+	status_t status = encoder.Open(fOutputFile.Path());
+	if (status != B_OK) {
+		std::cerr << "MovieEncoder::_WriteGIF(): cannot create " << fOutputFile.Path() << ": " << ::strerror(status) << std::endl;
+		_HandleEncodingFinished(status);
+		return status;
+	}
+
+	FramePrefetcher prefetcher(fFileList, fSession.encodeLookahead);
+	status = prefetcher.Start();
+
+	int32 framesEncoded = 0;
+	while (status == B_OK && !fKillThread && framesEncoded < framesTotal) {
+		const BitmapEntry* entry = fFileList->ItemAt(framesEncoded);
+		_Throttle();
+		BBitmap* frame = prefetcher.NextFrame(&status);
+		if (frame != NULL) {
+			BBitmap* filtered = NULL;
+			if (status == B_OK) {
+				TraceScope trace("filter", framesEncoded);
+				status = filters->Apply(frame, entry->TimeStamp(), &filtered);
+			}
+			if (status == B_OK)
+				status = encoder.WriteFrame(filtered, entry->TimeStamp());
+			prefetcher.Recycle(frame);
+		} else if (status == B_OK) {
+			// GIF images have their own duration: duplicates
+			// just make the previous one last longer
+			if (fFileList->IsDuplicate(framesEncoded))
+				status = encoder.WriteDuplicate(entry->TimeStamp());
+			else
+				status = B_ERROR;
+		}
+		if (status != B_OK) {
+			std::cerr << "MovieEncoder::_WriteGIF(): cannot write frame " << framesEncoded << ": " << ::strerror(status) << std::endl;
+			break;
+		}
+
+		framesEncoded++;
+		if (!fMessenger.IsValid())
+			break;
+		BMessage progressMessage(kEncodingProgress);
+		progressMessage.AddInt32("frames_remaining", framesTotal - framesEncoded);
+		fMessenger.SendMessage(&progressMessage);
+	}
+	prefetcher.Stop();
+
+	const status_t closeStatus = encoder.Close();
+	if (status == B_OK && fKillThread)
+		status = B_CANCELED;
+	if (status == B_OK)
+		status = closeStatus;
+	std::cout << framesEncoded << " frames were written as " << encoder.CountImages() << " GIF images" << std::endl;
+
+	_HandleEncodingFinished(status, status == B_OK ? framesEncoded : 0);
+
+	return status;
+}
+
+
+// Has ffmpeg read the frames as raw video from a pipe, and
+// make the output file with the given options
+status_t
+MovieEncoder::_PipeToFFMPEG(ImageFilterChain* filters, const char* outputOptions)
+{
+	const int32 framesTotal = fFileList->CountItems();
+	const float fps = ClipFrameRate(fFileList, fSession);
+
+	BMessage initialMessage(kEncodingProgress);
+	initialMessage.AddBool("reset", true);
+	initialMessage.AddInt32("frames_total", framesTotal);
+	initialMessage.AddString("text", "Encoding...");
+	fMessenger.SendMessage(&initialMessage);
+
+	FramePrefetcher prefetcher(fFileList, fSession.encodeLookahead);
+	status_t status = prefetcher.Start();
+
+	// ffmpeg quitting early must not kill us when we write to the pipe
+	struct sigaction ignore;
+	struct sigaction previousAction;
+	memset(&ignore, 0, sizeof(ignore));
+	ignore.sa_handler = SIG_IGN;
+	sigaction(SIGPIPE, &ignore, &previousAction);
+
+	FILE* pipe = NULL;
+	int32 framesEncoded = 0;
+	// Raw video has a constant frame rate: duplicates are written
+	// again from the last filtered frame
+	BBitmap* filtered = NULL;
+	BBitmap* lastFrame = NULL;
+	while (status == B_OK && !fKillThread && framesEncoded < framesTotal) {
+		const BitmapEntry* entry = fFileList->ItemAt(framesEncoded);
+		_Throttle();
+		BBitmap* frame = prefetcher.NextFrame(&status);
+		if (frame != NULL) {
+			prefetcher.Recycle(lastFrame);
+			lastFrame = frame;
+			if (status == B_OK) {
+				TraceScope trace("filter", framesEncoded);
+				status = filters->Apply(frame, entry->TimeStamp(), &filtered);
+			}
+		} else if (status == B_OK && (filtered == NULL
+				|| !fFileList->IsDuplicate(framesEncoded)))
+			status = B_ERROR;
+
+		// The size of the frames is only known after they're filtered
+		if (status == B_OK && pipe == NULL) {
+			const BRect bounds = filtered->Bounds();
+			BString command;
+			command << "ffmpeg -v error -f rawvideo -pix_fmt bgra";
+			command << " -s " << bounds.IntegerWidth() + 1 << "x" << bounds.IntegerHeight() + 1;
+			command << " -r " << fps << " -i pipe:0 " << outputOptions;
+			command << " -y " << QuoteShellArgument(fOutputFile.Path());
+			std::cout << "MovieEncoder::_PipeToFFMPEG(): " << command.String() << std::endl;
+			pipe = ::popen(command.String(), "w");
+			if (pipe == NULL)
+				status = B_ERROR;
+		}
+
+		const int32 copies = CountCopies(fSession, entry->TimeStamp(),
+			NextFrameTime(fFileList, framesEncoded));
+		for (int32 copy = 0; copy < copies && status == B_OK; copy++) {
+			const size_t rowLength = (filtered->Bounds().IntegerWidth() + 1) * 4;
+			const uint8* bits = (const uint8*)filtered->Bits();
+			for (int32 y = 0; y <= filtered->Bounds().IntegerHeight(); y++) {
+				if (::fwrite(bits + y * filtered->BytesPerRow(), rowLength, 1, pipe) != 1) {
+					status = B_IO_ERROR;
+					break;
+				}
+			}
+		}
+		if (status != B_OK) {
+			std::cerr << "MovieEncoder::_PipeToFFMPEG(): cannot write frame " << framesEncoded << ": " << ::strerror(status) << std::endl;
+			break;
+		}
+
+		framesEncoded++;
+		if (!fMessenger.IsValid())
+			break;
+		BMessage progressMessage(kEncodingProgress);
+		progressMessage.AddInt32("frames_remaining", framesTotal - framesEncoded);
+		fMessenger.SendMessage(&progressMessage);
+	}
+	prefetcher.Recycle(lastFrame);
+	prefetcher.Stop();
+
+	if (pipe != NULL) {
+		// ffmpeg finishes the file once it reads the end of the input
+		const int result = ::pclose(pipe);
+		if (status == B_OK && (!WIFEXITED(result) || WEXITSTATUS(result) != 0)) {
+			std::cerr << "MovieEncoder::_PipeToFFMPEG(): ffmpeg failed" << std::endl;
+			status = B_ERROR;
+		}
+	}
+	sigaction(SIGPIPE, &previousAction, NULL);
+
+	if (status == B_OK && fKillThread)
+		status = B_CANCELED;
+	_HandleEncodingFinished(status, status == B_OK ? framesEncoded : 0);
+
+	return status;
+}
+
+
+// What the outputs are given for every frame. A NULL frame is
+// a duplicate: the last one is written again
+struct output_work {
+	MovieEncoder* const* outputs;
+	BBitmap* frame;
+	const BitmapEntry* entry;
+	bigtime_t nextTime;
+};
+
+
+// Every frame is read once, and given to all the outputs at the
+// same time: each one scales and converts it for its own file.
+// An output which fails is left out, the others go on. Only this
+// encoder failing fails the batch
+status_t
+MovieEncoder::_EncodeOutputs(int32& framesWritten)
+{
+	const int32 framesTotal = fFileList->CountItems();
+	const color_space sourceSpace = fFileList->Store() != NULL
+		? fFileList->Store()->ColorSpace() : fColorSpace;
+	const float fps = ClipFrameRate(fFileList, fSession);
+	fTempPath = fFileList->TempPath();
+
+	std::vector<MovieEncoder*> outputs;
+	outputs.push_back(this);
+	outputs.insert(outputs.end(), fOutputs.begin(), fOutputs.end());
+	for (size_t i = 0; i < outputs.size(); i++) {
+		MovieEncoder* output = outputs[i];
+		output->fDecompressionPool = fDecompressionPool;
+		output->fOutputStatus = output->_OpenOutput(sourceSpace, fps);
+		if (output->fOutputStatus != B_OK) {
+			std::cerr << "MovieEncoder::_EncodeOutputs(): cannot create "
+				<< output->fOutputFile.Path() << ": " << ::strerror(output->fOutputStatus) << std::endl;
+		}
 	}
+	status_t status = fOutputStatus;
+
+	// The pointer is drawn once, on the shared frame
+	ImageFilterChain* cursor = NULL;
+	if (status == B_OK && fFileList->GetCursorTrack() != NULL) {
+		cursor = new (std::nothrow) ImageFilterChain;
+		if (cursor == NULL)
+			status = B_NO_MEMORY;
+		else {
+			status = cursor->AddFilter(new (std::nothrow) ImageFilterCursor(
+				fFileList->GetCursorTrack(), _CapturedFrame()));
+		}
+	}
+
+	BMessage initialMessage(kEncodingProgress);
+	initialMessage.AddBool("reset", true);
+	initialMessage.AddInt32("frames_total", framesTotal);
+	initialMessage.AddString("text", "Encoding...");
+	fMessenger.SendMessage(&initialMessage);
 
+	FramePrefetcher prefetcher(fFileList, fSession.encodeLookahead);
 	if (status == B_OK)
-		status = _PostEncodingAction(fTempPath, frames, int32(fps));
+		status = prefetcher.Start();
+
+	bigtime_t encodeTime = 0;
+	output_work work = { outputs.data(), NULL, NULL, 0 };
+	// Kept until the next frame is read, for the duplicates
+	BBitmap* lastFrame = NULL;
+	while (status == B_OK && !fKillThread && framesWritten < framesTotal) {
+		const BitmapEntry* entry = fFileList->ItemAt(framesWritten);
+		_Throttle();
+		BBitmap* frame = prefetcher.NextFrame(&status);
+		const bool duplicate = frame == NULL && status == B_OK
+			&& lastFrame != NULL && fFileList->IsDuplicate(framesWritten);
+		if (frame == NULL && !duplicate) {
+			if (status == B_OK)
+				status = B_ERROR;
+			break;
+		}
+		if (frame != NULL) {
+			prefetcher.Recycle(lastFrame);
+			lastFrame = frame;
+			if (status == B_OK && cursor != NULL) {
+				BBitmap* drawn = NULL;
+				TraceScope trace("filter", framesWritten);
+				status = cursor->Apply(frame, entry->TimeStamp(), &drawn);
+			}
+			if (status != B_OK)
+				break;
+		}
 
-	_HandleEncodingFinished(status, status == B_OK ? frames : 0);
+		const bigtime_t encodeStart = system_time();
+		work.frame = frame;
+		work.entry = entry;
+		work.nextTime = NextFrameTime(fFileList, framesWritten);
+		if (fDecompressionPool != NULL)
+			status = fDecompressionPool->Run(_WriteOutputFrames, &work, outputs.size());
+		else {
+			for (size_t i = 0; i < outputs.size(); i++)
+				_WriteOutputFrames(&work, i);
+		}
+		if (status == B_OK)
+			status = fOutputStatus;
+		const bigtime_t elapsed = system_time() - encodeStart;
+		encodeTime += elapsed;
+		if (status != B_OK) {
+			std::cerr << "MovieEncoder::_EncodeOutputs(): cannot write frame " << framesWritten << ": " << ::strerror(status) << std::endl;
+			break;
+		}
+		if (fStats != NULL)
+			fStats->AddFrame(elapsed, 0, duplicate);
 
+		framesWritten++;
+		if (!fMessenger.IsValid())
+			break;
+		BMessage progressMessage(kEncodingProgress);
+		progressMessage.AddInt32("frames_remaining", framesTotal - framesWritten);
+		fMessenger.SendMessage(&progressMessage);
+	}
+	prefetcher.Recycle(lastFrame);
+	prefetcher.Stop();
+	delete cursor;
+
+	if (status == B_OK && fKillThread)
+		status = B_CANCELED;
+	for (size_t i = 0; i < outputs.size(); i++) {
+		MovieEncoder* output = outputs[i];
+		const status_t closeStatus = output->_CloseOutput();
+		if (output->fOutputStatus == B_OK)
+			output->fOutputStatus = closeStatus;
+		if (output == this) {
+			if (status == B_OK)
+				status = closeStatus;
+			continue;
+		}
+		// The file of this encoder is moved by the application
+		const bool raw = strcmp(output->fFileFormat.short_name, NULL_FORMAT_SHORT_NAME) == 0;
+		if (status == B_OK && output->fOutputStatus == B_OK) {
+			std::cout << "MovieEncoder: encoded " << output->fOutputFrames << " frames to "
+				<< (raw ? output->fTempPath.Path() : output->fOutputFile.Path()) << std::endl;
+		} else if (!raw)
+			BEntry(output->fOutputFile.Path()).Remove();
+	}
+	if (framesWritten > 0) {
+		std::cout << "Per frame: load " << prefetcher.LoadTime() / framesWritten / 1000.0
+			<< " ms, wait " << prefetcher.WaitTime() / framesWritten / 1000.0
+			<< " ms, encode " << encodeTime / framesWritten / 1000.0 << " ms for "
+			<< outputs.size() << " outputs" << std::endl;
+	}
+	return status;
+}
+
+
+/* static */
+void
+MovieEncoder::_WriteOutputFrames(void* cookie, int32 index)
+{
+	output_work* work = static_cast<output_work*>(cookie);
+	MovieEncoder* output = work->outputs[index];
+	if (output->fOutputStatus == B_OK)
+		output->fOutputStatus = output->_WriteOutputFrame(work->frame, work->entry,
+			work->nextTime);
+}
+
+
+// Creates the file of an output, or the folder of its frames
+status_t
+MovieEncoder::_OpenOutput(color_space sourceSpace, float fps)
+{
+	fOutputFiltered = NULL;
+	fOutputFrames = 0;
+	fLastFrameFile = "";
+	_ResetEncodingState();
+
+	status_t status = B_OK;
+	if (strcmp(fFileFormat.short_name, NULL_FORMAT_SHORT_NAME) == 0) {
+		fOutputFilters = _CreateFilterChain(fColorSpace, NULL);
+		if (fOutputFilters == NULL)
+			return B_NO_MEMORY;
+		status = _CreateFramesFolder();
+	} else if (strcmp(fFileFormat.short_name, GIF_FORMAT_SHORT_NAME) == 0) {
+		fOutputFilters = _CreateFilterChain(B_RGB32, NULL);
+		fGIFEncoder = new (std::nothrow) GIFEncoder(fDecompressionPool);
+		if (fOutputFilters == NULL || fGIFEncoder == NULL)
+			return B_NO_MEMORY;
+		status = fGIFEncoder->Open(fOutputFile.Path());
+	} else {
+		media_format format = fFormat;
+		_NegotiateColorSpace(format, sourceSpace);
+		format.u.raw_video.field_rate = fps;
+		fOutputFilters = _CreateFilterChain(format.u.raw_video.display.format, NULL);
+		if (fOutputFilters == NULL)
+			return B_NO_MEMORY;
+		status = _CreateFile(fOutputFile.Path(), fFileFormat, format, fCodecInfo,
+			fQuality);
+	}
+	return status;
+}
+
+
+// Called from the worker threads, at the same time for all the
+// outputs: the frame, with the pointer already drawn, is only read
+status_t
+MovieEncoder::_WriteOutputFrame(BBitmap* frame, const BitmapEntry* entry,
+	bigtime_t nextTime)
+{
+	status_t status = B_OK;
+	if (frame != NULL) {
+		TraceScope trace("filter", fOutputFrames);
+		status = fOutputFilters->Apply(frame, entry->TimeStamp(), &fOutputFiltered);
+	}
+	if (status != B_OK)
+		return status;
+
+	if (fGIFEncoder != NULL) {
+		// GIF images have their own duration: duplicates
+		// just make the previous one last longer
+		if (frame != NULL)
+			status = fGIFEncoder->WriteFrame(fOutputFiltered, entry->TimeStamp());
+		else
+			status = fGIFEncoder->WriteDuplicate(entry->TimeStamp());
+	} else if (fMediaTrack != NULL) {
+		status = _WriteFrameCopies(fOutputFiltered, fOutputFrames + 1,
+			_IsKeyFrame(entry->ChangeRatio()), entry->TimeStamp(), nextTime);
+	} else {
+		BString fileName;
+		fileName.SetToFormat("%s/frame_%07" B_PRId32 ".bmp", fTempPath.Path(),
+			fOutputFrames + 1);
+		if (frame != NULL || ::link(fLastFrameFile.String(), fileName.String()) != 0)
+			status = FramesList::WriteFrame(fOutputFiltered, entry->TimeStamp(), fileName);
+		fLastFrameFile = fileName;
+	}
+	if (status == B_OK)
+		fOutputFrames++;
+	return status;
+}
+
+
+status_t
+MovieEncoder::_CloseOutput()
+{
+	status_t status = B_OK;
+	if (fGIFEncoder != NULL) {
+		status = fGIFEncoder->Close();
+		delete fGIFEncoder;
+		fGIFEncoder = NULL;
+	} else if (fMediaFile != NULL)
+		status = _CloseFile();
+	delete fOutputFilters;
+	fOutputFilters = NULL;
+	fOutputFiltered = NULL;
 	return status;
 }
 
@@ -464,7 +1680,7 @@ MovieEncoder::EncodeThreaded()
 	fKillThread = false;
 
 	fEncoderThread = spawn_thread((thread_entry)EncodeStarter,
-		"Encoder Thread", B_DISPLAY_PRIORITY, this);
+		"Encoder Thread", fPriority, this);
 
 	if (fEncoderThread < 0)
 		return fEncoderThread;
@@ -479,6 +1695,181 @@ MovieEncoder::EncodeThreaded()
 }
 
 
+// Creates the file before the capture starts, so the frames can
+// be written as they arrive
+thread_id
+MovieEncoder::StartLiveEncoding(FramePool* pool, const CursorTrack* cursorTrack,
+	float fps)
+{
+	if (pool == NULL || fps <= 0)
+		return B_BAD_VALUE;
+	if (fFileList != NULL || fLiveWaiting)
+		return B_BUSY;
+	// Raw frames are only written after the capture. With the
+	// adaptive frame rate, a frame can only be written again
+	// once the next one is known
+	if ((strcmp(MediaFileFormat().short_name, NULL_FORMAT_SHORT_NAME) == 0) ||
+		(strcmp(MediaFileFormat().short_name, GIF_FORMAT_SHORT_NAME) == 0)
+		|| fSession.adaptiveFrameRate)
+		return B_NOT_SUPPORTED;
+
+	_DeleteLiveData();
+	_InitDecompressionPool();
+
+	if (!fDestFrame.IsValid())
+		fDestFrame = pool->Frame().OffsetToCopy(B_ORIGIN);
+
+	media_format mediaFormat = fFormat;
+	_NegotiateColorSpace(mediaFormat, pool->ColorSpace());
+	mediaFormat.u.raw_video.field_rate = fps;
+
+	status_t status = B_OK;
+	// The queue can hold all the buffers, so pushing can't fail
+	fLiveQueue = new (std::nothrow) FrameQueue(pool->CountBuffers());
+	fLiveFilters = _CreateFilterChain(mediaFormat.u.raw_video.display.format,
+		cursorTrack);
+	if (fLiveQueue == NULL || fLiveFilters == NULL)
+		status = B_NO_MEMORY;
+	else
+		status = fLiveQueue->InitCheck();
+	if (status == B_OK) {
+		fLiveDrainedSem = create_sem(0, "live encoder drained");
+		fLiveSourceSem = create_sem(0, "live encoder source");
+		if (fLiveDrainedSem < 0)
+			status = fLiveDrainedSem;
+		else if (fLiveSourceSem < 0)
+			status = fLiveSourceSem;
+	}
+	if (status == B_OK)
+		status = _CreateFile(fOutputFile.Path(), fFileFormat, mediaFormat, fCodecInfo,
+			fQuality);
+	if (status != B_OK) {
+		_DeleteLiveData();
+		return status;
+	}
+
+	_ResetEncodingState();
+	fLiveFramePool = pool;
+	fKillThread = false;
+	fEncoderThread = spawn_thread((thread_entry)LiveEncodeStarter,
+		"Live encoder thread", B_DISPLAY_PRIORITY, this);
+	if (fEncoderThread >= 0) {
+		status = resume_thread(fEncoderThread);
+		if (status != B_OK)
+			kill_thread(fEncoderThread);
+	} else
+		status = fEncoderThread;
+
+	if (status != B_OK) {
+		_CloseFile();
+		BEntry(fOutputFile.Path()).Remove();
+		_DeleteLiveData();
+		return status;
+	}
+	fLiveWaiting = true;
+	return fEncoderThread;
+}
+
+
+// Called by the capture thread: never blocks.
+// Once it fails, it keeps failing, so that the frames
+// which are spooled all come after the encoded ones
+bool
+MovieEncoder::EncodeLiveFrame(BBitmap* bitmap, bigtime_t frameTime)
+{
+	if (atomic_get(&fLiveBehind) != 0)
+		return false;
+
+	// Half of the buffers waiting for the encoder means
+	// it's not keeping up with the capture
+	const int32 limit = std::max(fLiveQueue->Capacity() / 2, int32(1));
+	if (fLiveQueue->Depth() >= limit
+		|| !fLiveQueue->Push(bitmap, frameTime)) {
+		atomic_set(&fLiveBehind, 1);
+		std::cerr << "MovieEncoder: the encoder can't keep up, spooling the next frames" << std::endl;
+		return false;
+	}
+	return true;
+}
+
+
+// Must be called once the capture thread is gone.
+// Waits until the queued frames are encoded, after which
+// the encoder doesn't use the frame pool anymore
+status_t
+MovieEncoder::StopLiveEncoding()
+{
+	if (!fLiveWaiting)
+		return B_NO_INIT;
+
+	fLiveQueue->Close();
+	status_t status;
+	do {
+		status = acquire_sem(fLiveDrainedSem);
+	} while (status == B_INTERRUPTED);
+	return status;
+}
+
+
+void
+MovieEncoder::_DeleteLiveData()
+{
+	delete fLiveFilters;
+	fLiveFilters = NULL;
+	delete fLiveQueue;
+	fLiveQueue = NULL;
+	if (fLiveDrainedSem >= 0)
+		delete_sem(fLiveDrainedSem);
+	fLiveDrainedSem = -1;
+	if (fLiveSourceSem >= 0)
+		delete_sem(fLiveSourceSem);
+	fLiveSourceSem = -1;
+	fLiveFramePool = NULL;
+	fLiveBehind = 0;
+	fLiveWaiting = false;
+}
+
+
+void
+MovieEncoder::_ResetEncodingState()
+{
+	fKeyFrameInterval = fSession.keyFrameInterval;
+	fSceneChangeKeyFrames = fSession.sceneChangeKeyFrames;
+	fFramesSinceKeyFrame = -1;
+	fLastChangeRatio = -1;
+	fFirstFrameTime = -1;
+}
+
+
+// Must be called for every frame, in order. There's
+// a key frame every fKeyFrameInterval frames and, if enabled,
+// where most of the frame starts changing. The frames after
+// that change as much, but don't need another one
+bool
+MovieEncoder::_IsKeyFrame(float changeRatio)
+{
+	bool keyFrame = fFramesSinceKeyFrame < 0
+		|| fFramesSinceKeyFrame >= fKeyFrameInterval;
+	if (fSceneChangeKeyFrames && changeRatio >= kSceneChangeRatio
+		&& fLastChangeRatio < kSceneChangeRatio)
+		keyFrame = true;
+
+	fLastChangeRatio = changeRatio;
+	fFramesSinceKeyFrame = keyFrame ? 1 : fFramesSinceKeyFrame + 1;
+	return keyFrame;
+}
+
+
+void
+MovieEncoder::_InitDecompressionPool()
+{
+	// Compressed frames are decompressed in parallel,
+	// also scaled and converted, by the shared threads
+	if (fDecompressionPool == NULL)
+		fDecompressionPool = WorkerPool::Shared(WorkerPool::kNormalWork);
+}
+
+
 void
 MovieEncoder::ResetConfiguration()
 {
@@ -542,55 +1933,6 @@ MovieEncoder::MediaCodecInfo() const
 }
 
 
-// private methods
-BBitmap*
-MovieEncoder::GetCursorBitmap(const uint8* cursor)
-{
-	uint8 size = *cursor;
-
-	BBitmap* cursorBitmap = new BBitmap(BRect(0, 0, size - 1, size - 1), B_RGBA32);
-
-	uint32 black = 0xFF000000;
-	uint32 white = 0xFFFFFFFF;
-
-	uint8* castCursor = const_cast<uint8*>(cursor);
-	uint16* cursorPtr = reinterpret_cast<uint16*>(castCursor + 4);
-	uint16* maskPtr = reinterpret_cast<uint16*>(castCursor + 36);
-	uint8* buffer = static_cast<uint8*>(cursorBitmap->Bits());
-	uint16 cursorFlip, maskFlip;
-	uint16 cursorVal, maskVal;
-	for (uint8 row = 0; row < size; row++) {
-		uint32* bits = (uint32*)(buffer + (row * cursorBitmap->BytesPerRow()));
-		cursorFlip = (cursorPtr[row] & 0xFF) << 8;
-		cursorFlip |= (cursorPtr[row] & 0xFF00) >> 8;
-
-		maskFlip = (maskPtr[row] & 0xFF) << 8;
-		maskFlip |= (maskPtr[row] & 0xFF00) >> 8;
-
-		for (uint8 column = 0; column < size; column++) {
-			uint16 posVal = 1 << (15 - column);
-			cursorVal = cursorFlip & posVal;
-			maskVal = maskFlip & posVal;
-			bits[column] = (cursorVal != 0 ? black : white) &
-							(maskVal > 0 ? white : 0x00FFFFFF);
-		}
-	}
-
-	return cursorBitmap;
-}
-
-
-status_t
-MovieEncoder::PopCursorPosition(BPoint& point)
-{
-	ASSERT(fCursorQueue != NULL);
-	//point = fCursorQueue->front();
-	//fCursorQueue->pop();
-
-	return B_OK;
-}
-
-
 int32
 MovieEncoder::EncodeStarter(void* arg)
 {
@@ -598,87 +1940,10 @@ MovieEncoder::EncodeStarter(void* arg)
 }
 
 
-static uint32
-ExtractNumFrames(char* string)
-{
-	float numFrames = 0;
-	char rest[256];
-	if (sscanf(string, "frame=%f %s", &numFrames, rest) == 0)
-		return 0;
-
-	return uint32(numFrames);
-}
-
-
-status_t
-MovieEncoder::_PostEncodingAction(const BPath& path, int32 numFrames, int32 fps)
+int32
+MovieEncoder::LiveEncodeStarter(void* arg)
 {
-	// For now we need PostEncoding only for GIF export
-	if (strcmp(MediaFileFormat().short_name, GIF_FORMAT_SHORT_NAME) != 0)
-		return B_OK;
-
-	if (!IsFFMPEGAvailable()) {
-		std::cerr << "ffmpeg_tools is not available" << std::endl;
-		return B_ERROR;
-	}
-
-	BMessage progressMessage(kEncodingProgress);
-	progressMessage.AddBool("reset", true);
-	progressMessage.AddInt32("frames_total", numFrames);
-	progressMessage.AddString("text", "Processing...");
-	fMessenger.SendMessage(&progressMessage);
-
-	if (fps < 0)
-		fps = 0;
-
-	BString command;
-	command.Append("ffmpeg "); // command
-	command.Append("-i ").Append(path.Path()).Append("/frame_%07d.bmp"); // input
-	command.Append(" -f gif "); // output type
-	// filter
-	command.Append("-vf \"");
-	// add FPS
-	command.Append("fps=");
-	command << fps;
-	command.Append(",");
-	// optimize conversion by generating a palette
-	command.Append("split[s0][s1];[s0]palettegen=stats_mode=diff[p];[s1][p]paletteuse=new=1:diff_mode=rectangle ");
-	command.Append("\"");
-	command.Append(" ");
-	command.Append(" -progress pipe:1 "); // to show progress
-	command.Append(fOutputFile.Path()); // output
-	//command.Append (" 2>&1");
-#if 1
-	std::cout << "PostEncodingAction command: " << command.String() << std::endl;
-#endif
-
-	status_t status = B_ERROR;
-	FILE* commandStream = ::popen(command.String(), "r");
-	if (commandStream != NULL) {
-		char line[256];
-		while (fgets(line, 256, commandStream) != NULL) {
-			uint32 frames = ExtractNumFrames(line);
-			if (frames != 0) {
-				BMessage progressMessage(kEncodingProgress);
-				progressMessage.AddInt32("frames_remaining", numFrames - frames);
-				fMessenger.SendMessage(&progressMessage);
-			}
-		}
-		::pclose(commandStream);
-		status = B_OK;
-	}
-
-	// Remove temporary path/files
-	BEntry pathEntry(fTempPath.Path());
-	if (pathEntry.Exists()) {
-		BDirectory dir(fTempPath.Path());
-		BEntry fileEntry;
-		while (dir.GetNextEntry(&fileEntry) == B_OK)
-			fileEntry.Remove();
-		pathEntry.Remove();
-	}
-
-	return status;
+	return static_cast<MovieEncoder*>(arg)->_LiveEncoderThread();
 }
 
 
@@ -692,6 +1957,8 @@ MovieEncoder::_HandleEncodingFinished(const status_t& status, const int32& numFr
 
 	BMessage message(kEncodingFinished);
 	message.AddInt32("status", (int32)status);
+	// Tells which encoder finished, when there are many
+	message.AddInt32("thread", find_thread(NULL));
 	if (numFrames > 0) {
 		message.AddInt32("frames", (int32)numFrames);
 		if (strcmp(MediaFileFormat().short_name, NULL_FORMAT_SHORT_NAME) == 0)
@@ -8,22 +8,37 @@
 #include <MediaDefs.h>
 #include <MediaFile.h>
 #include <Path.h>
+#include <String.h>
+
+#include "SessionConfig.h"
+
+#include <vector>
 
-#include <queue>
 
 class BBitmap;
+class BitmapEntry;
+class CursorTrack;
+class FramePool;
+class FrameQueue;
 class FramesList;
+class GIFEncoder;
+class ImageFilterChain;
+class StageStats;
+class WorkerPool;
 class MovieEncoder {
 public:
 	MovieEncoder();
 	~MovieEncoder();
 
+	// A new encoder configured like this one, which can encode
+	// another clip at the same time
+	MovieEncoder* CreateCopy() const;
+
 	void DisposeData();
 
 	void Cancel();
 
 	status_t SetSource(FramesList* fileList);
-	status_t SetCursorQueue(std::queue<BPoint> *queue);
 	status_t SetOutputFile(const char *fileName);
 	BPath OutputFile() const;
 
@@ -31,7 +46,17 @@ public:
 	void SetColorSpace(const color_space &space);
 	status_t SetQuality(const float &quality);
 	status_t SetThreadPriority(const int32 &value);
+	// While a capture runs, so it isn't slowed down
+	void SetThrottled(bool throttled);
 	status_t SetMessenger(const BMessenger &messenger);
+	// The settings of the recording. Until one is given,
+	// the ones there were when the encoder was created
+	void SetSessionConfig(const session_config& config);
+	// Every frame encoded is counted there, with the ones of the segments
+	void SetStats(StageStats* stats);
+	// The threads which decompress, scale and write the frames.
+	// The shared ones of normal priority, if none is given
+	void SetWorkerPool(WorkerPool* pool);
 
 	BView*	CodecOptionsView();
 	media_file_format	MediaFileFormat() const;
@@ -44,47 +69,102 @@ public:
 	void SetMediaFormat(const media_format &);
 	void SetMediaCodecInfo(const media_codec_info &);
 
+	// Batch encoding: the output, configured like an encoder, is
+	// made from the same decoded frames, in the same pass. Takes
+	// ownership, until the encoding is over. Not while recording
+	status_t AddOutput(MovieEncoder* output);
+	int32 CountOutputs() const;
+
 	thread_id EncodeThreaded();
 
+	// Encoding while recording: the captured frames are given to
+	// EncodeLiveFrame(), which fails from the moment the encoder
+	// falls behind. The remaining frames must then be spooled, and
+	// given with SetSource() after StopLiveEncoding().
+	// The cursor track must be valid until the encoding is finished
+	thread_id StartLiveEncoding(FramePool* pool,
+						const CursorTrack* cursorTrack, float fps);
+	bool EncodeLiveFrame(BBitmap* bitmap, bigtime_t frameTime);
+	status_t StopLiveEncoding();
+
 private:
 	void ResetConfiguration();
 
-	BBitmap *GetCursorBitmap(const uint8 *data);
-	status_t PopCursorPosition(BPoint &point);
-
 	status_t _CreateFile(const char* path,
 						const media_file_format& mff,
 						const media_format& inputFormat,
 						const media_codec_info& mci,
 						float quality = -1);
-	status_t _WriteFrame(const BBitmap* bitmap, int32 frameNum, bool isKeyFrame);
+	status_t _WriteFrame(const BBitmap* bitmap, int32 frameNum, bool isKeyFrame,
+						bigtime_t frameTime);
+	status_t _WriteFrameCopies(const BBitmap* bitmap, int32 frameNum,
+						bool isKeyFrame, bigtime_t frameTime,
+						bigtime_t nextTime);
 	status_t _CloseFile();
 
 	static int32 EncodeStarter(void *arg);
 	status_t _EncoderThread();
-
-	status_t _ApplyImageFilters();
-	status_t _WriteRawFrames();
+	static int32 LiveEncodeStarter(void *arg);
+	status_t _LiveEncoderThread();
+	void _DeleteLiveData();
+
+	void _InitDecompressionPool();
+	void _ResetEncodingState();
+	bool _IsKeyFrame(float changeRatio);
+	status_t _EncodeFile(const media_format& format, int32& framesWritten);
+	status_t _EncodeFrames(ImageFilterChain* filters, int32& framesWritten);
+	bool _IsCanceled() const;
+	void _Throttle();
+
+	int32 _CountSegments() const;
+	status_t _EncodeSegments(const media_format& format, int32 count,
+							int32& framesWritten);
+	static int32 SegmentStarter(void* arg);
+	status_t _SegmentThread();
+	status_t _JoinSegments(MovieEncoder* const* segments, int32 count);
+	status_t _ConcatSegments(MovieEncoder* const* segments, int32 count);
+	status_t _CopySegments(MovieEncoder* const* segments, int32 count);
+	void _NegotiateColorSpace(media_format& format,
+							color_space sourceSpace) const;
+	BRect _CapturedFrame() const;
+	ImageFilterChain* _CreateFilterChain(color_space colorSpace,
+							const CursorTrack* cursorTrack) const;
+	status_t _WriteRawFrames(ImageFilterChain* filters);
+	status_t _WriteGIF(ImageFilterChain* filters);
+	status_t _PipeToFFMPEG(ImageFilterChain* filters,
+							const char* outputOptions);
+	status_t _CreateFramesFolder();
+
+	status_t _EncodeOutputs(int32& framesWritten);
+	static void _WriteOutputFrames(void* cookie, int32 index);
+	status_t _OpenOutput(color_space sourceSpace, float fps);
+	status_t _WriteOutputFrame(BBitmap* frame, const BitmapEntry* entry,
+							bigtime_t nextTime);
+	status_t _CloseOutput();
 
 	void _HandleEncodingFinished(const status_t& status,
 								const int32& numFrames = 0);
-	status_t _PostEncodingAction(const BPath& path, int32 numFrames, int32 fps);
 
 	thread_id	fEncoderThread;
 	bool		fKillThread;
 
 	int32 fPriority;
+	int32 fThrottled;
+	// Only used by the thread encoding, to know its priority
+	bool fThreadThrottled;
 	BMessenger fMessenger;
 
 	FramesList* fFileList;
-
-	std::queue<BPoint> *fCursorQueue;
+	WorkerPool* fDecompressionPool;
+	StageStats* fStats;
+	session_config fSession;
 
 	BPath fOutputFile;
 	BPath fTempPath;
 
 	BRect fDestFrame;
 	color_space fColorSpace;
+	float fQuality;
 	BMediaFile*			fMediaFile;
 	BMediaTrack*		fMediaTrack;
 	bool				fHeaderCommitted;
@@ -93,6 +173,38 @@ private:
 	media_format_family	fFamily;
 	media_format		fFormat;
 	media_codec_info	fCodecInfo;
+
+	FramePool*			fLiveFramePool;
+	FrameQueue*			fLiveQueue;
+	ImageFilterChain*	fLiveFilters;
+	int32				fLiveBehind;
+	bool				fLiveWaiting;
+	sem_id				fLiveDrainedSem;
+	sem_id				fLiveSourceSem;
+
+	int32				fKeyFrameInterval;
+	bool				fSceneChangeKeyFrames;
+	int32				fFramesSinceKeyFrame;
+	float				fLastChangeRatio;
+	bigtime_t			fFirstFrameTime;
+
+	// Segment encoders only encode a part of the list, into their
+	// own file. The parent counts the frames all of them encoded
+	MovieEncoder*		fParent;
+	int32				fSegmentFirst;
+	int32				fSegmentEnd;
+	int32				fFramesEncoded;
+
+	// The outputs share the frames with this encoder, each one
+	// filters and writes them from its own thread.
+	// The first output is this encoder
+	std::vector<MovieEncoder*> fOutputs;
+	ImageFilterChain*	fOutputFilters;
+	BBitmap*			fOutputFiltered;
+	GIFEncoder*			fGIFEncoder;
+	BString				fLastFrameFile;
+	int32				fOutputFrames;
+	status_t			fOutputStatus;
 };
 
 
@@ -212,9 +212,11 @@ OutputView::MessageReceived(BMessage *message)
 
 				case kMsgControllerCaptureStarted:
 					fScaleSlider->SetEnabled(false);
+					fPreviewView->SetLivePreview(app->Preview());
 					break;
 
 				case kMsgControllerCaptureStopped:
+					fPreviewView->SetLivePreview(NULL);
 					break;
 
 				case kMsgControllerEncodeStarted:
@@ -223,7 +225,8 @@ OutputView::MessageReceived(BMessage *message)
 
 				case kMsgControllerEncodeFinished:
 					_UpdateFileNameControlState();
-					fScaleSlider->SetEnabled(true);
+					// A queued clip can be done while recording the next one
+					fScaleSlider->SetEnabled(app->State() != BSCApp::STATE_RECORDING);
 					break;
 
 				case kMsgControllerResetSettings:
@@ -0,0 +1,266 @@
+/*
+ * Copyright 2026 Stefano Ceccherini <stefano.ceccherini@gmail.com>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+#include "PipelineStats.h"
+
+#include <Message.h>
+#include <String.h>
+
+#include <algorithm>
+
+const static int32 kPercentiles[] = { 50, 90, 99 };
+
+
+StageStats::StageStats()
+{
+	Reset();
+}
+
+
+void
+StageStats::Reset()
+{
+	atomic_set64(&fFrames, 0);
+	atomic_set64(&fDuplicates, 0);
+	atomic_set64(&fBytes, 0);
+	atomic_set64(&fFirstTime, -1);
+	atomic_set64(&fLastTime, -1);
+	for (int32 i = 0; i < kLatencyBuckets; i++)
+		atomic_set64(&fBuckets[i], 0);
+}
+
+
+void
+StageStats::AddFrame(bigtime_t latency, int64 bytes, bool duplicate)
+{
+	const bigtime_t now = system_time();
+	// Only the first frame finds -1: later ones leave it alone
+	atomic_test_and_set64(&fFirstTime, now - latency, -1);
+	atomic_set64(&fLastTime, now);
+	atomic_add64(&fBuckets[_Bucket(latency)], 1);
+	if (bytes > 0)
+		atomic_add64(&fBytes, bytes);
+	if (duplicate)
+		atomic_add64(&fDuplicates, 1);
+	atomic_add64(&fFrames, 1);
+}
+
+
+int64
+StageStats::Frames() const
+{
+	return atomic_get64(const_cast<int64*>(&fFrames));
+}
+
+
+int64
+StageStats::Duplicates() const
+{
+	return atomic_get64(const_cast<int64*>(&fDuplicates));
+}
+
+
+int64
+StageStats::Bytes() const
+{
+	return atomic_get64(const_cast<int64*>(&fBytes));
+}
+
+
+float
+StageStats::FrameRate() const
+{
+	const bigtime_t first = atomic_get64(const_cast<int64*>(&fFirstTime));
+	const bigtime_t last = atomic_get64(const_cast<int64*>(&fLastTime));
+	if (first < 0 || last <= first)
+		return 0;
+	return float(Frames()) * 1000000 / (last - first);
+}
+
+
+int64
+StageStats::Throughput() const
+{
+	const bigtime_t first = atomic_get64(const_cast<int64*>(&fFirstTime));
+	const bigtime_t last = atomic_get64(const_cast<int64*>(&fLastTime));
+	if (first < 0 || last <= first)
+		return 0;
+	return Bytes() * 1000000 / (last - first);
+}
+
+
+void
+StageStats::AddLatencies(int64* buckets) const
+{
+	for (int32 i = 0; i < kLatencyBuckets; i++)
+		buckets[i] += atomic_get64(const_cast<int64*>(&fBuckets[i]));
+}
+
+
+/* static */
+bigtime_t
+StageStats::Percentile(const int64* buckets, int32 percent)
+{
+	int64 total = 0;
+	for (int32 i = 0; i < kLatencyBuckets; i++)
+		total += buckets[i];
+	if (total == 0)
+		return 0;
+
+	// The smallest latency of at least percent of the frames
+	const int64 rank = std::max(int64(1), (total * percent + 99) / 100);
+	int64 count = 0;
+	for (int32 i = 0; i < kLatencyBuckets; i++) {
+		count += buckets[i];
+		if (count >= rank)
+			return _BucketValue(i);
+	}
+	return _BucketValue(kLatencyBuckets - 1);
+}
+
+
+// The first four buckets hold one microsecond each, then every
+// power of two is split in four
+/* static */
+int32
+StageStats::_Bucket(bigtime_t latency)
+{
+	if (latency < 4)
+		return std::max(int32(latency), int32(0));
+
+	int32 octave = 2;
+	while (octave < 62 && (latency >> (octave + 1)) != 0)
+		octave++;
+	const int32 bucket = 4 * (octave - 1) + int32((latency >> (octave - 2)) & 3);
+	return std::min(bucket, kLatencyBuckets - 1);
+}
+
+
+// The middle of the bucket
+/* static */
+bigtime_t
+StageStats::_BucketValue(int32 bucket)
+{
+	if (bucket < 4)
+		return bucket;
+
+	const int32 octave = bucket / 4 + 1;
+	const bigtime_t start = bigtime_t(4 + bucket % 4) << (octave - 2);
+	return start + (bigtime_t(1) << (octave - 2)) / 2;
+}
+
+
+// #pragma mark - PipelineStats
+
+
+PipelineStats::PipelineStats()
+	:
+	fDroppedFrames(0),
+	fSkippedFrames(0)
+{
+}
+
+
+void
+PipelineStats::Reset()
+{
+	fGrab.Reset();
+	fEncode.Reset();
+	for (int32 i = 0; i < kMaxWriterStats; i++)
+		fWrite[i].Reset();
+	atomic_set(&fDroppedFrames, 0);
+	atomic_set(&fSkippedFrames, 0);
+}
+
+
+StageStats&
+PipelineStats::Grab()
+{
+	return fGrab;
+}
+
+
+void
+PipelineStats::SetDroppedFrames(int32 count)
+{
+	atomic_set(&fDroppedFrames, count);
+}
+
+
+void
+PipelineStats::AddSkippedFrame()
+{
+	atomic_add(&fSkippedFrames, 1);
+}
+
+
+StageStats&
+PipelineStats::Write(int32 writer)
+{
+	return fWrite[std::min(std::max(writer, int32(0)), kMaxWriterStats - 1)];
+}
+
+
+StageStats&
+PipelineStats::Encode()
+{
+	return fEncode;
+}
+
+
+void
+PipelineStats::Archive(BMessage* message, int32 queueDepth) const
+{
+	int64 buckets[kLatencyBuckets] = {};
+
+	message->AddInt64("frames_grabbed", fGrab.Frames());
+	message->AddInt32("frames_dropped",
+		atomic_get(const_cast<int32*>(&fDroppedFrames)));
+	message->AddInt32("frames_skipped",
+		atomic_get(const_cast<int32*>(&fSkippedFrames)));
+	message->AddFloat("grab_fps", fGrab.FrameRate());
+	fGrab.AddLatencies(buckets);
+	_AddLatencies(message, "grab_latency", buckets);
+
+	// The writers are one stage
+	std::fill(buckets, buckets + kLatencyBuckets, 0);
+	int64 framesWritten = 0;
+	int64 duplicates = 0;
+	int64 bytes = 0;
+	int64 throughput = 0;
+	for (int32 i = 0; i < kMaxWriterStats; i++) {
+		framesWritten += fWrite[i].Frames();
+		duplicates += fWrite[i].Duplicates();
+		bytes += fWrite[i].Bytes();
+		throughput += fWrite[i].Throughput();
+		fWrite[i].AddLatencies(buckets);
+	}
+	message->AddInt32("queue_depth", queueDepth);
+	message->AddInt64("frames_written", framesWritten);
+	message->AddInt64("frames_duplicated", duplicates);
+	message->AddInt64("spool_bytes", bytes);
+	message->AddInt64("spool_throughput", throughput);
+	_AddLatencies(message, "write_latency", buckets);
+
+	std::fill(buckets, buckets + kLatencyBuckets, 0);
+	message->AddInt64("frames_encoded", fEncode.Frames());
+	message->AddInt64("encode_duplicates", fEncode.Duplicates());
+	message->AddFloat("encode_fps", fEncode.FrameRate());
+	fEncode.AddLatencies(buckets);
+	_AddLatencies(message, "encode_latency", buckets);
+}
+
+
+// In microseconds, as name_p50, name_p90 and name_p99
+void
+PipelineStats::_AddLatencies(BMessage* message, const char* name,
+	const int64* buckets) const
+{
+	for (size_t i = 0; i < sizeof(kPercentiles) / sizeof(kPercentiles[0]); i++) {
+		BString field;
+		field << name << "_p" << kPercentiles[i];
+		message->AddInt64(field.String(),
+			StageStats::Percentile(buckets, kPercentiles[i]));
+	}
+}
@@ -0,0 +1,93 @@
+/*
+ * Copyright 2026 Stefano Ceccherini <stefano.ceccherini@gmail.com>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+#ifndef __PIPELINESTATS_H
+#define __PIPELINESTATS_H
+
+#include <OS.h>
+
+class BMessage;
+
+// Four buckets per power of two, up to a couple of hours
+const static int32 kLatencyBuckets = 128;
+// Writers past these share the last counters
+const static int32 kMaxWriterStats = 8;
+
+// The counters of one stage of the capture pipeline.
+// Written by the threads of the stage with atomic operations only,
+// so they can be read at any time, from any thread, without
+// slowing the stage down.
+class StageStats {
+public:
+	StageStats();
+
+	// Can race with a running stage, as a background encode
+	// when a capture starts: the frames it adds meanwhile
+	// may be counted only in part
+	void Reset();
+
+	void AddFrame(bigtime_t latency, int64 bytes = 0,
+			bool duplicate = false);
+
+	int64 Frames() const;
+	int64 Duplicates() const;
+	int64 Bytes() const;
+	// Frames and bytes per second, between the first
+	// and the last frame
+	float FrameRate() const;
+	int64 Throughput() const;
+
+	// Adds the latency counts to the given buckets,
+	// so stages running on more threads can be merged
+	void AddLatencies(int64* buckets) const;
+
+	// percent goes from 0 to 100
+	static bigtime_t Percentile(const int64* buckets, int32 percent);
+
+private:
+	static int32 _Bucket(bigtime_t latency);
+	static bigtime_t _BucketValue(int32 bucket);
+
+	int64 fFrames;
+	int64 fDuplicates;
+	int64 fBytes;
+	int64 fFirstTime;
+	int64 fLastTime;
+	int64 fBuckets[kLatencyBuckets];
+};
+
+
+// The counters of a whole capture, from reading the screen to
+// encoding the file. Every thread has its own StageStats:
+// reading them never stalls the capture.
+class PipelineStats {
+public:
+	PipelineStats();
+
+	// When a capture starts, before its threads are
+	void Reset();
+
+	// Capture thread
+	StageStats& Grab();
+	void SetDroppedFrames(int32 count);
+	void AddSkippedFrame();
+
+	StageStats& Write(int32 writer);
+	StageStats& Encode();
+
+	// queueDepth is read by the caller, which knows the writers
+	void Archive(BMessage* message, int32 queueDepth) const;
+
+private:
+	void _AddLatencies(BMessage* message, const char* name,
+			const int64* buckets) const;
+
+	StageStats fGrab;
+	StageStats fEncode;
+	StageStats fWrite[kMaxWriterStats];
+	int32 fDroppedFrames;
+	int32 fSkippedFrames;
+};
+
+#endif // __PIPELINESTATS_H
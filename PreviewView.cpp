@@ -4,16 +4,24 @@
  */
 #include "PreviewView.h"
 
+#include "FramePreview.h"
+
 #include <Bitmap.h>
 #include <Catalog.h>
 #include <GroupLayout.h>
 #include <LayoutBuilder.h>
+#include <MessageRunner.h>
 #include <Screen.h>
 #include <String.h>
 
+#include <new>
+
 #undef B_TRANSLATION_CONTEXT
 #define B_TRANSLATION_CONTEXT "PreviewView"
 
+const static uint32 kRefreshLivePreview = 'RfLp';
+const static bigtime_t kRefreshInterval = 50000;
+
 
 class BitmapView : public BView {
 public:
@@ -32,13 +40,25 @@ PreviewView::PreviewView()
 	fTimeStamp(0),
 	fChanged(true),
 	fLeftTop(NULL),
-	fRightBottom(NULL)
+	fRightBottom(NULL),
+	fBitmap(NULL),
+	fScreenBitmap(NULL),
+	fLivePreview(NULL),
+	fLiveRunner(NULL)
 {
 	BLayoutBuilder::Group<>(this, B_VERTICAL, B_USE_DEFAULT_SPACING)
 		.Add(fBitmapView = new BitmapView());
 }
 
 
+PreviewView::~PreviewView()
+{
+	delete fLiveRunner;
+	delete fBitmap;
+	delete fScreenBitmap;
+}
+
+
 void
 PreviewView::AttachedToWindow()
 {
@@ -49,6 +69,20 @@ PreviewView::AttachedToWindow()
 }
 
 
+void
+PreviewView::MessageReceived(BMessage* message)
+{
+	switch (message->what) {
+		case kRefreshLivePreview:
+			_UpdateLivePreview();
+			break;
+		default:
+			BView::MessageReceived(message);
+			break;
+	}
+}
+
+
 void
 PreviewView::_SetRect(const BRect& rect)
 {
@@ -94,36 +128,48 @@ PreviewView::Update(const BRect* rect, BBitmap* bitmap)
 	if (rect != NULL)
 		_SetRect(*rect);
 
+	// The frames come from the capture
+	if (fLivePreview != NULL)
+		return;
+
 	bigtime_t now = system_time();
 	if (bitmap == NULL) {
 		// Avoid updating preview too often
-		if (fTimeStamp + 50000 >= now)
+		if (fTimeStamp + kRefreshInterval >= now)
 			return;
-		BScreen screen(Window());
-		screen.GetBitmap(&bitmap, false, &fCoordRect);
+		bitmap = _ReadScreen();
 	}
 	if (bitmap != NULL) {
-		BRect destRect;
-		BRect bitmapBounds = bitmap->Bounds();
-		BRect viewBounds = fBitmapView->Bounds();
-		if (BRectRatio(viewBounds) >= BRectRatio(bitmapBounds)) {
-			float overlap = BRectHorizontalOverlap(viewBounds, bitmapBounds);
-			destRect.Set(-overlap, 0, viewBounds.Width() + overlap,
-						viewBounds.Height());
-		} else {
-			float overlap = BRectVerticalOverlap(viewBounds, bitmapBounds);
-			destRect.Set(0, -overlap, viewBounds.Width(), viewBounds.Height() + overlap);
-		}
 		fTimeStamp = now;
-		fBitmapView->SetViewBitmap(bitmap,
-			bitmap->Bounds().OffsetToCopy(B_ORIGIN),
-			destRect,
-			B_FOLLOW_TOP|B_FOLLOW_LEFT, B_FILTER_BITMAP_BILINEAR);
-		Invalidate();
+		BRect bounds;
+		if (_PrepareBitmap() == B_OK
+			&& FramePreview::Downsample(bitmap, fBitmap, &bounds) == B_OK)
+			_ShowBitmap(fBitmap, bounds);
+		else
+			_ShowBitmap(bitmap, bitmap->Bounds().OffsetToCopy(B_ORIGIN));
 	}
 }
 
 
+void
+PreviewView::SetLivePreview(FramePreview* preview)
+{
+	if (preview == fLivePreview)
+		return;
+
+	delete fLiveRunner;
+	fLiveRunner = NULL;
+	fLivePreview = preview;
+	if (fLivePreview == NULL)
+		return;
+
+	BMessage refresh(kRefreshLivePreview);
+	fLiveRunner = new (std::nothrow) BMessageRunner(BMessenger(this),
+		&refresh, kRefreshInterval);
+	_UpdateLivePreview();
+}
+
+
 BRect
 PreviewView::Rect() const
 {
@@ -131,6 +177,92 @@ PreviewView::Rect() const
 }
 
 
+// The preview is as large as the view: the bitmap is only
+// allocated again when the view is resized
+status_t
+PreviewView::_PrepareBitmap()
+{
+	const BRect viewBounds = fBitmapView->Bounds();
+	const int32 width = viewBounds.IntegerWidth() + 1;
+	const int32 height = viewBounds.IntegerHeight() + 1;
+	if (width <= 0 || height <= 0)
+		return B_BAD_VALUE;
+
+	const BRect frame(0, 0, width - 1, height - 1);
+	if (fBitmap == NULL || fBitmap->Bounds() != frame) {
+		delete fBitmap;
+		fBitmap = new (std::nothrow) BBitmap(frame, B_RGB32);
+		if (fBitmap == NULL || fBitmap->InitCheck() != B_OK) {
+			delete fBitmap;
+			fBitmap = NULL;
+			return B_NO_MEMORY;
+		}
+	}
+	if (fLivePreview != NULL)
+		return fLivePreview->SetSize(width, height);
+	return B_OK;
+}
+
+
+// Reads the capture area into a bitmap which is kept
+// until the area changes size
+BBitmap*
+PreviewView::_ReadScreen()
+{
+	BRect rect = fCoordRect;
+	const BRect frame = rect.OffsetToCopy(B_ORIGIN);
+	if (fScreenBitmap == NULL || fScreenBitmap->Bounds() != frame) {
+		delete fScreenBitmap;
+		fScreenBitmap = new (std::nothrow) BBitmap(frame, B_RGB32);
+		if (fScreenBitmap == NULL || fScreenBitmap->InitCheck() != B_OK) {
+			delete fScreenBitmap;
+			fScreenBitmap = NULL;
+			return NULL;
+		}
+	}
+	if (BScreen(Window()).ReadBitmap(fScreenBitmap, false, &rect) != B_OK)
+		return NULL;
+	return fScreenBitmap;
+}
+
+
+void
+PreviewView::_ShowBitmap(BBitmap* bitmap, const BRect& bounds)
+{
+	BRect destRect;
+	BRect viewBounds = fBitmapView->Bounds();
+	if (BRectRatio(viewBounds) >= BRectRatio(bounds)) {
+		float overlap = BRectHorizontalOverlap(viewBounds, bounds);
+		destRect.Set(-overlap, 0, viewBounds.Width() + overlap,
+					viewBounds.Height());
+	} else {
+		float overlap = BRectVerticalOverlap(viewBounds, bounds);
+		destRect.Set(0, -overlap, viewBounds.Width(), viewBounds.Height() + overlap);
+	}
+	fBitmapView->SetViewBitmap(bitmap, bounds, destRect,
+		B_FOLLOW_TOP|B_FOLLOW_LEFT, B_FILTER_BITMAP_BILINEAR);
+	Invalidate();
+}
+
+
+// Shows the last frame scaled down by the capture thread,
+// and asks for the next one
+void
+PreviewView::_UpdateLivePreview()
+{
+	if (fLivePreview == NULL || Window()->IsHidden())
+		return;
+
+	if (_PrepareBitmap() != B_OK)
+		return;
+
+	BRect bounds;
+	if (fLivePreview->CopyTo(fBitmap, &bounds) == B_OK)
+		_ShowBitmap(fBitmap, bounds);
+	fLivePreview->Request();
+}
+
+
 // BitmapView
 BitmapView::BitmapView()
 	:
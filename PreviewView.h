@@ -7,14 +7,22 @@
 
 #include <View.h>
 
+class BMessageRunner;
 class BStringView;
+class FramePreview;
 class PreviewView : public BView {
 public:
 	PreviewView();
+	virtual ~PreviewView();
 	virtual void AttachedToWindow();
+	virtual void MessageReceived(BMessage* message);
 	void Update(const BRect* rect = NULL, BBitmap* bitmap = NULL);
 	BRect Rect() const;
 
+	// While recording, the preview shows the frames being captured.
+	// NULL goes back to reading the screen
+	void SetLivePreview(FramePreview* preview);
+
 private:
 	BView *fBitmapView;
 	BRect fCoordRect;
@@ -24,7 +32,17 @@ private:
 	BStringView *fLeftTop;
 	BStringView *fRightBottom;
 
+	// Preview sized, reused until the view is resized
+	BBitmap* fBitmap;
+	BBitmap* fScreenBitmap;
+	FramePreview* fLivePreview;
+	BMessageRunner* fLiveRunner;
+
 	void _SetRect(const BRect& rect);
+	status_t _PrepareBitmap();
+	BBitmap* _ReadScreen();
+	void _ShowBitmap(BBitmap* bitmap, const BRect& bounds);
+	void _UpdateLivePreview();
 };
 
 
@@ -8,6 +8,8 @@
 enum publicMessages {
 	kMsgGUIToggleCapture = 'StoR',
 	kMsgGUITogglePause = 'PauC',
+	// int64 "duration", optional
+	kMsgGUISaveReplay = 'SvRp',
 };
 
 #endif // __PUBLIC_MESSAGES_H
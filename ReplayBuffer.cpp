@@ -0,0 +1,392 @@
+/*
+ * Copyright 2026 Stefano Ceccherini <stefano.ceccherini@gmail.com>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+#include "ReplayBuffer.h"
+
+#include <Autolock.h>
+#include <Bitmap.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <new>
+#include <unistd.h>
+
+
+ReplayBuffer::ReplayBuffer()
+	:
+	fColorSpace(B_NO_COLOR_SPACE),
+	fBytesPerRow(0),
+	fFrameLength(0),
+	fCapacity(0),
+	fOnDisk(false),
+	fNextSequence(0),
+	fLocker("replay buffer lock"),
+	fArea(-1),
+	fData(NULL),
+	fFD(-1)
+{
+}
+
+
+ReplayBuffer::~ReplayBuffer()
+{
+	Release();
+}
+
+
+void
+ReplayBuffer::SetCapacity(int32 frames, bool onDisk)
+{
+	fCapacity = std::max(frames, int32(1));
+	fOnDisk = onDisk;
+}
+
+
+// On disk the slots are in the kReplayFileName file in the given
+// folder, which is as large as all of them from the start
+/* virtual */
+status_t
+ReplayBuffer::Create(const char* path, const BRect& bounds,
+	color_space colorSpace, int32 bytesPerRow, int64 memoryBudget)
+{
+	if (path == NULL || !bounds.IsValid() || bytesPerRow <= 0
+		|| memoryBudget < 0 || fCapacity <= 0)
+		return B_BAD_VALUE;
+
+	Release();
+
+	fBounds = bounds;
+	fColorSpace = colorSpace;
+	fBytesPerRow = bytesPerRow;
+	fFrameLength = size_t(bytesPerRow) * (bounds.IntegerHeight() + 1);
+	if (!fOnDisk && memoryBudget > 0) {
+		const int32 fitting = int32(std::min(memoryBudget / int64(fFrameLength),
+			int64(fCapacity)));
+		if (fitting < fCapacity) {
+			std::cerr << "ReplayBuffer: only " << fitting << " of " << fCapacity
+				<< " frames fit in memory" << std::endl;
+			fCapacity = std::max(fitting, int32(1));
+		}
+	}
+
+	try {
+		fSlots.resize(fCapacity);
+	} catch (...) {
+		return B_NO_MEMORY;
+	}
+	for (int32 i = 0; i < fCapacity; i++) {
+		fSlots[i].time = 0;
+		fSlots[i].sequence = -1;
+	}
+	fNextSequence = 0;
+
+	const off_t size = off_t(fFrameLength) * fCapacity;
+	if (fOnDisk) {
+		fPath << path << "/" << kReplayFileName;
+		fFD = ::open(fPath.String(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+		if (fFD < 0 || ::ftruncate(fFD, size) != 0) {
+			status_t status = errno;
+			std::cerr << "ReplayBuffer::Create(): cannot create file: " << ::strerror(status) << std::endl;
+			Release();
+			return status;
+		}
+	} else {
+		fPath = path;
+		const size_t areaSize = (size + B_PAGE_SIZE - 1) & ~(B_PAGE_SIZE - 1);
+		fArea = create_area("replay buffer", (void**)&fData, B_ANY_ADDRESS,
+			areaSize, B_NO_LOCK, B_READ_AREA | B_WRITE_AREA);
+		if (fArea < 0) {
+			status_t status = fArea;
+			Release();
+			return status;
+		}
+	}
+	return B_OK;
+}
+
+
+// The oldest slot is taken, and marked as being written,
+// so CopyTo() doesn't use it meanwhile
+/* virtual */
+status_t
+ReplayBuffer::WriteFrame(const BBitmap* bitmap, bigtime_t frameTime)
+{
+	if (bitmap == NULL || size_t(bitmap->BitsLength()) != fFrameLength)
+		return B_MISMATCHED_VALUES;
+
+	fLocker.Lock();
+	if (fSlots.empty()) {
+		fLocker.Unlock();
+		return B_NO_INIT;
+	}
+	const int64 sequence = fNextSequence++;
+	const int32 slot = int32(sequence % fCapacity);
+	fSlots[slot].sequence = -1;
+	fLocker.Unlock();
+
+	status_t status = _WriteSlot(slot, bitmap->Bits());
+
+	BAutolock _(fLocker);
+	if (status == B_OK) {
+		fSlots[slot].time = frameTime;
+		fSlots[slot].sequence = sequence;
+	}
+	return status;
+}
+
+
+/* virtual */
+status_t
+ReplayBuffer::Finish()
+{
+	return fSlots.empty() ? B_NO_INIT : B_OK;
+}
+
+
+/* virtual */
+int32
+ReplayBuffer::CountFramesInMemory() const
+{
+	return fOnDisk ? 0 : CountFrames();
+}
+
+
+// Every slot is read without holding the lock, then checked again:
+// if it was taken meanwhile, the frame is gone
+status_t
+ReplayBuffer::CopyTo(FrameStore* store, bigtime_t duration, int32* _count) const
+{
+	if (store == NULL || duration < 0)
+		return B_BAD_VALUE;
+
+	BBitmap bitmap(fBounds, 0, fColorSpace, fBytesPerRow);
+	status_t status = bitmap.InitCheck();
+	if (status != B_OK)
+		return status;
+
+	int64 first;
+	int64 end;
+	bigtime_t since = 0;
+	{
+		BAutolock _(fLocker);
+		first = _FirstSequence();
+		end = fNextSequence;
+		if (end == first)
+			return B_ENTRY_NOT_FOUND;
+		if (duration > 0) {
+			const int64 last = _ReadySequence(first, end, true);
+			if (last < 0)
+				return B_ENTRY_NOT_FOUND;
+			since = fSlots[last % fCapacity].time - duration;
+		}
+	}
+
+	int32 count = 0;
+	for (int64 sequence = first; sequence < end && status == B_OK; sequence++) {
+		const int32 slot = int32(sequence % fCapacity);
+		bigtime_t time;
+		{
+			BAutolock _(fLocker);
+			if (fSlots[slot].sequence != sequence)
+				continue;
+			time = fSlots[slot].time;
+		}
+		if (duration > 0 && time < since)
+			continue;
+		status = _ReadSlot(slot, bitmap.Bits());
+		if (status != B_OK)
+			break;
+		{
+			BAutolock _(fLocker);
+			if (fSlots[slot].sequence != sequence)
+				continue;
+		}
+		status = store->WriteFrame(&bitmap, time);
+		if (status == B_OK)
+			count++;
+	}
+	if (_count != NULL)
+		*_count = count;
+	return status;
+}
+
+
+// Of the frames in the buffer
+bigtime_t
+ReplayBuffer::Duration() const
+{
+	BAutolock _(fLocker);
+	const int64 first = _ReadySequence(_FirstSequence(), fNextSequence, false);
+	const int64 last = _ReadySequence(_FirstSequence(), fNextSequence, true);
+	if (first < 0 || last < 0)
+		return 0;
+	return fSlots[last % fCapacity].time - fSlots[first % fCapacity].time;
+}
+
+
+/* virtual */
+status_t
+ReplayBuffer::Open(const char* path)
+{
+	// The slots aren't in order in the file
+	return B_NOT_SUPPORTED;
+}
+
+
+/* virtual */
+const char*
+ReplayBuffer::Path() const
+{
+	return fPath.String();
+}
+
+
+/* virtual */
+BRect
+ReplayBuffer::Bounds() const
+{
+	return fBounds;
+}
+
+
+/* virtual */
+color_space
+ReplayBuffer::ColorSpace() const
+{
+	return fColorSpace;
+}
+
+
+/* virtual */
+int32
+ReplayBuffer::BytesPerRow() const
+{
+	return fBytesPerRow;
+}
+
+
+/* virtual */
+int32
+ReplayBuffer::CountFrames() const
+{
+	BAutolock _(fLocker);
+	return int32(fNextSequence - _FirstSequence());
+}
+
+
+/* virtual */
+bigtime_t
+ReplayBuffer::FrameTime(int32 index) const
+{
+	BAutolock _(fLocker);
+	const int64 sequence = _FirstSequence() + index;
+	if (index < 0 || sequence >= fNextSequence)
+		return -1;
+	return fSlots[sequence % fCapacity].time;
+}
+
+
+/* virtual */
+status_t
+ReplayBuffer::ReadBitmap(int32 index, BBitmap* bitmap) const
+{
+	if (bitmap == NULL || size_t(bitmap->BitsLength()) != fFrameLength
+		|| bitmap->BytesPerRow() != fBytesPerRow)
+		return B_BAD_VALUE;
+
+	int32 slot;
+	{
+		BAutolock _(fLocker);
+		const int64 sequence = _FirstSequence() + index;
+		if (index < 0 || sequence >= fNextSequence)
+			return B_BAD_VALUE;
+		slot = int32(sequence % fCapacity);
+	}
+	return _ReadSlot(slot, bitmap->Bits());
+}
+
+
+/* virtual */
+status_t
+ReplayBuffer::Trim(int32 first, int32 count)
+{
+	return B_NOT_SUPPORTED;
+}
+
+
+/* virtual */
+void
+ReplayBuffer::Release()
+{
+	BAutolock _(fLocker);
+	if (fArea >= 0)
+		delete_area(fArea);
+	fArea = -1;
+	fData = NULL;
+	if (fFD >= 0) {
+		::close(fFD);
+		::unlink(fPath.String());
+	}
+	fFD = -1;
+	fPath = "";
+	fSlots.clear();
+	fNextSequence = 0;
+}
+
+
+// Must be called with the lock held
+int64
+ReplayBuffer::_FirstSequence() const
+{
+	return std::max(fNextSequence - fCapacity, int64(0));
+}
+
+
+// The newest or the oldest frame between first and end which is
+// in its slot: with several writers, the newest ones can still be
+// written, and their slots still have older frames. -1 if there
+// isn't any. Must be called with the lock held
+int64
+ReplayBuffer::_ReadySequence(int64 first, int64 end, bool newest) const
+{
+	for (int64 i = 0; i < end - first; i++) {
+		const int64 sequence = newest ? end - 1 - i : first + i;
+		if (fSlots[sequence % fCapacity].sequence == sequence)
+			return sequence;
+	}
+	return -1;
+}
+
+
+status_t
+ReplayBuffer::_ReadSlot(int32 slot, void* buffer) const
+{
+	const off_t offset = off_t(slot) * fFrameLength;
+	if (fData != NULL) {
+		::memcpy(buffer, fData + offset, fFrameLength);
+		return B_OK;
+	}
+	ssize_t bytesRead = ::pread(fFD, buffer, fFrameLength, offset);
+	if (bytesRead != (ssize_t)fFrameLength)
+		return bytesRead < 0 ? errno : B_IO_ERROR;
+	return B_OK;
+}
+
+
+status_t
+ReplayBuffer::_WriteSlot(int32 slot, const void* buffer)
+{
+	const off_t offset = off_t(slot) * fFrameLength;
+	if (fData != NULL) {
+		::memcpy(fData + offset, buffer, fFrameLength);
+		return B_OK;
+	}
+	ssize_t written = ::pwrite(fFD, buffer, fFrameLength, offset);
+	if (written != (ssize_t)fFrameLength)
+		return written < 0 ? errno : B_IO_ERROR;
+	return B_OK;
+}
@@ -0,0 +1,93 @@
+/*
+ * Copyright 2026 Stefano Ceccherini <stefano.ceccherini@gmail.com>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+#ifndef __REPLAYBUFFER_H
+#define __REPLAYBUFFER_H
+
+#include "FrameStore.h"
+
+#include <Locker.h>
+#include <OS.h>
+#include <String.h>
+
+#include <vector>
+
+const static char* const kReplayFileName = "replay.ring";
+
+class BBitmap;
+// Keeps only the last frames of a capture which never stops, in a
+// fixed number of slots, in memory or in a file of the session folder.
+// Everything is allocated by Create(): a new frame takes the slot of
+// the oldest one, so the capture can run for as long as needed.
+// CopyTo() copies the frames to another store while the capture goes
+// on: a slot which is being written over meanwhile is skipped.
+// The FrameStore reading methods are only meant for a finished buffer.
+class ReplayBuffer : public FrameStore {
+public:
+	ReplayBuffer();
+	virtual ~ReplayBuffer();
+
+	// Must be called before Create(). The capacity is lowered
+	// to what fits in the memory budget, when kept in memory
+	void SetCapacity(int32 frames, bool onDisk);
+
+	virtual status_t Create(const char* path, const BRect& bounds,
+				color_space colorSpace, int32 bytesPerRow,
+				int64 memoryBudget = 0);
+	// Thread safe
+	virtual status_t WriteFrame(const BBitmap* bitmap, bigtime_t frameTime);
+	virtual status_t Finish();
+	virtual int32 CountFramesInMemory() const;
+
+	// Copies the frames of the last duration microseconds (all of
+	// them if 0), oldest first, and returns how many were copied.
+	// Can be called while frames are written
+	status_t CopyTo(FrameStore* store, bigtime_t duration,
+				int32* _count) const;
+	bigtime_t Duration() const;
+
+	virtual status_t Open(const char* path);
+
+	virtual const char* Path() const;
+	virtual BRect Bounds() const;
+	virtual color_space ColorSpace() const;
+	virtual int32 BytesPerRow() const;
+
+	virtual int32 CountFrames() const;
+	virtual bigtime_t FrameTime(int32 index) const;
+	virtual status_t ReadBitmap(int32 index, BBitmap* bitmap) const;
+
+	virtual status_t Trim(int32 first, int32 count);
+	virtual void Release();
+
+private:
+	struct ring_slot {
+		bigtime_t time;
+		// Of the frame in the slot: -1 while it's written
+		int64 sequence;
+	};
+
+	int64 _FirstSequence() const;
+	int64 _ReadySequence(int64 first, int64 end, bool newest) const;
+	status_t _ReadSlot(int32 slot, void* buffer) const;
+	status_t _WriteSlot(int32 slot, const void* buffer);
+
+	BString fPath;
+	BRect fBounds;
+	color_space fColorSpace;
+	int32 fBytesPerRow;
+	size_t fFrameLength;
+	int32 fCapacity;
+	bool fOnDisk;
+
+	std::vector<ring_slot> fSlots;
+	int64 fNextSequence;
+	mutable BLocker fLocker;
+
+	area_id fArea;
+	uint8* fData;
+	int fFD;
+};
+
+#endif // __REPLAYBUFFER_H
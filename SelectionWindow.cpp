@@ -5,14 +5,20 @@
 #include "SelectionWindow.h"
 
 #include "Constants.h"
+#include "FrameGrid.h"
 #include "Settings.h"
 #include "Utils.h"
 
 #include <Bitmap.h>
 #include <Cursor.h>
+#include <Region.h>
 #include <Screen.h>
 #include <String.h>
 
+#include <cmath>
+#include <cstring>
+#include <new>
+
 
 const char *kInfoRegionMode = "Click and drag to select, press ENTER to confirm";
 const char *kInfoWindowMode = "Click to select a window";
@@ -26,12 +32,20 @@ const static float kDraggerFullSize = kDraggerSize + kDraggerSpacing;
 class SelectionView : public BView {
 public:
 	SelectionView(BRect frame, const char *name, const char* text = NULL);
+	virtual ~SelectionView();
 
 	virtual void Draw(BRect updateRect);
 	virtual BRect SelectionRect() const;
 
+	// Shown under the view. Keeps a copy with the selection
+	// color blended in, so highlighting is just a copy
+	void SetScreenBitmap(const BBitmap* bitmap);
+
 protected:
+	void _DrawHighlight(const BRect& rect, const BRect& updateRect);
+
 	BString fText;
+	BBitmap* fHighlightBitmap;
 };
 
 
@@ -74,6 +88,10 @@ public:
 private:
 	void _DrawDraggers();
 	int _MouseOnDragger(BPoint where) const;
+	void _GetSizeString(const BRect& selection, BString& string,
+		BPoint& position) const;
+	void _IncludeDecorations(BRegion& region, const BRect& selection) const;
+	void _InvalidateChange(const BRect& oldSelection, const BRect& newSelection);
 
 	BPoint fSelectionStart;
 	BPoint fSelectionEnd;
@@ -98,10 +116,8 @@ public:
 	virtual BRect SelectionRect() const;
 
 private:
-	BObjectList<BRect> fFrameList;
+	FrameGrid fFrameGrid;
 	BRect fHighlightFrame;
-
-	BRect HitTestFrame(BPoint& where);
 };
 
 
@@ -109,12 +125,19 @@ private:
 SelectionView::SelectionView(BRect frame, const char *name, const char* text)
 	:
 	BView(frame, name, B_FOLLOW_NONE, B_WILL_DRAW),
-	fText(text)
+	fText(text),
+	fHighlightBitmap(NULL)
 {
 	SetFontSize(30);
 }
 
 
+SelectionView::~SelectionView()
+{
+	delete fHighlightBitmap;
+}
+
+
 void
 SelectionView::Draw(BRect updateRect)
 {
@@ -139,6 +162,65 @@ SelectionView::SelectionRect() const
 }
 
 
+void
+SelectionView::SetScreenBitmap(const BBitmap* bitmap)
+{
+	SetViewBitmap(bitmap);
+
+	delete fHighlightBitmap;
+	fHighlightBitmap = NULL;
+	if (bitmap == NULL
+		|| (bitmap->ColorSpace() != B_RGB32 && bitmap->ColorSpace() != B_RGBA32))
+		return;
+
+	fHighlightBitmap = new (std::nothrow) BBitmap(bitmap->Bounds(), B_RGB32);
+	if (fHighlightBitmap == NULL || fHighlightBitmap->InitCheck() != B_OK) {
+		delete fHighlightBitmap;
+		fHighlightBitmap = NULL;
+		return;
+	}
+
+	// What B_OP_ALPHA would draw with kSelectionColor
+	const uint32 alpha = kSelectionColor.alpha;
+	const uint32 blue = kSelectionColor.blue * alpha;
+	const uint32 green = kSelectionColor.green * alpha;
+	const uint32 red = kSelectionColor.red * alpha;
+	const int32 width = bitmap->Bounds().IntegerWidth() + 1;
+	const int32 height = bitmap->Bounds().IntegerHeight() + 1;
+	for (int32 y = 0; y < height; y++) {
+		const uint8* source = (const uint8*)bitmap->Bits() + y * bitmap->BytesPerRow();
+		uint8* dest = (uint8*)fHighlightBitmap->Bits() + y * fHighlightBitmap->BytesPerRow();
+		for (int32 x = 0; x < width; x++) {
+			dest[0] = (source[0] * (255 - alpha) + blue) / 255;
+			dest[1] = (source[1] * (255 - alpha) + green) / 255;
+			dest[2] = (source[2] * (255 - alpha) + red) / 255;
+			dest[3] = 255;
+			source += 4;
+			dest += 4;
+		}
+	}
+}
+
+
+void
+SelectionView::_DrawHighlight(const BRect& rect, const BRect& updateRect)
+{
+	if (fHighlightBitmap == NULL) {
+		SetDrawingMode(B_OP_ALPHA);
+		SetHighColor(kSelectionColor);
+		FillRect(rect);
+		return;
+	}
+
+	const BRect dirty = rect & updateRect & fHighlightBitmap->Bounds();
+	if (dirty.IsValid()) {
+		SetDrawingMode(B_OP_COPY);
+		DrawBitmap(fHighlightBitmap, dirty, dirty);
+	}
+	SetDrawingMode(B_OP_ALPHA);
+}
+
+
 // SelectionViewRegion
 SelectionViewRegion::SelectionViewRegion(BRect frame, const char *name)
 	:
@@ -189,7 +271,7 @@ SelectionViewRegion::MouseDown(BPoint where)
 				fDragMode = DRAG_MODE_RESIZE_RIGHT_BOTTOM;
 				break;
 			default:
-				Invalidate();
+				_InvalidateChange(SelectionRect(), BRect(0, 0, -1, -1));
 				fDragMode = DRAG_MODE_SELECT;
 				fSelectionStart = where;
 				fSelectionEnd = where;
@@ -255,10 +337,7 @@ SelectionViewRegion::MouseMoved(BPoint where, uint32 code, const BMessage *messa
 				break;
 		}
 
-		BRect newSelection = SelectionRect();
-		BRect invalidateRect = (selectionRect | newSelection);
-		invalidateRect.InsetBySelf(-(kDraggerSize + kDraggerSpacing), -(kDraggerSize + kDraggerSpacing));
-		Invalidate(invalidateRect);
+		_InvalidateChange(selectionRect, SelectionRect());
 	} else
 		SetViewCursor(B_CURSOR_SYSTEM_DEFAULT);
 
@@ -313,16 +392,10 @@ SelectionViewRegion::Draw(BRect updateRect)
 
 	if (SelectionRect().IsValid()) {
 		BRect selection = SelectionRect();
-		SetDrawingMode(B_OP_ALPHA);
-		SetHighColor(kSelectionColor);
-		FillRect(selection);
+		_DrawHighlight(selection, updateRect);
 		BString sizeString;
-		sizeString << selection.IntegerWidth() << " x " << selection.IntegerHeight();
-		float stringWidth = StringWidth(sizeString.String());
 		BPoint position;
-		position.x = (selection.Width() - stringWidth) / 2;
-		position.y = selection.Height() / 2;
-		position += selection.LeftTop();
+		_GetSizeString(selection, sizeString, position);
 		SetHighColor(kBlack);
 		SetLowColor(kBlack);
 		DrawString(sizeString.String(), position);
@@ -405,6 +478,65 @@ SelectionViewRegion::_DrawDraggers()
 }
 
 
+void
+SelectionViewRegion::_GetSizeString(const BRect& selection, BString& string,
+	BPoint& position) const
+{
+	string << selection.IntegerWidth() << " x " << selection.IntegerHeight();
+	float stringWidth = StringWidth(string.String());
+	position.x = (selection.Width() - stringWidth) / 2;
+	position.y = selection.Height() / 2;
+	position += selection.LeftTop();
+}
+
+
+// What is drawn around and over a selection, apart from the color:
+// the draggers on the corners and the size in the middle
+void
+SelectionViewRegion::_IncludeDecorations(BRegion& region, const BRect& selection) const
+{
+	if (!selection.IsValid())
+		return;
+
+	const BRect outer = selection.InsetByCopy(-kDraggerFullSize - 1,
+		-kDraggerFullSize - 1);
+	region.Include(BRect(outer.left, outer.top, selection.left, selection.top));
+	region.Include(BRect(selection.right, outer.top, outer.right, selection.top));
+	region.Include(BRect(outer.left, selection.bottom, selection.left, outer.bottom));
+	region.Include(BRect(selection.right, selection.bottom, outer.right, outer.bottom));
+
+	BString sizeString;
+	BPoint position;
+	_GetSizeString(selection, sizeString, position);
+	font_height height;
+	GetFontHeight(&height);
+	region.Include(BRect(position.x - 1, position.y - ceilf(height.ascent) - 1,
+		position.x + StringWidth(sizeString.String()) + 1,
+		position.y + ceilf(height.descent) + 1));
+}
+
+
+// The inside of the selection looks the same wherever
+// it is, so only what changed is drawn again
+void
+SelectionViewRegion::_InvalidateChange(const BRect& oldSelection,
+	const BRect& newSelection)
+{
+	BRegion region;
+	if (oldSelection.IsValid())
+		region.Include(oldSelection);
+	if (newSelection.IsValid())
+		region.Include(newSelection);
+	const BRect common = oldSelection & newSelection;
+	if (oldSelection.IsValid() && newSelection.IsValid() && common.IsValid())
+		region.Exclude(common.InsetByCopy(1, 1));
+
+	_IncludeDecorations(region, oldSelection);
+	_IncludeDecorations(region, newSelection);
+	Invalidate(&region);
+}
+
+
 int
 SelectionViewRegion::_MouseOnDragger(BPoint point) const
 {
@@ -424,21 +556,30 @@ SelectionViewRegion::_MouseOnDragger(BPoint point) const
 // SelectionViewWindow
 SelectionViewWindow::SelectionViewWindow(BRect frame, const char *name)
 	:
-	SelectionView(frame, name, kInfoWindowMode)
+	SelectionView(frame, name, kInfoWindowMode),
+	fFrameGrid(frame),
+	fHighlightFrame(0, 0, -1, -1)
 {
-	GetWindowsFrameList(fFrameList, Settings::Current().WindowFrameEdgeSize());
+	BObjectList<BRect> frameList(20, true);
+	GetWindowsFrameList(frameList, Settings::Current().WindowFrameEdgeSize());
+	for (int32 i = 0; i < frameList.CountItems(); i++)
+		fFrameGrid.AddFrame(*frameList.ItemAt(i));
 }
 
 
 void
 SelectionViewWindow::MouseMoved(BPoint where, uint32 code, const BMessage *message)
 {
-	BRect frame = HitTestFrame(where);
-	if (frame.IsValid())
-		fHighlightFrame = frame;
-	else
-		fHighlightFrame.Set(0, 0, -1, -1);
-	Invalidate();
+	const BRect frame = fFrameGrid.HitTest(where);
+	if (frame == fHighlightFrame)
+		return;
+
+	// Only the old and the new highlight are drawn again
+	if (fHighlightFrame.IsValid())
+		Invalidate(fHighlightFrame);
+	fHighlightFrame = frame;
+	if (fHighlightFrame.IsValid())
+		Invalidate(fHighlightFrame);
 }
 
 
@@ -454,11 +595,8 @@ SelectionViewWindow::Draw(BRect updateRect)
 {
 	SelectionView::Draw(updateRect);
 
-	if (fHighlightFrame.IsValid()) {
-		SetDrawingMode(B_OP_ALPHA);
-		SetHighColor(kSelectionColor);
-		FillRect(fHighlightFrame);
-	}
+	if (fHighlightFrame.IsValid())
+		_DrawHighlight(fHighlightFrame, updateRect);
 }
 
 
@@ -469,20 +607,6 @@ SelectionViewWindow::SelectionRect() const
 }
 
 
-BRect
-SelectionViewWindow::HitTestFrame(BPoint& where)
-{
-	int32 count = fFrameList.CountItems();
-	for (int32 i = 0; i < count; i++) {
-		BRect *frame = fFrameList.ItemAt(i);
-		if (frame->Contains(where))
-			return *frame;
-	}
-
-	return BRect(0, 0, -1, -1);
-}
-
-
 // SelectionWindow
 SelectionWindow::SelectionWindow(int mode, BMessenger& target, uint32 command)
 	:
@@ -505,7 +629,7 @@ SelectionWindow::Show()
 {
 	BBitmap *bitmap = NULL;
 	BScreen(this).GetBitmap(&bitmap, false);
-	fView->SetViewBitmap(bitmap);
+	fView->SetScreenBitmap(bitmap);
 	fView->MakeFocus(true);
 	delete bitmap;
 
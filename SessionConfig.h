@@ -0,0 +1,120 @@
+/*
+ * Copyright 2026 Stefano Ceccherini <stefano.ceccherini@gmail.com>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+#ifndef __SESSIONCONFIG_H
+#define __SESSIONCONFIG_H
+
+#include <GraphicsDefs.h>
+#include <Rect.h>
+#include <String.h>
+#include <StringList.h>
+
+#include <vector>
+
+// One more file made from the frames of the recording, in the
+// same pass as the output file
+struct encode_output {
+	// Short or pretty names. No codec is the first of the format
+	BString		fileFormat;
+	BString		codec;
+	// Of the capture area, in percent
+	float		scale;
+	// From 0 to 1, negative for the one of the codec
+	float		quality;
+
+	bool operator==(const encode_output& other) const
+	{
+		return fileFormat == other.fileFormat
+			&& codec == other.codec
+			&& scale == other.scale
+			&& quality == other.quality;
+	}
+};
+
+// The settings a recording uses, copied from Settings when it starts
+// and then given to the capture, the frame store and the encoder.
+// Reading it needs no lock, and changing the settings meanwhile
+// doesn't affect the recording: it stays the same until the clip
+// is encoded.
+struct session_config {
+	BRect		captureArea;
+	// Captured along with it, side by side on its right
+	std::vector<BRect> extraAreas;
+	// Of the frames, with all the areas, at the origin
+	BRect		frameBounds;
+	BRect		targetRect;
+	float		scale;
+	// The frames are spooled at the target size
+	bool		scaleAtCapture;
+	color_space	clipDepth;
+	int32		frameRate;
+	// From minFrameRate up to frameRate, following the changes
+	bool		adaptiveFrameRate;
+	int32		minFrameRate;
+	bool		useDirectWindow;
+	bool		includeCursor;
+	int32		windowFrameEdgeSize;
+	bool		followCursor;
+	int32		followCursorDeadZone;
+	int32		followCursorSmoothing;
+
+	int32		frameStoreType;
+	int32		memoryShare;
+	bool		unbufferedWrites;
+	bool		lockFrameBuffers;
+	bool		compressFrames;
+	int32		captureBackpressure;
+	bool		replayBuffer;
+	int32		replaySeconds;
+	bool		replayOnDisk;
+	// Where the frames are spooled, striped if more than one
+	BStringList	spoolFolders;
+
+	bool		encodeWhileRecording;
+	int32		encodeLookahead;
+	int32		encodeSegments;
+	int32		keyFrameInterval;
+	bool		sceneChangeKeyFrames;
+	bool		ffmpegGIF;
+	std::vector<encode_output> extraOutputs;
+
+	bool operator==(const session_config& other) const
+	{
+		return captureArea == other.captureArea
+			&& extraAreas == other.extraAreas
+			&& frameBounds == other.frameBounds
+			&& targetRect == other.targetRect
+			&& scale == other.scale
+			&& scaleAtCapture == other.scaleAtCapture
+			&& clipDepth == other.clipDepth
+			&& frameRate == other.frameRate
+			&& adaptiveFrameRate == other.adaptiveFrameRate
+			&& minFrameRate == other.minFrameRate
+			&& useDirectWindow == other.useDirectWindow
+			&& includeCursor == other.includeCursor
+			&& windowFrameEdgeSize == other.windowFrameEdgeSize
+			&& followCursor == other.followCursor
+			&& followCursorDeadZone == other.followCursorDeadZone
+			&& followCursorSmoothing == other.followCursorSmoothing
+			&& frameStoreType == other.frameStoreType
+			&& memoryShare == other.memoryShare
+			&& unbufferedWrites == other.unbufferedWrites
+			&& lockFrameBuffers == other.lockFrameBuffers
+			&& compressFrames == other.compressFrames
+			&& captureBackpressure == other.captureBackpressure
+			&& replayBuffer == other.replayBuffer
+			&& replaySeconds == other.replaySeconds
+			&& replayOnDisk == other.replayOnDisk
+			&& spoolFolders == other.spoolFolders
+			&& encodeWhileRecording == other.encodeWhileRecording
+			&& encodeLookahead == other.encodeLookahead
+			&& encodeSegments == other.encodeSegments
+			&& keyFrameInterval == other.keyFrameInterval
+			&& sceneChangeKeyFrames == other.sceneChangeKeyFrames
+			&& ffmpegGIF == other.ffmpegGIF
+			&& extraOutputs == other.extraOutputs;
+	}
+};
+
+#endif // __SESSIONCONFIG_H
@@ -5,6 +5,10 @@
 
 #include "Settings.h"
 
+#include "CaptureThrottle.h"
+#include "FrameStore.h"
+#include "SessionConfig.h"
+
 #include <Autolock.h>
 #include <Directory.h>
 #include <File.h>
@@ -14,15 +18,19 @@
 #include <Screen.h>
 #include <String.h>
 
+#include <algorithm>
 #include <cstdio>
+#include <cstdlib>
 #include <cstring>
 
 static Settings* sDefault;
 static Settings* sCurrent;
 
 const static char *kCaptureRect = "capture rect";
+const static char *kExtraCaptureAreas = "extra capture areas";
 const static char *kClipDepth = "clip depth";
 const static char *kClipScale = "clip scale";
+const static char *kScaleAtCapture = "scale at capture";
 const static char *kUseDirectWindow = "use DW";
 const static char *kIncludeCursor = "cursor";
 const static char *kMinimize = "minimize";
@@ -38,6 +46,32 @@ const static char *kEnableShortcut = "enable shortcut";
 const static char *kSelectOnStart = "select on start";
 const static char *kDockingMode = "docking mode";
 const static char *kHideDeskbarIcon = "hide deskbar icon";
+const static char *kCompressFrames = "compress frames";
+const static char *kMemoryShare = "memory share";
+const static char *kEncodeLookahead = "encode lookahead";
+const static char *kEncodeWhileRecording = "encode while recording";
+const static char *kKeyFrameInterval = "key frame interval";
+const static char *kSceneChangeKeyFrames = "scene change key frames";
+const static char *kFFMPEGGIF = "ffmpeg gif";
+const static char *kEncodeSegments = "encode segments";
+const static char *kFrameStoreType = "frame store";
+const static char *kUnbufferedWrites = "unbuffered writes";
+const static char *kLockFrameBuffers = "lock frame buffers";
+const static char *kCaptureBackpressure = "capture backpressure";
+const static char *kFollowCursor = "follow cursor";
+const static char *kFollowCursorDeadZone = "follow cursor dead zone";
+const static char *kFollowCursorSmoothing = "follow cursor smoothing";
+const static char *kStandby = "standby";
+const static char *kReplayBuffer = "replay buffer";
+const static char *kReplayBufferSeconds = "replay buffer seconds";
+const static char *kReplayBufferOnDisk = "replay buffer on disk";
+const static char *kSpoolFolders = "spool folders";
+const static char *kEncodeRangeStart = "encode range start";
+const static char *kEncodeRangeEnd = "encode range end";
+const static char *kEncodeRangeInFrames = "encode range in frames";
+const static char *kExtraOutputs = "extra outputs";
+const static char *kAdaptiveFrameRate = "adaptive frame rate";
+const static char *kMinFrameRate = "min frame rate";
 
 
 /* static */
@@ -115,10 +149,14 @@ Settings::Load()
 		const char *string = NULL;
 		if (tempMessage.FindRect(kCaptureRect, &rect) == B_OK)
 			fSettings->SetRect(kCaptureRect, rect);
+		for (int32 i = 0; tempMessage.FindRect(kExtraCaptureAreas, i, &rect) == B_OK; i++)
+			fSettings->AddRect(kExtraCaptureAreas, rect);
 		if (tempMessage.FindInt32(kClipDepth, &integer) == B_OK)
 			fSettings->SetInt32(kClipDepth, integer);
 		if (tempMessage.FindFloat(kClipScale, &decimal) == B_OK)
 			fSettings->SetFloat(kClipScale, decimal);
+		if (tempMessage.FindBool(kScaleAtCapture, &boolean) == B_OK)
+			fSettings->SetBool(kScaleAtCapture, boolean);
 		if (tempMessage.FindBool(kUseDirectWindow, &boolean) == B_OK)
 			fSettings->SetBool(kUseDirectWindow, boolean);
 		if (tempMessage.FindBool(kIncludeCursor, &boolean) == B_OK)
@@ -149,6 +187,62 @@ Settings::Load()
 			fSettings->SetBool(kEnableShortcut, boolean);
 		if (tempMessage.FindBool(kSelectOnStart, &boolean) == B_OK)
 			fSettings->SetBool(kSelectOnStart, boolean);
+		if (tempMessage.FindBool(kCompressFrames, &boolean) == B_OK)
+			fSettings->SetBool(kCompressFrames, boolean);
+		if (tempMessage.FindInt32(kMemoryShare, &integer) == B_OK)
+			fSettings->SetInt32(kMemoryShare, integer);
+		if (tempMessage.FindInt32(kEncodeLookahead, &integer) == B_OK)
+			fSettings->SetInt32(kEncodeLookahead, integer);
+		if (tempMessage.FindBool(kEncodeWhileRecording, &boolean) == B_OK)
+			fSettings->SetBool(kEncodeWhileRecording, boolean);
+		if (tempMessage.FindInt32(kKeyFrameInterval, &integer) == B_OK)
+			fSettings->SetInt32(kKeyFrameInterval, integer);
+		if (tempMessage.FindBool(kSceneChangeKeyFrames, &boolean) == B_OK)
+			fSettings->SetBool(kSceneChangeKeyFrames, boolean);
+		if (tempMessage.FindBool(kFFMPEGGIF, &boolean) == B_OK)
+			fSettings->SetBool(kFFMPEGGIF, boolean);
+		if (tempMessage.FindInt32(kEncodeSegments, &integer) == B_OK)
+			fSettings->SetInt32(kEncodeSegments, integer);
+		if (tempMessage.FindInt32(kFrameStoreType, &integer) == B_OK)
+			fSettings->SetInt32(kFrameStoreType, integer);
+		if (tempMessage.FindBool(kUnbufferedWrites, &boolean) == B_OK)
+			fSettings->SetBool(kUnbufferedWrites, boolean);
+		if (tempMessage.FindBool(kLockFrameBuffers, &boolean) == B_OK)
+			fSettings->SetBool(kLockFrameBuffers, boolean);
+		if (tempMessage.FindInt32(kCaptureBackpressure, &integer) == B_OK)
+			fSettings->SetInt32(kCaptureBackpressure, integer);
+		if (tempMessage.FindBool(kFollowCursor, &boolean) == B_OK)
+			fSettings->SetBool(kFollowCursor, boolean);
+		if (tempMessage.FindInt32(kFollowCursorDeadZone, &integer) == B_OK)
+			fSettings->SetInt32(kFollowCursorDeadZone, integer);
+		if (tempMessage.FindInt32(kFollowCursorSmoothing, &integer) == B_OK)
+			fSettings->SetInt32(kFollowCursorSmoothing, integer);
+		if (tempMessage.FindBool(kStandby, &boolean) == B_OK)
+			fSettings->SetBool(kStandby, boolean);
+		if (tempMessage.FindBool(kReplayBuffer, &boolean) == B_OK)
+			fSettings->SetBool(kReplayBuffer, boolean);
+		if (tempMessage.FindInt32(kReplayBufferSeconds, &integer) == B_OK)
+			fSettings->SetInt32(kReplayBufferSeconds, integer);
+		if (tempMessage.FindBool(kReplayBufferOnDisk, &boolean) == B_OK)
+			fSettings->SetBool(kReplayBufferOnDisk, boolean);
+		fSettings->RemoveName(kSpoolFolders);
+		for (int32 i = 0; tempMessage.FindString(kSpoolFolders, i, &string) == B_OK; i++)
+			fSettings->AddString(kSpoolFolders, string);
+		if (tempMessage.FindInt32(kEncodeRangeStart, &integer) == B_OK)
+			fSettings->SetInt32(kEncodeRangeStart, integer);
+		if (tempMessage.FindInt32(kEncodeRangeEnd, &integer) == B_OK)
+			fSettings->SetInt32(kEncodeRangeEnd, integer);
+		if (tempMessage.FindBool(kEncodeRangeInFrames, &boolean) == B_OK)
+			fSettings->SetBool(kEncodeRangeInFrames, boolean);
+		fSettings->RemoveName(kExtraOutputs);
+		for (int32 i = 0; tempMessage.FindString(kExtraOutputs, i, &string) == B_OK; i++) {
+			if (ParseEncodeOutput(string, NULL))
+				fSettings->AddString(kExtraOutputs, string);
+		}
+		if (tempMessage.FindBool(kAdaptiveFrameRate, &boolean) == B_OK)
+			fSettings->SetBool(kAdaptiveFrameRate, boolean);
+		if (tempMessage.FindInt32(kMinFrameRate, &integer) == B_OK)
+			fSettings->SetInt32(kMinFrameRate, integer);
 	}
 
 	return status;
@@ -199,14 +293,72 @@ Settings::CaptureArea() const
 }
 
 
+std::vector<BRect>
+Settings::ExtraCaptureAreas() const
+{
+	BAutolock _(fLocker);
+	std::vector<BRect> areas;
+	BRect rect;
+	for (int32 i = 0; fSettings->FindRect(kExtraCaptureAreas, i, &rect) == B_OK; i++)
+		areas.push_back(rect);
+	return areas;
+}
+
+
+void
+Settings::SetExtraCaptureAreas(const std::vector<BRect>& areas)
+{
+	BAutolock _(fLocker);
+	fSettings->RemoveName(kExtraCaptureAreas);
+	for (size_t i = 0; i < areas.size(); i++)
+		fSettings->AddRect(kExtraCaptureAreas, areas[i]);
+}
+
+
+// "left,top,right,bottom" for every area, separated by ';'
+/* static */
+bool
+Settings::ParseCaptureAreas(const BString& spec, std::vector<BRect>* areas)
+{
+	std::vector<BRect> parsed;
+	BStringList list;
+	if (spec != "" && !spec.Split(";", true, list))
+		return false;
+	for (int32 i = 0; i < list.CountStrings(); i++) {
+		BRect rect;
+		if (::sscanf(list.StringAt(i).String(), "%f,%f,%f,%f", &rect.left,
+				&rect.top, &rect.right, &rect.bottom) != 4 || !rect.IsValid())
+			return false;
+		parsed.push_back(rect);
+	}
+	if (areas != NULL)
+		*areas = parsed;
+	return true;
+}
+
+
+// The capture area, then the extra ones on its right, aligned
+// at the top
+BRect
+Settings::FrameBounds() const
+{
+	BAutolock _(fLocker);
+	BRect frame = CaptureArea().OffsetToCopy(B_ORIGIN);
+	const std::vector<BRect> areas = ExtraCaptureAreas();
+	for (size_t i = 0; i < areas.size(); i++) {
+		frame.right += areas[i].IntegerWidth() + 1;
+		frame.bottom = std::max(frame.bottom, areas[i].Height());
+	}
+	return frame;
+}
+
+
 BRect
 Settings::TargetRect() const
 {
 	BAutolock _(fLocker);
 	const float scale = Scale();
-	BRect scaledRect = CaptureArea();
-
-	scaledRect.OffsetTo(B_ORIGIN);
+	BRect scaledRect = FrameBounds();
 	scaledRect.right = roundf((scaledRect.right + 1) * scale / 100 - 1);
 	scaledRect.bottom = roundf((scaledRect.bottom + 1) * scale / 100 - 1);
 
@@ -251,6 +403,27 @@ Settings::Scale() const
 }
 
 
+// The frames are scaled before they're spooled, instead of
+// when they're encoded: they take less room, but the frames
+// at the original size are lost
+void
+Settings::SetScaleAtCapture(const bool &atCapture)
+{
+	BAutolock _(fLocker);
+	fSettings->SetBool(kScaleAtCapture, atCapture);
+}
+
+
+bool
+Settings::ScaleAtCapture() const
+{
+	BAutolock _(fLocker);
+	bool atCapture = false;
+	fSettings->FindBool(kScaleAtCapture, &atCapture);
+	return atCapture;
+}
+
+
 void
 Settings::SetUseDirectWindow(const bool &use)
 {
@@ -269,6 +442,303 @@ Settings::UseDirectWindow() const
 }
 
 
+void
+Settings::SetCompressFrames(const bool &compress)
+{
+	BAutolock _(fLocker);
+	fSettings->SetBool(kCompressFrames, compress);
+}
+
+
+bool
+Settings::CompressFrames() const
+{
+	BAutolock _(fLocker);
+	bool compress = false;
+	fSettings->FindBool(kCompressFrames, &compress);
+	return compress;
+}
+
+
+// Percentage of the free memory which can be used to keep
+// the captured frames in memory
+void
+Settings::SetMemoryShare(const int32 &percent)
+{
+	BAutolock _(fLocker);
+	fSettings->SetInt32(kMemoryShare, std::min(std::max(percent, int32(0)), int32(100)));
+}
+
+
+int32
+Settings::MemoryShare() const
+{
+	BAutolock _(fLocker);
+	int32 percent = 0;
+	fSettings->FindInt32(kMemoryShare, &percent);
+	return std::min(std::max(percent, int32(0)), int32(100));
+}
+
+
+void
+Settings::SetEncodeLookahead(const int32 &frames)
+{
+	BAutolock _(fLocker);
+	fSettings->SetInt32(kEncodeLookahead, std::min(std::max(frames, int32(1)), int32(32)));
+}
+
+
+int32
+Settings::EncodeLookahead() const
+{
+	BAutolock _(fLocker);
+	int32 frames = 1;
+	fSettings->FindInt32(kEncodeLookahead, &frames);
+	return std::min(std::max(frames, int32(1)), int32(32));
+}
+
+
+// Frames are encoded as soon as they're captured, and only
+// spooled when the encoder can't keep up
+void
+Settings::SetEncodeWhileRecording(const bool &encode)
+{
+	BAutolock _(fLocker);
+	fSettings->SetBool(kEncodeWhileRecording, encode);
+}
+
+
+bool
+Settings::EncodeWhileRecording() const
+{
+	BAutolock _(fLocker);
+	bool encode = false;
+	fSettings->FindBool(kEncodeWhileRecording, &encode);
+	return encode;
+}
+
+
+// Frames between two key frames. With scene change key frames,
+// the longest distance between them
+void
+Settings::SetKeyFrameInterval(const int32 &frames)
+{
+	BAutolock _(fLocker);
+	fSettings->SetInt32(kKeyFrameInterval,
+		std::min(std::max(frames, int32(1)), int32(600)));
+}
+
+
+int32
+Settings::KeyFrameInterval() const
+{
+	BAutolock _(fLocker);
+	int32 frames = 10;
+	fSettings->FindInt32(kKeyFrameInterval, &frames);
+	return std::min(std::max(frames, int32(1)), int32(600));
+}
+
+
+void
+Settings::SetSceneChangeKeyFrames(const bool &enable)
+{
+	BAutolock _(fLocker);
+	fSettings->SetBool(kSceneChangeKeyFrames, enable);
+}
+
+
+bool
+Settings::SceneChangeKeyFrames() const
+{
+	BAutolock _(fLocker);
+	bool enable = false;
+	fSettings->FindBool(kSceneChangeKeyFrames, &enable);
+	return enable;
+}
+
+
+// GIF files are made by ffmpeg, when it's installed, instead of
+// GIFEncoder. Slower, but the palettes are dithered
+void
+Settings::SetFFMPEGGIF(const bool &use)
+{
+	BAutolock _(fLocker);
+	fSettings->SetBool(kFFMPEGGIF, use);
+}
+
+
+bool
+Settings::FFMPEGGIF() const
+{
+	BAutolock _(fLocker);
+	bool use = false;
+	fSettings->FindBool(kFFMPEGGIF, &use);
+	return use;
+}
+
+
+// Long clips are split in this many parts, encoded at the same
+// time and joined at the end. 1 encodes them in one go
+void
+Settings::SetEncodeSegments(const int32 &segments)
+{
+	BAutolock _(fLocker);
+	fSettings->SetInt32(kEncodeSegments, segments);
+}
+
+
+int32
+Settings::EncodeSegments() const
+{
+	BAutolock _(fLocker);
+	int32 segments = 1;
+	fSettings->FindInt32(kEncodeSegments, &segments);
+	return std::min(std::max(segments, int32(1)), int32(16));
+}
+
+
+// Where the captured frames are kept, one of frame_store_type
+void
+Settings::SetFrameStoreType(const int32 &type)
+{
+	BAutolock _(fLocker);
+	fSettings->SetInt32(kFrameStoreType, type);
+}
+
+
+int32
+Settings::FrameStoreType() const
+{
+	BAutolock _(fLocker);
+	int32 type = kSpoolFrameStore;
+	fSettings->FindInt32(kFrameStoreType, &type);
+	if (type != kSpoolFrameStore && type != kBMPFrameStore)
+		type = kSpoolFrameStore;
+	return type;
+}
+
+
+// Frames moved to the disk bypass the file cache, so that
+// a long capture doesn't push everything else out of it
+void
+Settings::SetUnbufferedWrites(const bool &unbuffered)
+{
+	BAutolock _(fLocker);
+	fSettings->SetBool(kUnbufferedWrites, unbuffered);
+}
+
+
+bool
+Settings::UnbufferedWrites() const
+{
+	BAutolock _(fLocker);
+	bool unbuffered = false;
+	fSettings->FindBool(kUnbufferedWrites, &unbuffered);
+	return unbuffered;
+}
+
+
+// The capture buffers are kept in memory, so grabbing a
+// frame never waits for them to be paged in
+void
+Settings::SetLockFrameBuffers(const bool &lock)
+{
+	BAutolock _(fLocker);
+	fSettings->SetBool(kLockFrameBuffers, lock);
+}
+
+
+bool
+Settings::LockFrameBuffers() const
+{
+	BAutolock _(fLocker);
+	bool lock = true;
+	fSettings->FindBool(kLockFrameBuffers, &lock);
+	return lock;
+}
+
+
+// What the capture does when the frames can't be written as fast
+// as they're captured, one of capture_backpressure_policy
+void
+Settings::SetCaptureBackpressure(const int32 &policy)
+{
+	BAutolock _(fLocker);
+	fSettings->SetInt32(kCaptureBackpressure, policy);
+}
+
+
+int32
+Settings::CaptureBackpressure() const
+{
+	BAutolock _(fLocker);
+	int32 policy = kBackpressureNotify;
+	fSettings->FindInt32(kCaptureBackpressure, &policy);
+	if (policy < kBackpressureNotify || policy > kBackpressureCompressFrames)
+		policy = kBackpressureNotify;
+	return policy;
+}
+
+
+// The capture area keeps its size, but moves with the pointer
+void
+Settings::SetFollowCursor(const bool &follow)
+{
+	BAutolock _(fLocker);
+	fSettings->SetBool(kFollowCursor, follow);
+}
+
+
+bool
+Settings::FollowCursor() const
+{
+	BAutolock _(fLocker);
+	bool follow = false;
+	fSettings->FindBool(kFollowCursor, &follow);
+	return follow;
+}
+
+
+// How near, in pixels, the pointer can get to the sides
+// of the area before the area moves
+void
+Settings::SetFollowCursorDeadZone(const int32 &pixels)
+{
+	BAutolock _(fLocker);
+	fSettings->SetInt32(kFollowCursorDeadZone, pixels);
+}
+
+
+int32
+Settings::FollowCursorDeadZone() const
+{
+	BAutolock _(fLocker);
+	int32 pixels = 64;
+	fSettings->FindInt32(kFollowCursorDeadZone, &pixels);
+	return std::max(pixels, int32(0));
+}
+
+
+// How much of the way the area has still to go after every frame,
+// in percent: 0 follows the pointer straight away
+void
+Settings::SetFollowCursorSmoothing(const int32 &percent)
+{
+	BAutolock _(fLocker);
+	fSettings->SetInt32(kFollowCursorSmoothing, percent);
+}
+
+
+int32
+Settings::FollowCursorSmoothing() const
+{
+	BAutolock _(fLocker);
+	int32 percent = 80;
+	fSettings->FindInt32(kFollowCursorSmoothing, &percent);
+	return std::min(std::max(percent, int32(0)), int32(95));
+}
+
+
 void
 Settings::SetIncludeCursor(const bool &include)
 {
@@ -412,6 +882,42 @@ Settings::SetCaptureFrameRate(const int32& value)
 }
 
 
+bool
+Settings::AdaptiveFrameRate() const
+{
+	BAutolock _(fLocker);
+	bool adaptive = false;
+	fSettings->FindBool(kAdaptiveFrameRate, &adaptive);
+	return adaptive;
+}
+
+
+void
+Settings::SetAdaptiveFrameRate(const bool& adaptive)
+{
+	BAutolock _(fLocker);
+	fSettings->SetBool(kAdaptiveFrameRate, adaptive);
+}
+
+
+int32
+Settings::MinFrameRate() const
+{
+	BAutolock _(fLocker);
+	int32 value = 5;
+	fSettings->FindInt32(kMinFrameRate, &value);
+	return std::max(value, int32(1));
+}
+
+
+void
+Settings::SetMinFrameRate(const int32& value)
+{
+	BAutolock _(fLocker);
+	fSettings->SetInt32(kMinFrameRate, std::max(value, int32(1)));
+}
+
+
 void
 Settings::SetWarnOnQuit(const bool& warn)
 {
@@ -520,6 +1026,272 @@ Settings::SetDockingMode(const bool& value)
 }
 
 
+// Keeps the next capture ready while idle
+bool
+Settings::Standby() const
+{
+	BAutolock _(fLocker);
+	bool standby = false;
+	fSettings->FindBool(kStandby, &standby);
+	return standby;
+}
+
+
+void
+Settings::SetStandby(const bool& standby)
+{
+	BAutolock _(fLocker);
+	fSettings->SetBool(kStandby, standby);
+}
+
+
+// Captures into a ring which only keeps the last seconds
+bool
+Settings::ReplayBuffer() const
+{
+	BAutolock _(fLocker);
+	bool replay = false;
+	fSettings->FindBool(kReplayBuffer, &replay);
+	return replay;
+}
+
+
+void
+Settings::SetReplayBuffer(const bool& replay)
+{
+	BAutolock _(fLocker);
+	fSettings->SetBool(kReplayBuffer, replay);
+}
+
+
+int32
+Settings::ReplayBufferSeconds() const
+{
+	BAutolock _(fLocker);
+	int32 seconds = 30;
+	fSettings->FindInt32(kReplayBufferSeconds, &seconds);
+	return std::max(int32(1), std::min(seconds, int32(3600)));
+}
+
+
+void
+Settings::SetReplayBufferSeconds(const int32& seconds)
+{
+	BAutolock _(fLocker);
+	fSettings->SetInt32(kReplayBufferSeconds, std::max(int32(1), std::min(seconds, int32(3600))));
+}
+
+
+bool
+Settings::ReplayBufferOnDisk() const
+{
+	BAutolock _(fLocker);
+	bool onDisk = false;
+	fSettings->FindBool(kReplayBufferOnDisk, &onDisk);
+	return onDisk;
+}
+
+
+void
+Settings::SetReplayBufferOnDisk(const bool& onDisk)
+{
+	BAutolock _(fLocker);
+	fSettings->SetBool(kReplayBufferOnDisk, onDisk);
+}
+
+
+BStringList
+Settings::SpoolFolders() const
+{
+	BAutolock _(fLocker);
+	BStringList folders;
+	const char* folder = NULL;
+	for (int32 i = 0; fSettings->FindString(kSpoolFolders, i, &folder) == B_OK; i++)
+		folders.Add(folder);
+	return folders;
+}
+
+
+void
+Settings::SetSpoolFolders(const BStringList& folders)
+{
+	BAutolock _(fLocker);
+	fSettings->RemoveName(kSpoolFolders);
+	for (int32 i = 0; i < folders.CountStrings(); i++) {
+		if (folders.StringAt(i) != "")
+			fSettings->AddString(kSpoolFolders, folders.StringAt(i));
+	}
+}
+
+
+int32
+Settings::EncodeRangeStart() const
+{
+	BAutolock _(fLocker);
+	int32 start = 0;
+	fSettings->FindInt32(kEncodeRangeStart, &start);
+	return std::max(start, int32(0));
+}
+
+
+void
+Settings::SetEncodeRangeStart(const int32& start)
+{
+	BAutolock _(fLocker);
+	fSettings->SetInt32(kEncodeRangeStart, std::max(start, int32(0)));
+}
+
+
+int32
+Settings::EncodeRangeEnd() const
+{
+	BAutolock _(fLocker);
+	int32 end = 0;
+	fSettings->FindInt32(kEncodeRangeEnd, &end);
+	return std::max(end, int32(0));
+}
+
+
+void
+Settings::SetEncodeRangeEnd(const int32& end)
+{
+	BAutolock _(fLocker);
+	fSettings->SetInt32(kEncodeRangeEnd, std::max(end, int32(0)));
+}
+
+
+bool
+Settings::EncodeRangeInFrames() const
+{
+	BAutolock _(fLocker);
+	bool inFrames = false;
+	fSettings->FindBool(kEncodeRangeInFrames, &inFrames);
+	return inFrames;
+}
+
+
+void
+Settings::SetEncodeRangeInFrames(const bool& inFrames)
+{
+	BAutolock _(fLocker);
+	fSettings->SetBool(kEncodeRangeInFrames, inFrames);
+}
+
+
+BStringList
+Settings::ExtraOutputs() const
+{
+	BAutolock _(fLocker);
+	BStringList outputs;
+	const char* output = NULL;
+	for (int32 i = 0; fSettings->FindString(kExtraOutputs, i, &output) == B_OK; i++)
+		outputs.Add(output);
+	return outputs;
+}
+
+
+status_t
+Settings::SetExtraOutputs(const BStringList& outputs)
+{
+	for (int32 i = 0; i < outputs.CountStrings(); i++) {
+		if (!ParseEncodeOutput(outputs.StringAt(i), NULL))
+			return B_BAD_VALUE;
+	}
+	BAutolock _(fLocker);
+	fSettings->RemoveName(kExtraOutputs);
+	for (int32 i = 0; i < outputs.CountStrings(); i++)
+		fSettings->AddString(kExtraOutputs, outputs.StringAt(i));
+	return B_OK;
+}
+
+
+/* static */
+bool
+Settings::ParseEncodeOutput(const BString& spec, encode_output* output)
+{
+	BStringList fields;
+	if (!spec.Split(":", false, fields) || fields.CountStrings() > 4)
+		return false;
+
+	encode_output parsed;
+	parsed.fileFormat = fields.StringAt(0);
+	parsed.fileFormat.Trim();
+	if (parsed.fileFormat == "")
+		return false;
+	parsed.codec = fields.StringAt(1);
+	parsed.codec.Trim();
+	parsed.scale = 100;
+	parsed.quality = -1;
+
+	char* end = NULL;
+	BString field = fields.StringAt(2);
+	if (field.Trim() != "") {
+		parsed.scale = ::strtof(field.String(), &end);
+		if (*end != '\0' || parsed.scale < 1 || parsed.scale > 100)
+			return false;
+	}
+	field = fields.StringAt(3);
+	if (field.Trim() != "") {
+		parsed.quality = ::strtof(field.String(), &end);
+		if (*end != '\0' || parsed.quality < 0 || parsed.quality > 1)
+			return false;
+	}
+	if (output != NULL)
+		*output = parsed;
+	return true;
+}
+
+
+session_config
+Settings::SessionConfig() const
+{
+	BAutolock _(fLocker);
+	session_config config;
+	config.captureArea = CaptureArea();
+	config.extraAreas = ExtraCaptureAreas();
+	config.frameBounds = FrameBounds();
+	config.targetRect = TargetRect();
+	config.scale = Scale();
+	config.scaleAtCapture = ScaleAtCapture();
+	config.clipDepth = ClipDepth();
+	config.frameRate = CaptureFrameRate();
+	config.adaptiveFrameRate = AdaptiveFrameRate();
+	config.minFrameRate = MinFrameRate();
+	config.useDirectWindow = UseDirectWindow();
+	config.includeCursor = IncludeCursor();
+	config.windowFrameEdgeSize = WindowFrameEdgeSize();
+	config.followCursor = FollowCursor();
+	config.followCursorDeadZone = FollowCursorDeadZone();
+	config.followCursorSmoothing = FollowCursorSmoothing();
+
+	config.frameStoreType = FrameStoreType();
+	config.memoryShare = MemoryShare();
+	config.unbufferedWrites = UnbufferedWrites();
+	config.lockFrameBuffers = LockFrameBuffers();
+	config.compressFrames = CompressFrames();
+	config.captureBackpressure = CaptureBackpressure();
+	config.replayBuffer = ReplayBuffer();
+	config.replaySeconds = ReplayBufferSeconds();
+	config.replayOnDisk = ReplayBufferOnDisk();
+	config.spoolFolders = SpoolFolders();
+
+	config.encodeWhileRecording = EncodeWhileRecording();
+	config.encodeLookahead = EncodeLookahead();
+	config.encodeSegments = EncodeSegments();
+	config.keyFrameInterval = KeyFrameInterval();
+	config.sceneChangeKeyFrames = SceneChangeKeyFrames();
+	config.ffmpegGIF = FFMPEGGIF();
+
+	const BStringList outputs = ExtraOutputs();
+	for (int32 i = 0; i < outputs.CountStrings(); i++) {
+		encode_output output;
+		if (ParseEncodeOutput(outputs.StringAt(i), &output))
+			config.extraOutputs.push_back(output);
+	}
+	return config;
+}
+
+
 void
 Settings::PrintToStream()
 {
@@ -563,6 +1335,7 @@ Settings::_SetDefaults()
 	fSettings->SetRect(kCaptureRect, rect);
 	fSettings->SetString(kOutputFile, "/boot/home/clip.mpg");
 	fSettings->SetFloat(kClipScale, 100);
+	fSettings->SetBool(kScaleAtCapture, false);
 	fSettings->SetInt32(kClipDepth, B_RGB32);
 	fSettings->SetBool(kIncludeCursor, true);
 	fSettings->SetInt32(kThreadPriority, B_NORMAL_PRIORITY);
@@ -577,6 +1350,32 @@ Settings::_SetDefaults()
 	fSettings->SetBool(kEnableShortcut, false);
 	fSettings->SetBool(kSelectOnStart, false);
 	fSettings->SetBool(kHideDeskbarIcon, false);
+	fSettings->SetBool(kCompressFrames, false);
+	fSettings->SetInt32(kMemoryShare, 25);
+	fSettings->SetInt32(kEncodeLookahead, 4);
+	fSettings->SetBool(kEncodeWhileRecording, false);
+	fSettings->SetInt32(kKeyFrameInterval, 10);
+	fSettings->SetBool(kSceneChangeKeyFrames, false);
+	fSettings->SetBool(kFFMPEGGIF, false);
+	fSettings->SetInt32(kEncodeSegments, 1);
+	fSettings->SetInt32(kFrameStoreType, kSpoolFrameStore);
+	fSettings->SetBool(kUnbufferedWrites, false);
+	fSettings->SetBool(kLockFrameBuffers, true);
+	fSettings->SetInt32(kCaptureBackpressure, kBackpressureNotify);
+	fSettings->SetBool(kFollowCursor, false);
+	fSettings->SetInt32(kFollowCursorDeadZone, 64);
+	fSettings->SetInt32(kFollowCursorSmoothing, 80);
+	fSettings->SetBool(kStandby, false);
+	fSettings->SetBool(kReplayBuffer, false);
+	fSettings->SetInt32(kReplayBufferSeconds, 30);
+	fSettings->SetBool(kReplayBufferOnDisk, false);
+	fSettings->RemoveName(kSpoolFolders);
+	fSettings->SetInt32(kEncodeRangeStart, 0);
+	fSettings->SetInt32(kEncodeRangeEnd, 0);
+	fSettings->SetBool(kEncodeRangeInFrames, false);
+	fSettings->RemoveName(kExtraOutputs);
+	fSettings->SetBool(kAdaptiveFrameRate, false);
+	fSettings->SetInt32(kMinFrameRate, 5);
 	return B_OK;
 }
 
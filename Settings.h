@@ -9,11 +9,16 @@
 #include <Locker.h>
 #include <GraphicsDefs.h>
 #include <Rect.h>
+#include <StringList.h>
+
+#include <vector>
 
 class BFile;
 class BMessage;
 class BPath;
 class BString;
+struct encode_output;
+struct session_config;
 
 class Settings {
 public:
@@ -32,6 +37,14 @@ public:
 	BRect CaptureArea() const;
 	void SetCaptureArea(const BRect &rect);
 
+	// Captured at the same time, side by side in the frames
+	std::vector<BRect> ExtraCaptureAreas() const;
+	void SetExtraCaptureAreas(const std::vector<BRect>& areas);
+	static bool ParseCaptureAreas(const BString& spec,
+		std::vector<BRect>* areas);
+	// Of the frames, with all the areas
+	BRect FrameBounds() const;
+
 	BRect TargetRect() const;
 	void SetTargetRect(const BRect& rect) const;
 
@@ -40,16 +53,63 @@ public:
 
 	float Scale() const;
 	void SetScale(const float &scale);
+	bool ScaleAtCapture() const;
+	void SetScaleAtCapture(const bool &atCapture);
 
 	bool UseDirectWindow() const;
 	void SetUseDirectWindow(const bool &use);
 
+	bool CompressFrames() const;
+	void SetCompressFrames(const bool &compress);
+
+	int32 MemoryShare() const;
+	void SetMemoryShare(const int32 &percent);
+
+	int32 EncodeLookahead() const;
+	void SetEncodeLookahead(const int32 &frames);
+
+	bool EncodeWhileRecording() const;
+	void SetEncodeWhileRecording(const bool &encode);
+
+	int32 KeyFrameInterval() const;
+	void SetKeyFrameInterval(const int32 &frames);
+
+	bool SceneChangeKeyFrames() const;
+	void SetSceneChangeKeyFrames(const bool &enable);
+
+	bool FFMPEGGIF() const;
+	void SetFFMPEGGIF(const bool &use);
+
+	int32 EncodeSegments() const;
+	void SetEncodeSegments(const int32 &segments);
+
+	int32 FrameStoreType() const;
+	void SetFrameStoreType(const int32 &type);
+
+	bool UnbufferedWrites() const;
+	void SetUnbufferedWrites(const bool &unbuffered);
+
+	bool LockFrameBuffers() const;
+	void SetLockFrameBuffers(const bool &lock);
+
+	int32 CaptureBackpressure() const;
+	void SetCaptureBackpressure(const int32 &policy);
+
 	bool IncludeCursor() const;
 	void SetIncludeCursor(const bool &include);
 
 	int32 WindowFrameEdgeSize() const;
 	void SetWindowFrameEdgeSize(const int32 &size);
 
+	bool FollowCursor() const;
+	void SetFollowCursor(const bool &follow);
+
+	int32 FollowCursorDeadZone() const;
+	void SetFollowCursorDeadZone(const int32 &pixels);
+
+	int32 FollowCursorSmoothing() const;
+	void SetFollowCursorSmoothing(const int32 &percent);
+
 	bool MinimizeOnRecording() const;
 	void SetMinimizeOnRecording(const bool &minimize);
 
@@ -67,6 +127,12 @@ public:
 
 	int32 CaptureFrameRate() const;
 	void SetCaptureFrameRate(const int32& value);
+	// The capture rate goes down to the minimum while the screen
+	// doesn't change, and back to the capture frame rate when it does
+	bool AdaptiveFrameRate() const;
+	void SetAdaptiveFrameRate(const bool& adaptive);
+	int32 MinFrameRate() const;
+	void SetMinFrameRate(const int32& value);
 
 	void SetWarnOnQuit(const bool& warn);
 	bool WarnOnQuit() const;
@@ -86,6 +152,38 @@ public:
 	bool DockingMode() const;
 	void SetDockingMode(const bool& value);
 
+	bool Standby() const;
+	void SetStandby(const bool& standby);
+
+	bool ReplayBuffer() const;
+	void SetReplayBuffer(const bool& replay);
+	int32 ReplayBufferSeconds() const;
+	void SetReplayBufferSeconds(const int32& seconds);
+	bool ReplayBufferOnDisk() const;
+	void SetReplayBufferOnDisk(const bool& onDisk);
+
+	// Empty for the system temporary directory
+	BStringList SpoolFolders() const;
+	void SetSpoolFolders(const BStringList& folders);
+
+	// The part of the recording which is encoded, in milliseconds
+	// from its start or in frames. An end of 0 is the last frame
+	int32 EncodeRangeStart() const;
+	void SetEncodeRangeStart(const int32& start);
+	int32 EncodeRangeEnd() const;
+	void SetEncodeRangeEnd(const int32& end);
+	bool EncodeRangeInFrames() const;
+	void SetEncodeRangeInFrames(const bool& inFrames);
+
+	// The other files made with the output file, each as
+	// "format[:codec[:scale[:quality]]]". Fails if one is invalid
+	BStringList ExtraOutputs() const;
+	status_t SetExtraOutputs(const BStringList& outputs);
+	static bool ParseEncodeOutput(const BString& spec, encode_output* output);
+
+	// All at once, so they go together
+	session_config SessionConfig() const;
+
 	void PrintToStream();
 
 private:
@@ -0,0 +1,322 @@
+/*
+ * Copyright 2026 Stefano Ceccherini <stefano.ceccherini@gmail.com>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+#include "StripedFrameStore.h"
+
+#include <Bitmap.h>
+
+#include <algorithm>
+#include <iostream>
+
+
+StripedFrameStore::StripedFrameStore()
+	:
+	fStripes(4, true),
+	fNextStripe(0),
+	fColorSpace(B_NO_COLOR_SPACE),
+	fBytesPerRow(0)
+{
+}
+
+
+StripedFrameStore::~StripedFrameStore()
+{
+}
+
+
+status_t
+StripedFrameStore::AddStripe(FrameStore* store, const char* path)
+{
+	if (store == NULL || path == NULL) {
+		delete store;
+		return B_BAD_VALUE;
+	}
+	try {
+		fPaths.push_back(path);
+	} catch (...) {
+		delete store;
+		return B_NO_MEMORY;
+	}
+	if (!fStripes.AddItem(store)) {
+		fPaths.pop_back();
+		delete store;
+		return B_NO_MEMORY;
+	}
+	return B_OK;
+}
+
+
+int32
+StripedFrameStore::CountStripes() const
+{
+	return fStripes.CountItems();
+}
+
+
+FrameStore*
+StripedFrameStore::StripeAt(int32 index) const
+{
+	return fStripes.ItemAt(index);
+}
+
+
+// The given path isn't used: every stripe has its own
+/* virtual */
+status_t
+StripedFrameStore::Create(const char* path, const BRect& bounds,
+	color_space colorSpace, int32 bytesPerRow, int64 memoryBudget)
+{
+	if (fStripes.IsEmpty())
+		return B_NO_INIT;
+
+	fBounds = bounds;
+	fColorSpace = colorSpace;
+	fBytesPerRow = bytesPerRow;
+	fFrames.clear();
+	fNextStripe = 0;
+
+	const int64 stripeBudget = memoryBudget / CountStripes();
+	for (int32 i = 0; i < CountStripes(); i++) {
+		status_t status = StripeAt(i)->Create(fPaths[i].String(), bounds,
+			colorSpace, bytesPerRow, stripeBudget);
+		if (status != B_OK) {
+			std::cerr << "StripedFrameStore::Create(): cannot create stripe in "
+				<< fPaths[i].String() << std::endl;
+			return status;
+		}
+	}
+	return B_OK;
+}
+
+
+/* virtual */
+status_t
+StripedFrameStore::WriteFrame(const BBitmap* bitmap, bigtime_t frameTime)
+{
+	if (fStripes.IsEmpty())
+		return B_NO_INIT;
+	const int32 stripe = uint32(atomic_add(&fNextStripe, 1)) % CountStripes();
+	return StripeAt(stripe)->WriteFrame(bitmap, frameTime);
+}
+
+
+// Every stripe is finished even if one fails, so their
+// files are complete
+/* virtual */
+status_t
+StripedFrameStore::Finish()
+{
+	status_t status = B_OK;
+	for (int32 i = 0; i < CountStripes(); i++) {
+		status_t stripeStatus = StripeAt(i)->Finish();
+		if (stripeStatus != B_OK && status == B_OK)
+			status = stripeStatus;
+	}
+	if (status != B_OK)
+		return status;
+	return _BuildIndex();
+}
+
+
+/* virtual */
+void
+StripedFrameStore::SetUnbufferedWrites(bool unbuffered)
+{
+	for (int32 i = 0; i < CountStripes(); i++)
+		StripeAt(i)->SetUnbufferedWrites(unbuffered);
+}
+
+
+/* virtual */
+int32
+StripedFrameStore::CountFramesInMemory() const
+{
+	int32 count = 0;
+	for (int32 i = 0; i < CountStripes(); i++)
+		count += StripeAt(i)->CountFramesInMemory();
+	return count;
+}
+
+
+/* virtual */
+status_t
+StripedFrameStore::Open(const char* path)
+{
+	// The stripes are only known while the session runs
+	return B_NOT_SUPPORTED;
+}
+
+
+/* virtual */
+void
+StripedFrameStore::SetWorkerPool(WorkerPool* pool)
+{
+	for (int32 i = 0; i < CountStripes(); i++)
+		StripeAt(i)->SetWorkerPool(pool);
+}
+
+
+/* virtual */
+const char*
+StripedFrameStore::Path() const
+{
+	return fPaths.empty() ? NULL : fPaths[0].String();
+}
+
+
+/* virtual */
+BRect
+StripedFrameStore::Bounds() const
+{
+	return fBounds;
+}
+
+
+/* virtual */
+color_space
+StripedFrameStore::ColorSpace() const
+{
+	return fColorSpace;
+}
+
+
+/* virtual */
+int32
+StripedFrameStore::BytesPerRow() const
+{
+	return fBytesPerRow;
+}
+
+
+/* virtual */
+int32
+StripedFrameStore::CountFrames() const
+{
+	return fFrames.size();
+}
+
+
+/* virtual */
+bigtime_t
+StripedFrameStore::FrameTime(int32 index) const
+{
+	if (index < 0 || index >= CountFrames())
+		return -1;
+	return fFrames[index].time;
+}
+
+
+/* virtual */
+float
+StripedFrameStore::ChangeRatio(int32 index) const
+{
+	// Of the frame before it in the same stripe, so only
+	// the first stripe would be right
+	return -1;
+}
+
+
+/* virtual */
+uint64
+StripedFrameStore::FrameHash(int32 index) const
+{
+	if (index < 0 || index >= CountFrames())
+		return 0;
+	const stripe_frame& frame = fFrames[index];
+	return StripeAt(frame.stripe)->FrameHash(frame.index);
+}
+
+
+/* virtual */
+BPoint
+StripedFrameStore::AreaOrigin(int32 index) const
+{
+	if (index < 0 || index >= CountFrames())
+		return B_ORIGIN;
+	const stripe_frame& frame = fFrames[index];
+	return StripeAt(frame.stripe)->AreaOrigin(frame.index);
+}
+
+
+// Consecutive frames are in different stripes, so
+// they can only be compared by their hash
+/* virtual */
+bool
+StripedFrameStore::SameAsPrevious(int32 index) const
+{
+	if (index <= 0 || index >= CountFrames())
+		return false;
+	const uint64 hash = FrameHash(index);
+	return hash != 0 && hash == FrameHash(index - 1);
+}
+
+
+/* virtual */
+status_t
+StripedFrameStore::ReadBitmap(int32 index, BBitmap* bitmap) const
+{
+	if (index < 0 || index >= CountFrames())
+		return B_BAD_VALUE;
+	const stripe_frame& frame = fFrames[index];
+	return StripeAt(frame.stripe)->ReadBitmap(frame.index, bitmap);
+}
+
+
+// Every stripe is written in order, so the frames kept
+// are a contiguous range of each one
+/* virtual */
+status_t
+StripedFrameStore::Trim(int32 first, int32 count)
+{
+	if (first < 0 || count < 0 || first + count > CountFrames())
+		return B_BAD_VALUE;
+
+	const int32 stripeCount = CountStripes();
+	std::vector<int32> firstKept(stripeCount, -1);
+	std::vector<int32> lastKept(stripeCount, -1);
+	for (int32 i = first; i < first + count; i++) {
+		const stripe_frame& frame = fFrames[i];
+		if (firstKept[frame.stripe] < 0)
+			firstKept[frame.stripe] = frame.index;
+		lastKept[frame.stripe] = frame.index;
+	}
+	for (int32 i = 0; i < stripeCount; i++) {
+		status_t status = firstKept[i] < 0 ? StripeAt(i)->Trim(0, 0)
+			: StripeAt(i)->Trim(firstKept[i], lastKept[i] - firstKept[i] + 1);
+		if (status != B_OK)
+			return status;
+	}
+	return _BuildIndex();
+}
+
+
+/* virtual */
+void
+StripedFrameStore::Release()
+{
+	for (int32 i = 0; i < CountStripes(); i++)
+		StripeAt(i)->Release();
+	fFrames.clear();
+}
+
+
+status_t
+StripedFrameStore::_BuildIndex()
+{
+	fFrames.clear();
+	try {
+		for (int32 i = 0; i < CountStripes(); i++) {
+			const FrameStore* stripe = StripeAt(i);
+			for (int32 index = 0; index < stripe->CountFrames(); index++) {
+				stripe_frame frame = { stripe->FrameTime(index), i, index };
+				fFrames.push_back(frame);
+			}
+		}
+	} catch (...) {
+		fFrames.clear();
+		return B_NO_MEMORY;
+	}
+	std::stable_sort(fFrames.begin(), fFrames.end());
+	return B_OK;
+}
@@ -0,0 +1,84 @@
+/*
+ * Copyright 2026 Stefano Ceccherini <stefano.ceccherini@gmail.com>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+#ifndef __STRIPEDFRAMESTORE_H
+#define __STRIPEDFRAMESTORE_H
+
+#include "FrameStore.h"
+
+#include <ObjectList.h>
+#include <String.h>
+
+#include <vector>
+
+// Spreads the frames of a session over several stores, every one
+// in its own folder, usually on a different volume, so they're
+// written at the same time.
+// The stores are written to directly, each by its own writer: the
+// frames then go to them round robin. Once finished, they're read
+// as a single store, in the order of their timestamps.
+class StripedFrameStore : public FrameStore {
+public:
+	StripedFrameStore();
+	virtual ~StripedFrameStore();
+
+	// Before Create(). The striped store owns the store
+	status_t AddStripe(FrameStore* store, const char* path);
+	int32 CountStripes() const;
+	FrameStore* StripeAt(int32 index) const;
+
+	// Writing. Every stripe is created in its own folder, and
+	// gets an equal share of the memory budget
+	virtual status_t Create(const char* path, const BRect& bounds,
+				color_space colorSpace, int32 bytesPerRow,
+				int64 memoryBudget = 0);
+	// Round robin, for those which don't write to the stripes
+	virtual status_t WriteFrame(const BBitmap* bitmap,
+				bigtime_t frameTime);
+	virtual status_t Finish();
+	virtual void SetUnbufferedWrites(bool unbuffered);
+	virtual int32 CountFramesInMemory() const;
+
+	// Reading
+	virtual status_t Open(const char* path);
+	virtual void SetWorkerPool(WorkerPool* pool);
+
+	virtual const char* Path() const;
+	virtual BRect Bounds() const;
+	virtual color_space ColorSpace() const;
+	virtual int32 BytesPerRow() const;
+
+	virtual int32 CountFrames() const;
+	virtual bigtime_t FrameTime(int32 index) const;
+	virtual float ChangeRatio(int32 index) const;
+	virtual uint64 FrameHash(int32 index) const;
+	virtual BPoint AreaOrigin(int32 index) const;
+	virtual bool SameAsPrevious(int32 index) const;
+	virtual status_t ReadBitmap(int32 index, BBitmap* bitmap) const;
+
+	virtual status_t Trim(int32 first, int32 count);
+	virtual void Release();
+
+private:
+	struct stripe_frame {
+		bigtime_t time;
+		int32 stripe;
+		int32 index;
+
+		bool operator<(const stripe_frame& other) const
+			{ return time < other.time; }
+	};
+
+	status_t _BuildIndex();
+
+	BObjectList<FrameStore> fStripes;
+	std::vector<BString> fPaths;
+	std::vector<stripe_frame> fFrames;
+	int32 fNextStripe;
+	BRect fBounds;
+	color_space fColorSpace;
+	int32 fBytesPerRow;
+};
+
+#endif // __STRIPEDFRAMESTORE_H
@@ -0,0 +1,312 @@
+/*
+ * Copyright 2026 Stefano Ceccherini <stefano.ceccherini@gmail.com>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+#include "TileDelta.h"
+
+#include <Bitmap.h>
+#include <InterfaceDefs.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+const static uint64 kHashPrime1 = 0x9e3779b185ebca87ULL;
+const static uint64 kHashPrime2 = 0xc2b2ae3d27d4eb4fULL;
+
+
+static inline uint64
+HashBytes(uint64 hash, const uint8* data, size_t length)
+{
+	while (length >= sizeof(uint64)) {
+		uint64 word;
+		::memcpy(&word, data, sizeof(word));
+		hash ^= word * kHashPrime2;
+		hash = ((hash << 31) | (hash >> 33)) * kHashPrime1;
+		data += sizeof(uint64);
+		length -= sizeof(uint64);
+	}
+	while (length-- > 0)
+		hash = (hash ^ *data++) * kHashPrime1;
+	return hash;
+}
+
+
+static int32
+BytesPerPixel(color_space colorSpace)
+{
+	size_t pixelChunk = 0;
+	size_t rowAlignment = 0;
+	size_t pixelsPerChunk = 0;
+	if (get_pixel_size_for(colorSpace, &pixelChunk, &rowAlignment,
+			&pixelsPerChunk) != B_OK || pixelsPerChunk != 1)
+		return 0;
+	return pixelChunk;
+}
+
+
+TileDeltaEncoder::TileDeltaEncoder(int32 tileSize, int32 keyFrameInterval)
+	:
+	fTileSize(std::max(tileSize, int32(8))),
+	fKeyFrameInterval(std::max(keyFrameInterval, int32(1))),
+	fFramesSinceKeyFrame(-1),
+	fChangedRatio(-1),
+	fFrameHash(0),
+	fWidth(0),
+	fHeight(0),
+	fBytesPerRow(0),
+	fBytesPerPixel(0),
+	fTilesX(0),
+	fTilesY(0),
+	fHashes(NULL),
+	fPreviousHashes(NULL),
+	fBuffer(NULL),
+	fBufferSize(0)
+{
+}
+
+
+TileDeltaEncoder::~TileDeltaEncoder()
+{
+	delete[] fHashes;
+	delete[] fPreviousHashes;
+	free(fBuffer);
+}
+
+
+status_t
+TileDeltaEncoder::Encode(const BBitmap* bitmap, const void** data,
+	size_t* length, bool* keyFrame)
+{
+	if (bitmap == NULL || data == NULL || length == NULL || keyFrame == NULL)
+		return B_BAD_VALUE;
+
+	status_t status = _Prepare(bitmap);
+	if (status != B_OK)
+		return status;
+
+	*keyFrame = true;
+	*data = bitmap->Bits();
+	*length = bitmap->BitsLength();
+	fChangedRatio = -1;
+	fFrameHash = 0;
+
+	// Color spaces with less than a byte per pixel
+	// are always stored in full
+	if (fBytesPerPixel == 0)
+		return B_OK;
+
+	_HashTiles(bitmap);
+
+	const uint32 tileCount = fTilesX * fTilesY;
+	fFrameHash = HashBytes(tileCount, (const uint8*)fHashes,
+		tileCount * sizeof(uint64));
+	if (fFrameHash == 0)
+		fFrameHash = 1;
+	uint32 changedCount = 0;
+	for (uint32 i = 0; i < tileCount; i++) {
+		if (fHashes[i] != fPreviousHashes[i])
+			changedCount++;
+	}
+	if (fFramesSinceKeyFrame >= 0)
+		fChangedRatio = float(changedCount) / tileCount;
+
+	// When most of the frame changed, a key frame costs
+	// about the same and doesn't depend on the previous ones
+	const bool needsKeyFrame = fFramesSinceKeyFrame < 0
+		|| fFramesSinceKeyFrame >= fKeyFrameInterval
+		|| changedCount * 4 > tileCount * 3;
+
+	std::swap(fHashes, fPreviousHashes);
+
+	if (needsKeyFrame) {
+		fFramesSinceKeyFrame = 1;
+		return B_OK;
+	}
+
+	const size_t bitsetSize = ((tileCount + 31) / 32) * sizeof(uint32);
+	size_t recordSize = sizeof(tile_delta_header) + bitsetSize;
+	for (uint32 i = 0; i < tileCount; i++) {
+		if (fPreviousHashes[i] == fHashes[i])
+			continue;
+		const int32 x = (i % fTilesX) * fTileSize;
+		const int32 y = (i / fTilesX) * fTileSize;
+		recordSize += std::min(fTileSize, fWidth - x) * fBytesPerPixel
+			* std::min(fTileSize, fHeight - y);
+	}
+
+	if (recordSize > fBufferSize) {
+		uint8* buffer = (uint8*)realloc(fBuffer, recordSize);
+		if (buffer == NULL)
+			return B_NO_MEMORY;
+		fBuffer = buffer;
+		fBufferSize = recordSize;
+	}
+
+	tile_delta_header* header = (tile_delta_header*)fBuffer;
+	header->tileSize = fTileSize;
+	header->tilesX = fTilesX;
+	header->tilesY = fTilesY;
+	header->changedCount = changedCount;
+
+	uint32* bitset = (uint32*)(fBuffer + sizeof(tile_delta_header));
+	::memset(bitset, 0, bitsetSize);
+
+	const uint8* bits = (const uint8*)bitmap->Bits();
+	uint8* out = fBuffer + sizeof(tile_delta_header) + bitsetSize;
+	for (uint32 i = 0; i < tileCount; i++) {
+		if (fPreviousHashes[i] == fHashes[i])
+			continue;
+		bitset[i / 32] |= 1UL << (i % 32);
+		const int32 x = (i % fTilesX) * fTileSize;
+		const int32 y = (i / fTilesX) * fTileSize;
+		const size_t rowLength = std::min(fTileSize, fWidth - x) * fBytesPerPixel;
+		const int32 rows = std::min(fTileSize, fHeight - y);
+		const uint8* in = bits + y * fBytesPerRow + x * fBytesPerPixel;
+		for (int32 row = 0; row < rows; row++) {
+			::memcpy(out, in, rowLength);
+			out += rowLength;
+			in += fBytesPerRow;
+		}
+	}
+
+	fFramesSinceKeyFrame++;
+	*keyFrame = false;
+	*data = fBuffer;
+	*length = recordSize;
+	return B_OK;
+}
+
+
+void
+TileDeltaEncoder::Reset()
+{
+	fFramesSinceKeyFrame = -1;
+}
+
+
+float
+TileDeltaEncoder::ChangedRatio() const
+{
+	return fChangedRatio;
+}
+
+
+uint64
+TileDeltaEncoder::FrameHash() const
+{
+	return fFrameHash;
+}
+
+
+status_t
+TileDeltaEncoder::_Prepare(const BBitmap* bitmap)
+{
+	const BRect bounds = bitmap->Bounds();
+	const int32 width = bounds.IntegerWidth() + 1;
+	const int32 height = bounds.IntegerHeight() + 1;
+	if (width == fWidth && height == fHeight
+		&& bitmap->BytesPerRow() == fBytesPerRow && fHashes != NULL)
+		return B_OK;
+
+	// Geometry changed: start again with a key frame
+	delete[] fHashes;
+	delete[] fPreviousHashes;
+	fHashes = NULL;
+	fPreviousHashes = NULL;
+	Reset();
+
+	const uint32 tilesX = (width + fTileSize - 1) / fTileSize;
+	const uint32 tilesY = (height + fTileSize - 1) / fTileSize;
+	fHashes = new (std::nothrow) uint64[tilesX * tilesY];
+	fPreviousHashes = new (std::nothrow) uint64[tilesX * tilesY];
+	if (fHashes == NULL || fPreviousHashes == NULL) {
+		delete[] fHashes;
+		delete[] fPreviousHashes;
+		fHashes = NULL;
+		fPreviousHashes = NULL;
+		return B_NO_MEMORY;
+	}
+	::memset(fPreviousHashes, 0, tilesX * tilesY * sizeof(uint64));
+
+	fWidth = width;
+	fHeight = height;
+	fBytesPerRow = bitmap->BytesPerRow();
+	fBytesPerPixel = BytesPerPixel(bitmap->ColorSpace());
+	fTilesX = tilesX;
+	fTilesY = tilesY;
+	return B_OK;
+}
+
+
+void
+TileDeltaEncoder::_HashTiles(const BBitmap* bitmap)
+{
+	::memset(fHashes, 0, fTilesX * fTilesY * sizeof(uint64));
+
+	// Walk the bitmap row by row, so memory is read sequentially
+	const uint8* bits = (const uint8*)bitmap->Bits();
+	const size_t tileRowLength = fTileSize * fBytesPerPixel;
+	const size_t rowLength = fWidth * fBytesPerPixel;
+	for (int32 y = 0; y < fHeight; y++) {
+		uint64* hashes = fHashes + (y / fTileSize) * fTilesX;
+		const uint8* row = bits + y * fBytesPerRow;
+		for (uint32 tx = 0; tx < fTilesX; tx++) {
+			const size_t offset = tx * tileRowLength;
+			hashes[tx] = HashBytes(hashes[tx] + 1, row + offset,
+				std::min(tileRowLength, rowLength - offset));
+		}
+	}
+}
+
+
+// Patches the bitmap, which must contain the reference frame,
+// with the tiles stored in the record
+status_t
+ApplyTileDelta(const void* record, size_t length, BBitmap* bitmap)
+{
+	if (record == NULL || bitmap == NULL || length < sizeof(tile_delta_header))
+		return B_BAD_VALUE;
+
+	const tile_delta_header* header = (const tile_delta_header*)record;
+	const int32 bytesPerPixel = BytesPerPixel(bitmap->ColorSpace());
+	const BRect bounds = bitmap->Bounds();
+	const int32 width = bounds.IntegerWidth() + 1;
+	const int32 height = bounds.IntegerHeight() + 1;
+	const int32 tileSize = header->tileSize;
+	if (bytesPerPixel == 0 || tileSize <= 0
+		|| header->tilesX != uint32((width + tileSize - 1) / tileSize)
+		|| header->tilesY != uint32((height + tileSize - 1) / tileSize))
+		return B_MISMATCHED_VALUES;
+
+	const uint32 tileCount = header->tilesX * header->tilesY;
+	const size_t bitsetSize = ((tileCount + 31) / 32) * sizeof(uint32);
+	if (length < sizeof(tile_delta_header) + bitsetSize)
+		return B_BAD_DATA;
+
+	const uint32* bitset = (const uint32*)((const uint8*)record
+		+ sizeof(tile_delta_header));
+	const uint8* in = (const uint8*)record + sizeof(tile_delta_header) + bitsetSize;
+	const uint8* end = (const uint8*)record + length;
+
+	const int32 bytesPerRow = bitmap->BytesPerRow();
+	uint8* bits = (uint8*)bitmap->Bits();
+	for (uint32 i = 0; i < tileCount; i++) {
+		if ((bitset[i / 32] & (1UL << (i % 32))) == 0)
+			continue;
+		const int32 x = (i % header->tilesX) * tileSize;
+		const int32 y = (i / header->tilesX) * tileSize;
+		const size_t rowLength = std::min(tileSize, width - x) * bytesPerPixel;
+		const int32 rows = std::min(tileSize, height - y);
+		if (in + rowLength * rows > end)
+			return B_BAD_DATA;
+		uint8* out = bits + y * bytesPerRow + x * bytesPerPixel;
+		for (int32 row = 0; row < rows; row++) {
+			::memcpy(out, in, rowLength);
+			in += rowLength;
+			out += bytesPerRow;
+		}
+	}
+	return B_OK;
+}
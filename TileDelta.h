@@ -0,0 +1,74 @@
+/*
+ * Copyright 2026 Stefano Ceccherini <stefano.ceccherini@gmail.com>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+#ifndef __TILEDELTA_H
+#define __TILEDELTA_H
+
+#include <SupportDefs.h>
+
+const static int32 kDefaultTileSize = 64;
+const static int32 kDefaultKeyFrameInterval = 60;
+
+// A delta record starts with this header, followed by a bitset
+// (one bit per tile, in rows) of changed tiles, and by the pixels of
+// the changed tiles, in the same order, packed row after row.
+struct tile_delta_header {
+	uint32 tileSize;
+	uint32 tilesX;
+	uint32 tilesY;
+	uint32 changedCount;
+};
+
+class BBitmap;
+// Splits frames in tiles and keeps the hash of every tile.
+// Encode() compares them with the ones of the previous frame and packs
+// only the changed tiles. Every keyFrameInterval frames, or when most
+// of the frame changed anyway, a full key frame is requested instead.
+class TileDeltaEncoder {
+public:
+	TileDeltaEncoder(int32 tileSize = kDefaultTileSize,
+		int32 keyFrameInterval = kDefaultKeyFrameInterval);
+	~TileDeltaEncoder();
+
+	// On success, data and length point to the record to be stored,
+	// which is valid until the next call. If keyFrame is true,
+	// data points directly to the bitmap bits.
+	status_t Encode(const BBitmap* bitmap, const void** data,
+		size_t* length, bool* keyFrame);
+	// Forces the next frame to be a key frame
+	void Reset();
+	// The share of the tiles which changed in the last
+	// encoded frame, negative if it couldn't be compared,
+	// as for the first one after Reset()
+	float ChangedRatio() const;
+	// Of the whole last encoded frame, so frames from different
+	// encoders can be compared. 0 if it wasn't hashed
+	uint64 FrameHash() const;
+
+private:
+	status_t _Prepare(const BBitmap* bitmap);
+	void _HashTiles(const BBitmap* bitmap);
+
+	int32 fTileSize;
+	int32 fKeyFrameInterval;
+	int32 fFramesSinceKeyFrame;
+	float fChangedRatio;
+	uint64 fFrameHash;
+
+	int32 fWidth;
+	int32 fHeight;
+	int32 fBytesPerRow;
+	int32 fBytesPerPixel;
+	uint32 fTilesX;
+	uint32 fTilesY;
+
+	uint64* fHashes;
+	uint64* fPreviousHashes;
+	uint8* fBuffer;
+	size_t fBufferSize;
+};
+
+status_t ApplyTileDelta(const void* record, size_t length, BBitmap* bitmap);
+
+#endif // __TILEDELTA_H
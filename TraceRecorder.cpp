@@ -0,0 +1,173 @@
+/*
+ * Copyright 2026 Stefano Ceccherini <stefano.ceccherini@gmail.com>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+#include "TraceRecorder.h"
+
+#include <Autolock.h>
+#include <Locker.h>
+#include <String.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <new>
+#include <unistd.h>
+#include <vector>
+
+// A couple of minutes for every stage, at 60 frames per second
+const static int32 kEventsPerThread = 65536;
+
+struct trace_event {
+	bigtime_t time;
+	const char* name;
+	int32 frame;
+	char phase;
+};
+
+struct trace_buffer {
+	thread_id thread;
+	char threadName[B_OS_NAME_LENGTH];
+	trace_event events[kEventsPerThread];
+	// Only written by the thread, after the event
+	int32 count;
+	// The events before it were recorded before Start()
+	int32 first;
+};
+
+/* static */ int32 TraceRecorder::sRecording = 0;
+
+// Rings are never freed: the threads keep a pointer to theirs.
+// The ones of the threads which are gone are given to new ones,
+// once they have no events since Start(), so they can be dumped
+static BLocker sLocker("trace recorder lock");
+static std::vector<trace_buffer*> sBuffers;
+static __thread trace_buffer* sThreadBuffer = NULL;
+
+
+/* static */
+void
+TraceRecorder::Start()
+{
+	BAutolock _(sLocker);
+	for (size_t i = 0; i < sBuffers.size(); i++)
+		sBuffers[i]->first = atomic_get(&sBuffers[i]->count);
+	atomic_set(&sRecording, 1);
+}
+
+
+/* static */
+void
+TraceRecorder::Stop()
+{
+	atomic_set(&sRecording, 0);
+}
+
+
+// Threads which are still recording meanwhile could overwrite
+// the oldest events of their ring while they're written
+/* static */
+status_t
+TraceRecorder::Dump(const char* path)
+{
+	if (path == NULL)
+		return B_BAD_VALUE;
+	FILE* file = ::fopen(path, "w");
+	if (file == NULL)
+		return errno;
+
+	const pid_t team = ::getpid();
+	bool firstEvent = true;
+	::fprintf(file, "{\"traceEvents\":[\n");
+	BAutolock _(sLocker);
+	for (size_t i = 0; i < sBuffers.size(); i++) {
+		const trace_buffer* buffer = sBuffers[i];
+		const int32 count = atomic_get(const_cast<int32*>(&buffer->count));
+		const int32 first = std::max(buffer->first, count - kEventsPerThread);
+		if (count == first)
+			continue;
+
+		BString name(buffer->threadName);
+		name.CharacterEscape("\"\\", '\\');
+		::fprintf(file, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,"
+			"\"tid\":%" B_PRId32 ",\"args\":{\"name\":\"%s\"}}",
+			firstEvent ? "" : ",\n", (int)team, buffer->thread, name.String());
+		firstEvent = false;
+		for (int32 e = first; e < count; e++) {
+			const trace_event& event = buffer->events[e % kEventsPerThread];
+			::fprintf(file, ",\n{\"name\":\"%s\",\"ph\":\"%c\",\"ts\":%" B_PRIdBIGTIME
+				",\"pid\":%d,\"tid\":%" B_PRId32, event.name, event.phase,
+				event.time, (int)team, buffer->thread);
+			if (event.frame >= 0)
+				::fprintf(file, ",\"args\":{\"frame\":%" B_PRId32 "}", event.frame);
+			::fprintf(file, "}");
+		}
+	}
+	::fprintf(file, "\n]}\n");
+
+	status_t status = ::ferror(file) ? B_IO_ERROR : B_OK;
+	if (::fclose(file) != 0 && status == B_OK)
+		status = errno;
+	if (status != B_OK)
+		std::cerr << "TraceRecorder::Dump(): cannot write " << path << ": " << ::strerror(status) << std::endl;
+	return status;
+}
+
+
+/* static */
+void
+TraceRecorder::_AddEvent(const char* name, int32 frame, char phase)
+{
+	trace_buffer* buffer = sThreadBuffer;
+	if (buffer == NULL) {
+		buffer = _BufferForThread();
+		if (buffer == NULL)
+			return;
+		sThreadBuffer = buffer;
+	}
+	trace_event& event = buffer->events[buffer->count % kEventsPerThread];
+	event.time = system_time();
+	event.name = name;
+	event.frame = frame;
+	event.phase = phase;
+	atomic_add(&buffer->count, 1);
+}
+
+
+/* static */
+trace_buffer*
+TraceRecorder::_BufferForThread()
+{
+	thread_info info;
+	if (get_thread_info(find_thread(NULL), &info) != B_OK)
+		return NULL;
+
+	BAutolock _(sLocker);
+	trace_buffer* buffer = NULL;
+	for (size_t i = 0; i < sBuffers.size(); i++) {
+		thread_info unused;
+		if (atomic_get(&sBuffers[i]->count) == sBuffers[i]->first
+			&& get_thread_info(sBuffers[i]->thread, &unused) != B_OK) {
+			buffer = sBuffers[i];
+			break;
+		}
+	}
+	if (buffer == NULL) {
+		buffer = new (std::nothrow) trace_buffer;
+		if (buffer == NULL)
+			return NULL;
+		try {
+			sBuffers.push_back(buffer);
+		} catch (...) {
+			delete buffer;
+			return NULL;
+		}
+	}
+	buffer->thread = info.thread;
+	::strlcpy(buffer->threadName, info.name, sizeof(buffer->threadName));
+	buffer->count = 0;
+	buffer->first = 0;
+	return buffer;
+}
@@ -0,0 +1,65 @@
+/*
+ * Copyright 2026 Stefano Ceccherini <stefano.ceccherini@gmail.com>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+#ifndef __TRACERECORDER_H
+#define __TRACERECORDER_H
+
+#include <OS.h>
+
+struct trace_buffer;
+// Records when the stages of the pipeline begin and end, for every
+// frame, and writes them as a Chrome trace, which can be opened in
+// chrome://tracing or Perfetto.
+// Every thread has its own ring of events, only written by that
+// thread, so recording doesn't take any lock. When it's full, the
+// oldest events are overwritten. While not recording, an event
+// only costs the check.
+class TraceRecorder {
+public:
+	// Forgets the events recorded until now. Threads which
+	// record for the first time get their ring then
+	static void Start();
+	static void Stop();
+	static bool IsRecording() { return sRecording != 0; }
+
+	// The name must stay valid: string literals are best.
+	// A negative frame isn't shown
+	static void Begin(const char* name, int32 frame = -1)
+		{ if (sRecording != 0) _AddEvent(name, frame, 'B'); }
+	static void End(const char* name, int32 frame = -1)
+		{ if (sRecording != 0) _AddEvent(name, frame, 'E'); }
+
+	// Of the events since Start(), as a Chrome trace JSON file
+	static status_t Dump(const char* path);
+
+private:
+	static void _AddEvent(const char* name, int32 frame, char phase);
+	static trace_buffer* _BufferForThread();
+
+	static int32 sRecording;
+};
+
+
+// Begins an event, and ends it when it goes out of scope
+class TraceScope {
+public:
+	TraceScope(const char* name, int32 frame = -1)
+		:
+		fName(name),
+		fFrame(frame)
+	{
+		TraceRecorder::Begin(fName, fFrame);
+	}
+
+	~TraceScope()
+	{
+		TraceRecorder::End(fName, fFrame);
+	}
+
+private:
+	const char* fName;
+	int32 fFrame;
+};
+
+#endif // __TRACERECORDER_H
@@ -5,6 +5,7 @@
 #include "Utils.h"
 
 #include "Constants.h"
+#include "MediaCache.h"
 #include "Settings.h"
 
 // Private Haiku header
@@ -14,7 +15,9 @@
 #include <Entry.h>
 #include <Path.h>
 #include <String.h>
+#include <Volume.h>
 #include <Window.h>
+#include <fs_info.h>
 
 #include <algorithm>
 #include <cstring>
@@ -72,27 +75,40 @@ IsFFMPEGAvailable()
 }
 
 
-// If prettyName is NULL, returns the first found media_file_format,
-// otherwise returns the media_file_format with the same prettyName
-// TODO: Use the short_name instead
+BString
+QuoteShellArgument(const char* argument)
+{
+	BString quoted(argument);
+	quoted.ReplaceAll("'", "'\\''");
+	quoted.Prepend("'");
+	quoted.Append("'");
+	return quoted;
+}
+
+
+// If name is empty, returns the first found media_file_format,
+// otherwise returns the media_file_format with the same pretty
+// or short name
 bool
-GetMediaFileFormat(const BString& prettyName, media_file_format* outFormat)
+GetMediaFileFormat(const BString& name, media_file_format* outFormat)
 {
-	media_file_format mediaFileFormat;
-	int32 cookie = 0;
-	while (get_next_file_format(&cookie, &mediaFileFormat) == B_OK) {
-		if (!IsFileFormatUsable(mediaFileFormat))
-			continue;
-		if (prettyName == "" || prettyName == mediaFileFormat.pretty_name) {
-			*outFormat = mediaFileFormat;
-			return true;
+	BObjectList<media_file_format> formats(20, true);
+	MediaCache* cache = MediaCache::Default();
+	if (cache != NULL && cache->GetFileFormats(formats) == B_OK) {
+		for (int32 i = 0; i < formats.CountItems(); i++) {
+			const media_file_format* format = formats.ItemAt(i);
+			if (name == "" || name == format->pretty_name
+				|| name == format->short_name) {
+				*outFormat = *format;
+				return true;
+			}
 		}
 	}
 
-	if (prettyName == NULL_FORMAT_PRETTY_NAME) {
+	if (name == NULL_FORMAT_PRETTY_NAME || name == NULL_FORMAT_SHORT_NAME) {
 		MakeNULLMediaFileFormat(*outFormat);
 		return true;
-	} else if (prettyName == GIF_FORMAT_PRETTY_NAME) {
+	} else if (name == GIF_FORMAT_PRETTY_NAME || name == GIF_FORMAT_SHORT_NAME) {
 		MakeGIFMediaFileFormat(*outFormat);
 		return true;
 	}
@@ -296,3 +312,18 @@ GetFreeMemory()
 
 	return info.free_memory;
 }
+
+
+int64
+GetFreeSpace(const char* path)
+{
+	if (path == NULL)
+		return -1;
+	const dev_t device = dev_for_path(path);
+	if (device < 0)
+		return -1;
+	BVolume volume(device);
+	if (volume.InitCheck() != B_OK)
+		return -1;
+	return volume.FreeBytes();
+}
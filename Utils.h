@@ -17,7 +17,9 @@ class BString;
 void PrintMediaFormat(const media_format& format);
 bool IsFileFormatUsable(const media_file_format&);
 bool IsFFMPEGAvailable();
-bool GetMediaFileFormat(const BString& prettyName, media_file_format* outFormat);
+// In single quotes, so the shell passes it as it is
+BString QuoteShellArgument(const char* argument);
+bool GetMediaFileFormat(const BString& name, media_file_format* outFormat);
 void MakeGIFMediaFileFormat(media_file_format& outFormat);
 void MakeNULLMediaFileFormat(media_file_format& outFormat);
 
@@ -31,6 +33,8 @@ int32 GetWindowTokenForFrame(BRect frame, int32 border = 0);
 float CalculateFPS(const uint32& numFrames, const bigtime_t& elapsedTime);
 
 uint64 GetFreeMemory();
+// Of the volume the path is on, or -1 if unknown
+int64 GetFreeSpace(const char* path);
 
 
 #endif // __UTILS_H
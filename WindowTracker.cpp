@@ -0,0 +1,118 @@
+/*
+ * Copyright 2026 Stefano Ceccherini <stefano.ceccherini@gmail.com>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+#include "WindowTracker.h"
+
+#include "TraceRecorder.h"
+#include "Utils.h"
+
+#include <Rect.h>
+
+// Not a valid position: the left coordinate can't be that far
+const static int64 kUnknownPosition = (int64)INT32_MIN << 32;
+
+
+static inline int64
+PackPosition(int32 left, int32 top)
+{
+	return ((int64)left << 32) | (uint32)top;
+}
+
+
+WindowTracker::WindowTracker(int32 token, int32 border, bigtime_t interval)
+	:
+	fToken(token),
+	fBorder(border),
+	fInterval(interval),
+	fThread(-1),
+	fQuitSem(-1),
+	fPosition(kUnknownPosition)
+{
+}
+
+
+WindowTracker::~WindowTracker()
+{
+	Stop();
+}
+
+
+status_t
+WindowTracker::Start()
+{
+	if (fThread >= 0)
+		return B_OK;
+
+	// Know the position before the first frame
+	_Update();
+
+	fQuitSem = create_sem(0, "window tracker quit");
+	if (fQuitSem < 0)
+		return fQuitSem;
+
+	// The position is only read from the app_server,
+	// no need for a high priority
+	fThread = spawn_thread((thread_entry)_TrackerStarter, "Window tracker",
+		B_LOW_PRIORITY, this);
+	if (fThread < 0) {
+		status_t status = fThread;
+		delete_sem(fQuitSem);
+		fQuitSem = -1;
+		return status;
+	}
+	return resume_thread(fThread);
+}
+
+
+void
+WindowTracker::Stop()
+{
+	if (fThread >= 0) {
+		delete_sem(fQuitSem);
+		status_t unused;
+		wait_for_thread(fThread, &unused);
+		fThread = -1;
+		fQuitSem = -1;
+	}
+}
+
+
+bool
+WindowTracker::GetPosition(BPoint& position) const
+{
+	const int64 packed = atomic_get64(&fPosition);
+	if (packed == kUnknownPosition)
+		return false;
+	position.x = (int32)(packed >> 32);
+	position.y = (int32)(packed & 0xffffffff);
+	return true;
+}
+
+
+/* static */
+int32
+WindowTracker::_TrackerStarter(void* arg)
+{
+	return static_cast<WindowTracker*>(arg)->_TrackerThread();
+}
+
+
+int32
+WindowTracker::_TrackerThread()
+{
+	// Deleting the semaphore stops the thread
+	while (acquire_sem_etc(fQuitSem, 1, B_RELATIVE_TIMEOUT, fInterval) == B_TIMED_OUT)
+		_Update();
+	return B_OK;
+}
+
+
+void
+WindowTracker::_Update()
+{
+	TraceScope trace("window");
+	const BRect frame = GetWindowFrameForToken(fToken, fBorder);
+	atomic_set64(&fPosition, frame.IsValid()
+		? PackPosition((int32)frame.left, (int32)frame.top) : kUnknownPosition);
+}
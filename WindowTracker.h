@@ -0,0 +1,40 @@
+/*
+ * Copyright 2026 Stefano Ceccherini <stefano.ceccherini@gmail.com>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+#ifndef __WINDOWTRACKER_H
+#define __WINDOWTRACKER_H
+
+#include <OS.h>
+#include <Point.h>
+
+// Follows the position of a window from its own thread, so that
+// asking the app_server about it doesn't slow down the capture
+class WindowTracker {
+public:
+	WindowTracker(int32 token, int32 border,
+		bigtime_t interval = 50000);
+	~WindowTracker();
+
+	status_t Start();
+	void Stop();
+
+	// Returns the latest known position of the window frame,
+	// or false if the window is gone. Doesn't block
+	bool GetPosition(BPoint& position) const;
+
+private:
+	static int32 _TrackerStarter(void* arg);
+	int32 _TrackerThread();
+	void _Update();
+
+	int32 fToken;
+	int32 fBorder;
+	bigtime_t fInterval;
+	thread_id fThread;
+	sem_id fQuitSem;
+	// Both coordinates, so they are always updated together
+	mutable int64 fPosition;
+};
+
+#endif // __WINDOWTRACKER_H
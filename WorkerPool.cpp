@@ -0,0 +1,271 @@
+/*
+ * Copyright 2026 Stefano Ceccherini <stefano.ceccherini@gmail.com>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+#include "WorkerPool.h"
+
+#include "FunctionObject.h"
+
+#include <Autolock.h>
+#include <String.h>
+
+#include <algorithm>
+#include <new>
+
+// More threads than this don't help: the work is memory bound
+const static int32 kMaxThreads = 8;
+
+static BLocker sSharedLocker("shared worker pools");
+static WorkerPool* sSharedPools[WorkerPool::kWorkPriorities];
+
+
+WorkerPool::WorkerPool(const char* name, int32 threadCount, int32 priority)
+	:
+	fLocker("worker pool lock"),
+	fBatches(4, false),
+	fTasks(4, true),
+	fWorkSem(-1),
+	fThreads(NULL),
+	fThreadCount(0),
+	fInitStatus(B_NO_INIT),
+	fQuitting(false)
+{
+	if (threadCount <= 0) {
+		system_info info;
+		if (get_system_info(&info) == B_OK)
+			threadCount = info.cpu_count;
+	}
+	threadCount = std::min(std::max(threadCount, int32(1)), kMaxThreads);
+
+	fWorkSem = create_sem(0, "worker pool work");
+	if (fWorkSem < 0) {
+		fInitStatus = fWorkSem;
+		return;
+	}
+
+	fThreads = new (std::nothrow) thread_id[threadCount];
+	if (fThreads == NULL) {
+		fInitStatus = B_NO_MEMORY;
+		return;
+	}
+
+	for (int32 i = 0; i < threadCount; i++) {
+		BString threadName;
+		threadName.SetToFormat("%s %" B_PRId32, name, i + 1);
+		thread_id thread = spawn_thread((thread_entry)_WorkerStarter,
+			threadName.String(), priority, this);
+		if (thread < 0)
+			break;
+		if (resume_thread(thread) != B_OK) {
+			kill_thread(thread);
+			break;
+		}
+		fThreads[fThreadCount++] = thread;
+	}
+
+	// Run() works even without any thread, but then
+	// it's not worth having a pool
+	fInitStatus = fThreadCount > 0 ? B_OK : B_ERROR;
+}
+
+
+WorkerPool::~WorkerPool()
+{
+	fQuitting = true;
+	if (fWorkSem >= 0)
+		delete_sem(fWorkSem);
+	for (int32 i = 0; i < fThreadCount; i++) {
+		status_t unused;
+		wait_for_thread(fThreads[i], &unused);
+	}
+	delete[] fThreads;
+}
+
+
+/* static */
+WorkerPool*
+WorkerPool::Shared(work_priority priority)
+{
+	if (priority < kDisplayWork || priority >= kWorkPriorities)
+		return NULL;
+
+	BAutolock _(sSharedLocker);
+	if (sSharedPools[priority] == NULL) {
+		const static char* kNames[] = { "Display worker", "Worker",
+			"Background worker" };
+		const static int32 kPriorities[] = { B_DISPLAY_PRIORITY,
+			B_NORMAL_PRIORITY, B_LOW_PRIORITY };
+		WorkerPool* pool = new (std::nothrow) WorkerPool(kNames[priority], 0,
+			kPriorities[priority]);
+		if (pool != NULL && pool->InitCheck() != B_OK) {
+			delete pool;
+			pool = NULL;
+		}
+		sSharedPools[priority] = pool;
+	}
+	return sSharedPools[priority];
+}
+
+
+/* static */
+void
+WorkerPool::DeleteShared()
+{
+	BAutolock _(sSharedLocker);
+	for (int32 i = 0; i < kWorkPriorities; i++) {
+		delete sSharedPools[i];
+		sSharedPools[i] = NULL;
+	}
+}
+
+
+status_t
+WorkerPool::InitCheck() const
+{
+	return fInitStatus;
+}
+
+
+int32
+WorkerPool::CountThreads() const
+{
+	return fThreadCount;
+}
+
+
+status_t
+WorkerPool::Run(work_function function, void* cookie, int32 count)
+{
+	if (function == NULL || count < 0)
+		return B_BAD_VALUE;
+	if (count == 0)
+		return B_OK;
+
+	work_batch batch;
+	batch.function = function;
+	batch.cookie = cookie;
+	batch.count = count;
+	batch.next = 0;
+	batch.done = 0;
+	batch.doneSem = -1;
+
+	if (count > 1 && fThreadCount > 0) {
+		batch.doneSem = create_sem(0, "worker pool batch");
+		if (batch.doneSem >= 0) {
+			fLocker.Lock();
+			fBatches.AddItem(&batch);
+			fLocker.Unlock();
+			release_sem_etc(fWorkSem, std::min(count - 1, fThreadCount),
+				B_DO_NOT_RESCHEDULE);
+		}
+	}
+
+	// Help with our own batch
+	while (_RunNext(&batch, true))
+		;
+
+	if (batch.doneSem >= 0) {
+		while (acquire_sem(batch.doneSem) == B_INTERRUPTED)
+			;
+		delete_sem(batch.doneSem);
+	}
+	return B_OK;
+}
+
+
+status_t
+WorkerPool::Post(FunctionObject* task)
+{
+	if (task == NULL)
+		return B_BAD_VALUE;
+	if (fThreadCount == 0) {
+		(*task)();
+		delete task;
+		return B_OK;
+	}
+
+	fLocker.Lock();
+	const bool added = fTasks.AddItem(task);
+	fLocker.Unlock();
+	if (!added) {
+		delete task;
+		return B_NO_MEMORY;
+	}
+	return release_sem(fWorkSem);
+}
+
+
+/* static */
+int32
+WorkerPool::_WorkerStarter(void* arg)
+{
+	return static_cast<WorkerPool*>(arg)->_WorkerThread();
+}
+
+
+int32
+WorkerPool::_WorkerThread()
+{
+	while (acquire_sem(fWorkSem) == B_OK && !fQuitting) {
+		// Whatever the semaphore was released for: a thread can
+		// end up helping with a batch instead of running its task
+		while (!fQuitting && _RunQueued())
+			;
+	}
+	return B_OK;
+}
+
+
+// Batches first, since their callers are waiting.
+// Returns false when there's nothing to do
+bool
+WorkerPool::_RunQueued()
+{
+	fLocker.Lock();
+	work_batch* batch = fBatches.ItemAt(0);
+	FunctionObject* task = NULL;
+	if (batch == NULL)
+		task = fTasks.RemoveItemAt(0);
+	fLocker.Unlock();
+
+	if (batch != NULL) {
+		while (_RunNext(batch, false))
+			;
+		return true;
+	}
+	if (task == NULL)
+		return false;
+	(*task)();
+	delete task;
+	return true;
+}
+
+
+// Runs the next index of the batch. Returns false when there
+// are none left. After the last call completes, the batch can be
+// destroyed by its owner, so it's not touched anymore.
+bool
+WorkerPool::_RunNext(work_batch* batch, bool owner)
+{
+	fLocker.Lock();
+	// The batch could be gone already: other than their own,
+	// threads can only use batches which are still in the list
+	if (!owner && !fBatches.HasItem(batch)) {
+		fLocker.Unlock();
+		return false;
+	}
+	const int32 index = batch->next++;
+	if (batch->next >= batch->count)
+		fBatches.RemoveItem(batch);
+	fLocker.Unlock();
+
+	if (index >= batch->count)
+		return false;
+
+	batch->function(batch->cookie, index);
+
+	const sem_id doneSem = batch->doneSem;
+	if (atomic_add(&batch->done, 1) + 1 == batch->count && doneSem >= 0)
+		release_sem(doneSem);
+	return true;
+}
@@ -0,0 +1,78 @@
+/*
+ * Copyright 2026 Stefano Ceccherini <stefano.ceccherini@gmail.com>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+#ifndef __WORKERPOOL_H
+#define __WORKERPOOL_H
+
+#include <Locker.h>
+#include <ObjectList.h>
+#include <OS.h>
+
+class FunctionObject;
+// A fixed set of threads which run the same function
+// on many indexes at the same time.
+// Many threads can call Run() at once: their calls are
+// served in order. Idle threads take the next index of the
+// oldest batch, so a slow index doesn't hold the others back.
+// The threads also run single tasks, after the batches.
+class WorkerPool {
+public:
+	typedef void (*work_function)(void* cookie, int32 index);
+
+	enum work_priority {
+		kDisplayWork = 0,
+		kNormalWork,
+		kBackgroundWork,
+		kWorkPriorities
+	};
+
+	// threadCount <= 0 means one thread for every CPU
+	WorkerPool(const char* name, int32 threadCount = 0,
+		int32 priority = B_NORMAL_PRIORITY);
+	~WorkerPool();
+
+	// One pool for every priority, shared by the whole application.
+	// Created when first asked for, NULL if that fails.
+	static WorkerPool* Shared(work_priority priority);
+	// When quitting, once nobody uses them anymore
+	static void DeleteShared();
+
+	status_t InitCheck() const;
+	int32 CountThreads() const;
+
+	// Calls function(cookie, i) for every i in [0, count), using
+	// the pool threads and the calling one, and returns when
+	// all the calls are done.
+	status_t Run(work_function function, void* cookie, int32 count);
+	// Runs the task on one of the pool threads, without waiting
+	// for it, and then deletes it. Tasks still queued when the pool
+	// is deleted are deleted without being run
+	status_t Post(FunctionObject* task);
+
+private:
+	struct work_batch {
+		work_function function;
+		void* cookie;
+		int32 count;
+		int32 next;
+		int32 done;
+		sem_id doneSem;
+	};
+
+	static int32 _WorkerStarter(void* arg);
+	int32 _WorkerThread();
+	bool _RunQueued();
+	bool _RunNext(work_batch* batch, bool owner);
+
+	BLocker fLocker;
+	BObjectList<work_batch> fBatches;
+	BObjectList<FunctionObject> fTasks;
+	sem_id fWorkSem;
+	thread_id* fThreads;
+	int32 fThreadCount;
+	status_t fInitStatus;
+	bool fQuitting;
+};
+
+#endif // __WORKERPOOL_H
@@ -0,0 +1,337 @@
+/*
+ * Copyright 2026 Stefano Ceccherini <stefano.ceccherini@gmail.com>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+
+// Times the pixel kernels of BeScreenCapture on synthetic frames,
+// without the screen or the Media Kit: the row copies and color
+// conversions used when reading the screen, the color conversions
+// and the scaler used when encoding, the tile hashing of the frame
+// spool and the drawing of the pointer.
+// Kernels with a SIMD version are timed side by side with the same
+// code built without it (see ScalarKernels.h).
+// The results are printed as tab separated values, in cycles of the
+// time stamp counter per pixel, or in nanoseconds per pixel where
+// there's no such counter.
+
+#include "ColorConverter.h"
+#include "CursorTrack.h"
+#include "DirectFrameBuffer.h"
+#include "FrameScaler.h"
+#include "ScalarKernels.h"
+#include "TileDelta.h"
+
+#include <Application.h>
+#include <Bitmap.h>
+#include <OS.h>
+#include <String.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+#if defined(__i386__) || defined(__x86_64__)
+#include <x86intrin.h>
+#define HAVE_CYCLE_COUNTER 1
+#define SIMD_NAME "sse2"
+#else
+#define SIMD_NAME "simd"
+#endif
+
+// Every measure is repeated for at least this long
+const static bigtime_t kMinimumTime = 250000;
+const static int32 kMinimumRuns = 3;
+
+struct frame_size {
+	int32 width;
+	int32 height;
+	const char* name;
+};
+
+const static frame_size kFrameSizes[] = {
+	{ 1280, 720, "720p" },
+	{ 1920, 1080, "1080p" },
+	{ 2560, 1440, "1440p" },
+	{ 3840, 2160, "2160p" }
+};
+
+const static struct {
+	color_space colorSpace;
+	const char* name;
+} kColorSpaces[] = {
+	{ B_RGB32, "RGB32" },
+	{ B_RGBA32, "RGBA32" },
+	{ B_RGB24, "RGB24" },
+	{ B_RGB16, "RGB16" },
+	{ B_RGB15, "RGB15" },
+	{ B_YCbCr422, "YCbCr422" },
+	{ B_YCbCr420, "YCbCr420" }
+};
+
+const static struct {
+	FrameScaler::scale_kernel kernel;
+	const char* name;
+} kScaleKernels[] = {
+	{ FrameScaler::kKernelBox, "box" },
+	{ FrameScaler::kKernelBilinear, "bilinear" },
+	{ FrameScaler::kKernelLanczos, "lanczos" }
+};
+
+
+static inline uint64
+CycleCount()
+{
+#if HAVE_CYCLE_COUNTER
+	return __rdtsc();
+#else
+	return system_time() * 1000;
+#endif
+}
+
+
+// Calls the function until it has run for long enough, and returns
+// the cost of one pixel, or a negative number if the function failed
+template<typename Function>
+static double
+Measure(Function function, int64 pixels)
+{
+	// Once to warm up the caches, and to see if it works
+	if (function() != B_OK)
+		return -1;
+
+	int32 runs = 0;
+	const bigtime_t start = system_time();
+	const uint64 startCycles = CycleCount();
+	while (runs < kMinimumRuns || system_time() - start < kMinimumTime) {
+		if (function() != B_OK)
+			return -1;
+		runs++;
+	}
+	const uint64 cycles = CycleCount() - startCycles;
+	return double(cycles) / runs / pixels;
+}
+
+
+static void
+PrintResult(const char* kernel, const char* variant, const frame_size& size,
+	double scalar, double simd)
+{
+	printf("%s\t%s\t%s", kernel, variant, size.name);
+	if (scalar < 0)
+		printf("\t-");
+	else
+		printf("\t%.3f", scalar);
+	if (simd < 0)
+		printf("\t-\t-\n");
+	else if (scalar < 0)
+		printf("\t%.3f\t-\n", simd);
+	else
+		printf("\t%.3f\t%.2f\n", simd, scalar / simd);
+}
+
+
+// Gradients with some noise, so nothing is a special case
+static void
+FillFrame(uint8* bits, int32 bytesPerRow, int32 width, int32 height,
+	uint32 seed)
+{
+	for (int32 y = 0; y < height; y++) {
+		uint32* row = (uint32*)(bits + y * bytesPerRow);
+		for (int32 x = 0; x < width; x++) {
+			seed = seed * 1103515245 + 12345;
+			const uint32 noise = (seed >> 16) & 0x0f;
+			row[x] = 0xff000000 | (((x * 255 / width) ^ noise) << 16)
+				| (((y * 255 / height) ^ noise) << 8) | ((x + y) & 0xff);
+		}
+	}
+}
+
+
+static const char*
+ColorSpaceName(color_space colorSpace)
+{
+	for (size_t i = 0; i < sizeof(kColorSpaces) / sizeof(kColorSpaces[0]); i++) {
+		if (kColorSpaces[i].colorSpace == colorSpace)
+			return kColorSpaces[i].name;
+	}
+	return "unknown";
+}
+
+
+// The row copies and conversions used to read the screen
+static void
+BenchmarkReadConversions(const frame_size& size, const uint8* source,
+	int32 sourceBytesPerRow, uint8* dest)
+{
+	for (size_t i = 0; i < sizeof(kColorSpaces) / sizeof(kColorSpaces[0]); i++) {
+		const color_space to = kColorSpaces[i].colorSpace;
+		if (!DirectFrameBuffer::CanConvert(B_RGB32, to))
+			continue;
+		int32 destBytesPerRow;
+		ColorConverter::GetFrameLayout(to, size.width, size.height,
+			&destBytesPerRow, NULL);
+
+		const int64 pixels = int64(size.width) * size.height;
+		const double scalar = Measure([&]() {
+			return ScalarDirectFrameBuffer::ConvertRows(source,
+				sourceBytesPerRow, B_RGB32, dest, destBytesPerRow, to,
+				size.width, size.height);
+		}, pixels);
+		const double simd = Measure([&]() {
+			return DirectFrameBuffer::ConvertRows(source, sourceBytesPerRow,
+				B_RGB32, dest, destBytesPerRow, to, size.width, size.height);
+		}, pixels);
+
+		BString variant;
+		variant << "RGB32->" << ColorSpaceName(to);
+		PrintResult("read_row", variant.String(), size, scalar, simd);
+	}
+}
+
+
+// The conversions to the color spaces of the codecs, on one thread
+static void
+BenchmarkEncodeConversions(const frame_size& size, const uint8* source,
+	int32 sourceBytesPerRow, uint8* dest)
+{
+	const color_space kTargets[] = { B_YCbCr422, B_YCbCr420 };
+	for (size_t i = 0; i < sizeof(kTargets) / sizeof(kTargets[0]); i++) {
+		const color_space to = kTargets[i];
+		int32 destBytesPerRow;
+		ColorConverter::GetFrameLayout(to, size.width, size.height,
+			&destBytesPerRow, NULL);
+
+		const int64 pixels = int64(size.width) * size.height;
+		const double scalar = Measure([&]() {
+			return ScalarColorConverter::Convert(NULL, source,
+				sourceBytesPerRow, B_RGB32, dest, destBytesPerRow, to,
+				size.width, size.height);
+		}, pixels);
+		const double simd = Measure([&]() {
+			return ColorConverter::Convert(NULL, source, sourceBytesPerRow,
+				B_RGB32, dest, destBytesPerRow, to, size.width, size.height);
+		}, pixels);
+
+		BString variant;
+		variant << "RGB32->" << ColorSpaceName(to);
+		PrintResult("convert", variant.String(), size, scalar, simd);
+	}
+}
+
+
+// To half the size, on one thread. Counted in source pixels
+static void
+BenchmarkScaler(const frame_size& size, const uint8* source,
+	int32 sourceBytesPerRow, uint8* dest)
+{
+	const int32 destWidth = size.width / 2;
+	const int32 destHeight = size.height / 2;
+	const int32 destBytesPerRow = destWidth * 4;
+	for (size_t i = 0; i < sizeof(kScaleKernels) / sizeof(kScaleKernels[0]); i++) {
+		ScalarFrameScaler scalarScaler(
+			(ScalarFrameScaler::scale_kernel)kScaleKernels[i].kernel);
+		FrameScaler scaler(kScaleKernels[i].kernel);
+
+		const int64 pixels = int64(size.width) * size.height;
+		const double scalar = Measure([&]() {
+			return scalarScaler.Scale(source, sourceBytesPerRow, size.width,
+				size.height, dest, destBytesPerRow, destWidth, destHeight);
+		}, pixels);
+		const double simd = Measure([&]() {
+			return scaler.Scale(source, sourceBytesPerRow, size.width,
+				size.height, dest, destBytesPerRow, destWidth, destHeight);
+		}, pixels);
+
+		PrintResult("scale", kScaleKernels[i].name, size, scalar, simd);
+	}
+}
+
+
+// Hashes the tiles of every frame. Two frames which differ in one
+// band take turns, so both the unchanged and the changed path run
+static void
+BenchmarkTileDelta(const frame_size& size, BBitmap* frames[2])
+{
+	TileDeltaEncoder encoder;
+	int32 frame = 0;
+	const double scalar = Measure([&]() {
+		const void* data;
+		size_t length;
+		bool keyFrame;
+		return encoder.Encode(frames[frame++ & 1], &data, &length, &keyFrame);
+	}, int64(size.width) * size.height);
+
+	PrintResult("tile_delta", "RGB32", size, scalar, -1);
+}
+
+
+// Draws the pointer over the frame. Counted in pointer pixels,
+// since the frame size doesn't matter
+static void
+BenchmarkCursor(const frame_size& size, BBitmap* frame)
+{
+	CursorTrack track;
+	track.AddSample(0, BPoint(size.width / 2, size.height / 2));
+	const double scalar = Measure([&]() {
+		return track.DrawCursor(frame, 0);
+	}, 10 * 16);
+
+	PrintResult("cursor", "RGB32", size, scalar, -1);
+}
+
+
+int
+main()
+{
+	// BBitmap needs a connection to the app_server
+	BApplication application("application/x-vnd.BeScreenCapture-PixelBenchmark");
+
+	printf("# BeScreenCapture pixel kernels, in %s per pixel\n",
+#if HAVE_CYCLE_COUNTER
+		"cycles"
+#else
+		"nanoseconds"
+#endif
+		);
+	printf("kernel\tvariant\tsize\tscalar\t" SIMD_NAME "\tspeedup\n");
+
+	for (size_t i = 0; i < sizeof(kFrameSizes) / sizeof(kFrameSizes[0]); i++) {
+		const frame_size& size = kFrameSizes[i];
+
+		const BRect bounds(0, 0, size.width - 1, size.height - 1);
+		BBitmap* frames[2];
+		frames[0] = new (std::nothrow) BBitmap(bounds, B_RGB32);
+		frames[1] = new (std::nothrow) BBitmap(bounds, B_RGB32);
+		// Big enough for any result
+		uint8* dest = (uint8*)malloc(size_t(size.width) * size.height * 4);
+		if (frames[0] == NULL || frames[0]->InitCheck() != B_OK
+			|| frames[1] == NULL || frames[1]->InitCheck() != B_OK
+			|| dest == NULL) {
+			fprintf(stderr, "Not enough memory for %s frames\n", size.name);
+			delete frames[0];
+			delete frames[1];
+			free(dest);
+			return 1;
+		}
+
+		const int32 bytesPerRow = frames[0]->BytesPerRow();
+		FillFrame((uint8*)frames[0]->Bits(), bytesPerRow, size.width,
+			size.height, 1);
+		::memcpy(frames[1]->Bits(), frames[0]->Bits(), frames[0]->BitsLength());
+		FillFrame((uint8*)frames[1]->Bits() + size.height / 2 * bytesPerRow,
+			bytesPerRow, size.width, size.height / 16, 2);
+
+		const uint8* source = (const uint8*)frames[0]->Bits();
+		BenchmarkReadConversions(size, source, bytesPerRow, dest);
+		BenchmarkEncodeConversions(size, source, bytesPerRow, dest);
+		BenchmarkScaler(size, source, bytesPerRow, dest);
+		BenchmarkTileDelta(size, frames);
+		BenchmarkCursor(size, frames[0]);
+
+		delete frames[0];
+		delete frames[1];
+		free(dest);
+	}
+	return 0;
+}
@@ -0,0 +1,13 @@
+/*
+ * Copyright 2026 Stefano Ceccherini <stefano.ceccherini@gmail.com>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+
+// DirectFrameBuffer.cpp without SIMD: see ScalarKernels.h
+#undef __SSE2__
+
+#define ColorConverter ScalarColorConverter
+#define DirectFrameBuffer ScalarDirectFrameBuffer
+#define FrameScaler ScalarFrameScaler
+
+#include "DirectFrameBuffer.cpp"
@@ -0,0 +1,33 @@
+/*
+ * Copyright 2026 Stefano Ceccherini <stefano.ceccherini@gmail.com>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+#ifndef __SCALARKERNELS_H
+#define __SCALARKERNELS_H
+
+// The pixel kernels of the application, built a second time without
+// SIMD (see the Scalar*.cpp files) so both versions can be timed in
+// the same executable. The classes are renamed, so they don't clash
+// with the ones built from the original sources.
+
+#include "ColorConverter.h"
+#include "DirectFrameBuffer.h"
+#include "FrameScaler.h"
+
+#define ColorConverter ScalarColorConverter
+#define DirectFrameBuffer ScalarDirectFrameBuffer
+#define FrameScaler ScalarFrameScaler
+
+#undef __COLORCONVERTER_H
+#undef __DIRECTFRAMEBUFFER_H
+#undef __FRAMESCALER_H
+
+#include "ColorConverter.h"
+#include "DirectFrameBuffer.h"
+#include "FrameScaler.h"
+
+#undef ColorConverter
+#undef DirectFrameBuffer
+#undef FrameScaler
+
+#endif // __SCALARKERNELS_H
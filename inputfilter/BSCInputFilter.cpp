@@ -23,9 +23,15 @@ public:
 	filter_result	Filter(BMessage* message, BList* outList);
 	void SetEnabled(bool enabled);
 private:
+	void _ToggleCapture();
+	void _SaveReplay();
+
 	BLooper* fLooper;
 	BLocker fLocker;
 	BMessenger fMessenger;
+	// Kept until the application quits, so a keypress doesn't
+	// have to ask the roster
+	BMessenger fAppMessenger;
 	node_ref fNodeRef;
 	bool fEnabled;
 };
@@ -123,7 +129,7 @@ BSCInputFilter::Filter(BMessage* message, BList* outList)
 			if ((modifiers & B_CONTROL_KEY)
 					&& (modifiers & B_COMMAND_KEY)
 					&& (modifiers & B_SHIFT_KEY)) {
-				if (key == 'r') {
+				if (key == 'r' || key == 's') {
 					int32 repeat;
 					if (message->FindInt32("be:key_repeat", &repeat) == B_OK) {
 						// Ignore repeat keypresses
@@ -135,13 +141,10 @@ BSCInputFilter::Filter(BMessage* message, BList* outList)
 						return B_SKIP_MESSAGE;
 					}
 
-					BMessage msg(kMsgGUIToggleCapture);
-					if (be_roster->IsRunning(kAppSignature)) {
-						BMessenger messenger(kAppSignature);
-						messenger.SendMessage(&msg);
-					} else
-						be_roster->Launch(kAppSignature, &msg);
-
+					if (key == 'r')
+						_ToggleCapture();
+					else
+						_SaveReplay();
 					return B_SKIP_MESSAGE;
 				}
 			}
@@ -153,6 +156,32 @@ BSCInputFilter::Filter(BMessage* message, BList* outList)
 }
 
 
+void
+BSCInputFilter::_ToggleCapture()
+{
+	BMessage msg(kMsgGUIToggleCapture);
+	if (fAppMessenger.IsValid() && fAppMessenger.SendMessage(&msg) == B_OK)
+		return;
+
+	fAppMessenger = BMessenger(kAppSignature);
+	if (fAppMessenger.IsValid() && fAppMessenger.SendMessage(&msg) == B_OK)
+		return;
+
+	be_roster->Launch(kAppSignature, &msg);
+}
+
+
+// Only makes sense if the application is running
+void
+BSCInputFilter::_SaveReplay()
+{
+	if (!fAppMessenger.IsValid())
+		fAppMessenger = BMessenger(kAppSignature);
+	if (fAppMessenger.IsValid())
+		fAppMessenger.SendMessage(kMsgGUISaveReplay);
+}
+
+
 void
 BSCInputFilter::SetEnabled(bool enable)
 {